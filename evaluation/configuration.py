@@ -8,6 +8,9 @@ parser.add_argument('--method', type=int, default=0,
                     help="Evaluation method: 0 - all, 1 - memory footprint, 2 - CPU time, 3 - hash performance, 4 - parallel efficiency, 5 - GPU time."
                          "Default: 0")
 parser.add_argument("--iterations", type=int, default=10, help="Number of iterations for each evaluation. Default: 10")
+parser.add_argument("--mesh-cache", action="store_true",
+                    help="Load the datasets through the binary mesh cache, which is written by the first run. "
+                         "The cache has no point or cell data, so the attributes are not gathered. Default: off")
 
 # Parse the command-line arguments
 args = parser.parse_args()
@@ -49,6 +52,8 @@ fig_gpu_time_dir = os.path.join(figures_dir, "gpu_time")
 
 # Executables
 executable = os.path.join(build_dir, "vtk-external-facelist-evaluation")
+if args.mesh_cache:
+    executable = f"{executable} --mesh-cache --cache-read-ahead"
 time_executable = shutil.which("time")
 memory_evaluator = f"{time_executable} -v"
 perf_executable = shutil.which("perf")
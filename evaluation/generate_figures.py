@@ -206,7 +206,15 @@ def get_experiment_average_time_of_algorithm(experiment):
     algorithm_name = experiment['algorithm-name']
     hash_function = experiment['hash-name']
     algorithm_full_name = f"{algorithm_name}-{hash_function}" if hash_function != "None" else algorithm_name
-    trials = experiment.get('trials', [])
+    # the statistics leave out the failed trials and the outliers
+    statistics = experiment.get('statistics', {}).get('seconds-total')
+    if statistics is not None:
+        avg_time = statistics['mean'] if statistics.get('count', 0) > 0 else float('nan')
+        return algorithm_full_name, avg_time
+    trials = [trial for trial in experiment.get('trials', [])
+              if not trial.get('failed', False) and 'seconds-total' in trial]
+    if not trials and experiment.get('trials'):
+        return algorithm_full_name, float('nan')
     total_time = sum(trial['seconds-total'] for trial in trials)
     avg_time = total_time / len(trials) if trials else 0
     return algorithm_full_name, avg_time
@@ -58,24 +58,142 @@ void Arguments::ParseArguments(int argc, char** argv)
 {
   std::unique_ptr<CLI::App> app = std::make_unique<CLI::App>("External Facelist Evaluation");
 
-  app->add_option("-i,--input", this->InputFileName, "Input file name")->required();
+  app->add_option("-i,--input", this->InputFileName, "Input file name");
+
+  app
+    ->add_option("-g,--generate", this->GenerateType,
+      "Generate a uniform grid of hexahedra, of tetrahedra, of wedges, or of mixed hexahedra, "
+      "wedges and pyramids instead of reading an input file")
+    ->check(CLI::IsMember({ "hex", "tet", "wedge", "mixed" }))
+    ->excludes("--input");
+
+  app
+    ->add_option("--generate-cells", this->GenerateCells,
+      "Approximate number of cells of the generated mesh (Default: 1000000)")
+    ->check(CLI::PositiveNumber)
+    ->needs("--generate");
+
+  app
+    ->add_option("--generate-holes", this->GenerateHoles,
+      "Number of spherical holes inside the generated mesh, placed using the seed (Default: 0)")
+    ->needs("--generate");
+
+  app
+    ->add_flag("--parallel-read", this->ParallelRead,
+      "Decode the appended data arrays and pieces of the input concurrently. Always used for "
+      ".pvtu files")
+    ->excludes("--generate");
+
+  app
+    ->add_flag("--mesh-cache", this->MeshCache,
+      "Load the points and cells of the input from a binary cache next to it, which is written "
+      "on first load. Point and cell data are not cached, and are dropped if the cache cannot be "
+      "written, so that every run processes the same workload")
+    ->excludes("--generate");
+
+  app
+    ->add_flag("--cache-read-ahead", this->CacheReadAhead,
+      "Populate the mapped mesh cache before running the algorithms")
+    ->needs("--mesh-cache");
 
   app->add_option("-t,--threads", this->NumberOfThreads, "Number of threads (Default: 1)")
     ->check(CLI::Range(1u, std::thread::hardware_concurrency()));
 
+  app
+    ->add_option("--thread-sweep", this->ThreadSweep,
+      "Comma separated numbers of threads with which all algorithms run on the same loaded "
+      "input, reporting the speedup and efficiency relative to the first one")
+    ->delimiter(',')
+    ->check(CLI::Range(1u, std::thread::hardware_concurrency()))
+    ->excludes("--threads");
+
   app->add_option("-d,--device", this->DeviceName,
     "Device name. Available: " + ::GetValidDeviceNames() + ". (Default: TBB).");
 
-  app->add_option("-n,--trials", this->NumberOfTrials, "Number of trials (Default: 1)");
+  app->add_option("-n,--trials", this->NumberOfTrials,
+    "Number of trials, which is the minimum number of trials with --target-ci or --time-budget "
+    "(Default: 1)");
+
+  app->add_option("--warmup", this->WarmupRuns,
+    "Number of untimed runs of each algorithm before its trials (Default: 0)");
+
+  app
+    ->add_option("--target-ci", this->TargetRelativeCI,
+      "Repeat the trials until the 95% confidence interval of the total time, relative to its "
+      "mean, is below this value, where 0 runs exactly --trials trials (Default: 0)")
+    ->check(CLI::NonNegativeNumber);
+
+  app
+    ->add_option("--max-trials", this->MaxTrials,
+      "Maximum number of trials with --target-ci or --time-budget (Default: 100)")
+    ->check(CLI::PositiveNumber);
+
+  app
+    ->add_option("--time-budget", this->TimeBudget,
+      "Repeat the trials of an algorithm until they took this many seconds, or until "
+      "--target-ci is reached, where 0 disables it (Default: 0)")
+    ->check(CLI::NonNegativeNumber);
+
+  app
+    ->add_option("--outlier-threshold", this->OutlierThreshold,
+      "Modified z-score above which a trial is excluded from the statistics, where 0 keeps all "
+      "trials (Default: 3.5)")
+    ->check(CLI::NonNegativeNumber);
+
+  app->add_flag("--perf-counters", this->PerfCounters,
+    "Count cycles, instructions, LLC misses, dTLB misses and branch misses of every timed phase "
+    "and VTK filter run through perf_event_open, skipping unavailable counters");
+
+  app->add_flag("--memory-profile", this->MemoryProfile,
+    "Count heap allocations and report the peak heap, allocated bytes and resident set size of "
+    "every timed phase, VTK filter run and VTK-m algorithm run, in builds with the "
+    "EFL_MEMORY_TRACKING CMake option");
+
+  app->add_option("--trace", this->TraceFile,
+    "Write a Chrome trace of the timed phases, the algorithm runs and the per-thread chunks of "
+    "the P-Classifier and P-Hash filters to this file");
+
+  app->add_option("--metrics-jsonl", this->MetricLinesFile,
+    "Also write the metrics of every trial to this file in the JSON Lines format, one object "
+    "per trial");
+
+  app
+    ->add_option("--cache-mode", this->CacheMode,
+      "State of the caches before every trial, where cold flushes the caches and pages out the "
+      "mapped mesh cache, warm runs the algorithm untimed right before the trial to touch its "
+      "outputs and workspaces, and default leaves them as the previous run left them "
+      "(Default: default)")
+    ->check(CLI::IsMember({ "default", "cold", "warm" }));
 
   app->add_flag("-r,--randomize", this->Randomize, "Randomize connections of generated topology");
 
-  app->add_option("-s,--seed", this->RandomSeed, "Randomized seed (Default: 1234567890)")
+  app->add_option("-s,--seed", this->RandomSeed,
+    "Seed of the randomization and of the generated holes (Default: 1234567890)");
+
+  app
+    ->add_option("--permute", this->PermutationTarget,
+      "Entities that are randomly permuted, where points renumbers the points used by the "
+      "connectivity, cells reorders the cells, and both does both (Default: points)")
+    ->check(CLI::IsMember({ "points", "cells", "both" }))
+    ->needs("--randomize");
+
+  app
+    ->add_option("--permute-window", this->PermutationWindow,
+      "Size of the windows inside which entities are shuffled, where 0 shuffles all entities "
+      "(Default: 0)")
+    ->check(CLI::NonNegativeNumber)
     ->needs("--randomize");
 
   app->add_flag(
     "--hash-distribution", this->HashDistribution, "Run the Hash Distribution algorithm");
 
+  app
+    ->add_option("--hash-table-sizes", this->HashTableSizes,
+      "Additional hash table sizes analyzed by the Hash Distribution algorithm, which always "
+      "analyzes the number of points")
+    ->check(CLI::PositiveNumber)
+    ->needs("--hash-distribution");
+
   app->add_flag("--s-classifier", this->SClassifier, "Run the S-Classifier algorithm");
 
   app->add_flag("--s-hash", this->SHash, "Run the S-Hash algorithm");
@@ -95,9 +213,75 @@ void Arguments::ParseArguments(int argc, char** argv)
       "Hash function, where 0 is All, 1 is FNV1A, 2 is MinPointID (Default: 0)")
     ->check(CLI::Range(0, 2));
 
+  app
+    ->add_option("--point-map", this->PointMap,
+      "Tracking of the used points by the P-Hash and P-Classifier algorithms, where array writes "
+      "an id per input point, bitset sets a bit per used point and derives the output ids from a "
+      "parallel prefix sum, which only P-Hash supports, and fused numbers the points on first "
+      "touch during extraction (Default: array)")
+    ->check(CLI::IsMember({ "array", "bitset", "fused" }));
+
+  app
+    ->add_option("--extent", this->Extent,
+      "Comma separated xmin,xmax,ymin,ymax,zmin,zmax box to which the surfaces are clipped, "
+      "keeping the cells inside of it. The VTK algorithms clip with their extent clipping, and "
+      "the DP-Hash-* algorithms run on a grid of the cells inside of the box, whose selection "
+      "time is added to every run")
+    ->delimiter(',')
+    ->expected(6)
+    ->excludes("--s-hash");
+
+  app
+    ->add_flag("--bin-grid", this->BinGrid,
+      "Build a grid of bins over the cells once, through which the P-Classifier and P-Hash "
+      "algorithms only visit the cells near the --extent box, and the cells of the box are "
+      "found for the DP-Hash-* algorithms")
+    ->needs("--extent");
+
+  app
+    ->add_option("--cell-mask", this->CellMask,
+      "Name of an unsigned char or bit cell array of the input, where the P-Hash and DP-Hash-* "
+      "algorithms extract the boundary of the cells with a non-zero value, so that the faces "
+      "shared with the other cells are external")
+    ->excludes("--s-classifier")
+    ->excludes("--s-hash")
+    ->excludes("--p-classifier")
+    ->excludes("--mesh-cache");
+
+  app
+    ->add_option("--region-ids", this->RegionIds,
+      "Name of an integral cell array of the input with the region, e.g. the material, of each "
+      "cell, where the P-Hash and DP-Hash-Count algorithms also extract the faces shared by "
+      "cells of different regions")
+    ->excludes("--s-classifier")
+    ->excludes("--s-hash")
+    ->excludes("--p-classifier")
+    ->excludes("--dp-hash-sort")
+    ->excludes("--dp-hash-fight")
+    ->excludes("--mesh-cache");
+
+  app->add_flag("--face-neighbors", this->FaceNeighbors,
+    "Also build the face adjacency of the input cells, the neighbor cell of every face of every "
+    "cell or -1 on the boundary, in the DP-Hash-Count and DP-Hash-Sort algorithms");
+
+  app->add_flag("--cache-topology", this->CacheTopology,
+    "Keep the surface of the first run of the P-Hash and DP-Hash-* algorithms, so that the "
+    "later runs on the same cells only gather the points and attributes again, which P-Hash "
+    "does without --extent");
+
+  app
+    ->add_option("--memory-mode", this->MemoryMode,
+      "Dataset representations kept in memory, where both keeps the VTK and VTK-m datasets, and "
+      "single releases the VTK dataset once only VTK-m algorithms remain (Default: both)")
+    ->check(CLI::IsMember({ "both", "single" }));
+
   try
   {
     app->parse(argc, argv);
+    if (this->InputFileName.empty() && this->GenerateType.empty())
+    {
+      throw CLI::RequiredError("--input or --generate");
+    }
   }
   catch (const CLI::CallForHelp& e)
   {
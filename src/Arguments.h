@@ -6,15 +6,35 @@
 #define CLI_H
 
 #include <string>
+#include <vector>
 
 struct Arguments
 {
   std::string InputFileName;
+  std::string GenerateType;
+  long long GenerateCells = 1000000;
+  unsigned int GenerateHoles = 0;
+  bool ParallelRead = false;
+  bool MeshCache = false;
+  bool CacheReadAhead = false;
   unsigned int NumberOfThreads = 1;
+  std::vector<unsigned int> ThreadSweep;
   std::string DeviceName = "TBB";
   unsigned int NumberOfTrials = 1;
+  unsigned int WarmupRuns = 0;
+  double TargetRelativeCI = 0.0;
+  unsigned int MaxTrials = 100;
+  double TimeBudget = 0.0;
+  double OutlierThreshold = 3.5;
+  bool PerfCounters = false;
+  bool MemoryProfile = false;
+  std::string TraceFile;
+  std::string MetricLinesFile;
+  std::string CacheMode = "default";
   bool Randomize = false;
   unsigned int RandomSeed = 1234567890;
+  std::string PermutationTarget = "points";
+  long long PermutationWindow = 0;
 
   bool HashDistribution = false;
   bool SClassifier = false;
@@ -26,6 +46,16 @@ struct Arguments
   bool DPHashCount = false;
 
   int HashFunction = 0;
+  std::vector<long long> HashTableSizes;
+  std::string PointMap = "array";
+  std::vector<double> Extent;
+  bool BinGrid = false;
+  std::string CellMask;
+  std::string RegionIds;
+  bool FaceNeighbors = false;
+  bool CacheTopology = false;
+
+  std::string MemoryMode = "both";
 
   /**
    * @brief Parse command line arguments.
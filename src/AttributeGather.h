@@ -0,0 +1,154 @@
+//============================================================================
+//  Copyright (c) Kitware, Inc.
+//  All rights reserved.
+//  See LICENSE.txt for details.
+//  This software is distributed WITHOUT ANY WARRANTY; without even
+//  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+//  PURPOSE.  See the above copyright notice for more information.
+//============================================================================
+#ifndef _AttributeGather_h
+#define _AttributeGather_h
+
+#include <vtkArrayDispatch.h>
+#include <vtkDataArray.h>
+#include <vtkDataArrayRange.h>
+#include <vtkDataSetAttributes.h>
+#include <vtkType.h>
+
+#include <vector>
+
+namespace detail
+{
+template <int NumberOfComponents, typename InRange, typename OutRange, typename IdType>
+void GatherTuples(const InRange& input, OutRange& output, const IdType* inputIds,
+  vtkIdType outputBegin, vtkIdType count)
+{
+  auto out = output.begin() + outputBegin * NumberOfComponents;
+  for (vtkIdType i = 0; i < count; ++i)
+  {
+    const auto in = input.begin() + static_cast<vtkIdType>(inputIds[i]) * NumberOfComponents;
+    for (int c = 0; c < NumberOfComponents; ++c)
+    {
+      *out++ = in[c];
+    }
+  }
+}
+
+struct GatherWorker
+{
+  template <typename InArray, typename OutArray, typename IdType>
+  void operator()(InArray* inArray, OutArray* outArray, const IdType* inputIds,
+    vtkIdType outputBegin, vtkIdType count) const
+  {
+    const auto input = vtk::DataArrayValueRange(inArray);
+    auto output = vtk::DataArrayValueRange(outArray);
+    // fixed component counts let the compiler unroll and vectorize the common cases
+    switch (inArray->GetNumberOfComponents())
+    {
+      case 1:
+        GatherTuples<1>(input, output, inputIds, outputBegin, count);
+        break;
+      case 2:
+        GatherTuples<2>(input, output, inputIds, outputBegin, count);
+        break;
+      case 3:
+        GatherTuples<3>(input, output, inputIds, outputBegin, count);
+        break;
+      case 4:
+        GatherTuples<4>(input, output, inputIds, outputBegin, count);
+        break;
+      case 6:
+        GatherTuples<6>(input, output, inputIds, outputBegin, count);
+        break;
+      case 9:
+        GatherTuples<9>(input, output, inputIds, outputBegin, count);
+        break;
+      default:
+      {
+        const int numberOfComponents = inArray->GetNumberOfComponents();
+        auto out = output.begin() + outputBegin * numberOfComponents;
+        for (vtkIdType i = 0; i < count; ++i)
+        {
+          const auto in =
+            input.begin() + static_cast<vtkIdType>(inputIds[i]) * numberOfComponents;
+          for (int c = 0; c < numberOfComponents; ++c)
+          {
+            *out++ = in[c];
+          }
+        }
+      }
+    }
+  }
+};
+}
+
+/// \brief Copies the attribute arrays of an output from its input one array at a time.
+///
+/// ArrayList copies all arrays of one tuple per call, through a virtual call per array and
+/// tuple. Instead, \c Gather takes the input ids of a range of output tuples and copies each
+/// array over the whole range with a loop typed on its value type and number of components.
+/// Gathers of disjoint output ranges can run concurrently.
+class AttributeGather
+{
+public:
+  /// Pairs the input arrays with the output arrays of the same name that CopyAllocate or
+  /// InterpolateAllocate created, like ArrayList::AddArrays, and sizes the output arrays.
+  void AddArrays(vtkIdType numberOfTuples, vtkDataSetAttributes* input,
+    vtkDataSetAttributes* output)
+  {
+    for (int i = 0; i < input->GetNumberOfArrays(); ++i)
+    {
+      vtkDataArray* inArray = input->GetArray(i);
+      if (!inArray || !inArray->GetName() || inArray->GetDataType() == VTK_BIT)
+      {
+        continue;
+      }
+      vtkDataArray* outArray = output->GetArray(inArray->GetName());
+      if (!outArray || outArray->GetDataType() != inArray->GetDataType() ||
+        outArray->GetNumberOfComponents() != inArray->GetNumberOfComponents())
+      {
+        continue;
+      }
+      outArray->SetNumberOfTuples(numberOfTuples);
+      this->Pairs.push_back(Pair{ inArray, outArray });
+    }
+  }
+
+  bool IsEmpty() const { return this->Pairs.empty(); }
+
+  /// Copies the tuples inputIds[i] of the input arrays to the tuples outputBegin + i of the
+  /// output arrays, for i in [0, count).
+  template <typename IdType>
+  void Gather(const IdType* inputIds, vtkIdType outputBegin, vtkIdType count) const
+  {
+    if (count <= 0)
+    {
+      return;
+    }
+    detail::GatherWorker worker;
+    for (const Pair& pair : this->Pairs)
+    {
+      if (!vtkArrayDispatch::Dispatch2SameValueType::Execute(
+            pair.Input, pair.Output, worker, inputIds, outputBegin, count))
+      {
+        // fallback for array types that are not dispatched
+        for (vtkIdType i = 0; i < count; ++i)
+        {
+          pair.Output->SetTuple(
+            outputBegin + i, static_cast<vtkIdType>(inputIds[i]), pair.Input);
+        }
+      }
+    }
+  }
+
+private:
+  struct Pair
+  {
+    vtkDataArray* Input;
+    vtkDataArray* Output;
+  };
+
+  std::vector<Pair> Pairs;
+};
+
+#endif //_AttributeGather_h
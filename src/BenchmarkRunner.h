@@ -0,0 +1,282 @@
+//============================================================================
+//  Copyright (c) Kitware, Inc.
+//  All rights reserved.
+//  See LICENSE.txt for details.
+//  This software is distributed WITHOUT ANY WARRANTY; without even
+//  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+//  PURPOSE.  See the above copyright notice for more information.
+//============================================================================
+#ifndef _BenchmarkRunner_h
+#define _BenchmarkRunner_h
+
+#include "YamlWriter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+class CacheConditioner;
+
+/// How the trials of an algorithm are repeated.
+struct BenchmarkOptions
+{
+  /// Untimed runs before the trials.
+  unsigned int WarmupRuns = 0;
+  /// Trials that always run.
+  unsigned int MinTrials = 1;
+  /// Trials after which the runner stops.
+  unsigned int MaxTrials = 1;
+  /// Relative half-width of the 95% confidence interval of seconds-total at which the runner
+  /// stops, where 0 disables it.
+  double TargetRelativeCI = 0.0;
+  /// Seconds of trials after which the runner stops, where 0 disables it.
+  double TimeBudget = 0.0;
+  /// Modified z-score above which a sample is an outlier, where 0 disables outlier rejection.
+  double OutlierThreshold = 3.5;
+  /// Stream that also receives the metrics of every trial as a JSON line, or nullptr.
+  std::ostream* MetricLines = nullptr;
+  /// Conditions the caches before every trial, or nullptr to leave them as the previous run left
+  /// them.
+  CacheConditioner* Cache = nullptr;
+};
+
+/// Statistics of the samples of a timed phase that are not outliers.
+struct SampleStatistics
+{
+  std::size_t Count = 0;
+  std::size_t Outliers = 0;
+  double Min = 0.0;
+  double Median = 0.0;
+  double Mean = 0.0;
+  double StdDev = 0.0;
+  /// Half-width of the 95% confidence interval of the mean.
+  double CIHalfWidth = 0.0;
+
+  double GetRelativeCI() const { return this->Mean > 0.0 ? this->CIHalfWidth / this->Mean : 0.0; }
+};
+
+namespace detail
+{
+inline double GetMedian(const std::vector<double>& sortedValues)
+{
+  const std::size_t n = sortedValues.size();
+  return n % 2 == 1 ? sortedValues[n / 2] : 0.5 * (sortedValues[n / 2 - 1] + sortedValues[n / 2]);
+}
+
+// Two-sided 95% quantile of the Student t distribution.
+inline double GetStudentT95(std::size_t degreesOfFreedom)
+{
+  static const double table[30] = { 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306,
+    2.262, 2.228, 2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086, 2.080,
+    2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042 };
+  if (degreesOfFreedom == 0)
+  {
+    return 0.0;
+  }
+  if (degreesOfFreedom <= 30)
+  {
+    return table[degreesOfFreedom - 1];
+  }
+  return 1.96 + 2.37 / static_cast<double>(degreesOfFreedom);
+}
+} // namespace detail
+
+/// \brief Computes the statistics of samples after rejecting outliers.
+///
+/// A sample is an outlier if its modified z-score, 0.6745 |x - median| / MAD, where MAD is the
+/// median absolute deviation, is above the threshold.
+inline SampleStatistics ComputeSampleStatistics(
+  std::vector<double> samples, double outlierThreshold)
+{
+  SampleStatistics statistics;
+  if (samples.empty())
+  {
+    return statistics;
+  }
+  std::sort(samples.begin(), samples.end());
+  if (outlierThreshold > 0.0 && samples.size() > 2)
+  {
+    const double median = detail::GetMedian(samples);
+    std::vector<double> deviations(samples.size());
+    std::transform(samples.begin(), samples.end(), deviations.begin(),
+      [median](double x) { return std::abs(x - median); });
+    std::sort(deviations.begin(), deviations.end());
+    const double mad = detail::GetMedian(deviations);
+    if (mad > 0.0)
+    {
+      const std::size_t numberOfSamples = samples.size();
+      samples.erase(std::remove_if(samples.begin(), samples.end(),
+                      [&](double x)
+                      { return 0.6745 * std::abs(x - median) / mad > outlierThreshold; }),
+        samples.end());
+      statistics.Outliers = numberOfSamples - samples.size();
+    }
+  }
+
+  const std::size_t n = samples.size();
+  statistics.Count = n;
+  statistics.Min = samples.front();
+  statistics.Median = detail::GetMedian(samples);
+  double sum = 0.0;
+  for (const double x : samples)
+  {
+    sum += x;
+  }
+  statistics.Mean = sum / static_cast<double>(n);
+  if (n > 1)
+  {
+    double squaredDeviations = 0.0;
+    for (const double x : samples)
+    {
+      squaredDeviations += (x - statistics.Mean) * (x - statistics.Mean);
+    }
+    statistics.StdDev = std::sqrt(squaredDeviations / static_cast<double>(n - 1));
+    statistics.CIHalfWidth =
+      detail::GetStudentT95(n - 1) * statistics.StdDev / std::sqrt(static_cast<double>(n));
+  }
+  return statistics;
+}
+
+/// \brief Repeats the trials of an algorithm until its timings are trustworthy.
+///
+/// While a trial runs, the runner observes the numeric seconds-* entries written to the log,
+/// which are seconds-total and the phases of the algorithm. After the minimum number of trials,
+/// it stops once the confidence interval of seconds-total is narrow enough or the time budget
+/// is spent, whichever is enabled first, or when the maximum number of trials is reached.
+/// \c WriteStatistics then writes the statistics of every phase.
+///
+/// The samples of a failed trial are discarded, while the trial still counts towards the
+/// maximum number of trials, so that an algorithm that always fails stops.
+class BenchmarkRunner
+{
+public:
+  explicit BenchmarkRunner(const BenchmarkOptions& options)
+    : Options(options)
+  {
+  }
+
+  bool NeedsMoreTrials() const
+  {
+    const std::size_t trials = this->NumberOfTrials;
+    if (trials >= this->Options.MaxTrials)
+    {
+      return false;
+    }
+    if (trials < this->Options.MinTrials)
+    {
+      return true;
+    }
+    if (this->Options.TimeBudget > 0.0 &&
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - this->Start).count() >=
+        this->Options.TimeBudget)
+    {
+      return false;
+    }
+    if (this->Options.TargetRelativeCI <= 0.0)
+    {
+      return this->Options.TimeBudget > 0.0;
+    }
+    const auto totals = this->Samples.find("seconds-total");
+    return totals == this->Samples.end() ||
+      ComputeSampleStatistics(totals->second, this->Options.OutlierThreshold).GetRelativeCI() >
+      this->Options.TargetRelativeCI;
+  }
+
+  void StartTrial(YamlWriter& log)
+  {
+    if (this->NumberOfTrials == 0)
+    {
+      this->Start = std::chrono::steady_clock::now();
+    }
+    log.SetNumericEntryObserver(
+      [this](const std::string& key, double value)
+      {
+        if (key.compare(0, 8, "seconds-") != 0)
+        {
+          return;
+        }
+        this->TrialSamples.emplace_back(key, value);
+      });
+  }
+
+  /// Ends the trial, whose samples only enter the statistics if it succeeded.
+  void EndTrial(YamlWriter& log, bool succeeded = true)
+  {
+    log.SetNumericEntryObserver(nullptr);
+    ++this->NumberOfTrials;
+    if (!succeeded)
+    {
+      ++this->NumberOfFailedTrials;
+      this->TrialSamples.clear();
+      return;
+    }
+    for (const auto& sample : this->TrialSamples)
+    {
+      auto samples = this->Samples.find(sample.first);
+      if (samples == this->Samples.end())
+      {
+        this->Keys.push_back(sample.first);
+        samples = this->Samples.emplace(sample.first, std::vector<double>()).first;
+      }
+      samples->second.push_back(sample.second);
+    }
+    this->TrialSamples.clear();
+  }
+
+  /// Whether at least one trial succeeded.
+  bool HasSucceededTrials() const
+  {
+    return this->NumberOfTrials > this->NumberOfFailedTrials;
+  }
+
+  /// Statistics of the samples of an observed entry, e.g. seconds-total.
+  SampleStatistics GetStatistics(const std::string& key) const
+  {
+    const auto samples = this->Samples.find(key);
+    return samples == this->Samples.end()
+      ? SampleStatistics()
+      : ComputeSampleStatistics(samples->second, this->Options.OutlierThreshold);
+  }
+
+  void WriteStatistics(YamlWriter& log) const
+  {
+    log.StartBlock("statistics");
+    log.AddDictionaryEntry("warmup-runs", this->Options.WarmupRuns);
+    log.AddDictionaryEntry("trials", this->NumberOfTrials);
+    log.AddDictionaryEntry("failed-trials", this->NumberOfFailedTrials);
+    for (const std::string& key : this->Keys)
+    {
+      const SampleStatistics statistics =
+        ComputeSampleStatistics(this->Samples.at(key), this->Options.OutlierThreshold);
+      log.StartBlock(key);
+      log.AddDictionaryEntry("count", statistics.Count);
+      log.AddDictionaryEntry("outliers", statistics.Outliers);
+      log.AddDictionaryEntry("min", statistics.Min);
+      log.AddDictionaryEntry("median", statistics.Median);
+      log.AddDictionaryEntry("mean", statistics.Mean);
+      log.AddDictionaryEntry("stddev", statistics.StdDev);
+      log.AddDictionaryEntry("ci95-low", statistics.Mean - statistics.CIHalfWidth);
+      log.AddDictionaryEntry("ci95-high", statistics.Mean + statistics.CIHalfWidth);
+      log.AddDictionaryEntry("relative-ci95", statistics.GetRelativeCI());
+      log.EndBlock();
+    }
+    log.EndBlock();
+  }
+
+private:
+  BenchmarkOptions Options;
+  std::size_t NumberOfTrials = 0;
+  std::size_t NumberOfFailedTrials = 0;
+  std::chrono::steady_clock::time_point Start;
+  std::vector<std::string> Keys;
+  std::map<std::string, std::vector<double>> Samples;
+  // the samples of the running trial
+  std::vector<std::pair<std::string, double>> TrialSamples;
+};
+
+#endif //_BenchmarkRunner_h
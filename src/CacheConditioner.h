@@ -0,0 +1,215 @@
+//============================================================================
+//  Copyright (c) Kitware, Inc.
+//  All rights reserved.
+//  See LICENSE.txt for details.
+//  This software is distributed WITHOUT ANY WARRANTY; without even
+//  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+//  PURPOSE.  See the above copyright notice for more information.
+//============================================================================
+#ifndef _CacheConditioner_h
+#define _CacheConditioner_h
+
+#include "MeshCache.h"
+
+#include <vtkSMPThreadLocal.h>
+#include <vtkSMPTools.h>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+#include <unistd.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+enum class CacheMode
+{
+  Default,
+  Cold,
+  Warm
+};
+
+namespace detail
+{
+constexpr std::size_t CacheLineSize = 64;
+
+// Size of the last level cache in bytes, or 32 MiB if it cannot be determined.
+inline std::size_t GetLastLevelCacheSize()
+{
+#ifdef _SC_LEVEL3_CACHE_SIZE
+  const long level3 = sysconf(_SC_LEVEL3_CACHE_SIZE);
+  if (level3 > 0)
+  {
+    return static_cast<std::size_t>(level3);
+  }
+#endif
+  // e.g. "32768K"
+  std::ifstream sizeFile("/sys/devices/system/cpu/cpu0/cache/index3/size");
+  std::string size;
+  if (sizeFile >> size && !size.empty())
+  {
+    const std::size_t value = std::stoull(size);
+    const char unit = size.back();
+    return unit == 'K' ? value << 10 : unit == 'M' ? value << 20 : value;
+  }
+  return std::size_t(32) << 20;
+}
+}
+
+/// \brief Puts the caches into a defined state before every timed trial.
+///
+/// In cold mode, the caches are flushed by writing and then reading a buffer of four times the
+/// size of the last level cache in parallel, so that the private caches of the worker threads are
+/// flushed as well, and the pages of a mapped mesh cache are reclaimed, so that the trial faults
+/// the dataset in again like a freshly written solver output. The pages of a dataset that is not
+/// mapped from a mesh cache cannot be dropped without swapping and stay resident.
+///
+/// In warm mode, the algorithm runs once untimed right before every trial, which touches its
+/// outputs and workspaces, and the worker threads are woken up. With glibc, freed memory is kept
+/// in the heap instead of being returned to the system during the warm-up runs and trials of an
+/// algorithm, within a \c TrialScope, so that the next run reuses the touched pages instead of
+/// faulting in new ones. The first run and the rest of the process allocate with the defaults.
+class CacheConditioner
+{
+public:
+  explicit CacheConditioner(CacheMode mode)
+    : Mode(mode)
+  {
+    if (mode == CacheMode::Cold)
+    {
+      this->FlushBuffer.resize(4 * detail::GetLastLevelCacheSize(), 1);
+    }
+  }
+
+  /// \brief Tunes the heap for the warm-up runs and trials of one algorithm.
+  class TrialScope
+  {
+  public:
+    explicit TrialScope(CacheConditioner* conditioner)
+      : Conditioner(conditioner)
+    {
+      if (conditioner)
+      {
+        conditioner->BeginTrials();
+      }
+    }
+
+    ~TrialScope()
+    {
+      if (this->Conditioner)
+      {
+        this->Conditioner->EndTrials();
+      }
+    }
+
+    TrialScope(const TrialScope&) = delete;
+    TrialScope& operator=(const TrialScope&) = delete;
+
+  private:
+    CacheConditioner* Conditioner;
+  };
+
+  /// Whether the heap is tuned within a \c TrialScope.
+  bool TunesHeap() const
+  {
+#if defined(__GLIBC__)
+    return this->Mode == CacheMode::Warm;
+#else
+    return false;
+#endif
+  }
+
+  CacheMode GetMode() const { return this->Mode; }
+
+  const char* GetModeName() const
+  {
+    return this->Mode == CacheMode::Cold ? "cold"
+      : this->Mode == CacheMode::Warm    ? "warm"
+                                         : "default";
+  }
+
+  std::size_t GetFlushBytes() const { return this->FlushBuffer.size(); }
+
+  /// Conditions the caches for the next trial, where \c run runs the algorithm untimed.
+  template <typename RunFunction>
+  void Prepare(RunFunction&& run)
+  {
+    if (this->Mode == CacheMode::Cold)
+    {
+      this->FlushCaches();
+      PageOutMeshCacheSections();
+    }
+    else if (this->Mode == CacheMode::Warm)
+    {
+      run();
+      // an empty parallel loop wakes the worker threads up
+      vtkSMPTools::For(
+        0, vtkSMPTools::GetEstimatedNumberOfThreads(), [](vtkIdType, vtkIdType) {});
+    }
+  }
+
+private:
+  // the defaults of glibc
+  static constexpr int DefaultMmapMax = 65536;
+  static constexpr int DefaultTrimThreshold = 128 * 1024;
+
+  void BeginTrials()
+  {
+#if defined(__GLIBC__)
+    if (this->TunesHeap())
+    {
+      mallopt(M_MMAP_MAX, 0);
+      mallopt(M_TRIM_THRESHOLD, -1);
+    }
+#endif
+  }
+
+  // Restores the default limits, except that an explicit trim threshold no longer adapts to the
+  // sizes of the freed mapped blocks, and returns the memory that the trials kept.
+  void EndTrials()
+  {
+#if defined(__GLIBC__)
+    if (this->TunesHeap())
+    {
+      mallopt(M_MMAP_MAX, DefaultMmapMax);
+      mallopt(M_TRIM_THRESHOLD, DefaultTrimThreshold);
+      malloc_trim(0);
+    }
+#endif
+  }
+
+  void FlushCaches()
+  {
+    unsigned char* buffer = this->FlushBuffer.data();
+    const vtkIdType numberOfLines =
+      static_cast<vtkIdType>(this->FlushBuffer.size() / detail::CacheLineSize);
+    vtkSMPThreadLocal<std::uint64_t> sums(0);
+    vtkSMPTools::For(0, numberOfLines,
+      [&](vtkIdType begin, vtkIdType end)
+      {
+        std::uint64_t& sum = sums.Local();
+        for (vtkIdType line = begin; line < end; ++line)
+        {
+          buffer[line * detail::CacheLineSize] += 1;
+        }
+        for (vtkIdType line = begin; line < end; ++line)
+        {
+          sum += buffer[line * detail::CacheLineSize];
+        }
+      });
+    for (const std::uint64_t sum : sums)
+    {
+      this->Checksum += sum;
+    }
+  }
+
+  CacheMode Mode;
+  std::vector<unsigned char> FlushBuffer;
+  // keeps the reads of the flush from being optimized away
+  std::uint64_t Checksum = 0;
+};
+
+#endif //_CacheConditioner_h
@@ -0,0 +1,304 @@
+//============================================================================
+//  Copyright (c) Kitware, Inc.
+//  All rights reserved.
+//  See LICENSE.txt for details.
+//  This software is distributed WITHOUT ANY WARRANTY; without even
+//  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+//  PURPOSE.  See the above copyright notice for more information.
+//============================================================================
+#ifndef _CellBinGrid_h
+#define _CellBinGrid_h
+
+#include <vtkCellArray.h>
+#include <vtkDataSet.h>
+#include <vtkIdList.h>
+#include <vtkNew.h>
+#include <vtkPointSet.h>
+#include <vtkPoints.h>
+#include <vtkSMPThreadLocalObject.h>
+#include <vtkSMPTools.h>
+#include <vtkType.h>
+#include <vtkUnstructuredGrid.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <vector>
+
+/// \brief A uniform grid of bins over the points of a data set, holding its cells.
+///
+/// A cell is put in the bin of its first point. A cell that is inside of an extent has its first
+/// point inside of it, so the cells of the bins that overlap an extent are candidates for all of
+/// the cells inside of it, which lets the extent clipping of the geometry filters test only these
+/// candidates instead of every cell. Cells without points are never candidates.
+///
+/// The grid is built once and kept until the points or cells of its data set change, so that a
+/// small extent that moves over a large mesh only pays for the cells near it. Build and query are
+/// parallel; the cells of a bin are sorted, so the candidates do not depend on the scheduling.
+class CellBinGrid
+{
+public:
+  // cells per bin that the resolution aims for, and the largest number of bins
+  static constexpr vtkIdType CellsPerBin = 64;
+  static constexpr vtkIdType MaximumNumberOfBins = vtkIdType(1) << 22;
+
+  /// Builds the grid for the input if it was built for another data set, or if the points or
+  /// cells of the input changed since. Returns whether the grid was built.
+  bool Update(vtkDataSet* input)
+  {
+    const vtkMTimeType pointsTime = GetPointsTime(input);
+    const vtkMTimeType cellsTime = GetCellsTime(input);
+    if (input == this->DataSet && pointsTime == this->PointsTime &&
+      cellsTime == this->CellsTime && input->GetNumberOfCells() == this->NumberOfCells)
+    {
+      return false;
+    }
+    this->Build(input);
+    this->DataSet = input;
+    this->PointsTime = pointsTime;
+    this->CellsTime = cellsTime;
+    return true;
+  }
+
+  vtkIdType GetNumberOfBins() const
+  {
+    return static_cast<vtkIdType>(this->Dims[0]) * this->Dims[1] * this->Dims[2];
+  }
+
+  /// Sets cellIds to the cells of the bins that overlap the (xmin,xmax, ymin,ymax, zmin,zmax)
+  /// extent, in increasing order. Only valid after \c Update.
+  void FindCandidateCells(const double* extent, std::vector<vtkIdType>& cellIds) const
+  {
+    cellIds.clear();
+    int first[3], last[3];
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      if (!(extent[2 * axis] <= this->Bounds[2 * axis + 1] &&
+            extent[2 * axis + 1] >= this->Bounds[2 * axis]))
+      {
+        return;
+      }
+      first[axis] = this->GetBin(axis, extent[2 * axis]);
+      last[axis] = this->GetBin(axis, extent[2 * axis + 1]);
+    }
+
+    // the bins of a row along x are consecutive, so each row is one range of cells
+    struct Range
+    {
+      vtkIdType Begin;
+      vtkIdType End;
+      vtkIdType Offset;
+    };
+    std::vector<Range> ranges;
+    vtkIdType numberOfCandidates = 0;
+    for (int k = first[2]; k <= last[2]; ++k)
+    {
+      for (int j = first[1]; j <= last[1]; ++j)
+      {
+        const vtkIdType row = (static_cast<vtkIdType>(k) * this->Dims[1] + j) * this->Dims[0];
+        const vtkIdType begin = this->BinOffsets[row + first[0]];
+        const vtkIdType end = this->BinOffsets[row + last[0] + 1];
+        if (begin < end)
+        {
+          ranges.push_back(Range{ begin, end, numberOfCandidates });
+          numberOfCandidates += end - begin;
+        }
+      }
+    }
+    cellIds.resize(numberOfCandidates);
+    vtkSMPTools::For(0, static_cast<vtkIdType>(ranges.size()),
+      [&](vtkIdType range, vtkIdType endRange)
+      {
+        for (; range < endRange; ++range)
+        {
+          std::copy(this->CellIds.begin() + ranges[range].Begin,
+            this->CellIds.begin() + ranges[range].End, cellIds.begin() + ranges[range].Offset);
+        }
+      });
+    // visiting the candidates in cell order keeps the accesses to the cells ordered
+    vtkSMPTools::Sort(cellIds.begin(), cellIds.end());
+  }
+
+private:
+  static vtkMTimeType GetPointsTime(vtkDataSet* input)
+  {
+    vtkPointSet* pointSet = vtkPointSet::SafeDownCast(input);
+    return pointSet && pointSet->GetPoints() ? pointSet->GetPoints()->GetMTime()
+                                             : input->GetMTime();
+  }
+
+  // The links of an unstructured grid are reset without changing its cells, which modifies the
+  // grid, so its cells are tracked through its cell array.
+  static vtkMTimeType GetCellsTime(vtkDataSet* input)
+  {
+    vtkUnstructuredGrid* grid = vtkUnstructuredGrid::SafeDownCast(input);
+    return grid && grid->GetCells() ? grid->GetCells()->GetMTime() : input->GetMTime();
+  }
+
+  int GetBin(int axis, double x) const
+  {
+    const double bin = (x - this->Bounds[2 * axis]) * this->InverseSpacing[axis];
+    if (!(bin > 0.0))
+    {
+      return 0;
+    }
+    return bin >= this->Dims[axis] ? this->Dims[axis] - 1 : static_cast<int>(bin);
+  }
+
+  vtkIdType GetBin(const double* x) const
+  {
+    const vtkIdType k = this->GetBin(2, x[2]);
+    return (k * this->Dims[1] + this->GetBin(1, x[1])) * this->Dims[0] + this->GetBin(0, x[0]);
+  }
+
+  void Resize(vtkDataSet* input)
+  {
+    input->GetBounds(this->Bounds);
+    this->NumberOfCells = input->GetNumberOfCells();
+    const double numberOfBins = static_cast<double>(std::min(
+      std::max(this->NumberOfCells / CellsPerBin, vtkIdType(1)), MaximumNumberOfBins));
+
+    // Cubic bins over the axes along which the points extend. An axis that is shorter than the
+    // bins is collapsed and the bins are sized again over the other axes, since a thin slab
+    // would otherwise get tiny bins and up to MaximumNumberOfBins bins per axis.
+    double length[3];
+    bool extends[3];
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      length[axis] = this->Bounds[2 * axis + 1] - this->Bounds[2 * axis];
+      extends[axis] = length[axis] > 0.0;
+    }
+    double binSize = 1.0;
+    for (bool resized = true; resized;)
+    {
+      double volume = 1.0;
+      int numberOfAxes = 0;
+      for (int axis = 0; axis < 3; ++axis)
+      {
+        if (extends[axis])
+        {
+          volume *= length[axis];
+          ++numberOfAxes;
+        }
+      }
+      binSize = numberOfAxes ? std::pow(volume / numberOfBins, 1.0 / numberOfAxes) : 1.0;
+      resized = false;
+      for (int axis = 0; axis < 3; ++axis)
+      {
+        if (extends[axis] && length[axis] < binSize)
+        {
+          extends[axis] = false;
+          resized = true;
+        }
+      }
+    }
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      const double bins = extends[axis] ? std::ceil(length[axis] / binSize) : 1.0;
+      this->Dims[axis] = static_cast<int>(std::min(std::max(bins, 1.0), numberOfBins));
+    }
+    // the rounding up can exceed the number of bins by a small factor, which is bounded here
+    while (this->GetNumberOfBins() > MaximumNumberOfBins)
+    {
+      int* largest = std::max_element(this->Dims, this->Dims + 3);
+      *largest = (*largest + 1) / 2;
+    }
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      this->InverseSpacing[axis] = length[axis] > 0.0 ? this->Dims[axis] / length[axis] : 0.0;
+    }
+  }
+
+  // Calls function(cellId, bin) for the cells with points in [begin, end).
+  template <typename Function>
+  void ForEachCellBin(vtkDataSet* input, vtkIdType begin, vtkIdType end, vtkIdList* ids,
+    Function&& function) const
+  {
+    vtkIdType npts;
+    const vtkIdType* pts;
+    double x[3];
+    for (vtkIdType cellId = begin; cellId < end; ++cellId)
+    {
+      input->GetCellPoints(cellId, npts, pts, ids);
+      if (npts > 0)
+      {
+        input->GetPoint(pts[0], x);
+        function(cellId, this->GetBin(x));
+      }
+    }
+  }
+
+  // A counting sort of the cells by bin, with atomic counters and cursors per bin, followed by
+  // a sort of the cells of each bin.
+  void Build(vtkDataSet* input)
+  {
+    this->Resize(input);
+    const vtkIdType numberOfBins = this->GetNumberOfBins();
+    const vtkIdType numberOfCells = this->NumberOfCells;
+    std::unique_ptr<std::atomic<vtkIdType>[]> counts(new std::atomic<vtkIdType>[numberOfBins]);
+    vtkSMPTools::For(0, numberOfBins,
+      [&](vtkIdType bin, vtkIdType endBin)
+      {
+        for (; bin < endBin; ++bin)
+        {
+          counts[bin].store(0, std::memory_order_relaxed);
+        }
+      });
+    if (numberOfCells > 0)
+    {
+      // builds the cells of the data sets that do so lazily, which is not thread safe
+      vtkNew<vtkIdList> ids;
+      vtkIdType npts;
+      const vtkIdType* pts;
+      input->GetCellPoints(0, npts, pts, ids);
+    }
+
+    vtkSMPThreadLocalObject<vtkIdList> localIds;
+    vtkSMPTools::For(0, numberOfCells,
+      [&](vtkIdType begin, vtkIdType end)
+      {
+        this->ForEachCellBin(input, begin, end, localIds.Local(),
+          [&](vtkIdType, vtkIdType bin) { counts[bin].fetch_add(1, std::memory_order_relaxed); });
+      });
+
+    this->BinOffsets.resize(numberOfBins + 1);
+    this->BinOffsets[0] = 0;
+    for (vtkIdType bin = 0; bin < numberOfBins; ++bin)
+    {
+      const vtkIdType count = counts[bin].load(std::memory_order_relaxed);
+      this->BinOffsets[bin + 1] = this->BinOffsets[bin] + count;
+      counts[bin].store(this->BinOffsets[bin], std::memory_order_relaxed);
+    }
+
+    this->CellIds.resize(this->BinOffsets[numberOfBins]);
+    vtkIdType* cellIds = this->CellIds.data();
+    vtkSMPTools::For(0, numberOfCells,
+      [&](vtkIdType begin, vtkIdType end)
+      {
+        this->ForEachCellBin(input, begin, end, localIds.Local(),
+          [&](vtkIdType cellId, vtkIdType bin)
+          { cellIds[counts[bin].fetch_add(1, std::memory_order_relaxed)] = cellId; });
+      });
+    vtkSMPTools::For(0, numberOfBins,
+      [&](vtkIdType bin, vtkIdType endBin)
+      {
+        for (; bin < endBin; ++bin)
+        {
+          std::sort(cellIds + this->BinOffsets[bin], cellIds + this->BinOffsets[bin + 1]);
+        }
+      });
+  }
+
+  const vtkDataSet* DataSet = nullptr;
+  vtkMTimeType PointsTime = 0;
+  vtkMTimeType CellsTime = 0;
+  vtkIdType NumberOfCells = 0;
+  double Bounds[6] = { 0.0, -1.0, 0.0, -1.0, 0.0, -1.0 };
+  double InverseSpacing[3] = { 0.0, 0.0, 0.0 };
+  int Dims[3] = { 1, 1, 1 };
+  std::vector<vtkIdType> BinOffsets;
+  std::vector<vtkIdType> CellIds;
+};
+
+#endif //_CellBinGrid_h
@@ -0,0 +1,85 @@
+//============================================================================
+//  Copyright (c) Kitware, Inc.
+//  All rights reserved.
+//  See LICENSE.txt for details.
+//
+//  This software is distributed WITHOUT ANY WARRANTY; without even
+//  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+//  PURPOSE.  See the above copyright notice for more information.
+//============================================================================
+#ifndef vtk_m_worklet_CellSetTopologyCache_h
+#define vtk_m_worklet_CellSetTopologyCache_h
+
+#include <vtkm/Types.h>
+
+#include <vtkm/cont/ArrayHandle.h>
+#include <vtkm/cont/UnknownCellSet.h>
+
+namespace vtkm
+{
+namespace worklet
+{
+
+/// \brief The output of a run of an external faces worklet, reused by its later runs on the
+/// same topology.
+///
+/// The output only depends on the cells of the input, so when only the points and fields of the
+/// input change, e.g. over the time steps of a simulation, the faces do not have to be hashed
+/// again. The key identifies the topology of the input, e.g. the MTime of the cell array of the
+/// VTK data set that the input was converted from, and must change when the cells change. The
+/// worklets are copied by value, so their copies share the cache through a pointer.
+class CellSetTopologyCache
+{
+public:
+  /// Copies the cached output into outCellSet if it was stored for the key and with the same
+  /// type of cell set. Returns whether it was copied.
+  template <typename CellSetType>
+  bool Restore(vtkm::UInt64 key, CellSetType& outCellSet) const
+  {
+    if (!this->Valid || key != this->Key || !this->CellSet.CanConvert<CellSetType>())
+    {
+      return false;
+    }
+    this->CellSet.AsCellSet(outCellSet);
+    return true;
+  }
+
+  /// Stores the output of a run for the key. The other outputs of the worklet are set on the
+  /// public members afterwards.
+  template <typename CellSetType>
+  void Store(vtkm::UInt64 key, const CellSetType& outCellSet,
+    const vtkm::cont::ArrayHandle<vtkm::Id>& cellIdMap)
+  {
+    this->Valid = true;
+    this->Key = key;
+    this->CellSet = outCellSet;
+    this->CellIdMap = cellIdMap;
+  }
+
+  /// Forgets the stored output, e.g. when an option that changes the output is set.
+  void Clear()
+  {
+    this->Valid = false;
+    this->CellSet = vtkm::cont::UnknownCellSet();
+    this->CellIdMap = vtkm::cont::ArrayHandle<vtkm::Id>();
+    this->RegionIdPairs = vtkm::cont::ArrayHandle<vtkm::Id2>();
+    this->FaceNeighborOffsets = vtkm::cont::ArrayHandle<vtkm::Id>();
+    this->FaceNeighbors = vtkm::cont::ArrayHandle<vtkm::Id>();
+  }
+
+  vtkm::cont::ArrayHandle<vtkm::Id> CellIdMap;
+  // the additional outputs of the worklets that have them
+  vtkm::cont::ArrayHandle<vtkm::Id2> RegionIdPairs;
+  vtkm::cont::ArrayHandle<vtkm::Id> FaceNeighborOffsets;
+  vtkm::cont::ArrayHandle<vtkm::Id> FaceNeighbors;
+
+private:
+  bool Valid = false;
+  vtkm::UInt64 Key = 0;
+  vtkm::cont::UnknownCellSet CellSet;
+};
+
+}
+} // namespace vtkm::worklet
+
+#endif // vtk_m_worklet_CellSetTopologyCache_h
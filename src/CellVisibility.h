@@ -0,0 +1,296 @@
+//============================================================================
+//  Copyright (c) Kitware, Inc.
+//  All rights reserved.
+//  See LICENSE.txt for details.
+//  This software is distributed WITHOUT ANY WARRANTY; without even
+//  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+//  PURPOSE.  See the above copyright notice for more information.
+//============================================================================
+#ifndef _CellVisibility_h
+#define _CellVisibility_h
+
+#include <vtkArrayDispatch.h>
+#include <vtkBitArray.h>
+#include <vtkCellData.h>
+#include <vtkDataArrayRange.h>
+#include <vtkDataSet.h>
+#include <vtkIdList.h>
+#include <vtkNew.h>
+#include <vtkPointSet.h>
+#include <vtkPoints.h>
+#include <vtkSMPThreadLocalObject.h>
+#include <vtkSMPTools.h>
+#include <vtkType.h>
+#include <vtkUnsignedCharArray.h>
+
+#include <memory>
+
+namespace detail
+{
+struct ClassifyPointsWorker
+{
+  // Clears the mask of the points outside of the extent. The comparisons are done without
+  // branches, so that the loop vectorizes.
+  template <typename PointArray>
+  void operator()(PointArray* points, unsigned char* mask, const double* extent) const
+  {
+    const auto x = vtk::DataArrayValueRange<3>(points);
+    const double xMin = extent[0], xMax = extent[1];
+    const double yMin = extent[2], yMax = extent[3];
+    const double zMin = extent[4], zMax = extent[5];
+    vtkSMPTools::For(0, points->GetNumberOfTuples(),
+      [&](vtkIdType begin, vtkIdType end)
+      {
+        for (vtkIdType pointId = begin; pointId < end; ++pointId)
+        {
+          const double px = static_cast<double>(x[3 * pointId]);
+          const double py = static_cast<double>(x[3 * pointId + 1]);
+          const double pz = static_cast<double>(x[3 * pointId + 2]);
+          const int outside = (px < xMin) | (px > xMax) | (py < yMin) | (py > yMax) |
+            (pz < zMin) | (pz > zMax);
+          mask[pointId] &= static_cast<unsigned char>(outside ^ 1);
+        }
+      });
+  }
+};
+}
+
+/// \brief Computes which cells pass the cell, point and extent clipping of the geometry filters.
+///
+/// The points are classified once, in parallel, into a mask of the points that pass the point
+/// and extent clipping, and each cell is then visible if all of its points are in the mask.
+/// This replaces the serial loop over the cells that converted every cell point to double, and
+/// classified shared points once per cell.
+///
+/// A cell mask, a cell array with one component of type vtkUnsignedCharArray or vtkBitArray,
+/// also hides the cells with a zero value, so that the faces that they share with the other
+/// cells are external without copying the other cells into a new data set first.
+class CellVisibility
+{
+public:
+  CellVisibility(bool cellClipping, vtkIdType cellMinimum, vtkIdType cellMaximum,
+    bool pointClipping, vtkIdType pointMinimum, vtkIdType pointMaximum, bool extentClipping,
+    const double* extent)
+    : CellClipping(cellClipping)
+    , CellMinimum(cellMinimum)
+    , CellMaximum(cellMaximum)
+    , PointClipping(pointClipping)
+    , PointMinimum(pointMinimum)
+    , PointMaximum(pointMaximum)
+    , ExtentClipping(extentClipping)
+    , Extent(extent)
+  {
+  }
+
+  /// The cell array of the input with the given name if it can be used as a cell mask, or
+  /// nullptr.
+  static vtkDataArray* FindCellMask(vtkDataSet* input, const char* name)
+  {
+    vtkDataArray* mask = name ? input->GetCellData()->GetArray(name) : nullptr;
+    if (!mask || mask->GetNumberOfComponents() != 1 ||
+      mask->GetNumberOfTuples() != input->GetNumberOfCells() ||
+      (!vtkUnsignedCharArray::SafeDownCast(mask) && !vtkBitArray::SafeDownCast(mask)))
+    {
+      return nullptr;
+    }
+    return mask;
+  }
+
+  /// The values of a cell mask that are non-zero for the visible cells, and can thus be used as
+  /// the visibility of the cells as they are, or nullptr for a vtkBitArray.
+  static const char* GetCellMaskValues(vtkDataArray* mask)
+  {
+    vtkUnsignedCharArray* values = vtkUnsignedCharArray::SafeDownCast(mask);
+    return values ? reinterpret_cast<const char*>(values->GetPointer(0)) : nullptr;
+  }
+
+  /// Sets the cell mask, from \c FindCellMask, or nullptr to use all cells.
+  void SetCellMask(vtkDataArray* mask)
+  {
+    vtkBitArray* bits = vtkBitArray::SafeDownCast(mask);
+    this->CellMaskBits = bits != nullptr;
+    this->CellMask = bits ? bits->GetPointer(0)
+                          : reinterpret_cast<const unsigned char*>(GetCellMaskValues(mask));
+  }
+
+  /// Sets cellVis[cellId] to 1 for the visible cells of the input and to 0 for the others.
+  void Compute(vtkDataSet* input, char* cellVis)
+  {
+    const vtkIdType numCells = input->GetNumberOfCells();
+    const unsigned char* mask = nullptr;
+    if (this->PointClipping || this->ExtentClipping)
+    {
+      mask = this->ClassifyPoints(input);
+    }
+    if (numCells > 0 && mask)
+    {
+      // builds the cells of the data sets that do so lazily, which is not thread safe
+      vtkNew<vtkIdList> ids;
+      vtkIdType npts;
+      const vtkIdType* pts;
+      input->GetCellPoints(0, npts, pts, ids);
+    }
+
+    vtkSMPThreadLocalObject<vtkIdList> localIds;
+    vtkSMPTools::For(0, numCells,
+      [&](vtkIdType cellId, vtkIdType endCellId)
+      {
+        vtkIdList* ids = localIds.Local();
+        vtkIdType npts;
+        const vtkIdType* pts;
+        for (; cellId < endCellId; ++cellId)
+        {
+          if (this->CellClipping && (cellId < this->CellMinimum || cellId > this->CellMaximum))
+          {
+            cellVis[cellId] = 0;
+            continue;
+          }
+          unsigned char visible = this->IsUnmasked(cellId);
+          if (mask && visible)
+          {
+            input->GetCellPoints(cellId, npts, pts, ids);
+            for (vtkIdType i = 0; i < npts; ++i)
+            {
+              visible &= mask[pts[i]];
+            }
+          }
+          cellVis[cellId] = static_cast<char>(visible);
+        }
+      });
+  }
+
+  /// Sets cellVis[cellId] for the given cells only and leaves the other cells as they are. The
+  /// points of these cells are tested as they are visited instead of classified up front, so
+  /// that the cost does not depend on the size of the input, e.g. for the candidate cells of an
+  /// extent from a CellBinGrid.
+  void Compute(
+    vtkDataSet* input, const vtkIdType* cellIds, vtkIdType numberOfCellIds, char* cellVis) const
+  {
+    const bool testPoints = this->PointClipping || this->ExtentClipping;
+    if (numberOfCellIds > 0 && testPoints)
+    {
+      // builds the cells of the data sets that do so lazily, which is not thread safe
+      vtkNew<vtkIdList> ids;
+      vtkIdType npts;
+      const vtkIdType* pts;
+      input->GetCellPoints(cellIds[0], npts, pts, ids);
+    }
+
+    vtkSMPThreadLocalObject<vtkIdList> localIds;
+    vtkSMPTools::For(0, numberOfCellIds,
+      [&](vtkIdType index, vtkIdType endIndex)
+      {
+        vtkIdList* ids = localIds.Local();
+        vtkIdType npts;
+        const vtkIdType* pts;
+        double x[3];
+        for (; index < endIndex; ++index)
+        {
+          const vtkIdType cellId = cellIds[index];
+          char visible =
+            (!this->CellClipping || (cellId >= this->CellMinimum && cellId <= this->CellMaximum)) &&
+            this->IsUnmasked(cellId);
+          if (visible && testPoints)
+          {
+            input->GetCellPoints(cellId, npts, pts, ids);
+            for (vtkIdType i = 0; i < npts && visible; ++i)
+            {
+              if (this->PointClipping &&
+                (pts[i] < this->PointMinimum || pts[i] > this->PointMaximum))
+              {
+                visible = 0;
+              }
+              else if (this->ExtentClipping)
+              {
+                input->GetPoint(pts[i], x);
+                visible = !(x[0] < this->Extent[0] || x[0] > this->Extent[1] ||
+                  x[1] < this->Extent[2] || x[1] > this->Extent[3] || x[2] < this->Extent[4] ||
+                  x[2] > this->Extent[5]);
+              }
+            }
+          }
+          cellVis[cellId] = visible;
+        }
+      });
+  }
+
+private:
+  // 1 if there is no cell mask or it keeps the cell, else 0. The bits of a vtkBitArray are
+  // stored from the most significant bit of each byte.
+  unsigned char IsUnmasked(vtkIdType cellId) const
+  {
+    if (!this->CellMask)
+    {
+      return 1;
+    }
+    if (this->CellMaskBits)
+    {
+      return static_cast<unsigned char>((this->CellMask[cellId >> 3] >> (7 - (cellId & 7))) & 1);
+    }
+    return this->CellMask[cellId] != 0;
+  }
+
+  const unsigned char* ClassifyPoints(vtkDataSet* input)
+  {
+    const vtkIdType numPts = input->GetNumberOfPoints();
+    this->PointMask.reset(new unsigned char[numPts]);
+    unsigned char* mask = this->PointMask.get();
+
+    const bool pointClipping = this->PointClipping;
+    const vtkIdType pointMinimum = this->PointMinimum;
+    const vtkIdType pointMaximum = this->PointMaximum;
+    vtkSMPTools::For(0, numPts,
+      [&](vtkIdType begin, vtkIdType end)
+      {
+        for (vtkIdType pointId = begin; pointId < end; ++pointId)
+        {
+          mask[pointId] = static_cast<unsigned char>(
+            !pointClipping || (pointId >= pointMinimum && pointId <= pointMaximum));
+        }
+      });
+    if (!this->ExtentClipping)
+    {
+      return mask;
+    }
+
+    vtkPointSet* pointSet = vtkPointSet::SafeDownCast(input);
+    vtkPoints* points = pointSet ? pointSet->GetPoints() : nullptr;
+    using ClassifyDispatch = vtkArrayDispatch::DispatchByValueType<vtkArrayDispatch::Reals>;
+    if (!points ||
+      !ClassifyDispatch::Execute(points->GetData(), detail::ClassifyPointsWorker{}, mask,
+        this->Extent))
+    {
+      // implicit points, e.g. of structured data, and point types that are not dispatched
+      const double* extent = this->Extent;
+      vtkSMPTools::For(0, numPts,
+        [&](vtkIdType begin, vtkIdType end)
+        {
+          double x[3];
+          for (vtkIdType pointId = begin; pointId < end; ++pointId)
+          {
+            input->GetPoint(pointId, x);
+            if (x[0] < extent[0] || x[0] > extent[1] || x[1] < extent[2] || x[1] > extent[3] ||
+              x[2] < extent[4] || x[2] > extent[5])
+            {
+              mask[pointId] = 0;
+            }
+          }
+        });
+    }
+    return mask;
+  }
+
+  bool CellClipping;
+  vtkIdType CellMinimum;
+  vtkIdType CellMaximum;
+  bool PointClipping;
+  vtkIdType PointMinimum;
+  vtkIdType PointMaximum;
+  bool ExtentClipping;
+  const double* Extent;
+  const unsigned char* CellMask = nullptr;
+  bool CellMaskBits = false;
+  std::unique_ptr<unsigned char[]> PointMask;
+};
+
+#endif //_CellVisibility_h
@@ -0,0 +1,137 @@
+//============================================================================
+//  Copyright (c) Kitware, Inc.
+//  All rights reserved.
+//  See LICENSE.txt for details.
+//  This software is distributed WITHOUT ANY WARRANTY; without even
+//  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+//  PURPOSE.  See the above copyright notice for more information.
+//============================================================================
+#ifndef _DataSetConverter_h
+#define _DataSetConverter_h
+
+#include <vtkm/cont/ArrayHandleBasic.h>
+#include <vtkm/cont/CellSetExplicit.h>
+#include <vtkm/cont/CoordinateSystem.h>
+#include <vtkm/cont/DataSet.h>
+
+#include <vtkAOSDataArrayTemplate.h>
+#include <vtkCellArray.h>
+#include <vtkCellType.h>
+#include <vtkPoints.h>
+#include <vtkUnsignedCharArray.h>
+#include <vtkUnstructuredGrid.h>
+#include <vtkmlib/DataSetConverters.h>
+
+/// Describes how the VTK-m representation of a VTK dataset was produced.
+struct DataSetConversionInfo
+{
+  /// True if the shapes, connectivity and offsets share memory with the vtkCellArray.
+  bool ZeroCopyTopology = false;
+  /// True if the coordinates share memory with the vtkPoints.
+  bool ZeroCopyPoints = false;
+};
+
+namespace detail
+{
+// Deleter of the ArrayHandles that share memory with a VTK array. The VTK array is registered
+// when it is wrapped, so it stays alive as long as any ArrayHandle references its buffer.
+inline void UnRegisterSharedVTKArray(void* container)
+{
+  static_cast<vtkObjectBase*>(container)->UnRegister(nullptr);
+}
+
+template <typename T, typename VTKArrayType>
+inline vtkm::cont::ArrayHandleBasic<T> ShareVTKArray(VTKArrayType* array, vtkm::Id numberOfValues)
+{
+  array->Register(nullptr);
+  return vtkm::cont::ArrayHandleBasic<T>(reinterpret_cast<T*>(array->GetPointer(0)), array,
+    numberOfValues, UnRegisterSharedVTKArray);
+}
+
+// VTK cell types whose id and point ordering are identical in VTK-m.
+inline bool IsSharedCellType(unsigned char cellType)
+{
+  switch (cellType)
+  {
+    case VTK_EMPTY_CELL:
+    case VTK_VERTEX:
+    case VTK_LINE:
+    case VTK_POLY_LINE:
+    case VTK_TRIANGLE:
+    case VTK_POLYGON:
+    case VTK_QUAD:
+    case VTK_TETRA:
+    case VTK_HEXAHEDRON:
+    case VTK_WEDGE:
+    case VTK_PYRAMID:
+      return true;
+    default:
+      return false;
+  }
+}
+
+template <typename T>
+inline bool SharePoints(vtkPoints* points, vtkm::cont::DataSet& dataSet)
+{
+  auto array = vtkAOSDataArrayTemplate<T>::FastDownCast(points->GetData());
+  if (!array || array->GetNumberOfComponents() != 3)
+  {
+    return false;
+  }
+  dataSet.AddCoordinateSystem(vtkm::cont::CoordinateSystem("coordinates",
+    ShareVTKArray<vtkm::Vec<T, 3>>(array, static_cast<vtkm::Id>(array->GetNumberOfTuples()))));
+  return true;
+}
+} // namespace detail
+
+/// \brief Converts the points and cells of an unstructured grid to a VTK-m dataset.
+///
+/// Only the topology and the coordinates are converted, since that is all the external faces
+/// algorithms need. When the cell array uses 64-bit storage, vtkm::Id is 64-bit, and all cell
+/// types have the same definition in VTK-m, the ArrayHandles share the buffers of the
+/// vtkCellArray without copying. The same holds for float/double AOS points. Otherwise, the
+/// dataset is converted through tovtkm::Convert, which copies.
+inline vtkm::cont::DataSet ConvertTopology(vtkUnstructuredGrid* ug, DataSetConversionInfo& info)
+{
+  info = DataSetConversionInfo{};
+  vtkCellArray* cells = ug->GetCells();
+  vtkUnsignedCharArray* cellTypes = ug->GetCellTypesArray();
+
+  bool canShareTopology = sizeof(vtkm::Id) == sizeof(vtkTypeInt64) && cells && cellTypes &&
+    cells->IsStorage64Bit();
+  if (canShareTopology)
+  {
+    vtkUnsignedCharArray* distinctCellTypes = ug->GetDistinctCellTypesArray();
+    for (vtkIdType i = 0; i < distinctCellTypes->GetNumberOfValues(); ++i)
+    {
+      canShareTopology &= detail::IsSharedCellType(distinctCellTypes->GetValue(i));
+    }
+  }
+
+  vtkm::cont::DataSet dataSet;
+  const bool canSharePoints = canShareTopology &&
+    (detail::SharePoints<vtkm::Float32>(ug->GetPoints(), dataSet) ||
+      detail::SharePoints<vtkm::Float64>(ug->GetPoints(), dataSet));
+  if (!canShareTopology || !canSharePoints)
+  {
+    return tovtkm::Convert(ug, tovtkm::FieldsFlag::None);
+  }
+
+  const vtkm::Id numberOfCells = static_cast<vtkm::Id>(ug->GetNumberOfCells());
+  auto connectivityArray = cells->GetConnectivityArray64();
+  auto offsetsArray = cells->GetOffsetsArray64();
+
+  vtkm::cont::CellSetExplicit<> cellSet;
+  cellSet.Fill(static_cast<vtkm::Id>(ug->GetNumberOfPoints()),
+    detail::ShareVTKArray<vtkm::UInt8>(cellTypes, numberOfCells),
+    detail::ShareVTKArray<vtkm::Id>(
+      connectivityArray, static_cast<vtkm::Id>(connectivityArray->GetNumberOfValues())),
+    detail::ShareVTKArray<vtkm::Id>(offsetsArray, numberOfCells + 1));
+  dataSet.SetCellSet(cellSet);
+
+  info.ZeroCopyTopology = true;
+  info.ZeroCopyPoints = true;
+  return dataSet;
+}
+
+#endif //_DataSetConverter_h
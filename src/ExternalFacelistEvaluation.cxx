@@ -1,4 +1,7 @@
 #include <vtkm/Version.h>
+#include <vtkm/cont/ArrayCopy.h>
+#include <vtkm/cont/ArrayHandleBasic.h>
+#include <vtkm/cont/ArrayHandlePermutation.h>
 #include <vtkm/cont/CellSetPermutation.h>
 #include <vtkm/cont/CellSetSingleType.h>
 #include <vtkm/cont/DataSet.h>
@@ -8,11 +11,18 @@
 #include <vtkm/filter/clean_grid/CleanGrid.h>
 #include <vtkm/filter/geometry_refinement/Tetrahedralize.h>
 
+#include <vtkArrayDispatch.h>
+#include <vtkCellArray.h>
 #include <vtkCellData.h>
+#include <vtkDataArrayRange.h>
 #include <vtkIdList.h>
+#include <vtkIdTypeArray.h>
+#include <vtkNew.h>
+#include <vtkPointData.h>
 #include <vtkSMPThreadLocalObject.h>
 #include <vtkSMPTools.h>
 #include <vtkSmartPointer.h>
+#include <vtkUnsignedCharArray.h>
 #include <vtkUnstructuredGrid.h>
 #include <vtkVersionFull.h>
 #include <vtkXMLUnstructuredGridReader.h>
@@ -22,6 +32,7 @@
 #include <vtkmlib/DataSetConverters.h>
 #include <vtkmlib/UnstructuredGridConverter.h>
 #include <vtksys/SystemInformation.hxx>
+#include <vtksys/SystemTools.hxx>
 
 #include "ExternalFacesHashCountFnv1a.h"
 #include "ExternalFacesHashCountMinPointId.h"
@@ -36,101 +47,316 @@
 #include "vtkGeometryFilterSClassifier.h"
 
 #include "Arguments.h"
+#include "BenchmarkRunner.h"
+#include "CacheConditioner.h"
+#include "CellBinGrid.h"
+#include "CellVisibility.h"
+#include "DataSetConverter.h"
+#include "FaceHashDistribution.h"
+#include "MemoryTracker.h"
+#include "MeshCache.h"
+#include "MeshGenerator.h"
+#include "MetricSink.h"
+#include "ParallelUnstructuredGridReader.h"
+#include "PerfCounters.h"
+#include "PhaseTimer.h"
+#include "ScopedThreadLimit.h"
+#include "SurfaceFingerprint.h"
+#include "SurfaceTopologyCache.h"
+#include "TopologyPermutation.h"
+#include "TraceRecorder.h"
 #include "YamlWriter.h"
 
+#include <algorithm>
+#include <array>
+#include <cmath>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <ctime>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <numeric>
 #include <random>
 #include <sstream>
 #include <vector>
 
-auto ReadDataSet(const std::string& filename) -> vtkSmartPointer<vtkUnstructuredGrid>
+auto ReadDataSet(const std::string& filename, bool parallelRead)
+  -> vtkSmartPointer<vtkUnstructuredGrid>
 {
+  // .pvtu files are only supported by the parallel reader
+  if (parallelRead || vtksys::SystemTools::GetFilenameLastExtension(filename) == ".pvtu")
+  {
+    return ReadUnstructuredGridParallel(filename);
+  }
   vtkNew<vtkXMLUnstructuredGridReader> reader;
   reader->SetFileName(filename.c_str());
   reader->Update();
   return reader->GetOutput();
 }
 
+// Reports that the mesh cache cannot be used, and returns the points and cells of the dataset
+// that was read instead, without its point and cell data, so that the algorithms process the
+// same workload as with a cached dataset.
+auto FallBackFromMeshCache(vtkUnstructuredGrid* ug, const std::string& status,
+  const std::string& error, YamlWriter& log) -> vtkSmartPointer<vtkUnstructuredGrid>
+{
+  log.AddDictionaryEntry("mesh-cache", status);
+  log.AddDictionaryEntry("mesh-cache-error", error);
+  auto meshUG = vtkSmartPointer<vtkUnstructuredGrid>::New();
+  meshUG->ShallowCopy(ug);
+  meshUG->GetPointData()->Initialize();
+  meshUG->GetCellData()->Initialize();
+  return meshUG;
+}
+
+auto ReadCachedDataSet(const std::string& filename, bool parallelRead, bool readAhead,
+  YamlWriter& log) -> vtkSmartPointer<vtkUnstructuredGrid>
+{
+  const std::string cacheFilename = filename + ".eflcache";
+  vtkSmartPointer<vtkUnstructuredGrid> ug = ReadMeshCache(cacheFilename, filename, readAhead);
+  if (ug)
+  {
+    log.AddDictionaryEntry("mesh-cache", "hit");
+    return ug;
+  }
+  ug = ReadDataSet(filename, parallelRead);
+  if (!WriteMeshCache(cacheFilename, filename, ug))
+  {
+    return FallBackFromMeshCache(
+      ug, "write-failed", "the cache file cannot be written; the input file is used", log);
+  }
+  // Reload the dataset from the cache, so that every run uses the same memory layout
+  auto cachedUG = ReadMeshCache(cacheFilename, filename, readAhead);
+  if (!cachedUG)
+  {
+    return FallBackFromMeshCache(
+      ug, "map-failed", "the written cache cannot be mapped; the input file is used", log);
+  }
+  log.AddDictionaryEntry("mesh-cache", "written");
+  return cachedUG;
+}
+
 auto RandomizeDataSet(const vtkSmartPointer<vtkUnstructuredGrid>& ug, YamlWriter& log,
-  vtkm::UInt32 seed) -> vtkSmartPointer<vtkUnstructuredGrid>
+  const std::string& target, vtkIdType window, vtkm::UInt32 seed)
+  -> vtkSmartPointer<vtkUnstructuredGrid>
 {
-  // Create a list of indices to shuffle (representing point IDs)
-  std::vector<vtkIdType> pointMap(ug->GetNumberOfPoints());
-  std::iota(pointMap.begin(), pointMap.end(), 0); // Initialize to {0, 1, 2, ..., numPoints-1}
-
-  // Use a random engine and shuffle the point IDs with the given seed
-  std::mt19937 randomEngine(seed);
-  std::shuffle(pointMap.begin(), pointMap.end(), randomEngine);
-
-  vtkPoints* inputPoints = ug->GetPoints();
-  // Create a copy of the points
-  vtkNew<vtkPoints> randomPoints;
-  randomPoints->SetDataType(inputPoints->GetDataType());
-  randomPoints->SetNumberOfPoints(inputPoints->GetNumberOfPoints());
-
-  // update the points in the randomized order
-  vtkSMPTools::For(0, inputPoints->GetNumberOfPoints(),
+  const PermutationTarget permutationTarget = target == "cells" ? PermutationTarget::Cells
+    : target == "both"                                          ? PermutationTarget::Both
+                                                                : PermutationTarget::Points;
+  vtkm::cont::Timer timer;
+  timer.Start();
+  auto randomUG = PermuteDataSet(ug, permutationTarget, window, seed);
+  timer.Stop();
+  log.AddDictionaryEntry("permutation-target", target);
+  log.AddDictionaryEntry("permutation-window", window);
+  log.AddDictionaryEntry("seconds-randomize", timer.GetElapsedTime());
+  return randomUG;
+}
+
+// The cells of the input inside of the extent, from the candidates of the bin grid if there is
+// one, in increasing order.
+auto FindExtentCells(vtkUnstructuredGrid* ug, const double* extent, CellBinGrid* binGrid)
+  -> std::vector<vtkIdType>
+{
+  CellVisibility visibility(false, 0, 0, false, 0, 0, true, extent);
+  std::unique_ptr<char[]> cellVis(new char[ug->GetNumberOfCells()]);
+  std::vector<vtkIdType> cellIds;
+  if (binGrid)
+  {
+    binGrid->Update(ug);
+    binGrid->FindCandidateCells(extent, cellIds);
+    visibility.Compute(
+      ug, cellIds.data(), static_cast<vtkIdType>(cellIds.size()), cellVis.get());
+  }
+  else
+  {
+    cellIds.resize(ug->GetNumberOfCells());
+    std::iota(cellIds.begin(), cellIds.end(), 0);
+    visibility.Compute(ug, cellVis.get());
+  }
+  cellIds.erase(std::remove_if(cellIds.begin(), cellIds.end(),
+                  [&](vtkIdType cellId) { return !cellVis[cellId]; }),
+    cellIds.end());
+  return cellIds;
+}
+
+// An unstructured grid of the given cells of the input, which shares the points of the input.
+auto ExtractCellSubset(vtkUnstructuredGrid* ug, const std::vector<vtkIdType>& cellIds)
+  -> vtkSmartPointer<vtkUnstructuredGrid>
+{
+  const vtkIdType numberOfCells = static_cast<vtkIdType>(cellIds.size());
+  vtkCellArray* cells = ug->GetCells();
+  vtkNew<vtkIdTypeArray> offsets;
+  offsets->SetNumberOfValues(numberOfCells + 1);
+  vtkIdType* offsetsPtr = offsets->GetPointer(0);
+  vtkNew<vtkUnsignedCharArray> types;
+  types->SetNumberOfValues(numberOfCells);
+  unsigned char* typesPtr = types->GetPointer(0);
+  offsetsPtr[0] = 0;
+  vtkSMPTools::For(0, numberOfCells,
     [&](vtkIdType begin, vtkIdType end)
     {
-      double point[3];
-      for (vtkIdType index = begin; index < end; index++)
+      for (vtkIdType i = begin; i < end; ++i)
       {
-        inputPoints->GetPoint(pointMap[index], point);
-        randomPoints->SetPoint(index, point);
+        offsetsPtr[i + 1] = cells->GetCellSize(cellIds[i]);
+        typesPtr[i] = static_cast<unsigned char>(ug->GetCellType(cellIds[i]));
       }
     });
+  std::partial_sum(offsetsPtr, offsetsPtr + numberOfCells + 1, offsetsPtr);
 
-  vtkCellArray* inputCells = ug->GetCells();
-  // randomize the cells
-  auto offsets = vtk::TakeSmartPointer(
-    vtkDataArray::CreateDataArray(inputCells->GetOffsetsArray()->GetDataType()));
-  auto connectivity = vtk::TakeSmartPointer(
-    vtkDataArray::CreateDataArray(inputCells->GetConnectivityArray()->GetDataType()));
-  offsets->ShallowCopy(inputCells->GetOffsetsArray());
-  connectivity->SetNumberOfTuples(inputCells->GetConnectivityArray()->GetNumberOfTuples());
-  vtkNew<vtkCellArray> randomCells;
-  randomCells->SetData(offsets, connectivity);
-
-  // update the cells with the new point IDs
+  vtkNew<vtkIdTypeArray> connectivity;
+  connectivity->SetNumberOfValues(offsetsPtr[numberOfCells]);
+  vtkIdType* connectivityPtr = connectivity->GetPointer(0);
   vtkSMPThreadLocalObject<vtkIdList> tlPointIds;
-  vtkSMPTools::For(0, inputCells->GetNumberOfCells(),
+  vtkSMPTools::For(0, numberOfCells,
     [&](vtkIdType begin, vtkIdType end)
     {
       vtkIdList* pointIds = tlPointIds.Local();
-      for (vtkIdType index = begin; index < end; index++)
+      vtkIdType npts;
+      const vtkIdType* pts;
+      for (vtkIdType i = begin; i < end; ++i)
       {
-        inputCells->GetCellAtId(index, pointIds);
-        for (vtkIdType i = 0; i < pointIds->GetNumberOfIds(); i++)
-        {
-          pointIds->SetId(i, pointMap[pointIds->GetId(i)]);
-        }
-        randomCells->ReplaceCellAtId(index, pointIds);
+        cells->GetCellAtId(cellIds[i], npts, pts, pointIds);
+        std::copy(pts, pts + npts, connectivityPtr + offsetsPtr[i]);
       }
     });
 
-  // copy cell types
-  vtkNew<vtkUnsignedCharArray> cellTypes;
-  cellTypes->ShallowCopy(ug->GetCellTypesArray());
+  vtkNew<vtkCellArray> subsetCells;
+  subsetCells->SetData(offsets, connectivity);
+  auto subset = vtkSmartPointer<vtkUnstructuredGrid>::New();
+  subset->SetPoints(ug->GetPoints());
+  subset->SetCells(types, subsetCells);
+  return subset;
+}
 
-  auto randomUG = vtkSmartPointer<vtkUnstructuredGrid>::New();
-  randomUG->SetPoints(randomPoints);
-  randomUG->SetCells(cellTypes, randomCells);
-  randomUG->GetCellData()->PassData(ug->GetCellData());
+struct CopyRegionIdsWorker
+{
+  template <typename RegionArray>
+  void operator()(RegionArray* regions, vtkm::Id* regionIds) const
+  {
+    const auto values = vtk::DataArrayValueRange<1>(regions);
+    vtkSMPTools::For(0, regions->GetNumberOfTuples(),
+      [&](vtkIdType begin, vtkIdType end)
+      {
+        for (vtkIdType cellId = begin; cellId < end; ++cellId)
+        {
+          regionIds[cellId] = static_cast<vtkm::Id>(values[cellId]);
+        }
+      });
+  }
+};
 
-  return randomUG;
+// The region of each cell of the input, from its integral cell array with one component of the
+// given name. Returns false if the input has no such array.
+auto ReadRegionIds(vtkUnstructuredGrid* ug, const std::string& name,
+  vtkm::cont::ArrayHandle<vtkm::Id>& regionIds) -> bool
+{
+  vtkDataArray* regions = ug->GetCellData()->GetArray(name.c_str());
+  if (!regions || regions->GetNumberOfComponents() != 1 ||
+    regions->GetNumberOfTuples() != ug->GetNumberOfCells())
+  {
+    return false;
+  }
+  vtkm::cont::ArrayHandleBasic<vtkm::Id> values;
+  values.Allocate(ug->GetNumberOfCells());
+  using RegionDispatch = vtkArrayDispatch::DispatchByValueType<vtkArrayDispatch::Integrals>;
+  if (!RegionDispatch::Execute(regions, CopyRegionIdsWorker{}, values.GetWritePointer()))
+  {
+    return false;
+  }
+  regionIds = values;
+  return true;
+}
+
+auto GenerateDataSet(const std::string& type, vtkIdType numberOfCells, unsigned int numberOfHoles,
+  vtkm::UInt32 seed, YamlWriter& log) -> vtkSmartPointer<vtkUnstructuredGrid>
+{
+  const GeneratedMeshType meshType = type == "tet" ? GeneratedMeshType::Tetrahedra
+    : type == "wedge"                              ? GeneratedMeshType::Wedges
+    : type == "mixed"                              ? GeneratedMeshType::Mixed
+                                                   : GeneratedMeshType::Hexahedra;
+  std::array<vtkIdType, 3> dimensions;
+  auto ug = GenerateMesh(meshType, numberOfCells, numberOfHoles, seed, dimensions);
+  log.AddDictionaryEntry("generated-mesh", type);
+  log.AddDictionaryEntry("generated-dimensions",
+    std::to_string(dimensions[0]) + "x" + std::to_string(dimensions[1]) + "x" +
+      std::to_string(dimensions[2]));
+  log.AddDictionaryEntry("generated-holes", numberOfHoles);
+  return ug;
+}
+
+// The time that the trial functions return when the algorithm failed, which neither enters the
+// statistics nor is added to other times
+const vtkm::Float64 FailedRunTime = std::numeric_limits<vtkm::Float64>::quiet_NaN();
+
+/// The mean time, which is FailedRunTime if every run failed, and the output fingerprint of an
+/// algorithm.
+struct AlgorithmResult
+{
+  std::string FullName;
+  vtkm::Float64 Seconds = 0.0;
+  SurfaceFingerprint Fingerprint;
+};
+
+// Compares the output fingerprints of the algorithms of one run with the one of the first.
+// An invalid fingerprint is reported, and mismatches every other one.
+void ValidateSurfaces(const std::vector<AlgorithmResult>& results, YamlWriter& log)
+{
+  if (results.empty())
+  {
+    return;
+  }
+  std::vector<std::string> mismatches;
+  std::vector<std::string> invalidFingerprints;
+  for (const AlgorithmResult& result : results)
+  {
+    if (!result.Fingerprint.Valid)
+    {
+      invalidFingerprints.push_back(result.FullName);
+    }
+    if (result.Fingerprint != results[0].Fingerprint)
+    {
+      mismatches.push_back(result.FullName);
+    }
+  }
+  log.StartBlock("surface-validation");
+  log.AddDictionaryEntry("reference", results[0].FullName);
+  log.AddDictionaryEntry("reference-fingerprint", results[0].Fingerprint.ToString());
+  log.AddDictionaryEntry("num-mismatches", mismatches.size());
+  if (!mismatches.empty())
+  {
+    log.StartBlock("mismatches");
+    for (const std::string& mismatch : mismatches)
+    {
+      log.AddListValue(mismatch);
+    }
+    log.EndBlock();
+  }
+  if (!invalidFingerprints.empty())
+  {
+    log.StartBlock("invalid-fingerprints");
+    for (const std::string& name : invalidFingerprints)
+    {
+      log.AddListValue(name);
+    }
+    log.EndBlock();
+  }
+  log.EndBlock();
 }
 
 template <typename ExternalFacesAlgorithm>
 auto RunVTKTrial(ExternalFacesAlgorithm* externalFaces, vtkUnstructuredGrid* inData,
-  YamlWriter& log, bool firstRun = false) -> vtkm::Float64
+  YamlWriter& log, MetricSink& metrics, bool firstRun = false) -> vtkm::Float64
 {
-  vtkm::cont::Timer timer;
+  PhaseTimer timer;
   timer.Start();
   inData->SetLinks(nullptr); // Clear the links to have a clean run
   externalFaces->SetInputData(inData);
+  // the filter adds the times of its phases, nested in the filter phase
+  externalFaces->SetMetrics(&metrics);
   externalFaces->Modified();
   try
   {
@@ -139,11 +365,12 @@ auto RunVTKTrial(ExternalFacesAlgorithm* externalFaces, vtkUnstructuredGrid* inD
   catch (std::exception& e)
   {
     log.AddDictionaryEntry("error", e.what());
-    return 0.0;
+    return FailedRunTime;
   }
   auto outData = externalFaces->GetOutput();
   timer.Stop();
   vtkm::Float64 elapsedTime = timer.GetElapsedTime();
+  timer.ReportObservers(metrics, "filter");
   if (firstRun)
   {
     log.AddDictionaryEntry("num-output-points", outData->GetNumberOfPoints());
@@ -152,173 +379,347 @@ auto RunVTKTrial(ExternalFacesAlgorithm* externalFaces, vtkUnstructuredGrid* inD
   return elapsedTime;
 }
 
+// Runs the filter untimed with the input ids passed through to its output, and returns the
+// fingerprint of the output. It runs after the timed first run, so that neither the id arrays
+// nor their gathering add to a reported time.
 template <typename ExternalFacesAlgorithm>
-auto DoVTKRun(const std::string& algorithmName, const std::string& hashName, unsigned int numTrials,
-  vtkUnstructuredGrid* inData, YamlWriter& log) -> void
+auto FingerprintVTKRun(ExternalFacesAlgorithm* externalFaces, vtkUnstructuredGrid* inData,
+  YamlWriter& log) -> SurfaceFingerprint
+{
+  ScopedFingerprintIds fingerprintIds(inData);
+  inData->SetLinks(nullptr);
+  externalFaces->SetInputData(inData);
+  externalFaces->SetMetrics(nullptr);
+  externalFaces->Modified();
+  try
+  {
+    externalFaces->Update();
+  }
+  catch (std::exception&)
+  {
+    return SurfaceFingerprint::Invalid();
+  }
+  const SurfaceFingerprint fingerprint = ComputeSurfaceFingerprint(externalFaces->GetOutput());
+  log.AddDictionaryEntry("output-fingerprint", fingerprint.ToString());
+  return fingerprint;
+}
+
+// configure sets the options of the filter, and may log them in the item of the algorithm.
+template <typename ExternalFacesAlgorithm>
+auto DoVTKRun(const std::string& algorithmName, const std::string& hashName,
+  const BenchmarkOptions& benchmark, vtkUnstructuredGrid* inData, YamlWriter& log,
+  const std::function<void(ExternalFacesAlgorithm*)>& configure = nullptr) -> AlgorithmResult
 {
   vtkNew<ExternalFacesAlgorithm> externalFaces;
   log.StartListItem();
   log.AddDictionaryEntry("algorithm-name", algorithmName);
   log.AddDictionaryEntry("hash-name", hashName);
   log.AddDictionaryEntry("full-name", algorithmName + " " + hashName);
+  if (configure)
+  {
+    configure(externalFaces.GetPointer());
+  }
+  AlgorithmResult result;
+  result.FullName = algorithmName + " " + hashName;
+  TraceRecorder* recorder = TraceRecorder::GetInstance();
+  TraceScope algorithmScope(recorder ? recorder->Intern(result.FullName) : "", "algorithm");
+  MetricSink metrics;
 
-  log.AddDictionaryEntry(
-    "first-run-time", RunVTKTrial(externalFaces.GetPointer(), inData, log, true));
+  const vtkm::Float64 firstRunTime =
+    RunVTKTrial(externalFaces.GetPointer(), inData, log, metrics, true);
+  if (!std::isnan(firstRunTime))
+  {
+    log.AddDictionaryEntry("first-run-time", firstRunTime);
+  }
+  result.Fingerprint = FingerprintVTKRun(externalFaces.GetPointer(), inData, log);
+
+  CacheConditioner::TrialScope trialScope(benchmark.Cache);
+  std::stringstream dummyStream;
+  YamlWriter dummyLog(dummyStream);
+  for (unsigned int warmup = 0; warmup < benchmark.WarmupRuns; warmup++)
+  {
+    RunVTKTrial(externalFaces.GetPointer(), inData, dummyLog, metrics);
+  }
 
-  if (numTrials > 0)
+  BenchmarkRunner runner(benchmark);
+  if (runner.NeedsMoreTrials())
   {
     log.StartBlock("trials");
-    for (unsigned int trial = 0; trial < numTrials; trial++)
+    for (unsigned int trial = 0; runner.NeedsMoreTrials(); trial++)
     {
       log.StartListItem();
       log.AddDictionaryEntry("trial-index", trial);
-      log.AddDictionaryEntry("seconds-total", RunVTKTrial(externalFaces.GetPointer(), inData, log));
+      if (benchmark.Cache)
+      {
+        benchmark.Cache->Prepare(
+          [&]() { RunVTKTrial(externalFaces.GetPointer(), inData, dummyLog, metrics); });
+        log.AddDictionaryEntry("cache-mode", benchmark.Cache->GetModeName());
+      }
+      runner.StartTrial(log);
+      // the metrics of the trial are only written after it ran
+      metrics.Clear();
+      const vtkm::Float64 seconds = RunVTKTrial(externalFaces.GetPointer(), inData, log, metrics);
+      if (std::isnan(seconds))
+      {
+        log.AddDictionaryEntry("failed", "true");
+        runner.EndTrial(log, false);
+        continue;
+      }
+      metrics.Add("seconds-total", seconds);
+      metrics.Write(log);
+      if (benchmark.MetricLines)
+      {
+        metrics.WriteJsonLine(*benchmark.MetricLines, result.FullName, trial);
+      }
+      runner.EndTrial(log);
     }
     log.EndBlock();
+    runner.WriteStatistics(log);
+    if (!runner.HasSucceededTrials())
+    {
+      log.AddDictionaryEntry("error", "every trial failed");
+      result.Seconds = FailedRunTime;
+      return result;
+    }
+    result.Seconds = runner.GetStatistics("seconds-total").Mean;
+    return result;
   }
+  result.Seconds = firstRunTime;
+  return result;
 }
 
+// inputCellIds maps the cells of a subset of the input, e.g. of an extent, to the input cells.
+// The cell mask and the options of configure are already set on the worklet.
 template <typename ExternalFacesWorklet>
 auto RunVTKmTrial(ExternalFacesWorklet externalFaces, const vtkm::cont::DataSet& inData,
-  YamlWriter& log, bool firstRun = false) -> vtkm::Float64
+  YamlWriter& log, MetricSink& metrics, SurfaceFingerprint* fingerprint = nullptr,
+  const vtkm::cont::ArrayHandle<vtkm::Id>* inputCellIds = nullptr) -> vtkm::Float64
 {
+  const bool firstRun = fingerprint != nullptr;
   const vtkm::cont::UnknownCellSet& unknownCellSet = inData.GetCellSet();
   auto inCellSet = unknownCellSet.ResetCellSetList<VTKM_DEFAULT_CELL_SET_LIST_UNSTRUCTURED>();
 
   vtkm::cont::CellSetExplicit<> outCellSet;
 
-  std::stringstream dummyStream;
-  YamlWriter dummyLog(dummyStream);
-
-  vtkm::cont::Timer timer;
+  PhaseTimer timer;
   timer.Start();
   try
   {
-    externalFaces.Run(inCellSet, outCellSet, firstRun ? dummyLog : log);
+    externalFaces.Run(inCellSet, outCellSet, metrics);
   }
   catch (vtkm::cont::Error& e)
   {
     log.AddDictionaryEntry("error", e.GetMessage());
-    return 0.0;
+    return FailedRunTime;
   }
   catch (std::exception& e)
   {
     log.AddDictionaryEntry("error", e.what());
-    return 0.0;
+    return FailedRunTime;
   }
   timer.Stop();
   vtkm::Float64 elapsedTime = timer.GetElapsedTime();
+  timer.ReportObservers(metrics, "run");
   vtkm::filter::clean_grid::CleanGrid cleanGrid;
   cleanGrid.SetMergePoints(false);
   cleanGrid.SetCompactPointFields(true);
   vtkm::cont::DataSet outDataSet;
   outDataSet.AddCoordinateSystem(inData.GetCoordinateSystem());
   outDataSet.SetCellSet(outCellSet);
-  timer.Start();
+  PhaseTimer cleanGridTimer;
+  cleanGridTimer.Start();
   auto cleanResult = cleanGrid.Execute(outDataSet);
-  timer.Stop();
-  elapsedTime += timer.GetElapsedTime();
+  cleanGridTimer.Stop();
+  elapsedTime += cleanGridTimer.GetElapsedTime();
+  cleanGridTimer.Report(metrics, "seconds-clean-grid");
   if (firstRun)
   {
     log.AddDictionaryEntry(
       "num-output-points", cleanResult.GetCoordinateSystem().GetNumberOfPoints());
     log.AddDictionaryEntry("num-output-cells", cleanResult.GetNumberOfCells());
-  }
-  else
-  {
-    log.AddDictionaryEntry("seconds-clean-grid", timer.GetElapsedTime());
+    vtkm::cont::ArrayHandle<vtkm::Id> cellIdMap = externalFaces.GetCellIdMap();
+    if (inputCellIds)
+    {
+      vtkm::cont::ArrayHandle<vtkm::Id> inputCellIdMap;
+      vtkm::cont::ArrayCopy(
+        vtkm::cont::make_ArrayHandlePermutation(cellIdMap, *inputCellIds), inputCellIdMap);
+      cellIdMap = inputCellIdMap;
+    }
+    *fingerprint = ComputeSurfaceFingerprint(outCellSet, cellIdMap);
+    log.AddDictionaryEntry("output-fingerprint", fingerprint->ToString());
   }
   return elapsedTime;
 }
 
 template <typename ExternalFacesWorklet>
 auto DoVTKmRun(const std::string& algorithmName, const std::string& hashName,
-  unsigned int numTrials, const vtkm::cont::DataSet& inData, YamlWriter& log) -> void
+  const BenchmarkOptions& benchmark, const vtkm::cont::DataSet& inData, YamlWriter& log,
+  const vtkm::cont::ArrayHandle<vtkm::Id>* inputCellIds = nullptr,
+  vtkm::Float64 subsetSeconds = 0.0,
+  const vtkm::cont::ArrayHandle<vtkm::UInt8>* cellMask = nullptr,
+  const std::function<void(ExternalFacesWorklet&)>& configure = nullptr) -> AlgorithmResult
 {
   ExternalFacesWorklet externalFaces;
+  if (cellMask)
+  {
+    externalFaces.SetCellMask(*cellMask);
+  }
   log.StartListItem();
   log.AddDictionaryEntry("algorithm-name", algorithmName);
   log.AddDictionaryEntry("hash-name", hashName);
   log.AddDictionaryEntry("full-name", algorithmName + " " + hashName);
+  if (configure)
+  {
+    configure(externalFaces);
+  }
+  AlgorithmResult result;
+  result.FullName = algorithmName + " " + hashName;
+  TraceRecorder* recorder = TraceRecorder::GetInstance();
+  TraceScope algorithmScope(recorder ? recorder->Intern(result.FullName) : "", "algorithm");
+  MetricSink metrics;
+
+  // The VTK filters select the cells of an extent in every run, while the subset that the
+  // VTK-m algorithms run on is selected once, so its seconds are added to every run.
+  const vtkm::Float64 firstRunTime = subsetSeconds +
+    RunVTKmTrial(externalFaces, inData, log, metrics, &result.Fingerprint, inputCellIds);
+  if (!std::isnan(firstRunTime))
+  {
+    log.AddDictionaryEntry("first-run-time", firstRunTime);
+  }
+  else
+  {
+    result.Fingerprint = SurfaceFingerprint::Invalid();
+  }
 
-  log.AddDictionaryEntry("first-run-time", RunVTKmTrial(externalFaces, inData, log, true));
+  CacheConditioner::TrialScope trialScope(benchmark.Cache);
+  std::stringstream dummyStream;
+  YamlWriter dummyLog(dummyStream);
+  for (unsigned int warmup = 0; warmup < benchmark.WarmupRuns; warmup++)
+  {
+    RunVTKmTrial(externalFaces, inData, dummyLog, metrics);
+  }
 
-  if (numTrials > 0)
+  BenchmarkRunner runner(benchmark);
+  if (runner.NeedsMoreTrials())
   {
     log.StartBlock("trials");
-    for (unsigned int trial = 0; trial < numTrials; trial++)
+    for (unsigned int trial = 0; runner.NeedsMoreTrials(); trial++)
     {
       log.StartListItem();
       log.AddDictionaryEntry("trial-index", trial);
-      log.AddDictionaryEntry("seconds-total", RunVTKmTrial(externalFaces, inData, log));
+      if (benchmark.Cache)
+      {
+        benchmark.Cache->Prepare(
+          [&]() { RunVTKmTrial(externalFaces, inData, dummyLog, metrics); });
+        log.AddDictionaryEntry("cache-mode", benchmark.Cache->GetModeName());
+      }
+      runner.StartTrial(log);
+      // the metrics of the trial are only written after it ran
+      metrics.Clear();
+      const vtkm::Float64 seconds =
+        subsetSeconds + RunVTKmTrial(externalFaces, inData, log, metrics);
+      if (std::isnan(seconds))
+      {
+        log.AddDictionaryEntry("failed", "true");
+        runner.EndTrial(log, false);
+        continue;
+      }
+      if (inputCellIds)
+      {
+        metrics.Add("seconds-extent-subset", subsetSeconds);
+      }
+      metrics.Add("seconds-total", seconds);
+      metrics.Write(log);
+      if (benchmark.MetricLines)
+      {
+        metrics.WriteJsonLine(*benchmark.MetricLines, result.FullName, trial);
+      }
+      runner.EndTrial(log);
     }
     log.EndBlock();
+    runner.WriteStatistics(log);
+    if (!runner.HasSucceededTrials())
+    {
+      log.AddDictionaryEntry("error", "every trial failed");
+      result.Seconds = FailedRunTime;
+      return result;
+    }
+    result.Seconds = runner.GetStatistics("seconds-total").Mean;
+    return result;
   }
+  result.Seconds = firstRunTime;
+  return result;
 }
 
-auto ComputeFaceHashDistribution(
-  const vtkSmartPointer<vtkUnstructuredGrid>& inData, YamlWriter& log) -> void
+auto ComputeFaceHashDistribution(const vtkSmartPointer<vtkUnstructuredGrid>& inData,
+  const std::vector<long long>& tableSizes, YamlWriter& log) -> void
 {
-  const vtkIdType numPoints = inData->GetNumberOfPoints();
-  std::vector<unsigned int> fnv1aCounter(inData->GetNumberOfPoints(), 0);
-  std::vector<unsigned int> minPointCounter(inData->GetNumberOfPoints(), 0);
+  vtkm::cont::Timer timer;
+  timer.Start();
+  const FaceHashDistribution distribution(inData);
 
-  vtkNew<vtkGenericCell> cell;
-  for (vtkIdType cellId = 0; cellId < inData->GetNumberOfCells(); cellId++)
+  // the first table size is the one of the DP-Hash-* algorithms
+  std::vector<vtkm::Id> sizes = { inData->GetNumberOfPoints() };
+  for (const long long tableSize : tableSizes)
   {
-    inData->GetCell(cellId, cell);
-    for (int faceId = 0; faceId < cell->GetNumberOfFaces(); ++faceId)
+    if (std::find(sizes.begin(), sizes.end(), tableSize) == sizes.end())
     {
-      vtkIdList* pointIds = cell->GetFace(faceId)->GetPointIds();
-      std::sort(pointIds->GetPointer(0), pointIds->GetPointer(0) + pointIds->GetNumberOfIds());
-
-      vtkm::Id3 canonicalFaceId(pointIds->GetId(0), pointIds->GetId(1), pointIds->GetId(2));
-      vtkm::Id fnv1aHash = vtkm::Hash(canonicalFaceId) % numPoints;
-      ++fnv1aCounter[fnv1aHash];
-
-      vtkIdType minPointId = pointIds->GetId(0);
-      ++minPointCounter[minPointId];
+      sizes.push_back(tableSize);
     }
   }
-
-  std::map<unsigned int, unsigned int> fnv1aHashSizeMap;
-  std::map<unsigned int, unsigned int> minPointHashSizeMap;
-  for (vtkIdType pointId = 0; pointId < numPoints; pointId++)
+  std::vector<FaceHashStatistics> statistics;
+  for (const FaceHashPolicy& policy : GetFaceHashPolicies())
   {
-    auto fnv1aHashSizeMapIt = fnv1aHashSizeMap.find(fnv1aCounter[pointId]);
-    if (fnv1aHashSizeMapIt == fnv1aHashSizeMap.end())
-    {
-      fnv1aHashSizeMap[fnv1aCounter[pointId]] = 1;
-    }
-    else
+    for (const vtkm::Id tableSize : sizes)
     {
-      fnv1aHashSizeMapIt->second++;
-    }
-    auto minPointHashSizeMapIt = minPointHashSizeMap.find(minPointCounter[pointId]);
-    if (minPointHashSizeMapIt == minPointHashSizeMap.end())
-    {
-      minPointHashSizeMap[minPointCounter[pointId]] = 1;
-    }
-    else
-    {
-      minPointHashSizeMapIt->second++;
+      statistics.push_back(distribution.Compute(policy, tableSize));
     }
   }
+  timer.Stop();
 
   log.StartBlock("face-hash-distribution");
-  log.StartBlock("FNV1A");
-  for (const auto& entry : fnv1aHashSizeMap)
+  for (const FaceHashStatistics& entry : statistics)
   {
-    log.AddDictionaryEntry(std::to_string(entry.first), entry.second);
+    if (entry.TableSize != sizes[0])
+    {
+      continue;
+    }
+    log.StartBlock(entry.HashName);
+    for (const auto& occupancy : entry.OccupancyHistogram)
+    {
+      log.AddDictionaryEntry(std::to_string(occupancy.first), occupancy.second);
+    }
+    log.EndBlock();
   }
   log.EndBlock();
-  log.StartBlock("MinPointID");
-  for (const auto& entry : minPointHashSizeMap)
+
+  log.StartBlock("face-hash-statistics");
+  for (const FaceHashStatistics& entry : statistics)
   {
-    log.AddDictionaryEntry(std::to_string(entry.first), entry.second);
+    log.StartListItem();
+    log.AddDictionaryEntry("hash-name", entry.HashName);
+    log.AddDictionaryEntry("table-size", entry.TableSize);
+    log.AddDictionaryEntry("faces", entry.NumberOfFaces);
+    log.AddDictionaryEntry("distinct-faces", entry.NumberOfDistinctFaces);
+    log.AddDictionaryEntry("non-empty-buckets", entry.NonEmptyBuckets);
+    log.AddDictionaryEntry("max-occupancy", entry.MaxOccupancy);
+    log.AddDictionaryEntry("occupancy-p50", entry.OccupancyP50);
+    log.AddDictionaryEntry("occupancy-p90", entry.OccupancyP90);
+    log.AddDictionaryEntry("occupancy-p99", entry.OccupancyP99);
+    log.AddDictionaryEntry("occupancy-p99.9", entry.OccupancyP999);
+    log.AddDictionaryEntry("pairwise-comparisons", entry.PairwiseComparisons);
+    log.AddDictionaryEntry("pairwise-comparisons-per-bucket",
+      static_cast<double>(entry.PairwiseComparisons) / static_cast<double>(entry.TableSize));
+    log.AddDictionaryEntry("pairwise-comparisons-per-face",
+      entry.NumberOfFaces > 0
+        ? static_cast<double>(entry.PairwiseComparisons) / static_cast<double>(entry.NumberOfFaces)
+        : 0.0);
+    log.AddDictionaryEntry("colliding-buckets", entry.CollidingBuckets);
+    log.AddDictionaryEntry("colliding-faces", entry.CollidingFaces);
+    log.AddDictionaryEntry("colliding-face-pairs", entry.CollidingFacePairs);
   }
   log.EndBlock();
-  log.EndBlock();
+  log.AddDictionaryEntry("seconds-face-hash-distribution", timer.GetElapsedTime());
 }
 
 auto main(int argc, char** argv) -> int
@@ -326,6 +727,24 @@ auto main(int argc, char** argv) -> int
   Arguments args;
   args.ParseArguments(argc, argv);
 
+  // The counters must exist before the SMP backends create their threads to be inherited
+  std::unique_ptr<PerfCounters> perfCounters;
+  if (args.PerfCounters)
+  {
+    perfCounters = std::make_unique<PerfCounters>();
+  }
+  // The allocations are counted from the start, so that the dataset is part of the heap
+  std::unique_ptr<MemoryProfiler> memoryProfiler;
+  if (args.MemoryProfile && MemoryTracker::IsAvailable())
+  {
+    memoryProfiler = std::make_unique<MemoryProfiler>();
+  }
+  std::unique_ptr<TraceRecorder> traceRecorder;
+  if (!args.TraceFile.empty())
+  {
+    traceRecorder = std::make_unique<TraceRecorder>();
+  }
+
   vtksys::SystemInformation sysinfo;
 
   std::string deviceName =
@@ -341,12 +760,26 @@ auto main(int argc, char** argv) -> int
   char timeString[256];
   std::strftime(timeString, 256, "%Y-%m-%dT%H:%M:%S%z", std::localtime(&currentTime));
   log.AddDictionaryEntry("date", timeString);
+  if (perfCounters)
+  {
+    perfCounters->LogAvailability(log);
+  }
+  if (args.MemoryProfile && !memoryProfiler)
+  {
+    log.AddDictionaryEntry(
+      "memory-profile-error", "the heap is only counted when built with EFL_MEMORY_TRACKING");
+  }
 
-  vtkSMPTools::Initialize(static_cast<int>(args.NumberOfThreads));
+  // A thread sweep initializes the backends with its largest number of threads, and limits
+  // them for each of its steps
+  const unsigned int numberOfThreads = args.ThreadSweep.empty()
+    ? args.NumberOfThreads
+    : *std::max_element(args.ThreadSweep.begin(), args.ThreadSweep.end());
+  vtkSMPTools::Initialize(static_cast<int>(numberOfThreads));
   // Construct the command line string for vtkm::cont::Initialize
   std::vector<std::string> strings = { argv[0], "--vtkm-device", deviceName };
   strings.emplace_back("--vtkm-num-threads");
-  strings.push_back(std::to_string(args.NumberOfThreads));
+  strings.push_back(std::to_string(numberOfThreads));
   std::vector<char*> argvVector;
   for (const auto& str : strings)
   {
@@ -358,15 +791,30 @@ auto main(int argc, char** argv) -> int
   auto result = vtkm::cont::Initialize(vtkm_argc, vtkm_argv,
     vtkm::cont::InitializeOptions::RequireDevice | vtkm::cont::InitializeOptions::ErrorOnBadOption);
   log.AddDictionaryEntry("device", result.Device.GetName());
-  log.AddDictionaryEntry("num-threads", args.NumberOfThreads);
+  log.AddDictionaryEntry("num-threads", numberOfThreads);
 
-  log.AddDictionaryEntry("input-file", args.InputFileName);
-
-  vtkSmartPointer<vtkUnstructuredGrid> vtkInputData = ReadDataSet(args.InputFileName);
+  vtkm::cont::Timer readTimer;
+  readTimer.Start();
+  vtkSmartPointer<vtkUnstructuredGrid> vtkInputData;
+  if (!args.GenerateType.empty())
+  {
+    vtkInputData = GenerateDataSet(
+      args.GenerateType, args.GenerateCells, args.GenerateHoles, args.RandomSeed, log);
+  }
+  else
+  {
+    log.AddDictionaryEntry("input-file", args.InputFileName);
+    vtkInputData = args.MeshCache
+      ? ReadCachedDataSet(args.InputFileName, args.ParallelRead, args.CacheReadAhead, log)
+      : ReadDataSet(args.InputFileName, args.ParallelRead);
+  }
+  readTimer.Stop();
+  log.AddDictionaryEntry("seconds-read-input", readTimer.GetElapsedTime());
 
   if (args.Randomize)
   {
-    vtkInputData = RandomizeDataSet(vtkInputData, log, args.RandomSeed);
+    vtkInputData = RandomizeDataSet(
+      vtkInputData, log, args.PermutationTarget, args.PermutationWindow, args.RandomSeed);
     log.AddDictionaryEntry("randomize-seed", args.RandomSeed);
     log.AddDictionaryEntry("topology-connections", "randomized");
   }
@@ -377,89 +825,438 @@ auto main(int argc, char** argv) -> int
   log.AddDictionaryEntry("num-input-points", vtkInputData->GetNumberOfPoints());
   log.AddDictionaryEntry("num-input-cells", vtkInputData->GetNumberOfCells());
 
-  // Convert the VTK data to VTK-m data if needed
-  // vtkm::cont::DataSet vtkmInputData;
-  // if (args.PHashSort || args.PHashFight || args.PHashCount)
-  // {
-  //   vtkmInputData = tovtkm::Convert(vtkInputData, tovtkm::FieldsFlag::PointsAndCells);
-  // }
-  vtkm::cont::DataSet vtkmInputData =
-    tovtkm::Convert(vtkInputData, tovtkm::FieldsFlag::PointsAndCells);
-  // deallocate the VTK data if it is not needed
-  // if (!(args.HashDistribution || args.SClassifier || args.SHash || args.PClassifier ||
-  // args.PHash))
-  // {
-  //   vtkInputData = nullptr;
-  // }
+  const bool runVTKAlgorithms =
+    args.HashDistribution || args.SClassifier || args.SHash || args.PClassifier || args.PHash;
+  const bool runVTKmAlgorithms = args.DPHashSort || args.DPHashFight || args.DPHashCount;
+  const bool singleRepresentation = args.MemoryMode == "single";
+  log.AddDictionaryEntry("memory-mode", args.MemoryMode);
 
-  const auto datasetMemoryUsed = sysinfo.GetProcMemoryUsed();
-  log.AddDictionaryEntry("dataset-memory-used", datasetMemoryUsed);
-
-  log.StartBlock("experiments");
+  // With an extent, the VTK filters clip to it, and the VTK-m algorithms run on a grid of its
+  // cells. The bin grid is built once here, and shared by the filters through their runs.
+  std::unique_ptr<CellBinGrid> binGrid;
+  vtkSmartPointer<vtkUnstructuredGrid> extentData;
+  vtkm::cont::ArrayHandle<vtkm::Id> extentCellIds;
+  const vtkm::cont::ArrayHandle<vtkm::Id>* inputCellIds = nullptr;
+  vtkm::Float64 extentSubsetSeconds = 0.0;
+  if (!args.Extent.empty())
+  {
+    std::stringstream extent;
+    extent << "[" << args.Extent[0];
+    for (std::size_t i = 1; i < args.Extent.size(); ++i)
+    {
+      extent << ", " << args.Extent[i];
+    }
+    extent << "]";
+    log.AddDictionaryEntry("extent", extent.str());
+    if (args.BinGrid)
+    {
+      binGrid = std::make_unique<CellBinGrid>();
+      vtkm::cont::Timer timer;
+      timer.Start();
+      binGrid->Update(vtkInputData);
+      timer.Stop();
+      log.AddDictionaryEntry("seconds-build-bin-grid", timer.GetElapsedTime());
+      log.AddDictionaryEntry("num-bins", binGrid->GetNumberOfBins());
+    }
+    if (runVTKmAlgorithms)
+    {
+      vtkm::cont::Timer timer;
+      timer.Start();
+      const std::vector<vtkIdType> cellIds =
+        FindExtentCells(vtkInputData, args.Extent.data(), binGrid.get());
+      extentData = ExtractCellSubset(vtkInputData, cellIds);
+      extentCellIds.Allocate(static_cast<vtkm::Id>(cellIds.size()));
+      auto portal = extentCellIds.WritePortal();
+      for (std::size_t i = 0; i < cellIds.size(); ++i)
+      {
+        portal.Set(static_cast<vtkm::Id>(i), static_cast<vtkm::Id>(cellIds[i]));
+      }
+      inputCellIds = &extentCellIds;
+      timer.Stop();
+      extentSubsetSeconds = timer.GetElapsedTime();
+      log.AddDictionaryEntry("seconds-extent-subset", extentSubsetSeconds);
+      log.AddDictionaryEntry("num-extent-cells", cellIds.size());
+    }
+  }
 
-  if (args.HashDistribution)
+  // The cell mask is expanded once to a value per cell for the VTK-m algorithms, for the cells
+  // that they run on.
+  vtkDataArray* maskArray = CellVisibility::FindCellMask(
+    vtkInputData, args.CellMask.empty() ? nullptr : args.CellMask.c_str());
+  const bool useCellMask = maskArray != nullptr;
+  vtkm::cont::ArrayHandle<vtkm::UInt8> cellMask;
+  if (!args.CellMask.empty())
   {
-    ComputeFaceHashDistribution(vtkInputData, log);
+    log.AddDictionaryEntry("cell-mask", args.CellMask);
+    if (!useCellMask)
+    {
+      log.AddDictionaryEntry(
+        "cell-mask-error", "the input has no unsigned char or bit cell array of this name");
+    }
+    else if (runVTKmAlgorithms)
+    {
+      vtkm::cont::Timer timer;
+      timer.Start();
+      vtkm::cont::ArrayHandleBasic<vtkm::UInt8> maskValues;
+      maskValues.Allocate(vtkInputData->GetNumberOfCells());
+      CellVisibility visibility(false, 0, 0, false, 0, 0, false, nullptr);
+      visibility.SetCellMask(maskArray);
+      visibility.Compute(vtkInputData, reinterpret_cast<char*>(maskValues.GetWritePointer()));
+      cellMask = maskValues;
+      if (inputCellIds)
+      {
+        vtkm::cont::ArrayHandle<vtkm::UInt8> extentMask;
+        vtkm::cont::ArrayCopy(
+          vtkm::cont::make_ArrayHandlePermutation(*inputCellIds, cellMask), extentMask);
+        cellMask = extentMask;
+      }
+      timer.Stop();
+      log.AddDictionaryEntry("seconds-cell-mask", timer.GetElapsedTime());
+    }
   }
-  if (args.SClassifier)
+
+  // The region ids are copied once for the VTK-m algorithms, for the cells that they run on.
+  vtkm::cont::ArrayHandle<vtkm::Id> regionIds;
+  bool useRegionIds = false;
+  if (!args.RegionIds.empty())
   {
-    DoVTKRun<vtkGeometryFilterSClassifier>(
-      "S-Classifier", "None", args.NumberOfTrials, vtkInputData, log);
+    log.AddDictionaryEntry("region-ids", args.RegionIds);
+    vtkm::cont::Timer timer;
+    timer.Start();
+    useRegionIds = ReadRegionIds(vtkInputData, args.RegionIds, regionIds);
+    if (!useRegionIds)
+    {
+      log.AddDictionaryEntry(
+        "region-ids-error", "the input has no integral cell array of this name");
+    }
+    else if (inputCellIds)
+    {
+      vtkm::cont::ArrayHandle<vtkm::Id> extentRegionIds;
+      vtkm::cont::ArrayCopy(
+        vtkm::cont::make_ArrayHandlePermutation(*inputCellIds, regionIds), extentRegionIds);
+      regionIds = extentRegionIds;
+    }
+    timer.Stop();
+    log.AddDictionaryEntry("seconds-region-ids", timer.GetElapsedTime());
   }
-  if (args.SHash)
+  // the interfaces between regions are only found by P-Hash and DP-Hash-Count
+  auto setRegionIds = [&](auto& worklet)
+  {
+    if (useRegionIds)
+    {
+      worklet.SetRegionIds(regionIds);
+    }
+  };
+  // the face adjacency is only built by DP-Hash-Count and DP-Hash-Sort
+  auto setFaceNeighbors = [&](auto& worklet)
+  {
+    worklet.SetComputeFaceNeighbors(args.FaceNeighbors);
+    if (args.FaceNeighbors)
+    {
+      log.AddDictionaryEntry("face-neighbors", "true");
+    }
+  };
+  // VTK-m cell sets have no modification time, so the surfaces that the DP-Hash-* algorithms
+  // keep are keyed by the cell array that their input was converted from
+  const vtkm::UInt64 topologyKey =
+    (extentData ? extentData : vtkInputData)->GetCells()->GetMTime();
+  auto setTopologyCache = [&](auto& worklet)
+  {
+    worklet.SetCacheTopology(args.CacheTopology);
+    worklet.SetTopologyKey(topologyKey);
+    if (args.CacheTopology)
+    {
+      log.AddDictionaryEntry("cache-topology", "true");
+    }
+  };
+  auto configureHashSort = [&](auto& worklet)
+  {
+    setFaceNeighbors(worklet);
+    setTopologyCache(worklet);
+  };
+  auto configureHashCount = [&](auto& worklet)
+  {
+    setRegionIds(worklet);
+    setFaceNeighbors(worklet);
+    setTopologyCache(worklet);
+  };
+  // P-Hash keeps its surface for the runs of one filter
+  std::unique_ptr<SurfaceTopologyCache> topologyCache;
+
+  auto clipToExtent = [&](auto* filter)
+  {
+    if (!args.Extent.empty())
+    {
+      filter->ExtentClippingOn();
+      filter->SetExtent(args.Extent.data());
+    }
+  };
+
+  // Convert the VTK data to VTK-m data only if a VTK-m algorithm will run. In single
+  // representation mode, the conversion is deferred until the VTK algorithms are done, and
+  // the VTK data is released as soon as only VTK-m algorithms remain.
+  vtkm::cont::DataSet vtkmInputData;
+  DataSetConversionInfo conversionInfo;
+  vtkm::Float64 conversionTime = 0.0;
+  auto convertInputData = [&]()
+  {
+    vtkm::cont::Timer timer;
+    timer.Start();
+    vtkmInputData = ConvertTopology(extentData ? extentData : vtkInputData, conversionInfo);
+    timer.Stop();
+    conversionTime = timer.GetElapsedTime();
+  };
+  if (runVTKmAlgorithms && (!singleRepresentation || !runVTKAlgorithms))
   {
-    DoVTKRun<vtkDataSetSurfaceFilterSHash>(
-      "S-Hash", "MinPointID", args.NumberOfTrials, vtkInputData, log);
+    convertInputData();
   }
-  if (args.PClassifier)
+  if (singleRepresentation && !runVTKAlgorithms)
   {
-    DoVTKRun<vtkGeometryFilterPClassifier>(
-      "P-Classifier", "None", args.NumberOfTrials, vtkInputData, log);
+    vtkInputData = nullptr;
   }
-  if (args.PHash)
+
+  const auto datasetMemoryUsed = sysinfo.GetProcMemoryUsed();
+  log.AddDictionaryEntry("dataset-memory-used", datasetMemoryUsed);
+  if (memoryProfiler)
   {
-    DoVTKRun<vtkGeometryFilterPHash>(
-      "P-Hash", "MinPointID", args.NumberOfTrials, vtkInputData, log);
+    log.AddDictionaryEntry("dataset-heap-bytes", MemoryTracker::GetCurrentBytes());
   }
 
-  if (args.DPHashSort)
+  BenchmarkOptions benchmark;
+  benchmark.WarmupRuns = args.WarmupRuns;
+  benchmark.MinTrials = args.NumberOfTrials;
+  benchmark.MaxTrials = args.NumberOfTrials;
+  if (args.TargetRelativeCI > 0.0 || args.TimeBudget > 0.0)
+  {
+    benchmark.MinTrials = std::max(args.NumberOfTrials, 2u);
+    benchmark.MaxTrials = std::max(args.MaxTrials, benchmark.MinTrials);
+  }
+  benchmark.TargetRelativeCI = args.TargetRelativeCI;
+  benchmark.TimeBudget = args.TimeBudget;
+  benchmark.OutlierThreshold = args.OutlierThreshold;
+  std::ofstream metricLines;
+  if (!args.MetricLinesFile.empty())
+  {
+    metricLines.open(args.MetricLinesFile);
+    if (metricLines)
+    {
+      benchmark.MetricLines = &metricLines;
+    }
+    else
+    {
+      log.AddDictionaryEntry("metrics-jsonl-error", "the metrics file cannot be written");
+    }
+  }
+  std::unique_ptr<CacheConditioner> cacheConditioner;
+  if (args.CacheMode != "default")
   {
-    if (args.HashFunction == 0 || args.HashFunction == 1)
+    cacheConditioner = std::make_unique<CacheConditioner>(
+      args.CacheMode == "cold" ? CacheMode::Cold : CacheMode::Warm);
+    benchmark.Cache = cacheConditioner.get();
+    log.AddDictionaryEntry("cache-mode", cacheConditioner->GetModeName());
+    log.AddDictionaryEntry("llc-bytes", detail::GetLastLevelCacheSize());
+    if (cacheConditioner->GetFlushBytes() > 0)
     {
-      DoVTKmRun<vtkm::worklet::ExternalFacesHashSortFnv1a>(
-        "DP-Hash-Sort", "FNV1A", args.NumberOfTrials, vtkmInputData, log);
+      log.AddDictionaryEntry("flush-bytes", cacheConditioner->GetFlushBytes());
     }
-    if (args.HashFunction == 0 || args.HashFunction == 2)
+    if (cacheConditioner->TunesHeap())
     {
-      DoVTKmRun<vtkm::worklet::ExternalFacesHashSortMinPointId>(
-        "DP-Hash-Sort", "MinPointID", args.NumberOfTrials, vtkmInputData, log);
+      log.AddDictionaryEntry(
+        "heap-tuning", "no mmap and no trimming during the warm-up runs and trials");
     }
   }
-  if (args.DPHashFight)
+
+  // Runs all selected algorithms, validates their outputs against each other, and returns their
+  // results. In a thread sweep, the VTK data is only released in single representation mode
+  // after the last sweep step.
+  auto runExperiments = [&](bool firstStep, bool lastStep) -> std::vector<AlgorithmResult>
   {
-    if (args.HashFunction == 0 || args.HashFunction == 1)
+    std::vector<AlgorithmResult> results;
+    log.StartBlock("experiments");
+
+    if (args.HashDistribution && firstStep)
+    {
+      ComputeFaceHashDistribution(vtkInputData, args.HashTableSizes, log);
+    }
+    if (args.SClassifier)
+    {
+      results.push_back(DoVTKRun<vtkGeometryFilterSClassifier>("S-Classifier", "None",
+        benchmark, vtkInputData, log, clipToExtent));
+    }
+    if (args.SHash)
+    {
+      results.push_back(DoVTKRun<vtkDataSetSurfaceFilterSHash>(
+        "S-Hash", "MinPointID", benchmark, vtkInputData, log));
+    }
+    if (args.PClassifier)
+    {
+      results.push_back(DoVTKRun<vtkGeometryFilterPClassifier>("P-Classifier", "None",
+        benchmark, vtkInputData, log,
+        [&](vtkGeometryFilterPClassifier* filter)
+        {
+          clipToExtent(filter);
+          filter->SetCellBinGrid(binGrid.get());
+          // the bitset point map is specific to P-Hash
+          const bool fused = args.PointMap == "fused";
+          filter->SetPointMapMode(fused ? vtkGeometryFilterPClassifier::POINT_MAP_FUSED
+                                        : vtkGeometryFilterPClassifier::POINT_MAP_ARRAY);
+          log.AddDictionaryEntry("point-map", fused ? "fused" : "array");
+        }));
+    }
+    if (args.PHash)
+    {
+      results.push_back(DoVTKRun<vtkGeometryFilterPHash>("P-Hash", "MinPointID", benchmark,
+        vtkInputData, log,
+        [&](vtkGeometryFilterPHash* filter)
+        {
+          clipToExtent(filter);
+          filter->SetCellBinGrid(binGrid.get());
+          filter->SetCellMaskArrayName(useCellMask ? args.CellMask.c_str() : nullptr);
+          filter->SetRegionIdsArrayName(useRegionIds ? args.RegionIds.c_str() : nullptr);
+          filter->SetPointMapMode(args.PointMap == "bitset"
+              ? vtkGeometryFilterPHash::POINT_MAP_BITSET
+              : args.PointMap == "fused" ? vtkGeometryFilterPHash::POINT_MAP_FUSED
+                                         : vtkGeometryFilterPHash::POINT_MAP_ARRAY);
+          log.AddDictionaryEntry("point-map", args.PointMap);
+          if (args.CacheTopology)
+          {
+            topologyCache = std::make_unique<SurfaceTopologyCache>();
+            filter->SetTopologyCache(topologyCache.get());
+            log.AddDictionaryEntry("cache-topology", "true");
+          }
+        }));
+    }
+
+    if (singleRepresentation && runVTKAlgorithms && vtkInputData)
+    {
+      if (runVTKmAlgorithms && vtkmInputData.GetNumberOfCells() == 0)
+      {
+        convertInputData();
+      }
+      if (lastStep)
+      {
+        // deallocate the VTK data, since the remaining algorithms only need the VTK-m data.
+        // Buffers shared with the VTK-m data are kept alive by the ArrayHandles.
+        vtkInputData = nullptr;
+      }
+    }
+
+    if (args.DPHashSort)
+    {
+      if (args.HashFunction == 0 || args.HashFunction == 1)
+      {
+        results.push_back(DoVTKmRun<vtkm::worklet::ExternalFacesHashSortFnv1a>("DP-Hash-Sort",
+          "FNV1A", benchmark, vtkmInputData, log, inputCellIds, extentSubsetSeconds, &cellMask,
+          configureHashSort));
+      }
+      if (args.HashFunction == 0 || args.HashFunction == 2)
+      {
+        results.push_back(DoVTKmRun<vtkm::worklet::ExternalFacesHashSortMinPointId>(
+          "DP-Hash-Sort", "MinPointID", benchmark, vtkmInputData, log, inputCellIds,
+          extentSubsetSeconds, &cellMask, configureHashSort));
+      }
+    }
+    if (args.DPHashFight)
     {
-      DoVTKmRun<vtkm::worklet::ExternalFacesHashFightFnv1a>(
-        "DP-Hash-Fight", "FNV1A", args.NumberOfTrials, vtkmInputData, log);
+      if (args.HashFunction == 0 || args.HashFunction == 1)
+      {
+        results.push_back(DoVTKmRun<vtkm::worklet::ExternalFacesHashFightFnv1a>(
+          "DP-Hash-Fight", "FNV1A", benchmark, vtkmInputData, log, inputCellIds,
+          extentSubsetSeconds, &cellMask, setTopologyCache));
+      }
+      if (args.HashFunction == 0 || args.HashFunction == 2)
+      {
+        results.push_back(DoVTKmRun<vtkm::worklet::ExternalFacesHashFightMinPointId>(
+          "DP-Hash-Fight", "MinPointID", benchmark, vtkmInputData, log, inputCellIds,
+          extentSubsetSeconds, &cellMask, setTopologyCache));
+      }
     }
-    if (args.HashFunction == 0 || args.HashFunction == 2)
+    if (args.DPHashCount)
     {
-      DoVTKmRun<vtkm::worklet::ExternalFacesHashFightMinPointId>(
-        "DP-Hash-Fight", "MinPointID", args.NumberOfTrials, vtkmInputData, log);
+      if (args.HashFunction == 0 || args.HashFunction == 1)
+      {
+        results.push_back(DoVTKmRun<vtkm::worklet::ExternalFacesHashCountFnv1a>("DP-Hash-Count",
+          "FNV1A", benchmark, vtkmInputData, log, inputCellIds, extentSubsetSeconds, &cellMask,
+          configureHashCount));
+      }
+      if (args.HashFunction == 0 || args.HashFunction == 2)
+      {
+        results.push_back(DoVTKmRun<vtkm::worklet::ExternalFacesHashCountMinPointId>(
+          "DP-Hash-Count", "MinPointID", benchmark, vtkmInputData, log, inputCellIds,
+          extentSubsetSeconds, &cellMask, configureHashCount));
+      }
     }
+    log.EndBlock();
+    ValidateSurfaces(results, log);
+    return results;
+  };
+
+  if (args.ThreadSweep.empty())
+  {
+    runExperiments(true, true);
   }
-  if (args.DPHashCount)
+  else
   {
-    if (args.HashFunction == 0 || args.HashFunction == 1)
+    // every sweep step is a list item with its own experiments, and the speedup and efficiency
+    // of each algorithm are relative to its time with the first number of threads
+    std::vector<std::vector<AlgorithmResult>> stepResults;
+    log.StartBlock("thread-sweep");
+    for (std::size_t step = 0; step < args.ThreadSweep.size(); ++step)
+    {
+      const unsigned int numberOfThreads = args.ThreadSweep[step];
+      log.StartListItem();
+      log.AddDictionaryEntry("num-threads", numberOfThreads);
+      RunWithThreadLimit(static_cast<int>(numberOfThreads),
+        [&]()
+        {
+          stepResults.push_back(
+            runExperiments(step == 0, step + 1 == args.ThreadSweep.size()));
+        });
+    }
+    log.EndBlock();
+
+    log.StartBlock("scaling");
+    log.AddDictionaryEntry("vtkm-threads-limited", ThreadLimitAppliesToVTKm() ? "true" : "false");
+    log.StartBlock("algorithms");
+    for (std::size_t algorithm = 0; algorithm < stepResults[0].size(); ++algorithm)
     {
-      DoVTKmRun<vtkm::worklet::ExternalFacesHashCountFnv1a>(
-        "DP-Hash-Count", "FNV1A", args.NumberOfTrials, vtkmInputData, log);
+      const vtkm::Float64 baseTime = stepResults[0][algorithm].Seconds;
+      log.StartListItem();
+      log.AddDictionaryEntry("full-name", stepResults[0][algorithm].FullName);
+      log.StartBlock("steps");
+      for (std::size_t step = 0; step < stepResults.size(); ++step)
+      {
+        const vtkm::Float64 time = stepResults[step][algorithm].Seconds;
+        const vtkm::Float64 speedup = baseTime > 0.0 && time > 0.0 ? baseTime / time : 0.0;
+        log.StartListItem();
+        log.AddDictionaryEntry("num-threads", args.ThreadSweep[step]);
+        log.AddDictionaryEntry("seconds-mean", time);
+        log.AddDictionaryEntry("speedup", speedup);
+        log.AddDictionaryEntry("efficiency",
+          speedup * args.ThreadSweep[0] / static_cast<vtkm::Float64>(args.ThreadSweep[step]));
+      }
+      log.EndBlock();
     }
-    if (args.HashFunction == 0 || args.HashFunction == 2)
+    log.EndBlock();
+    log.EndBlock();
+  }
+
+  if (runVTKmAlgorithms)
+  {
+    log.StartBlock("vtkm-conversion");
+    log.AddDictionaryEntry(
+      "zero-copy-topology", conversionInfo.ZeroCopyTopology ? "true" : "false");
+    log.AddDictionaryEntry("zero-copy-points", conversionInfo.ZeroCopyPoints ? "true" : "false");
+    log.AddDictionaryEntry("seconds-conversion", conversionTime);
+    log.EndBlock();
+  }
+
+  if (traceRecorder)
+  {
+    log.AddDictionaryEntry("trace-file", args.TraceFile);
+    if (!traceRecorder->Write(args.TraceFile))
     {
-      DoVTKmRun<vtkm::worklet::ExternalFacesHashCountMinPointId>(
-        "DP-Hash-Count", "MinPointID", args.NumberOfTrials, vtkmInputData, log);
+      log.AddDictionaryEntry("trace-error", "the trace file cannot be written");
     }
   }
-  log.EndBlock();
 }
\ No newline at end of file
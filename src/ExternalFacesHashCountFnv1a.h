@@ -19,6 +19,7 @@
 
 #include <vtkm/cont/Algorithm.h>
 #include <vtkm/cont/ArrayHandle.h>
+#include <vtkm/cont/ArrayHandleConstant.h>
 #include <vtkm/cont/ArrayHandleGroupVecVariable.h>
 #include <vtkm/cont/CellSetExplicit.h>
 #include <vtkm/cont/ConvertNumComponentsToOffsets.h>
@@ -28,7 +29,11 @@
 #include <vtkm/worklet/WorkletMapField.h>
 #include <vtkm/worklet/WorkletMapTopology.h>
 
-#include "YamlWriter.h"
+#include "CellSetTopologyCache.h"
+#include "MetricSink.h"
+#include "PhaseTimer.h"
+
+#include <memory>
 
 namespace vtkm
 {
@@ -37,18 +42,28 @@ namespace worklet
 
 struct ExternalFacesHashCountFnv1a
 {
-  // Worklet that returns the number of faces for each cell/shape
+  // Worklet that returns the number of faces for each cell/shape, which is zero for the cells
+  // hidden by the cell mask
   class NumFacesPerCell : public vtkm::worklet::WorkletVisitCellsWithPoints
   {
   public:
-    using ControlSignature = void(CellSetIn inCellSet, FieldOut numFacesInCell);
-    using ExecutionSignature = void(CellShape, _2);
+    using ControlSignature =
+      void(CellSetIn inCellSet, FieldInCell cellMask, FieldOut numFacesInCell);
+    using ExecutionSignature = void(CellShape, _2, _3);
     using InputDomain = _1;
 
     template <typename CellShapeTag>
-    VTKM_EXEC void operator()(CellShapeTag shape, vtkm::IdComponent& numFacesInCell) const
+    VTKM_EXEC void operator()(
+      CellShapeTag shape, vtkm::UInt8 cellMask, vtkm::IdComponent& numFacesInCell) const
     {
-      vtkm::exec::CellFaceNumberOfFaces(shape, numFacesInCell);
+      if (cellMask)
+      {
+        vtkm::exec::CellFaceNumberOfFaces(shape, numFacesInCell);
+      }
+      else
+      {
+        numFacesInCell = 0;
+      }
     }
   };
 
@@ -317,6 +332,135 @@ struct ExternalFacesHashCountFnv1a
     }
   };
 
+  // Worklet that writes the neighbor cell of each face of a hash at the position of the face in
+  // the faces of its cell, or -1 for the external faces. Only valid right after FaceCounts, which
+  // puts the two faces of each internal face next to each other after the external faces.
+  class FaceNeighbors : public vtkm::worklet::WorkletMapField
+  {
+  public:
+    using ControlSignature = void(FieldIn cellAndFaceIdOfFacesInHash,
+      FieldIn externalFacesInHash, WholeArrayIn facesPerCellOffsets, WholeArrayOut faceNeighbors);
+    using ExecutionSignature = void(_1, _2, _3, _4);
+    using InputDomain = _1;
+
+    template <typename CellAndFaceIdOfFacesInHash, typename OffsetsPortal,
+      typename FaceNeighborsPortal>
+    VTKM_EXEC void operator()(const CellAndFaceIdOfFacesInHash& cellAndFaceIdOfFacesInHash,
+      vtkm::IdComponent numExternalFaces, const OffsetsPortal& facesPerCellOffsets,
+      FaceNeighborsPortal& faceNeighbors) const
+    {
+      const vtkm::IdComponent numFacesInHash = cellAndFaceIdOfFacesInHash.GetNumberOfComponents();
+      CellFaceIdPacker::CellIdType cellId1, cellId2;
+      CellFaceIdPacker::FaceIdType faceId1, faceId2;
+      for (vtkm::IdComponent index = 0; index < numExternalFaces; ++index)
+      {
+        CellFaceIdPacker::Unpack(cellAndFaceIdOfFacesInHash[index], cellId1, faceId1);
+        faceNeighbors.Set(facesPerCellOffsets.Get(cellId1) + faceId1, -1);
+      }
+      for (vtkm::IdComponent index = numExternalFaces; index + 1 < numFacesInHash; index += 2)
+      {
+        CellFaceIdPacker::Unpack(cellAndFaceIdOfFacesInHash[index], cellId1, faceId1);
+        CellFaceIdPacker::Unpack(cellAndFaceIdOfFacesInHash[index + 1], cellId2, faceId2);
+        faceNeighbors.Set(facesPerCellOffsets.Get(cellId1) + faceId1, cellId2);
+        faceNeighbors.Set(facesPerCellOffsets.Get(cellId2) + faceId2, cellId1);
+      }
+    }
+  };
+
+  // Worklet that keeps, after the external faces of a hash, the internal faces shared by cells
+  // of different regions. Each such interface is a pair of faces after FaceCounts. The pairs are
+  // moved to the front of the internal faces, with the face of the cell of the lower region
+  // first, and then split so that the first faces of the m interfaces follow the external
+  // faces and the other face of each is m faces further. The resulting number is the number of
+  // external faces and interfaces.
+  class InterfaceFaceCounts : public vtkm::worklet::WorkletMapField
+  {
+  public:
+    using ControlSignature = void(FieldInOut cellAndFaceIdOfFacesInHash,
+      FieldIn externalFacesInHash, WholeArrayIn regionIds, FieldOut outputFacesInHash);
+    using ExecutionSignature = _4(_1, _2, _3);
+    using InputDomain = _1;
+
+    template <typename CellAndFaceIdOfFacesInHash, typename RegionIdsPortal>
+    VTKM_EXEC vtkm::IdComponent operator()(CellAndFaceIdOfFacesInHash& cellAndFaceIdOfFacesInHash,
+      vtkm::IdComponent numExternalFaces, const RegionIdsPortal& regionIds) const
+    {
+      using CellAndFaceIdType = CellFaceIdPacker::CellAndFaceIdType;
+      const vtkm::IdComponent numFacesInHash = cellAndFaceIdOfFacesInHash.GetNumberOfComponents();
+      CellFaceIdPacker::CellIdType cellId1, cellId2;
+      CellFaceIdPacker::FaceIdType faceId;
+      vtkm::IdComponent numInterfaces = 0;
+      for (vtkm::IdComponent index = numExternalFaces; index + 1 < numFacesInHash; index += 2)
+      {
+        CellAndFaceIdType face1 = cellAndFaceIdOfFacesInHash[index];
+        CellAndFaceIdType face2 = cellAndFaceIdOfFacesInHash[index + 1];
+        CellFaceIdPacker::Unpack(face1, cellId1, faceId);
+        CellFaceIdPacker::Unpack(face2, cellId2, faceId);
+        const vtkm::Id region1 = regionIds.Get(cellId1);
+        const vtkm::Id region2 = regionIds.Get(cellId2);
+        if (region1 != region2)
+        {
+          if (region2 < region1)
+          {
+            vtkm::Swap(face1, face2);
+          }
+          const vtkm::IdComponent target = numExternalFaces + 2 * numInterfaces;
+          cellAndFaceIdOfFacesInHash[index] = cellAndFaceIdOfFacesInHash[target];
+          cellAndFaceIdOfFacesInHash[index + 1] = cellAndFaceIdOfFacesInHash[target + 1];
+          cellAndFaceIdOfFacesInHash[target] = face1;
+          cellAndFaceIdOfFacesInHash[target + 1] = face2;
+          ++numInterfaces;
+        }
+      }
+      // (A0 B0 A1 B1 ...) to (A0 A1 ... B0 B1 ...). A hash rarely has more than one interface.
+      for (vtkm::IdComponent interfaceIndex = 1; interfaceIndex < numInterfaces; ++interfaceIndex)
+      {
+        for (vtkm::IdComponent index = numExternalFaces + 2 * interfaceIndex;
+             index > numExternalFaces + interfaceIndex; --index)
+        {
+          const CellAndFaceIdType face = cellAndFaceIdOfFacesInHash[index];
+          cellAndFaceIdOfFacesInHash[index] = cellAndFaceIdOfFacesInHash[index - 1];
+          cellAndFaceIdOfFacesInHash[index - 1] = face;
+        }
+      }
+      return numExternalFaces + numInterfaces;
+    }
+  };
+
+  // Worklet that returns the region of the cell of each outputted face, and the region of the
+  // cell on the other side of it, or -1 for the external faces.
+  class BuildRegionIdPairs : public vtkm::worklet::WorkletMapField
+  {
+  public:
+    using ControlSignature = void(FieldIn cellAndFaceIdOfFacesInHash,
+      FieldIn externalFacesInHash, FieldIn outputFacesInHash, WholeArrayIn regionIds,
+      FieldOut regionIdPairsOut);
+    using ExecutionSignature = void(_1, _2, _3, _4, VisitIndex, _5);
+    using InputDomain = _1;
+
+    using ScatterType = vtkm::worklet::ScatterCounting;
+
+    template <typename CellAndFaceIdOfFacesInHash, typename RegionIdsPortal>
+    VTKM_EXEC void operator()(const CellAndFaceIdOfFacesInHash& cellAndFaceIdOfFacesInHash,
+      vtkm::IdComponent numExternalFaces, vtkm::IdComponent numOutputFaces,
+      const RegionIdsPortal& regionIds, vtkm::IdComponent visitIndex,
+      vtkm::Id2& regionIdPairOut) const
+    {
+      CellFaceIdPacker::CellIdType cellId;
+      CellFaceIdPacker::FaceIdType faceId;
+      CellFaceIdPacker::Unpack(cellAndFaceIdOfFacesInHash[visitIndex], cellId, faceId);
+      regionIdPairOut[0] = regionIds.Get(cellId);
+      regionIdPairOut[1] = -1;
+      if (visitIndex >= numExternalFaces)
+      {
+        // the other face of an interface is after the first faces of all interfaces
+        const vtkm::IdComponent otherIndex = visitIndex + numOutputFaces - numExternalFaces;
+        CellFaceIdPacker::Unpack(cellAndFaceIdOfFacesInHash[otherIndex], cellId, faceId);
+        regionIdPairOut[1] = regionIds.Get(cellId);
+      }
+    }
+  };
+
 public:
   // Worklet that returns the number of points for each outputted face.
   // Have to manage the case where multiple faces have the same hash.
@@ -397,7 +541,62 @@ public:
   VTKM_CONT
   ExternalFacesHashCountFnv1a() {}
 
-  void ReleaseCellMapArrays() { this->CellIdMap.ReleaseResources(); }
+  void ReleaseCellMapArrays()
+  {
+    this->CellIdMap.ReleaseResources();
+    this->RegionIdPairs.ReleaseResources();
+    this->FaceNeighborOffsets.ReleaseResources();
+    this->FaceNeighbors.ReleaseResources();
+  }
+
+  /// Sets a mask of one value per input cell. The cells with a zero value are skipped as if they
+  /// were not in the input, so that the faces they share with the other cells are external. An
+  /// empty mask, the default, uses all cells.
+  void SetCellMask(const vtkm::cont::ArrayHandle<vtkm::UInt8>& cellMask)
+  {
+    this->CellMask = cellMask;
+    if (this->TopologyCache)
+    {
+      this->TopologyCache->Clear();
+    }
+  }
+
+  /// Sets the region, e.g. the material, of each input cell. The faces shared by cells of
+  /// different regions are then output after the external faces, as faces of the cell of the
+  /// lower region, and \c GetRegionIdPairs returns the regions on both sides of each output
+  /// face. An empty array, the default, removes all shared faces.
+  void SetRegionIds(const vtkm::cont::ArrayHandle<vtkm::Id>& regionIds)
+  {
+    this->RegionIds = regionIds;
+    if (this->TopologyCache)
+    {
+      this->TopologyCache->Clear();
+    }
+  }
+
+  /// Sets whether Run also builds the face adjacency of the input cells, from the face pairs
+  /// that it matches anyway. \c GetFaceNeighbors then holds the neighbor cell of each face of
+  /// each cell, or -1 for the external faces, starting at the entry of \c GetFaceNeighborOffsets
+  /// of the cell. The default is off.
+  void SetComputeFaceNeighbors(bool computeFaceNeighbors)
+  {
+    this->ComputeFaceNeighbors = computeFaceNeighbors;
+    if (this->TopologyCache)
+    {
+      this->TopologyCache->Clear();
+    }
+  }
+
+  /// Sets whether the output of Run is kept, so that the later runs with the same topology key
+  /// only copy it instead of hashing the faces again. The default is off.
+  void SetCacheTopology(bool cacheTopology)
+  {
+    this->TopologyCache = cacheTopology ? std::make_shared<CellSetTopologyCache>() : nullptr;
+  }
+
+  /// Sets the key of the topology of the input cells, which must change when the cells change,
+  /// e.g. the MTime of the cell array of the VTK data set that the input was converted from.
+  void SetTopologyKey(vtkm::UInt64 topologyKey) { this->TopologyKey = topologyKey; }
 
   ///////////////////////////////////////////////////
   /// \brief ExternalFacesHashCountFnv1a: Extract Faces on outside of geometry
@@ -405,8 +604,26 @@ public:
     typename OffsetsStorage>
   VTKM_CONT void Run(const InCellSetType& inCellSet,
     vtkm::cont::CellSetExplicit<ShapeStorage, ConnectivityStorage, OffsetsStorage>& outCellSet,
-    YamlWriter& log)
+    MetricSink& metrics)
   {
+    // The output of an earlier run on the same topology is copied as it is
+    if (this->TopologyCache)
+    {
+      PhaseTimer restoreTimer;
+      restoreTimer.Start();
+      const bool restored = this->TopologyCache->Restore(this->TopologyKey, outCellSet);
+      restoreTimer.Stop();
+      if (restored)
+      {
+        restoreTimer.Report(metrics, "seconds-restore-topology");
+        this->CellIdMap = this->TopologyCache->CellIdMap;
+        this->RegionIdPairs = this->TopologyCache->RegionIdPairs;
+        this->FaceNeighborOffsets = this->TopologyCache->FaceNeighborOffsets;
+        this->FaceNeighbors = this->TopologyCache->FaceNeighbors;
+        return;
+      }
+    }
+
     using PointCountArrayType = vtkm::cont::ArrayHandle<vtkm::IdComponent>;
     using ShapeArrayType = vtkm::cont::ArrayHandle<vtkm::UInt8, ShapeStorage>;
     using OffsetsArrayType = vtkm::cont::ArrayHandle<vtkm::Id, OffsetsStorage>;
@@ -419,11 +636,20 @@ public:
     vtkm::cont::ArrayHandle<vtkm::IdComponent> numFacesPerCell;
 
     // Compute the number of faces per cell
-    vtkm::cont::Timer timer;
+    PhaseTimer timer;
     timer.Start();
-    invoke(NumFacesPerCell(), inCellSet, numFacesPerCell);
+    if (this->CellMask.GetNumberOfValues() > 0)
+    {
+      invoke(NumFacesPerCell(), inCellSet, this->CellMask, numFacesPerCell);
+    }
+    else
+    {
+      invoke(NumFacesPerCell(), inCellSet,
+        vtkm::cont::make_ArrayHandleConstant(vtkm::UInt8(1), inCellSet.GetNumberOfCells()),
+        numFacesPerCell);
+    }
     timer.Stop();
-    log.AddDictionaryEntry("seconds-num-faces-per-cell", timer.GetElapsedTime());
+    timer.Report(metrics, "seconds-num-faces-per-cell");
 
     // Compute the offsets into a packed array holding face information for each cell.
     vtkm::Id totalNumberOfFaces;
@@ -432,15 +658,28 @@ public:
     vtkm::cont::ConvertNumComponentsToOffsets(
       numFacesPerCell, facesPerCellOffsets, totalNumberOfFaces);
     timer.Stop();
-    log.AddDictionaryEntry("seconds-face-per-cell-count", timer.GetElapsedTime());
+    timer.Report(metrics, "seconds-face-per-cell-count");
     // Release the resources of numFacesPerCell that is not needed anymore
     numFacesPerCell.ReleaseResources();
 
     if (totalNumberOfFaces == 0)
     {
-      // Data has no faces. Output is empty.
+      // Data has no faces, e.g. when every cell is masked out. Output is empty.
       outCellSet.PrepareToAddCells(0, 0);
       outCellSet.CompleteAddingCells(inCellSet.GetNumberOfPoints());
+      this->CellIdMap = vtkm::cont::ArrayHandle<vtkm::Id>();
+      this->RegionIdPairs = vtkm::cont::ArrayHandle<vtkm::Id2>();
+      // every cell has no face neighbors
+      this->FaceNeighborOffsets =
+        this->ComputeFaceNeighbors ? facesPerCellOffsets : vtkm::cont::ArrayHandle<vtkm::Id>();
+      this->FaceNeighbors = vtkm::cont::ArrayHandle<vtkm::Id>();
+      if (this->TopologyCache)
+      {
+        this->TopologyCache->Store(this->TopologyKey, outCellSet, this->CellIdMap);
+        this->TopologyCache->RegionIdPairs = this->RegionIdPairs;
+        this->TopologyCache->FaceNeighborOffsets = this->FaceNeighborOffsets;
+        this->TopologyCache->FaceNeighbors = this->FaceNeighbors;
+      }
       return;
     }
 
@@ -457,7 +696,7 @@ public:
     timer.Start();
     invoke(FaceHash(numberOfHashes), inCellSet, faceHashesGroupVec);
     timer.Stop();
-    log.AddDictionaryEntry("seconds-face-hash", timer.GetElapsedTime());
+    timer.Report(metrics, "seconds-face-hash");
 
     // Create an array to store the number of faces per hash
     vtkm::cont::ArrayHandle<vtkm::IdComponent> numFacesPerHash;
@@ -467,14 +706,14 @@ public:
     timer.Start();
     invoke(NumFacesPerHash(), faceHashes, numFacesPerHash);
     timer.Stop();
-    log.AddDictionaryEntry("seconds-num-faces-per-hash", timer.GetElapsedTime());
+    timer.Report(metrics, "seconds-num-faces-per-hash");
 
     // Compute the offsets for a packed array holding face information for each hash.
     vtkm::cont::ArrayHandle<vtkm::Id> facesPerHashOffsets;
     timer.Start();
     vtkm::cont::ConvertNumComponentsToOffsets(numFacesPerHash, facesPerHashOffsets);
     timer.Stop();
-    log.AddDictionaryEntry("seconds-face-per-hash-count", timer.GetElapsedTime());
+    timer.Report(metrics, "seconds-face-per-hash-count");
 
     // Create an array to store the cell and face ids of each face per hash
     vtkm::cont::ArrayHandle<CellFaceIdPacker::CellAndFaceIdType> cellAndFaceIdOfFacesPerHash;
@@ -489,9 +728,13 @@ public:
     invoke(BuildFacesPerHash(), faceHashesGroupVec, numFacesPerHash,
       cellAndFaceIdOfFacesPerHashGroupVec);
     timer.Stop();
-    log.AddDictionaryEntry("seconds-build-faces-per-hash", timer.GetElapsedTime());
-    // Release the resources of the arrays that are not needed anymore
-    facesPerCellOffsets.ReleaseResources();
+    timer.Report(metrics, "seconds-build-faces-per-hash");
+    // Release the resources of the arrays that are not needed anymore, except for the offsets
+    // of the faces of each cell, which are also the offsets of the face adjacency
+    if (!this->ComputeFaceNeighbors)
+    {
+      facesPerCellOffsets.ReleaseResources();
+    }
     faceHashes.ReleaseResources();
     numFacesPerHash.ReleaseResources();
 
@@ -503,16 +746,49 @@ public:
     timer.Start();
     invoke(FaceCounts(), cellAndFaceIdOfFacesPerHashGroupVec, inCellSet, numExternalFacesPerHash);
     timer.Stop();
-    log.AddDictionaryEntry("seconds-face-counts", timer.GetElapsedTime());
+    timer.Report(metrics, "seconds-face-counts");
+
+    vtkm::cont::ArrayHandle<vtkm::Id> faceNeighborOffsets;
+    vtkm::cont::ArrayHandle<vtkm::Id> faceNeighbors;
+    if (this->ComputeFaceNeighbors)
+    {
+      faceNeighborOffsets = facesPerCellOffsets;
+      faceNeighbors.Allocate(totalNumberOfFaces);
+      timer.Start();
+      invoke(FaceNeighbors(), cellAndFaceIdOfFacesPerHashGroupVec, numExternalFacesPerHash,
+        faceNeighborOffsets, faceNeighbors);
+      timer.Stop();
+      timer.Report(metrics, "seconds-face-neighbors");
+    }
+
+    // With regions, also keep the interfaces between them, which are output as external faces
+    const bool regions = this->RegionIds.GetNumberOfValues() > 0;
+    vtkm::cont::ArrayHandle<vtkm::IdComponent> numOutputFacesPerHash;
+    if (regions)
+    {
+      timer.Start();
+      invoke(InterfaceFaceCounts(), cellAndFaceIdOfFacesPerHashGroupVec, numExternalFacesPerHash,
+        this->RegionIds, numOutputFacesPerHash);
+      timer.Stop();
+      timer.Report(metrics, "seconds-interface-face-counts");
+    }
+    else
+    {
+      numOutputFacesPerHash = numExternalFacesPerHash;
+    }
 
     // Create a scatter counting object to only access the hashes with external faces
     timer.Start();
-    vtkm::worklet::ScatterCounting scatterCullInternalFaces(numExternalFacesPerHash);
+    vtkm::worklet::ScatterCounting scatterCullInternalFaces(numOutputFacesPerHash);
     timer.Stop();
-    log.AddDictionaryEntry("seconds-scatter-cull-internal-faces", timer.GetElapsedTime());
+    timer.Report(metrics, "seconds-scatter-cull-internal-faces");
     const vtkm::Id numberOfExternalFaces = scatterCullInternalFaces.GetOutputRange(numberOfHashes);
-    // Release the resources of externalFacesPerHash that is not needed anymore
-    numExternalFacesPerHash.ReleaseResources();
+    // Release the resources of externalFacesPerHash that is not needed anymore, unless the
+    // region id pairs are built from it
+    if (!regions)
+    {
+      numExternalFacesPerHash.ReleaseResources();
+    }
 
     // Create an array to store the number of points of the external faces
     PointCountArrayType numPointsPerExternalFace;
@@ -523,7 +799,7 @@ public:
     invoke(NumPointsPerFace(), scatterCullInternalFaces, cellAndFaceIdOfFacesPerHashGroupVec,
       inCellSet, numPointsPerExternalFace);
     timer.Stop();
-    log.AddDictionaryEntry("seconds-points-per-face", timer.GetElapsedTime());
+    timer.Report(metrics, "seconds-points-per-face");
 
     // Compute the offsets for a packed array holding the point connections for each external
     // face.
@@ -533,7 +809,7 @@ public:
     vtkm::cont::ConvertNumComponentsToOffsets(
       numPointsPerExternalFace, pointsPerExternalFaceOffsets, connectivitySize);
     timer.Stop();
-    log.AddDictionaryEntry("seconds-face-point-count", timer.GetElapsedTime());
+    timer.Report(metrics, "seconds-face-point-count");
 
     // Create an array to connectivity of the external faces
     ConnectivityArrayType externalFacesConnectivity;
@@ -556,17 +832,56 @@ public:
     invoke(BuildConnectivity(), scatterCullInternalFaces, cellAndFaceIdOfFacesPerHashGroupVec,
       inCellSet, externalFacesShapes, externalFacesConnectivityGroupVec, faceToCellIdMap);
     timer.Stop();
-    log.AddDictionaryEntry("seconds-build-connectivity", timer.GetElapsedTime());
+    timer.Report(metrics, "seconds-build-connectivity");
+
+    vtkm::cont::ArrayHandle<vtkm::Id2> regionIdPairs;
+    if (regions)
+    {
+      timer.Start();
+      invoke(BuildRegionIdPairs(), scatterCullInternalFaces, cellAndFaceIdOfFacesPerHashGroupVec,
+        numExternalFacesPerHash, numOutputFacesPerHash, this->RegionIds, regionIdPairs);
+      timer.Stop();
+      timer.Report(metrics, "seconds-build-region-id-pairs");
+    }
 
     outCellSet.Fill(inCellSet.GetNumberOfPoints(), externalFacesShapes, externalFacesConnectivity,
       pointsPerExternalFaceOffsets);
     this->CellIdMap = faceToCellIdMap;
+    this->RegionIdPairs = regionIdPairs;
+    this->FaceNeighborOffsets = faceNeighborOffsets;
+    this->FaceNeighbors = faceNeighbors;
+
+    if (this->TopologyCache)
+    {
+      this->TopologyCache->Store(this->TopologyKey, outCellSet, this->CellIdMap);
+      this->TopologyCache->RegionIdPairs = this->RegionIdPairs;
+      this->TopologyCache->FaceNeighborOffsets = this->FaceNeighborOffsets;
+      this->TopologyCache->FaceNeighbors = this->FaceNeighbors;
+    }
   }
 
   vtkm::cont::ArrayHandle<vtkm::Id> GetCellIdMap() const { return this->CellIdMap; }
 
+  /// The regions on both sides of each output face, -1 on the outside, if region ids are set.
+  vtkm::cont::ArrayHandle<vtkm::Id2> GetRegionIdPairs() const { return this->RegionIdPairs; }
+
+  /// The face adjacency of the input cells, if it is computed.
+  vtkm::cont::ArrayHandle<vtkm::Id> GetFaceNeighborOffsets() const
+  {
+    return this->FaceNeighborOffsets;
+  }
+  vtkm::cont::ArrayHandle<vtkm::Id> GetFaceNeighbors() const { return this->FaceNeighbors; }
+
 private:
   vtkm::cont::ArrayHandle<vtkm::Id> CellIdMap;
+  vtkm::cont::ArrayHandle<vtkm::UInt8> CellMask;
+  std::shared_ptr<CellSetTopologyCache> TopologyCache;
+  vtkm::UInt64 TopologyKey = 0;
+  vtkm::cont::ArrayHandle<vtkm::Id> RegionIds;
+  vtkm::cont::ArrayHandle<vtkm::Id2> RegionIdPairs;
+  bool ComputeFaceNeighbors = false;
+  vtkm::cont::ArrayHandle<vtkm::Id> FaceNeighborOffsets;
+  vtkm::cont::ArrayHandle<vtkm::Id> FaceNeighbors;
 
 }; // struct ExternalFacesHashCountFnv1a
 };
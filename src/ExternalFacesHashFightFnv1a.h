@@ -43,7 +43,11 @@
 #include <vtkm/worklet/WorkletMapTopology.h>
 #include <vtkm/worklet/WorkletReduceByKey.h>
 
-#include "YamlWriter.h"
+#include "CellSetTopologyCache.h"
+#include "MetricSink.h"
+#include "PhaseTimer.h"
+
+#include <memory>
 
 namespace vtkm
 {
@@ -74,18 +78,28 @@ struct ExternalFacesHashFightFnv1a
     }
   };
 
-  // Worklet that returns the number of faces for each cell/shape
+  // Worklet that returns the number of faces for each cell/shape, which is zero for the cells
+  // hidden by the cell mask
   class NumFacesPerCell : public vtkm::worklet::WorkletVisitCellsWithPoints
   {
   public:
-    using ControlSignature = void(CellSetIn inCellSet, FieldOut numFacesInCell);
-    using ExecutionSignature = void(CellShape, _2);
+    using ControlSignature =
+      void(CellSetIn inCellSet, FieldInCell cellMask, FieldOut numFacesInCell);
+    using ExecutionSignature = void(CellShape, _2, _3);
     using InputDomain = _1;
 
     template <typename CellShapeTag>
-    VTKM_EXEC void operator()(CellShapeTag shape, vtkm::IdComponent& numFaces) const
+    VTKM_EXEC void operator()(
+      CellShapeTag shape, vtkm::UInt8 cellMask, vtkm::IdComponent& numFaces) const
     {
-      vtkm::exec::CellFaceNumberOfFaces(shape, numFaces);
+      if (cellMask)
+      {
+        vtkm::exec::CellFaceNumberOfFaces(shape, numFaces);
+      }
+      else
+      {
+        numFaces = 0;
+      }
     }
   };
 
@@ -290,14 +304,52 @@ public:
 
   void ReleaseCellMapArrays() { this->CellIdMap.ReleaseResources(); }
 
+  /// Sets a mask of one value per input cell. The cells with a zero value are skipped as if they
+  /// were not in the input, so that the faces they share with the other cells are external. An
+  /// empty mask, the default, uses all cells.
+  void SetCellMask(const vtkm::cont::ArrayHandle<vtkm::UInt8>& cellMask)
+  {
+    this->CellMask = cellMask;
+    if (this->TopologyCache)
+    {
+      this->TopologyCache->Clear();
+    }
+  }
+
+  /// Sets whether the output of Run is kept, so that the later runs with the same topology key
+  /// only copy it instead of hashing the faces again. The default is off.
+  void SetCacheTopology(bool cacheTopology)
+  {
+    this->TopologyCache = cacheTopology ? std::make_shared<CellSetTopologyCache>() : nullptr;
+  }
+
+  /// Sets the key of the topology of the input cells, which must change when the cells change,
+  /// e.g. the MTime of the cell array of the VTK data set that the input was converted from.
+  void SetTopologyKey(vtkm::UInt64 topologyKey) { this->TopologyKey = topologyKey; }
+
   ///////////////////////////////////////////////////
   /// \brief ExternalFaces: Extract Faces on outside of geometry
   template <typename InCellSetType, typename ShapeStorage, typename ConnectivityStorage,
     typename OffsetsStorage>
   VTKM_CONT void Run(const InCellSetType& inCellSet,
     vtkm::cont::CellSetExplicit<ShapeStorage, ConnectivityStorage, OffsetsStorage>& outCellSet,
-    YamlWriter& log)
+    MetricSink& metrics)
   {
+    // The output of an earlier run on the same topology is copied as it is
+    if (this->TopologyCache)
+    {
+      PhaseTimer restoreTimer;
+      restoreTimer.Start();
+      const bool restored = this->TopologyCache->Restore(this->TopologyKey, outCellSet);
+      restoreTimer.Stop();
+      if (restored)
+      {
+        restoreTimer.Report(metrics, "seconds-restore-topology");
+        this->CellIdMap = this->TopologyCache->CellIdMap;
+        return;
+      }
+    }
+
     using PointCountArrayType = vtkm::cont::ArrayHandle<vtkm::IdComponent>;
     using ShapeArrayType = vtkm::cont::ArrayHandle<vtkm::UInt8, ShapeStorage>;
     using OffsetsArrayType = vtkm::cont::ArrayHandle<vtkm::Id, OffsetsStorage>;
@@ -307,23 +359,37 @@ public:
     vtkm::cont::ArrayHandle<vtkm::IdComponent> facesPerCell;
     vtkm::worklet::DispatcherMapTopology<NumFacesPerCell> numFacesDispatcher;
 
-    vtkm::cont::Timer timer;
+    PhaseTimer timer;
     timer.Start();
-    numFacesDispatcher.Invoke(inCellSet, facesPerCell);
+    if (this->CellMask.GetNumberOfValues() > 0)
+    {
+      numFacesDispatcher.Invoke(inCellSet, this->CellMask, facesPerCell);
+    }
+    else
+    {
+      numFacesDispatcher.Invoke(inCellSet,
+        vtkm::cont::make_ArrayHandleConstant(vtkm::UInt8(1), inCellSet.GetNumberOfCells()),
+        facesPerCell);
+    }
     timer.Stop();
-    log.AddDictionaryEntry("seconds-num-faces-per-cell", timer.GetElapsedTime());
+    timer.Report(metrics, "seconds-num-faces-per-cell");
 
     timer.Start();
     vtkm::worklet::ScatterCounting scatterCellToFace(facesPerCell);
     timer.Stop();
-    log.AddDictionaryEntry("seconds-face-input-count", timer.GetElapsedTime());
+    timer.Report(metrics, "seconds-face-input-count");
     facesPerCell.ReleaseResources();
 
     if (scatterCellToFace.GetOutputRange(inCellSet.GetNumberOfCells()) == 0)
     {
-      // Data has no faces. Output is empty.
+      // Data has no faces, e.g. when every cell is masked out. Output is empty.
       outCellSet.PrepareToAddCells(0, 0);
       outCellSet.CompleteAddingCells(inCellSet.GetNumberOfPoints());
+      this->CellIdMap = vtkm::cont::ArrayHandle<vtkm::Id>();
+      if (this->TopologyCache)
+      {
+        this->TopologyCache->Store(this->TopologyKey, outCellSet, this->CellIdMap);
+      }
       return;
     }
 
@@ -335,7 +401,7 @@ public:
     timer.Start();
     faceHashDispatcher.Invoke(inCellSet, faceHashes, originCells, originFaces);
     timer.Stop();
-    log.AddDictionaryEntry("seconds-face-hash", timer.GetElapsedTime());
+    timer.Report(metrics, "seconds-face-hash");
 
     vtkm::Id totalNumFaces = faceHashes.GetNumberOfValues();
 
@@ -389,7 +455,7 @@ public:
       numActiveFaces = activeFaceIndices.GetNumberOfValues();
     }
     timer.Stop();
-    log.AddDictionaryEntry("seconds-hash-fight-iterations", timer.GetElapsedTime());
+    timer.Report(metrics, "seconds-hash-fight-iterations");
 
     vtkm::worklet::ScatterCounting scatterCullInternalFaces(isExternalFace);
 
@@ -401,7 +467,7 @@ public:
     pointsPerFaceDispatcher.Invoke(vtkm::cont::ArrayHandleIndex(totalNumFaces), inCellSet,
       originCells, originFaces, facePointCount);
     timer.Stop();
-    log.AddDictionaryEntry("seconds-face-output-count", timer.GetElapsedTime());
+    timer.Report(metrics, "seconds-face-output-count");
 
     ShapeArrayType faceShapes;
 
@@ -410,7 +476,7 @@ public:
     timer.Start();
     vtkm::cont::ConvertNumComponentsToOffsets(facePointCount, faceOffsets, connectivitySize);
     timer.Stop();
-    log.AddDictionaryEntry("seconds-face-point-count", timer.GetElapsedTime());
+    timer.Report(metrics, "seconds-face-point-count");
 
     ConnectivityArrayType faceConnectivity;
     // Must pre allocate because worklet invocation will not have enough
@@ -431,16 +497,24 @@ public:
       originCells, originFaces, faceShapes,
       vtkm::cont::make_ArrayHandleGroupVecVariable(faceConnectivity, faceOffsets), faceToCellIdMap);
     timer.Stop();
-    log.AddDictionaryEntry("seconds-build-connectivity", timer.GetElapsedTime());
+    timer.Report(metrics, "seconds-build-connectivity");
 
     outCellSet.Fill(inCellSet.GetNumberOfPoints(), faceShapes, faceConnectivity, faceOffsets);
     this->CellIdMap = faceToCellIdMap;
+
+    if (this->TopologyCache)
+    {
+      this->TopologyCache->Store(this->TopologyKey, outCellSet, this->CellIdMap);
+    }
   }
 
   vtkm::cont::ArrayHandle<vtkm::Id> GetCellIdMap() const { return this->CellIdMap; }
 
 private:
   vtkm::cont::ArrayHandle<vtkm::Id> CellIdMap;
+  vtkm::cont::ArrayHandle<vtkm::UInt8> CellMask;
+  std::shared_ptr<CellSetTopologyCache> TopologyCache;
+  vtkm::UInt64 TopologyKey = 0;
 
 }; // struct ExternalFacesHashFightFnv1a
 }
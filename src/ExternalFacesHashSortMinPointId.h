@@ -43,7 +43,11 @@
 #include <vtkm/worklet/WorkletReduceByKey.h>
 
 #include "CellFaceMinMaxPointId.h"
-#include "YamlWriter.h"
+#include "CellSetTopologyCache.h"
+#include "MetricSink.h"
+#include "PhaseTimer.h"
+
+#include <memory>
 
 namespace vtkm
 {
@@ -52,18 +56,28 @@ namespace worklet
 
 struct ExternalFacesHashSortMinPointId
 {
-  // Worklet that returns the number of faces for each cell/shape
+  // Worklet that returns the number of faces for each cell/shape, which is zero for the cells
+  // hidden by the cell mask
   class NumFacesPerCell : public vtkm::worklet::WorkletVisitCellsWithPoints
   {
   public:
-    using ControlSignature = void(CellSetIn inCellSet, FieldOut numFacesInCell);
-    using ExecutionSignature = void(CellShape, _2);
+    using ControlSignature =
+      void(CellSetIn inCellSet, FieldInCell cellMask, FieldOut numFacesInCell);
+    using ExecutionSignature = void(CellShape, _2, _3);
     using InputDomain = _1;
 
     template <typename CellShapeTag>
-    VTKM_EXEC void operator()(CellShapeTag shape, vtkm::IdComponent& numFaces) const
+    VTKM_EXEC void operator()(
+      CellShapeTag shape, vtkm::UInt8 cellMask, vtkm::IdComponent& numFaces) const
     {
-      vtkm::exec::CellFaceNumberOfFaces(shape, numFaces);
+      if (cellMask)
+      {
+        vtkm::exec::CellFaceNumberOfFaces(shape, numFaces);
+      }
+      else
+      {
+        numFaces = 0;
+      }
     }
   };
 
@@ -145,6 +159,52 @@ struct ExternalFacesHashSortMinPointId
     }
   };
 
+  // Worklet that writes the neighbor cell of each face of a hash at the position of the face in
+  // the faces of all cells, which is ordered by cell, or -1 for the external faces.
+  class FaceNeighbors : public vtkm::worklet::WorkletReduceByKey
+  {
+  public:
+    using ControlSignature = void(KeysIn keys, WholeCellSetIn<> inputCells, ValuesIn originCells,
+      ValuesIn originFaces, ValuesIn facePositions, WholeArrayOut faceNeighbors);
+    using ExecutionSignature = void(_2, _3, _4, _5, _6);
+    using InputDomain = _1;
+
+    template <typename CellSetType, typename OriginCellsType, typename OriginFacesType,
+      typename FacePositionsType, typename FaceNeighborsPortal>
+    VTKM_EXEC void operator()(const CellSetType& cellSet, const OriginCellsType& originCells,
+      const OriginFacesType& originFaces, const FacePositionsType& facePositions,
+      FaceNeighborsPortal& faceNeighbors) const
+    {
+      vtkm::IdComponent numCellsOnHash = originCells.GetNumberOfComponents();
+      for (vtkm::IdComponent myIndex = 0; myIndex < numCellsOnHash; myIndex++)
+      {
+        vtkm::Id3 myFace;
+        vtkm::exec::CellFaceCanonicalId(originFaces[myIndex],
+          cellSet.GetCellShape(originCells[myIndex]), cellSet.GetIndices(originCells[myIndex]),
+          myFace);
+        vtkm::Id neighbor = -1;
+        for (vtkm::IdComponent otherIndex = 0; otherIndex < numCellsOnHash; otherIndex++)
+        {
+          if (otherIndex == myIndex)
+          {
+            continue;
+          }
+          vtkm::Id3 otherFace;
+          vtkm::exec::CellFaceCanonicalId(originFaces[otherIndex],
+            cellSet.GetCellShape(originCells[otherIndex]),
+            cellSet.GetIndices(originCells[otherIndex]), otherFace);
+          if (/*myFace[0] == otherFace[0] && */ myFace[1] == otherFace[1] &&
+            myFace[2] == otherFace[2])
+          {
+            neighbor = originCells[otherIndex];
+            break;
+          }
+        }
+        faceNeighbors.Set(facePositions[myIndex], neighbor);
+      }
+    }
+  };
+
 private:
   // Resolves duplicate hashes by finding a specified unique face for a given hash.
   // Given a cell set (from a WholeCellSetIn) and the cell/face id pairs for each face
@@ -294,7 +354,48 @@ public:
   VTKM_CONT
   ExternalFacesHashSortMinPointId() {}
 
-  void ReleaseCellMapArrays() { this->CellIdMap.ReleaseResources(); }
+  void ReleaseCellMapArrays()
+  {
+    this->CellIdMap.ReleaseResources();
+    this->FaceNeighborOffsets.ReleaseResources();
+    this->FaceNeighbors.ReleaseResources();
+  }
+
+  /// Sets a mask of one value per input cell. The cells with a zero value are skipped as if they
+  /// were not in the input, so that the faces they share with the other cells are external. An
+  /// empty mask, the default, uses all cells.
+  void SetCellMask(const vtkm::cont::ArrayHandle<vtkm::UInt8>& cellMask)
+  {
+    this->CellMask = cellMask;
+    if (this->TopologyCache)
+    {
+      this->TopologyCache->Clear();
+    }
+  }
+
+  /// Sets whether Run also builds the face adjacency of the input cells, from the faces that it
+  /// groups by hash anyway. \c GetFaceNeighbors then holds the neighbor cell of each face of
+  /// each cell, or -1 for the external faces, starting at the entry of \c GetFaceNeighborOffsets
+  /// of the cell. The default is off.
+  void SetComputeFaceNeighbors(bool computeFaceNeighbors)
+  {
+    this->ComputeFaceNeighbors = computeFaceNeighbors;
+    if (this->TopologyCache)
+    {
+      this->TopologyCache->Clear();
+    }
+  }
+
+  /// Sets whether the output of Run is kept, so that the later runs with the same topology key
+  /// only copy it instead of hashing the faces again. The default is off.
+  void SetCacheTopology(bool cacheTopology)
+  {
+    this->TopologyCache = cacheTopology ? std::make_shared<CellSetTopologyCache>() : nullptr;
+  }
+
+  /// Sets the key of the topology of the input cells, which must change when the cells change,
+  /// e.g. the MTime of the cell array of the VTK data set that the input was converted from.
+  void SetTopologyKey(vtkm::UInt64 topologyKey) { this->TopologyKey = topologyKey; }
 
   ///////////////////////////////////////////////////
   /// \brief ExternalFaces: Extract Faces on outside of geometry
@@ -302,8 +403,25 @@ public:
     typename OffsetsStorage>
   VTKM_CONT void Run(const InCellSetType& inCellSet,
     vtkm::cont::CellSetExplicit<ShapeStorage, ConnectivityStorage, OffsetsStorage>& outCellSet,
-    YamlWriter& log)
+    MetricSink& metrics)
   {
+    // The output of an earlier run on the same topology is copied as it is
+    if (this->TopologyCache)
+    {
+      PhaseTimer restoreTimer;
+      restoreTimer.Start();
+      const bool restored = this->TopologyCache->Restore(this->TopologyKey, outCellSet);
+      restoreTimer.Stop();
+      if (restored)
+      {
+        restoreTimer.Report(metrics, "seconds-restore-topology");
+        this->CellIdMap = this->TopologyCache->CellIdMap;
+        this->FaceNeighborOffsets = this->TopologyCache->FaceNeighborOffsets;
+        this->FaceNeighbors = this->TopologyCache->FaceNeighbors;
+        return;
+      }
+    }
+
     using PointCountArrayType = vtkm::cont::ArrayHandle<vtkm::IdComponent>;
     using ShapeArrayType = vtkm::cont::ArrayHandle<vtkm::UInt8, ShapeStorage>;
     using OffsetsArrayType = vtkm::cont::ArrayHandle<vtkm::Id, OffsetsStorage>;
@@ -313,23 +431,53 @@ public:
     vtkm::cont::ArrayHandle<vtkm::IdComponent> facesPerCell;
     vtkm::worklet::DispatcherMapTopology<NumFacesPerCell> numFacesDispatcher;
 
-    vtkm::cont::Timer timer;
+    PhaseTimer timer;
     timer.Start();
-    numFacesDispatcher.Invoke(inCellSet, facesPerCell);
+    if (this->CellMask.GetNumberOfValues() > 0)
+    {
+      numFacesDispatcher.Invoke(inCellSet, this->CellMask, facesPerCell);
+    }
+    else
+    {
+      numFacesDispatcher.Invoke(inCellSet,
+        vtkm::cont::make_ArrayHandleConstant(vtkm::UInt8(1), inCellSet.GetNumberOfCells()),
+        facesPerCell);
+    }
     timer.Stop();
-    log.AddDictionaryEntry("seconds-num-faces-per-cell", timer.GetElapsedTime());
+    timer.Report(metrics, "seconds-num-faces-per-cell");
 
     timer.Start();
     vtkm::worklet::ScatterCounting scatterCellToFace(facesPerCell);
     timer.Stop();
-    log.AddDictionaryEntry("seconds-face-input-count", timer.GetElapsedTime());
+    timer.Report(metrics, "seconds-face-input-count");
+
+    // The faces are generated in the order of their cells, so the offsets of the faces of each
+    // cell are the offsets of the face adjacency.
+    vtkm::cont::ArrayHandle<vtkm::Id> faceNeighborOffsets;
+    vtkm::Id numberOfFaces = 0;
+    if (this->ComputeFaceNeighbors)
+    {
+      timer.Start();
+      vtkm::cont::ConvertNumComponentsToOffsets(facesPerCell, faceNeighborOffsets, numberOfFaces);
+      timer.Stop();
+      timer.Report(metrics, "seconds-face-neighbor-offsets");
+    }
     facesPerCell.ReleaseResources();
 
     if (scatterCellToFace.GetOutputRange(inCellSet.GetNumberOfCells()) == 0)
     {
-      // Data has no faces. Output is empty.
+      // Data has no faces, e.g. when every cell is masked out. Output is empty.
       outCellSet.PrepareToAddCells(0, 0);
       outCellSet.CompleteAddingCells(inCellSet.GetNumberOfPoints());
+      this->CellIdMap = vtkm::cont::ArrayHandle<vtkm::Id>();
+      this->FaceNeighborOffsets = faceNeighborOffsets;
+      this->FaceNeighbors = vtkm::cont::ArrayHandle<vtkm::Id>();
+      if (this->TopologyCache)
+      {
+        this->TopologyCache->Store(this->TopologyKey, outCellSet, this->CellIdMap);
+        this->TopologyCache->FaceNeighborOffsets = this->FaceNeighborOffsets;
+        this->TopologyCache->FaceNeighbors = this->FaceNeighbors;
+      }
       return;
     }
 
@@ -341,12 +489,12 @@ public:
     timer.Start();
     faceHashDispatcher.Invoke(inCellSet, faceHashes, originCells, originFaces);
     timer.Stop();
-    log.AddDictionaryEntry("seconds-face-hash", timer.GetElapsedTime());
+    timer.Report(metrics, "seconds-face-hash");
 
     timer.Start();
     vtkm::worklet::Keys<vtkm::HashType> faceKeys(faceHashes);
     timer.Stop();
-    log.AddDictionaryEntry("seconds-keys-build-arrays", timer.GetElapsedTime());
+    timer.Report(metrics, "seconds-keys-build-arrays");
 
     vtkm::cont::ArrayHandle<vtkm::IdComponent> faceOutputCount;
     vtkm::worklet::DispatcherReduceByKey<FaceCounts> faceCountDispatcher;
@@ -354,12 +502,24 @@ public:
     timer.Start();
     faceCountDispatcher.Invoke(faceKeys, inCellSet, originCells, originFaces, faceOutputCount);
     timer.Stop();
-    log.AddDictionaryEntry("seconds-face-count", timer.GetElapsedTime());
+    timer.Report(metrics, "seconds-face-count");
+
+    vtkm::cont::ArrayHandle<vtkm::Id> faceNeighbors;
+    if (this->ComputeFaceNeighbors)
+    {
+      faceNeighbors.Allocate(numberOfFaces);
+      vtkm::worklet::DispatcherReduceByKey<FaceNeighbors> faceNeighborsDispatcher;
+      timer.Start();
+      faceNeighborsDispatcher.Invoke(faceKeys, inCellSet, originCells, originFaces,
+        vtkm::cont::ArrayHandleIndex(numberOfFaces), faceNeighbors);
+      timer.Stop();
+      timer.Report(metrics, "seconds-face-neighbors");
+    }
 
     timer.Start();
     auto scatterCullInternalFaces = NumPointsPerFace::MakeScatter(faceOutputCount);
     timer.Stop();
-    log.AddDictionaryEntry("seconds-face-output-count", timer.GetElapsedTime());
+    timer.Report(metrics, "seconds-face-output-count");
 
     PointCountArrayType facePointCount;
     vtkm::worklet::DispatcherReduceByKey<NumPointsPerFace> pointsPerFaceDispatcher(
@@ -368,7 +528,7 @@ public:
     timer.Start();
     pointsPerFaceDispatcher.Invoke(faceKeys, inCellSet, originCells, originFaces, facePointCount);
     timer.Stop();
-    log.AddDictionaryEntry("seconds-points-per-face", timer.GetElapsedTime());
+    timer.Report(metrics, "seconds-points-per-face");
 
     ShapeArrayType faceShapes;
 
@@ -377,7 +537,7 @@ public:
     timer.Start();
     vtkm::cont::ConvertNumComponentsToOffsets(facePointCount, faceOffsets, connectivitySize);
     timer.Stop();
-    log.AddDictionaryEntry("seconds-face-point-count", timer.GetElapsedTime());
+    timer.Report(metrics, "seconds-face-point-count");
 
     ConnectivityArrayType faceConnectivity;
     // Must pre allocate because worklet invocation will not have enough
@@ -393,16 +553,38 @@ public:
     buildConnectivityDispatcher.Invoke(faceKeys, inCellSet, originCells, originFaces, faceShapes,
       vtkm::cont::make_ArrayHandleGroupVecVariable(faceConnectivity, faceOffsets), faceToCellIdMap);
     timer.Stop();
-    log.AddDictionaryEntry("seconds-build-connectivity", timer.GetElapsedTime());
+    timer.Report(metrics, "seconds-build-connectivity");
 
     outCellSet.Fill(inCellSet.GetNumberOfPoints(), faceShapes, faceConnectivity, faceOffsets);
     this->CellIdMap = faceToCellIdMap;
+    this->FaceNeighborOffsets = faceNeighborOffsets;
+    this->FaceNeighbors = faceNeighbors;
+
+    if (this->TopologyCache)
+    {
+      this->TopologyCache->Store(this->TopologyKey, outCellSet, this->CellIdMap);
+      this->TopologyCache->FaceNeighborOffsets = this->FaceNeighborOffsets;
+      this->TopologyCache->FaceNeighbors = this->FaceNeighbors;
+    }
   }
 
   vtkm::cont::ArrayHandle<vtkm::Id> GetCellIdMap() const { return this->CellIdMap; }
 
+  /// The face adjacency of the input cells, if it is computed.
+  vtkm::cont::ArrayHandle<vtkm::Id> GetFaceNeighborOffsets() const
+  {
+    return this->FaceNeighborOffsets;
+  }
+  vtkm::cont::ArrayHandle<vtkm::Id> GetFaceNeighbors() const { return this->FaceNeighbors; }
+
 private:
   vtkm::cont::ArrayHandle<vtkm::Id> CellIdMap;
+  vtkm::cont::ArrayHandle<vtkm::UInt8> CellMask;
+  std::shared_ptr<CellSetTopologyCache> TopologyCache;
+  vtkm::UInt64 TopologyKey = 0;
+  bool ComputeFaceNeighbors = false;
+  vtkm::cont::ArrayHandle<vtkm::Id> FaceNeighborOffsets;
+  vtkm::cont::ArrayHandle<vtkm::Id> FaceNeighbors;
 
 }; // struct ExternalFacesHashSortMinPointId
 }
@@ -0,0 +1,294 @@
+//============================================================================
+//  Copyright (c) Kitware, Inc.
+//  All rights reserved.
+//  See LICENSE.txt for details.
+//  This software is distributed WITHOUT ANY WARRANTY; without even
+//  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+//  PURPOSE.  See the above copyright notice for more information.
+//============================================================================
+#ifndef _FaceHashDistribution_h
+#define _FaceHashDistribution_h
+
+#include <vtkm/CellShape.h>
+#include <vtkm/Hash.h>
+#include <vtkm/Types.h>
+#include <vtkm/exec/CellFace.h>
+
+#include <vtkCellArray.h>
+#include <vtkCellType.h>
+#include <vtkIdList.h>
+#include <vtkSMPThreadLocal.h>
+#include <vtkSMPThreadLocalObject.h>
+#include <vtkSMPTools.h>
+#include <vtkUnstructuredGrid.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <numeric>
+#include <string>
+#include <utility>
+#include <vector>
+
+/// A face hash function of the external faces algorithms.
+struct FaceHashPolicy
+{
+  std::string Name;
+  vtkm::Id (*Hash)(const vtkm::Id3& canonicalFaceId, vtkm::Id tableSize);
+};
+
+/// The hash functions used by the DP-Hash-* worklets, in the order of --hash-function.
+inline const std::vector<FaceHashPolicy>& GetFaceHashPolicies()
+{
+  static const std::vector<FaceHashPolicy> policies = {
+    { "FNV1A",
+      [](const vtkm::Id3& canonicalFaceId, vtkm::Id tableSize) -> vtkm::Id
+      { return static_cast<vtkm::Id>(vtkm::Hash(canonicalFaceId) % tableSize); } },
+    { "MinPointID",
+      [](const vtkm::Id3& canonicalFaceId, vtkm::Id tableSize) -> vtkm::Id
+      { return canonicalFaceId[0] % tableSize; } },
+  };
+  return policies;
+}
+
+/// Occupancy and collision statistics of a face hash function for one table size.
+struct FaceHashStatistics
+{
+  std::string HashName;
+  vtkm::Id TableSize = 0;
+  vtkm::Id NumberOfFaces = 0;
+  vtkm::Id NumberOfDistinctFaces = 0;
+  /// Number of buckets for each occupancy, i.e. number of faces in a bucket.
+  std::map<vtkm::Id, vtkm::Id> OccupancyHistogram;
+  vtkm::Id NonEmptyBuckets = 0;
+  vtkm::Id MaxOccupancy = 0;
+  vtkm::Id OccupancyP50 = 0;
+  vtkm::Id OccupancyP90 = 0;
+  vtkm::Id OccupancyP99 = 0;
+  vtkm::Id OccupancyP999 = 0;
+  /// Sum over the buckets of k(k-1)/2, where k is the occupancy of the bucket.
+  vtkm::Id PairwiseComparisons = 0;
+  /// Buckets that contain more than one distinct face.
+  vtkm::Id CollidingBuckets = 0;
+  /// Distinct faces that share their bucket with another distinct face.
+  vtkm::Id CollidingFaces = 0;
+  /// Pairs of distinct faces that share a bucket.
+  vtkm::Id CollidingFacePairs = 0;
+};
+
+/// \brief Computes the distribution of the faces of an unstructured grid in a hash table.
+///
+/// The canonical face ids of all cells are gathered and sorted once in parallel, so that any
+/// hash function and table size can then be evaluated by a parallel pass over the faces that
+/// counts the faces and the distinct faces of each bucket, and a parallel pass over the buckets
+/// with per-thread occupancy histograms. The canonical face ids and hash functions are the ones
+/// of the DP-Hash-* worklets, so cells that VTK-m does not support have no faces, except
+/// voxels, which are treated as hexahedra.
+class FaceHashDistribution
+{
+public:
+  explicit FaceHashDistribution(vtkUnstructuredGrid* ug)
+  {
+    vtkCellArray* cells = ug->GetCells();
+    const vtkIdType numberOfCells = ug->GetNumberOfCells();
+    const unsigned char* cellTypes = ug->GetCellTypesArray()->GetPointer(0);
+
+    std::vector<vtkm::Id> faceOffsets(numberOfCells + 1, 0);
+    vtkSMPTools::For(0, numberOfCells,
+      [&](vtkIdType begin, vtkIdType end)
+      {
+        for (vtkIdType cellId = begin; cellId < end; ++cellId)
+        {
+          vtkm::IdComponent numberOfFaces = 0;
+          if (vtkm::exec::CellFaceNumberOfFaces(GetShape(cellTypes[cellId]), numberOfFaces) !=
+            vtkm::ErrorCode::Success)
+          {
+            numberOfFaces = 0;
+          }
+          faceOffsets[cellId + 1] = numberOfFaces;
+        }
+      });
+    std::partial_sum(faceOffsets.begin(), faceOffsets.end(), faceOffsets.begin());
+
+    this->Faces.resize(faceOffsets[numberOfCells]);
+    vtkSMPThreadLocalObject<vtkIdList> tlPointIds;
+    vtkSMPTools::For(0, numberOfCells,
+      [&](vtkIdType begin, vtkIdType end)
+      {
+        vtkIdList* pointIds = tlPointIds.Local();
+        vtkm::Vec<vtkIdType, 8> voxelPointIds;
+        for (vtkIdType cellId = begin; cellId < end; ++cellId)
+        {
+          const vtkm::IdComponent numberOfFaces =
+            static_cast<vtkm::IdComponent>(faceOffsets[cellId + 1] - faceOffsets[cellId]);
+          if (numberOfFaces == 0)
+          {
+            continue;
+          }
+          vtkIdType numberOfPoints;
+          const vtkIdType* points;
+          cells->GetCellAtId(cellId, numberOfPoints, points, pointIds);
+          const vtkm::CellShapeTagGeneric shape = GetShape(cellTypes[cellId]);
+          vtkm::Id3* faces = this->Faces.data() + faceOffsets[cellId];
+          if (cellTypes[cellId] == VTK_VOXEL)
+          {
+            // the points of a voxel are the points of a hexahedron with 2-3 and 6-7 swapped
+            constexpr vtkm::IdComponent voxelToHexahedron[8] = { 0, 1, 3, 2, 4, 5, 7, 6 };
+            for (vtkm::IdComponent i = 0; i < 8; ++i)
+            {
+              voxelPointIds[i] = points[voxelToHexahedron[i]];
+            }
+            for (vtkm::IdComponent faceId = 0; faceId < numberOfFaces; ++faceId)
+            {
+              vtkm::exec::CellFaceCanonicalId(faceId, shape, voxelPointIds, faces[faceId]);
+            }
+            continue;
+          }
+          const vtkm::VecCConst<vtkIdType> cellPointIds(
+            points, static_cast<vtkm::IdComponent>(numberOfPoints));
+          for (vtkm::IdComponent faceId = 0; faceId < numberOfFaces; ++faceId)
+          {
+            vtkm::exec::CellFaceCanonicalId(faceId, shape, cellPointIds, faces[faceId]);
+          }
+        }
+      });
+
+    vtkSMPTools::Sort(this->Faces.begin(), this->Faces.end(),
+      [](const vtkm::Id3& a, const vtkm::Id3& b)
+      {
+        return a[0] < b[0] || (a[0] == b[0] && (a[1] < b[1] || (a[1] == b[1] && a[2] < b[2])));
+      });
+  }
+
+  /// Number of faces, where internal faces are counted once per cell that uses them.
+  vtkm::Id GetNumberOfFaces() const { return static_cast<vtkm::Id>(this->Faces.size()); }
+
+  /// Computes the statistics of a hash function for the given table size.
+  FaceHashStatistics Compute(const FaceHashPolicy& policy, vtkm::Id tableSize) const
+  {
+    FaceHashStatistics statistics;
+    statistics.HashName = policy.Name;
+    statistics.TableSize = tableSize;
+    statistics.NumberOfFaces = this->GetNumberOfFaces();
+
+    // faces and distinct faces per bucket. The faces are sorted, so a distinct face is counted
+    // at its first occurrence.
+    std::vector<std::atomic<std::uint32_t>> facesPerBucket(tableSize);
+    std::vector<std::atomic<std::uint32_t>> distinctFacesPerBucket(tableSize);
+    vtkSMPTools::For(0, tableSize,
+      [&](vtkIdType begin, vtkIdType end)
+      {
+        for (vtkIdType bucket = begin; bucket < end; ++bucket)
+        {
+          facesPerBucket[bucket].store(0, std::memory_order_relaxed);
+          distinctFacesPerBucket[bucket].store(0, std::memory_order_relaxed);
+        }
+      });
+    vtkSMPThreadLocal<vtkm::Id> localDistinctFaces(0);
+    vtkSMPTools::For(0, statistics.NumberOfFaces,
+      [&](vtkIdType begin, vtkIdType end)
+      {
+        vtkm::Id& distinctFaces = localDistinctFaces.Local();
+        for (vtkIdType faceIndex = begin; faceIndex < end; ++faceIndex)
+        {
+          const vtkm::Id3& face = this->Faces[faceIndex];
+          const vtkm::Id bucket = policy.Hash(face, tableSize);
+          facesPerBucket[bucket].fetch_add(1, std::memory_order_relaxed);
+          if (faceIndex == 0 || this->Faces[faceIndex - 1] != face)
+          {
+            distinctFacesPerBucket[bucket].fetch_add(1, std::memory_order_relaxed);
+            ++distinctFaces;
+          }
+        }
+      });
+    for (vtkm::Id distinctFaces : localDistinctFaces)
+    {
+      statistics.NumberOfDistinctFaces += distinctFaces;
+    }
+
+    struct LocalStatistics
+    {
+      std::vector<vtkm::Id> Histogram;
+      vtkm::Id PairwiseComparisons = 0;
+      vtkm::Id CollidingBuckets = 0;
+      vtkm::Id CollidingFaces = 0;
+      vtkm::Id CollidingFacePairs = 0;
+    };
+    vtkSMPThreadLocal<LocalStatistics> localStatistics;
+    vtkSMPTools::For(0, tableSize,
+      [&](vtkIdType begin, vtkIdType end)
+      {
+        LocalStatistics& local = localStatistics.Local();
+        for (vtkIdType bucket = begin; bucket < end; ++bucket)
+        {
+          const vtkm::Id faces = facesPerBucket[bucket].load(std::memory_order_relaxed);
+          const vtkm::Id distinctFaces =
+            distinctFacesPerBucket[bucket].load(std::memory_order_relaxed);
+          if (faces >= static_cast<vtkm::Id>(local.Histogram.size()))
+          {
+            local.Histogram.resize(faces + 1, 0);
+          }
+          ++local.Histogram[faces];
+          local.PairwiseComparisons += faces * (faces - 1) / 2;
+          if (distinctFaces > 1)
+          {
+            ++local.CollidingBuckets;
+            local.CollidingFaces += distinctFaces;
+            local.CollidingFacePairs += distinctFaces * (distinctFaces - 1) / 2;
+          }
+        }
+      });
+    std::vector<vtkm::Id> histogram;
+    for (const LocalStatistics& local : localStatistics)
+    {
+      if (local.Histogram.size() > histogram.size())
+      {
+        histogram.resize(local.Histogram.size(), 0);
+      }
+      for (std::size_t faces = 0; faces < local.Histogram.size(); ++faces)
+      {
+        histogram[faces] += local.Histogram[faces];
+      }
+      statistics.PairwiseComparisons += local.PairwiseComparisons;
+      statistics.CollidingBuckets += local.CollidingBuckets;
+      statistics.CollidingFaces += local.CollidingFaces;
+      statistics.CollidingFacePairs += local.CollidingFacePairs;
+    }
+
+    vtkm::Id cumulativeBuckets = 0;
+    const std::pair<double, vtkm::Id*> percentiles[] = { { 0.5, &statistics.OccupancyP50 },
+      { 0.9, &statistics.OccupancyP90 }, { 0.99, &statistics.OccupancyP99 },
+      { 0.999, &statistics.OccupancyP999 } };
+    std::size_t nextPercentile = 0;
+    for (std::size_t faces = 0; faces < histogram.size(); ++faces)
+    {
+      if (histogram[faces] == 0)
+      {
+        continue;
+      }
+      statistics.OccupancyHistogram[static_cast<vtkm::Id>(faces)] = histogram[faces];
+      statistics.MaxOccupancy = static_cast<vtkm::Id>(faces);
+      statistics.NonEmptyBuckets += faces > 0 ? histogram[faces] : 0;
+      cumulativeBuckets += histogram[faces];
+      while (nextPercentile < 4 &&
+        cumulativeBuckets >= std::ceil(percentiles[nextPercentile].first * tableSize))
+      {
+        *percentiles[nextPercentile++].second = static_cast<vtkm::Id>(faces);
+      }
+    }
+    return statistics;
+  }
+
+private:
+  static vtkm::CellShapeTagGeneric GetShape(unsigned char cellType)
+  {
+    return vtkm::CellShapeTagGeneric(
+      cellType == VTK_VOXEL ? vtkm::UInt8(vtkm::CELL_SHAPE_HEXAHEDRON) : cellType);
+  }
+
+  std::vector<vtkm::Id3> Faces;
+};
+
+#endif //_FaceHashDistribution_h
@@ -0,0 +1,177 @@
+//============================================================================
+//  Copyright (c) Kitware, Inc.
+//  All rights reserved.
+//  See LICENSE.txt for details.
+//  This software is distributed WITHOUT ANY WARRANTY; without even
+//  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+//  PURPOSE.  See the above copyright notice for more information.
+//============================================================================
+#ifndef _FusedPointMap_h
+#define _FusedPointMap_h
+
+#include <vtkSMPTools.h>
+#include <vtkType.h>
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+/// \brief Numbers the used input points while the output cells are extracted.
+///
+/// A point gets its output id when a thread first touches it, from a block of ids that the
+/// thread took from a shared counter, so the extracted connectivity is written in output ids
+/// and the point map does not have to be numbered and applied in later passes over all input
+/// points. The map also records the input id of every output id, from which the output points
+/// and their attributes are gathered in output order.
+///
+/// The last block of each thread is only partly used. \c Finalize moves the used ids above the
+/// number of output points into these holes, and \c Resolve applies the move to the ids written
+/// during extraction, which is a predictable branch for all but the last few ids. The output
+/// points are ordered by first touch, so their order depends on the scheduling of the threads.
+template <typename TId>
+class FusedPointMap
+{
+public:
+  // ids that a thread takes at a time, so that the shared counter is rarely contended
+  static constexpr TId BlockSize = 4096;
+
+  /// \brief Hands out output ids from the blocks of one thread.
+  class Allocator
+  {
+  public:
+    void SetMap(FusedPointMap* map)
+    {
+      this->Map = map;
+      this->Next = this->End = 0;
+    }
+
+    /// The output id of an input point, which is assigned if the point is touched first.
+    TId GetOutputId(TId inputId)
+    {
+      std::atomic<TId>& entry = this->Map->OutputIds[inputId];
+      TId outputId = entry.load(std::memory_order_relaxed);
+      if (outputId >= 0)
+      {
+        return outputId;
+      }
+      if (this->Next == this->End)
+      {
+        this->Next = this->Map->NextBlock.fetch_add(BlockSize, std::memory_order_relaxed);
+        this->End = this->Next + BlockSize;
+      }
+      if (entry.compare_exchange_strong(outputId, this->Next, std::memory_order_relaxed))
+      {
+        this->Map->InputIds[this->Next] = inputId;
+        return this->Next++;
+      }
+      // another thread touched the point in the meantime
+      return outputId;
+    }
+
+  private:
+    friend class FusedPointMap;
+    FusedPointMap* Map = nullptr;
+    TId Next = 0;
+    TId End = 0;
+  };
+
+  explicit FusedPointMap(vtkIdType numberOfPoints)
+    : OutputIds(new std::atomic<TId>[numberOfPoints])
+    // every thread holds at most one partly used block, and only the touched pages of the input
+    // ids are ever allocated
+    , InputIds(new TId[numberOfPoints +
+        static_cast<vtkIdType>(BlockSize) * (vtkSMPTools::GetEstimatedNumberOfThreads() + 1)])
+    , NextBlock(0)
+    , NumberOfOutputPoints(0)
+  {
+    std::atomic<TId>* outputIds = this->OutputIds.get();
+    vtkSMPTools::For(0, numberOfPoints,
+      [outputIds](vtkIdType begin, vtkIdType end)
+      {
+        for (vtkIdType pointId = begin; pointId < end; ++pointId)
+        {
+          outputIds[pointId].store(-1, std::memory_order_relaxed);
+        }
+      });
+  }
+
+  /// Returns the unused ids of the last block of an allocator. Extraction must be finished.
+  void Release(Allocator& allocator)
+  {
+    if (allocator.Next < allocator.End)
+    {
+      this->Holes.push_back(Hole{ allocator.Next, allocator.End });
+    }
+    allocator.Next = allocator.End = 0;
+  }
+
+  /// Fills the holes left by the released allocators and returns the number of output points.
+  vtkIdType Finalize()
+  {
+    const TId numberOfIds = this->NextBlock.load(std::memory_order_relaxed);
+    TId numberOfHoleIds = 0;
+    for (const Hole& hole : this->Holes)
+    {
+      numberOfHoleIds += hole.End - hole.Begin;
+    }
+    const TId numberOfOutputPoints = numberOfIds - numberOfHoleIds;
+    this->NumberOfOutputPoints = numberOfOutputPoints;
+
+    // the ids at or above the number of output points, which are either used or holes
+    this->Relocated.assign(static_cast<std::size_t>(numberOfHoleIds), 0);
+    std::vector<TId> targets;
+    for (const Hole& hole : this->Holes)
+    {
+      for (TId id = hole.Begin; id < hole.End; ++id)
+      {
+        if (id < numberOfOutputPoints)
+        {
+          targets.push_back(id);
+        }
+        else
+        {
+          this->Relocated[id - numberOfOutputPoints] = -1;
+        }
+      }
+    }
+    auto target = targets.begin();
+    for (TId id = numberOfOutputPoints; id < numberOfIds; ++id)
+    {
+      TId& relocated = this->Relocated[id - numberOfOutputPoints];
+      if (relocated != -1)
+      {
+        const TId inputId = this->InputIds[id];
+        relocated = *target++;
+        this->InputIds[relocated] = inputId;
+      }
+    }
+    this->Holes.clear();
+    return numberOfOutputPoints;
+  }
+
+  /// The final output id of an id handed out during extraction. Only valid after \c Finalize.
+  TId Resolve(TId id) const
+  {
+    return id < this->NumberOfOutputPoints ? id
+                                           : this->Relocated[id - this->NumberOfOutputPoints];
+  }
+
+  /// The input id of every output point. Only valid after \c Finalize.
+  const TId* GetInputIds() const { return this->InputIds.get(); }
+
+private:
+  struct Hole
+  {
+    TId Begin;
+    TId End;
+  };
+
+  std::unique_ptr<std::atomic<TId>[]> OutputIds;
+  std::unique_ptr<TId[]> InputIds;
+  std::atomic<TId> NextBlock;
+  std::vector<Hole> Holes;
+  TId NumberOfOutputPoints;
+  std::vector<TId> Relocated;
+};
+
+#endif //_FusedPointMap_h
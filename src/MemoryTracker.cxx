@@ -0,0 +1,290 @@
+//============================================================================
+//  Copyright (c) Kitware, Inc.
+//  All rights reserved.
+//  See LICENSE.txt for details.
+//  This software is distributed WITHOUT ANY WARRANTY; without even
+//  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+//  PURPOSE.  See the above copyright notice for more information.
+//============================================================================
+#include "MemoryTracker.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+namespace
+{
+std::atomic<bool> Enabled{ false };
+std::atomic<std::int64_t> CurrentBytes{ 0 };
+std::atomic<std::int64_t> AllocatedBytes{ 0 };
+std::atomic<std::int64_t> PeakBytes{ 0 };
+
+void RecordAllocation(std::int64_t bytes)
+{
+  if (!Enabled.load(std::memory_order_relaxed))
+  {
+    return;
+  }
+  AllocatedBytes.fetch_add(bytes, std::memory_order_relaxed);
+  const std::int64_t current = CurrentBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+  std::int64_t peak = PeakBytes.load(std::memory_order_relaxed);
+  while (current > peak &&
+    !PeakBytes.compare_exchange_weak(peak, current, std::memory_order_relaxed))
+  {
+  }
+}
+
+void RecordFree(std::int64_t bytes)
+{
+  if (!Enabled.load(std::memory_order_relaxed))
+  {
+    return;
+  }
+  CurrentBytes.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+#if defined(EFL_MEMORY_TRACKING) && defined(__GLIBC__)
+// The usable size is only looked up while counting, so that the hooks cost a relaxed load
+// otherwise.
+void RecordAllocation(void* pointer)
+{
+  if (pointer && Enabled.load(std::memory_order_relaxed))
+  {
+    RecordAllocation(static_cast<std::int64_t>(malloc_usable_size(pointer)));
+  }
+}
+
+void RecordFree(void* pointer)
+{
+  if (pointer && Enabled.load(std::memory_order_relaxed))
+  {
+    RecordFree(static_cast<std::int64_t>(malloc_usable_size(pointer)));
+  }
+}
+#elif defined(EFL_MEMORY_TRACKING)
+// The size of a block allocated by operator new is stored in front of it.
+constexpr std::size_t HeaderSize = alignof(std::max_align_t);
+
+void* AllocateWithHeader(std::size_t size)
+{
+  auto block = static_cast<unsigned char*>(std::malloc(HeaderSize + size));
+  if (!block)
+  {
+    return nullptr;
+  }
+  *reinterpret_cast<std::size_t*>(block) = size;
+  RecordAllocation(static_cast<std::int64_t>(size));
+  return block + HeaderSize;
+}
+
+void FreeWithHeader(void* pointer)
+{
+  if (!pointer)
+  {
+    return;
+  }
+  auto block = static_cast<unsigned char*>(pointer) - HeaderSize;
+  RecordFree(static_cast<std::int64_t>(*reinterpret_cast<std::size_t*>(block)));
+  std::free(block);
+}
+#endif
+}
+
+namespace MemoryTracker
+{
+bool IsAvailable()
+{
+#if defined(EFL_MEMORY_TRACKING)
+  return true;
+#else
+  return false;
+#endif
+}
+
+void Enable()
+{
+  Enabled.store(true);
+}
+
+bool IsEnabled()
+{
+  return Enabled.load();
+}
+
+std::int64_t GetCurrentBytes()
+{
+  return CurrentBytes.load(std::memory_order_relaxed);
+}
+
+std::int64_t GetAllocatedBytes()
+{
+  return AllocatedBytes.load(std::memory_order_relaxed);
+}
+
+std::int64_t GetPeakBytes()
+{
+  return PeakBytes.load(std::memory_order_relaxed);
+}
+
+void ResetPeakBytes()
+{
+  PeakBytes.store(CurrentBytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+}
+
+#if defined(EFL_MEMORY_TRACKING) && defined(__GLIBC__)
+// The allocation functions of glibc that the interposed ones forward to. operator new and
+// delete of libstdc++ use malloc and free, so they are counted through them.
+extern "C"
+{
+  void* __libc_malloc(size_t size);
+  void* __libc_calloc(size_t count, size_t size);
+  void* __libc_realloc(void* pointer, size_t size);
+  void* __libc_memalign(size_t alignment, size_t size);
+  void* __libc_valloc(size_t size);
+  void* __libc_pvalloc(size_t size);
+  void __libc_free(void* pointer);
+
+  void* malloc(size_t size)
+  {
+    void* pointer = __libc_malloc(size);
+    RecordAllocation(pointer);
+    return pointer;
+  }
+
+  void* calloc(size_t count, size_t size)
+  {
+    void* pointer = __libc_calloc(count, size);
+    RecordAllocation(pointer);
+    return pointer;
+  }
+
+  void* realloc(void* pointer, size_t size)
+  {
+    RecordFree(pointer);
+    void* newPointer = __libc_realloc(pointer, size);
+    // a failed realloc keeps the original block
+    RecordAllocation(newPointer || size == 0 ? newPointer : pointer);
+    return newPointer;
+  }
+
+  void* reallocarray(void* pointer, size_t count, size_t size)
+  {
+    size_t bytes;
+    if (__builtin_mul_overflow(count, size, &bytes))
+    {
+      errno = ENOMEM;
+      return nullptr;
+    }
+    return realloc(pointer, bytes);
+  }
+
+  void* memalign(size_t alignment, size_t size)
+  {
+    void* pointer = __libc_memalign(alignment, size);
+    RecordAllocation(pointer);
+    return pointer;
+  }
+
+  void* aligned_alloc(size_t alignment, size_t size)
+  {
+    return memalign(alignment, size);
+  }
+
+  void* valloc(size_t size)
+  {
+    void* pointer = __libc_valloc(size);
+    RecordAllocation(pointer);
+    return pointer;
+  }
+
+  void* pvalloc(size_t size)
+  {
+    void* pointer = __libc_pvalloc(size);
+    RecordAllocation(pointer);
+    return pointer;
+  }
+
+  int posix_memalign(void** result, size_t alignment, size_t size)
+  {
+    if (alignment < sizeof(void*) || (alignment & (alignment - 1)) != 0)
+    {
+      return EINVAL;
+    }
+    void* pointer = memalign(alignment, size);
+    if (!pointer && size != 0)
+    {
+      return ENOMEM;
+    }
+    *result = pointer;
+    return 0;
+  }
+
+  void free(void* pointer)
+  {
+    RecordFree(pointer);
+    __libc_free(pointer);
+  }
+}
+#elif defined(EFL_MEMORY_TRACKING)
+void* operator new(std::size_t size)
+{
+  void* pointer = AllocateWithHeader(size);
+  if (!pointer)
+  {
+    throw std::bad_alloc();
+  }
+  return pointer;
+}
+
+void* operator new[](std::size_t size)
+{
+  return ::operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+  return AllocateWithHeader(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+  return AllocateWithHeader(size);
+}
+
+void operator delete(void* pointer) noexcept
+{
+  FreeWithHeader(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+  FreeWithHeader(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+  FreeWithHeader(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept
+{
+  FreeWithHeader(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept
+{
+  FreeWithHeader(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept
+{
+  FreeWithHeader(pointer);
+}
+#endif
@@ -0,0 +1,174 @@
+//============================================================================
+//  Copyright (c) Kitware, Inc.
+//  All rights reserved.
+//  See LICENSE.txt for details.
+//  This software is distributed WITHOUT ANY WARRANTY; without even
+//  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+//  PURPOSE.  See the above copyright notice for more information.
+//============================================================================
+#ifndef _MemoryTracker_h
+#define _MemoryTracker_h
+
+#include "PhaseTimer.h"
+#include "MetricSink.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/// \brief Counts the heap allocations of the process.
+///
+/// The allocation functions are only replaced in MemoryTracker.cxx when the EFL_MEMORY_TRACKING
+/// CMake option is on, so that the other builds time the unmodified allocator. With glibc, the
+/// malloc family is interposed, which covers operator new, the buffers of the VTK arrays, and
+/// the host buffers of the VTK-m array handles. Elsewhere, only operator new and delete are
+/// counted.
+/// Counting starts when \c Enable is called, which must happen before the measured data is
+/// allocated, and never stops, so that every counted block is also counted when it is freed.
+namespace MemoryTracker
+{
+/// Whether the allocation functions are replaced in this build.
+bool IsAvailable();
+void Enable();
+bool IsEnabled();
+/// Bytes of the live counted blocks.
+std::int64_t GetCurrentBytes();
+/// Bytes of all counted allocations so far.
+std::int64_t GetAllocatedBytes();
+/// High-water mark of the current bytes since the last reset.
+std::int64_t GetPeakBytes();
+/// Sets the high-water mark to the current bytes.
+void ResetPeakBytes();
+}
+
+/// \brief Reports the memory used by the timed phases.
+///
+/// For every phase, it writes the high-water mark of the counted heap above its value at the
+/// start of the phase (peak-heap-bytes), the bytes allocated during the phase (allocated-bytes),
+/// the change of the counted heap (heap-delta-bytes), and, from /proc/self/status, the resident
+/// set size high-water mark (peak-rss-bytes) and change (rss-delta-bytes). The resident high-water
+/// mark is reset at the start of each phase through /proc/self/clear_refs; if that is not
+/// possible, peak-rss-bytes is omitted.
+class MemoryProfiler : public PhaseObserver
+{
+public:
+  MemoryProfiler()
+  {
+    MemoryTracker::Enable();
+    this->CanResetPeakRSS = ResetPeakRSS();
+    AddPhaseObserver(this);
+  }
+
+  ~MemoryProfiler() override { RemovePhaseObserver(this); }
+
+  MemoryProfiler(const MemoryProfiler&) = delete;
+  MemoryProfiler& operator=(const MemoryProfiler&) = delete;
+
+  void StartPhase() override
+  {
+    // the high-water marks are reset for the new phase, so fold them into the running ones
+    this->FoldPeaks();
+    MemoryTracker::ResetPeakBytes();
+    if (this->CanResetPeakRSS)
+    {
+      ResetPeakRSS();
+    }
+    Phase phase;
+    phase.HeapStart = MemoryTracker::GetCurrentBytes();
+    phase.HeapPeak = phase.HeapStart;
+    phase.AllocatedStart = MemoryTracker::GetAllocatedBytes();
+    ReadRSS(phase.RSSStart, phase.RSSPeak);
+    this->Running.push_back(phase);
+  }
+
+  void StopPhase() override
+  {
+    if (this->Running.empty())
+    {
+      return;
+    }
+    this->FoldPeaks();
+    const Phase& phase = this->Running.back();
+    std::int64_t rss, peakRSS;
+    ReadRSS(rss, peakRSS);
+    this->LastPeakHeap = phase.HeapPeak - phase.HeapStart;
+    this->LastAllocated = MemoryTracker::GetAllocatedBytes() - phase.AllocatedStart;
+    this->LastHeapDelta = MemoryTracker::GetCurrentBytes() - phase.HeapStart;
+    this->LastPeakRSS = phase.RSSPeak;
+    this->LastRSSDelta = rss - phase.RSSStart;
+    this->Running.pop_back();
+  }
+
+  void ReportPhase(MetricSink& metrics, const char* phase) override
+  {
+    metrics.AddCount("peak-heap-bytes", phase, this->LastPeakHeap);
+    metrics.AddCount("allocated-bytes", phase, this->LastAllocated);
+    metrics.AddCount("heap-delta-bytes", phase, this->LastHeapDelta);
+    if (this->CanResetPeakRSS)
+    {
+      metrics.AddCount("peak-rss-bytes", phase, this->LastPeakRSS);
+    }
+    metrics.AddCount("rss-delta-bytes", phase, this->LastRSSDelta);
+  }
+
+private:
+  struct Phase
+  {
+    std::int64_t HeapStart = 0;
+    std::int64_t HeapPeak = 0;
+    std::int64_t AllocatedStart = 0;
+    std::int64_t RSSStart = 0;
+    std::int64_t RSSPeak = 0;
+  };
+
+  void FoldPeaks()
+  {
+    const std::int64_t heapPeak = MemoryTracker::GetPeakBytes();
+    std::int64_t rss, rssPeak;
+    ReadRSS(rss, rssPeak);
+    for (Phase& phase : this->Running)
+    {
+      phase.HeapPeak = std::max(phase.HeapPeak, heapPeak);
+      phase.RSSPeak = std::max(phase.RSSPeak, rssPeak);
+    }
+  }
+
+  // Reads VmRSS and VmHWM in bytes.
+  static void ReadRSS(std::int64_t& rss, std::int64_t& peakRSS)
+  {
+    rss = peakRSS = 0;
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line))
+    {
+      if (line.compare(0, 6, "VmRSS:") == 0)
+      {
+        rss = std::stoll(line.substr(6)) * 1024;
+      }
+      else if (line.compare(0, 6, "VmHWM:") == 0)
+      {
+        peakRSS = std::stoll(line.substr(6)) * 1024;
+      }
+    }
+  }
+
+  static bool ResetPeakRSS()
+  {
+    std::ofstream clearRefs("/proc/self/clear_refs");
+    clearRefs << "5";
+    clearRefs.flush();
+    return clearRefs.good();
+  }
+
+  bool CanResetPeakRSS = false;
+  std::vector<Phase> Running;
+  std::int64_t LastPeakHeap = 0;
+  std::int64_t LastAllocated = 0;
+  std::int64_t LastHeapDelta = 0;
+  std::int64_t LastPeakRSS = 0;
+  std::int64_t LastRSSDelta = 0;
+};
+
+#endif //_MemoryTracker_h
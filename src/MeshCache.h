@@ -0,0 +1,337 @@
+//============================================================================
+//  Copyright (c) Kitware, Inc.
+//  All rights reserved.
+//  See LICENSE.txt for details.
+//  This software is distributed WITHOUT ANY WARRANTY; without even
+//  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+//  PURPOSE.  See the above copyright notice for more information.
+//============================================================================
+#ifndef _MeshCache_h
+#define _MeshCache_h
+
+#include <vtkAOSDataArrayTemplate.h>
+#include <vtkCellArray.h>
+#include <vtkDoubleArray.h>
+#include <vtkFloatArray.h>
+#include <vtkNew.h>
+#include <vtkPoints.h>
+#include <vtkSmartPointer.h>
+#include <vtkTypeInt64Array.h>
+#include <vtkUnsignedCharArray.h>
+#include <vtkUnstructuredGrid.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <string>
+
+/// \brief Header of the raw binary mesh cache.
+///
+/// The header is followed by the points, offsets, connectivity and cell types sections. Every
+/// section starts at a multiple of \c MeshCacheAlignment, so that it can be mapped on its own,
+/// and the offsets and connectivity are always stored as 64-bit integers. The size and the
+/// modification time of the source file are recorded to detect a stale cache.
+struct MeshCacheHeader
+{
+  char Magic[8];
+  std::uint64_t Version;
+  std::uint64_t SourceSize;
+  std::int64_t SourceModifiedTime;
+  std::uint64_t PointsDataType;
+  std::uint64_t NumberOfPoints;
+  std::uint64_t NumberOfCells;
+  std::uint64_t ConnectivitySize;
+  std::uint64_t PointsOffset;
+  std::uint64_t OffsetsOffset;
+  std::uint64_t ConnectivityOffset;
+  std::uint64_t CellTypesOffset;
+  std::uint64_t FileSize;
+};
+
+/// Alignment of the cache sections. It is a multiple of the page size of all supported systems.
+constexpr std::uint64_t MeshCacheAlignment = 65536;
+constexpr char MeshCacheMagic[8] = { 'E', 'F', 'L', 'M', 'E', 'S', 'H', '\0' };
+constexpr std::uint64_t MeshCacheVersion = 1;
+
+namespace detail
+{
+// Size of every mapped section, keyed by its address, so that the free function of the VTK
+// arrays, which only receives the address, can unmap it.
+inline std::map<void*, std::size_t>& MappedSections()
+{
+  static std::map<void*, std::size_t> sections;
+  return sections;
+}
+
+inline std::mutex& MappedSectionsMutex()
+{
+  static std::mutex mutex;
+  return mutex;
+}
+
+inline void UnmapMeshCacheSection(void* address)
+{
+  std::size_t length = 0;
+  {
+    std::lock_guard<std::mutex> lock(MappedSectionsMutex());
+    auto it = MappedSections().find(address);
+    if (it == MappedSections().end())
+    {
+      return;
+    }
+    length = it->second;
+    MappedSections().erase(it);
+  }
+  munmap(address, length);
+}
+
+inline bool StatSourceFile(
+  const std::string& fileName, std::uint64_t& size, std::int64_t& modifiedTime)
+{
+  struct stat info;
+  if (stat(fileName.c_str(), &info) != 0)
+  {
+    return false;
+  }
+  size = static_cast<std::uint64_t>(info.st_size);
+  modifiedTime = static_cast<std::int64_t>(info.st_mtim.tv_sec) * 1000000000 +
+    static_cast<std::int64_t>(info.st_mtim.tv_nsec);
+  return true;
+}
+
+inline std::uint64_t AlignMeshCacheOffset(std::uint64_t offset)
+{
+  return (offset + MeshCacheAlignment - 1) / MeshCacheAlignment * MeshCacheAlignment;
+}
+
+// Maps a section privately, so that the copy-on-write pages can be modified without touching
+// the file, and hands it to the array, which unmaps it when its buffer is released.
+template <typename ArrayType>
+inline bool MapMeshCacheSection(int fd, std::uint64_t offset, std::uint64_t numberOfValues,
+  bool readAhead, ArrayType* array)
+{
+  using ValueType = typename ArrayType::ValueType;
+  const std::size_t length = static_cast<std::size_t>(numberOfValues * sizeof(ValueType));
+  void* address = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+    MAP_PRIVATE | (readAhead ? MAP_POPULATE : 0), fd, static_cast<off_t>(offset));
+  if (address == MAP_FAILED)
+  {
+    return false;
+  }
+  {
+    std::lock_guard<std::mutex> lock(MappedSectionsMutex());
+    MappedSections()[address] = length;
+  }
+  array->SetArray(static_cast<ValueType*>(address), static_cast<vtkIdType>(numberOfValues), 0,
+    vtkAbstractArray::VTK_DATA_ARRAY_USER_DEFINED);
+  array->SetArrayFreeFunction(UnmapMeshCacheSection);
+  return true;
+}
+
+inline void WriteMeshCacheSection(
+  std::ofstream& file, std::uint64_t offset, const void* data, std::uint64_t numberOfBytes)
+{
+  static const char padding[4096] = {};
+  auto position = static_cast<std::uint64_t>(file.tellp());
+  while (position < offset)
+  {
+    const auto count = std::min<std::uint64_t>(offset - position, sizeof(padding));
+    file.write(padding, static_cast<std::streamsize>(count));
+    position += count;
+  }
+  file.write(static_cast<const char*>(data), static_cast<std::streamsize>(numberOfBytes));
+}
+} // namespace detail
+
+/// \brief Loads an unstructured grid from a mesh cache written by \c WriteMeshCache.
+///
+/// The points, offsets, connectivity and cell types are mapped and used as the buffers of the
+/// VTK arrays without copying. If \c readAhead is true, the mapped pages are populated before
+/// returning, so that the algorithms under test do not pay for page faults. Returns nullptr if
+/// the cache does not exist, is stale, or cannot be mapped.
+inline vtkSmartPointer<vtkUnstructuredGrid> ReadMeshCache(
+  const std::string& cacheFileName, const std::string& sourceFileName, bool readAhead)
+{
+  std::uint64_t sourceSize;
+  std::int64_t sourceModifiedTime;
+  if (!detail::StatSourceFile(sourceFileName, sourceSize, sourceModifiedTime))
+  {
+    return nullptr;
+  }
+  const int fd = open(cacheFileName.c_str(), O_RDONLY);
+  if (fd < 0)
+  {
+    return nullptr;
+  }
+  MeshCacheHeader header;
+  struct stat cacheInfo;
+  const bool validHeader =
+    pread(fd, &header, sizeof(header), 0) == static_cast<ssize_t>(sizeof(header)) &&
+    fstat(fd, &cacheInfo) == 0 &&
+    std::memcmp(header.Magic, MeshCacheMagic, sizeof(MeshCacheMagic)) == 0 &&
+    header.Version == MeshCacheVersion && header.SourceSize == sourceSize &&
+    header.SourceModifiedTime == sourceModifiedTime &&
+    header.FileSize == static_cast<std::uint64_t>(cacheInfo.st_size) &&
+    (header.PointsDataType == VTK_FLOAT || header.PointsDataType == VTK_DOUBLE) &&
+    header.NumberOfPoints > 0 && header.NumberOfCells > 0 && header.ConnectivitySize > 0;
+  if (!validHeader)
+  {
+    close(fd);
+    return nullptr;
+  }
+
+  vtkSmartPointer<vtkDataArray> pointsData;
+  bool mapped = false;
+  if (header.PointsDataType == VTK_FLOAT)
+  {
+    vtkNew<vtkFloatArray> array;
+    array->SetNumberOfComponents(3);
+    mapped = detail::MapMeshCacheSection(
+      fd, header.PointsOffset, 3 * header.NumberOfPoints, readAhead, array.GetPointer());
+    pointsData = array;
+  }
+  else
+  {
+    vtkNew<vtkDoubleArray> array;
+    array->SetNumberOfComponents(3);
+    mapped = detail::MapMeshCacheSection(
+      fd, header.PointsOffset, 3 * header.NumberOfPoints, readAhead, array.GetPointer());
+    pointsData = array;
+  }
+  vtkNew<vtkTypeInt64Array> offsets;
+  vtkNew<vtkTypeInt64Array> connectivity;
+  vtkNew<vtkUnsignedCharArray> cellTypes;
+  mapped = mapped &&
+    detail::MapMeshCacheSection(
+      fd, header.OffsetsOffset, header.NumberOfCells + 1, readAhead, offsets.GetPointer()) &&
+    detail::MapMeshCacheSection(fd, header.ConnectivityOffset, header.ConnectivitySize,
+      readAhead, connectivity.GetPointer()) &&
+    detail::MapMeshCacheSection(
+      fd, header.CellTypesOffset, header.NumberOfCells, readAhead, cellTypes.GetPointer());
+  // the mappings stay valid after the file descriptor is closed
+  close(fd);
+  if (!mapped)
+  {
+    return nullptr;
+  }
+
+  vtkNew<vtkPoints> points;
+  points->SetData(pointsData);
+  vtkNew<vtkCellArray> cells;
+  cells->SetData(offsets.GetPointer(), connectivity.GetPointer());
+
+  auto ug = vtkSmartPointer<vtkUnstructuredGrid>::New();
+  ug->SetPoints(points);
+  ug->SetCells(cellTypes, cells);
+  return ug;
+}
+
+/// \brief Writes the points and cells of an unstructured grid to a mesh cache.
+///
+/// Point and cell data arrays are not cached. The cache is written to a temporary file that is
+/// renamed once complete, so that concurrent evaluation processes never map a partial cache.
+/// Returns false if the cache could not be written.
+inline bool WriteMeshCache(
+  const std::string& cacheFileName, const std::string& sourceFileName, vtkUnstructuredGrid* ug)
+{
+  MeshCacheHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.Magic, MeshCacheMagic, sizeof(MeshCacheMagic));
+  header.Version = MeshCacheVersion;
+  if (!detail::StatSourceFile(sourceFileName, header.SourceSize, header.SourceModifiedTime))
+  {
+    return false;
+  }
+
+  vtkSmartPointer<vtkDataArray> pointsData = ug->GetPoints()->GetData();
+  if (!vtkFloatArray::FastDownCast(pointsData) && !vtkDoubleArray::FastDownCast(pointsData))
+  {
+    auto doubleData = vtkSmartPointer<vtkDoubleArray>::New();
+    doubleData->DeepCopy(pointsData);
+    pointsData = doubleData;
+  }
+  vtkSmartPointer<vtkCellArray> cells = ug->GetCells();
+  if (!cells->IsStorage64Bit())
+  {
+    cells = vtkSmartPointer<vtkCellArray>::New();
+    cells->DeepCopy(ug->GetCells());
+    cells->ConvertTo64BitStorage();
+  }
+  vtkUnsignedCharArray* cellTypes = ug->GetCellTypesArray();
+
+  header.PointsDataType = static_cast<std::uint64_t>(pointsData->GetDataType());
+  header.NumberOfPoints = static_cast<std::uint64_t>(ug->GetNumberOfPoints());
+  header.NumberOfCells = static_cast<std::uint64_t>(ug->GetNumberOfCells());
+  header.ConnectivitySize =
+    static_cast<std::uint64_t>(cells->GetConnectivityArray64()->GetNumberOfValues());
+
+  const std::uint64_t pointsBytes = 3 * header.NumberOfPoints * pointsData->GetDataTypeSize();
+  const std::uint64_t offsetsBytes = (header.NumberOfCells + 1) * sizeof(vtkTypeInt64);
+  const std::uint64_t connectivityBytes = header.ConnectivitySize * sizeof(vtkTypeInt64);
+  const std::uint64_t cellTypesBytes = header.NumberOfCells;
+  header.PointsOffset = detail::AlignMeshCacheOffset(sizeof(header));
+  header.OffsetsOffset = detail::AlignMeshCacheOffset(header.PointsOffset + pointsBytes);
+  header.ConnectivityOffset = detail::AlignMeshCacheOffset(header.OffsetsOffset + offsetsBytes);
+  header.CellTypesOffset =
+    detail::AlignMeshCacheOffset(header.ConnectivityOffset + connectivityBytes);
+  header.FileSize = header.CellTypesOffset + cellTypesBytes;
+
+  const std::string temporaryFileName = cacheFileName + ".tmp." + std::to_string(getpid());
+  {
+    std::ofstream file(temporaryFileName, std::ios::binary | std::ios::trunc);
+    if (!file)
+    {
+      return false;
+    }
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    detail::WriteMeshCacheSection(
+      file, header.PointsOffset, pointsData->GetVoidPointer(0), pointsBytes);
+    detail::WriteMeshCacheSection(
+      file, header.OffsetsOffset, cells->GetOffsetsArray64()->GetPointer(0), offsetsBytes);
+    detail::WriteMeshCacheSection(file, header.ConnectivityOffset,
+      cells->GetConnectivityArray64()->GetPointer(0), connectivityBytes);
+    detail::WriteMeshCacheSection(
+      file, header.CellTypesOffset, cellTypes->GetPointer(0), cellTypesBytes);
+    if (!file)
+    {
+      std::remove(temporaryFileName.c_str());
+      return false;
+    }
+  }
+  if (std::rename(temporaryFileName.c_str(), cacheFileName.c_str()) != 0)
+  {
+    std::remove(temporaryFileName.c_str());
+    return false;
+  }
+  return true;
+}
+
+/// Asks the kernel to reclaim the pages of the mapped sections, so that the next accesses fault
+/// them in from the file. Returns the number of bytes of the sections that were paged out.
+inline std::size_t PageOutMeshCacheSections()
+{
+  std::size_t bytes = 0;
+#ifdef MADV_PAGEOUT
+  std::lock_guard<std::mutex> lock(detail::MappedSectionsMutex());
+  for (const auto& section : detail::MappedSections())
+  {
+    if (madvise(section.first, section.second, MADV_PAGEOUT) == 0)
+    {
+      bytes += section.second;
+    }
+  }
+#endif
+  return bytes;
+}
+
+#endif //_MeshCache_h
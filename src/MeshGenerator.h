@@ -0,0 +1,357 @@
+//============================================================================
+//  Copyright (c) Kitware, Inc.
+//  All rights reserved.
+//  See LICENSE.txt for details.
+//  This software is distributed WITHOUT ANY WARRANTY; without even
+//  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+//  PURPOSE.  See the above copyright notice for more information.
+//============================================================================
+#ifndef _MeshGenerator_h
+#define _MeshGenerator_h
+
+#include <vtkCellArray.h>
+#include <vtkCellType.h>
+#include <vtkFloatArray.h>
+#include <vtkNew.h>
+#include <vtkPoints.h>
+#include <vtkSMPTools.h>
+#include <vtkSmartPointer.h>
+#include <vtkTypeInt64Array.h>
+#include <vtkUnsignedCharArray.h>
+#include <vtkUnstructuredGrid.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <initializer_list>
+#include <numeric>
+#include <random>
+#include <vector>
+
+/// The elements of a generated mesh.
+enum class GeneratedMeshType
+{
+  Hexahedra,
+  Tetrahedra,
+  Wedges,
+  Mixed
+};
+
+namespace detail
+{
+// How the unit cube at a grid position is filled. Every decomposition splits the sides of the
+// cube the same way as its neighbors, so that the generated meshes are conforming.
+enum class CubeFill
+{
+  Hexahedron, // 1 hexahedron
+  Tetrahedra, // 6 tetrahedra around the (0,0,0)-(1,1,1) diagonal
+  Wedges,     // 2 wedges split by the (0,0)-(1,1) diagonal of the xy faces
+  Pyramids    // 6 pyramids from the faces to an extra point at the center of the cube
+};
+
+inline CubeFill GetCubeFill(GeneratedMeshType type, vtkIdType i, vtkIdType j)
+{
+  switch (type)
+  {
+    case GeneratedMeshType::Hexahedra:
+      return CubeFill::Hexahedron;
+    case GeneratedMeshType::Tetrahedra:
+      return CubeFill::Tetrahedra;
+    case GeneratedMeshType::Wedges:
+      return CubeFill::Wedges;
+    default:
+      // columns along z keep the triangles of the wedges on the xy faces away from the quads of
+      // the other elements, while all of them share quads on the xz and yz faces
+      {
+        const CubeFill columnFills[3] = { CubeFill::Hexahedron, CubeFill::Wedges,
+          CubeFill::Pyramids };
+        return columnFills[(i + 2 * j) % 3];
+      }
+  }
+}
+
+inline vtkIdType GetNumberOfCubeCells(CubeFill fill)
+{
+  return fill == CubeFill::Hexahedron ? 1 : fill == CubeFill::Wedges ? 2 : 6;
+}
+
+inline vtkIdType GetCubeConnectivitySize(CubeFill fill)
+{
+  return fill == CubeFill::Hexahedron ? 8
+    : fill == CubeFill::Wedges        ? 12
+    : fill == CubeFill::Tetrahedra    ? 24
+                                      : 30;
+}
+
+// Writes the cells of a cube whose corner c[b] is at (b & 1, (b >> 1) & 1, b >> 2), starting
+// at the given connectivity position, which is advanced past them.
+inline void WriteCubeCells(CubeFill fill, const vtkTypeInt64 c[8], vtkTypeInt64 center,
+  unsigned char* types, vtkTypeInt64* offsets, vtkTypeInt64* connectivity, vtkTypeInt64& position)
+{
+  vtkIdType cell = 0;
+  auto writeCell = [&](unsigned char type, std::initializer_list<vtkTypeInt64> pointIds)
+  {
+    types[cell] = type;
+    offsets[cell++] = position;
+    for (const vtkTypeInt64 pointId : pointIds)
+    {
+      connectivity[position++] = pointId;
+    }
+  };
+  switch (fill)
+  {
+    case CubeFill::Hexahedron:
+      writeCell(VTK_HEXAHEDRON, { c[0], c[1], c[3], c[2], c[4], c[5], c[7], c[6] });
+      break;
+    case CubeFill::Wedges:
+      writeCell(VTK_WEDGE, { c[0], c[3], c[1], c[4], c[7], c[5] });
+      writeCell(VTK_WEDGE, { c[0], c[2], c[3], c[4], c[6], c[7] });
+      break;
+    case CubeFill::Tetrahedra:
+    {
+      // one tetrahedron per order of the axes along the diagonal, where the odd orders swap
+      // their middle points to keep a positive volume
+      const int axisOrders[6][2] = { { 0, 1 }, { 1, 2 }, { 2, 0 }, { 0, 2 }, { 2, 1 }, { 1, 0 } };
+      for (int t = 0; t < 6; ++t)
+      {
+        const int first = 1 << axisOrders[t][0];
+        const int second = first | (1 << axisOrders[t][1]);
+        if (t < 3)
+        {
+          writeCell(VTK_TETRA, { c[0], c[first], c[second], c[7] });
+        }
+        else
+        {
+          writeCell(VTK_TETRA, { c[0], c[second], c[first], c[7] });
+        }
+      }
+      break;
+    }
+    case CubeFill::Pyramids:
+      // the bases are ordered so that their normals point to the center
+      writeCell(VTK_PYRAMID, { c[0], c[1], c[3], c[2], center });
+      writeCell(VTK_PYRAMID, { c[4], c[6], c[7], c[5], center });
+      writeCell(VTK_PYRAMID, { c[0], c[4], c[5], c[1], center });
+      writeCell(VTK_PYRAMID, { c[2], c[3], c[7], c[6], center });
+      writeCell(VTK_PYRAMID, { c[0], c[2], c[6], c[4], center });
+      writeCell(VTK_PYRAMID, { c[1], c[5], c[7], c[3], center });
+      break;
+  }
+}
+
+struct SphericalHole
+{
+  double Center[3];
+  double SquaredRadius;
+};
+
+// Places holes of equal radius at random positions that keep them inside the grid, so that
+// each hole adds an internal surface to the external faces.
+inline std::vector<SphericalHole> MakeHoles(
+  const std::array<vtkIdType, 3>& dimensions, unsigned int numberOfHoles, std::uint32_t seed)
+{
+  std::vector<SphericalHole> holes;
+  if (numberOfHoles == 0)
+  {
+    return holes;
+  }
+  const double minDimension =
+    static_cast<double>(*std::min_element(dimensions.begin(), dimensions.end()));
+  const double radius = minDimension / (4.0 * std::cbrt(static_cast<double>(numberOfHoles)));
+  if (radius < 1.0)
+  {
+    return holes;
+  }
+  std::mt19937 randomEngine(seed);
+  for (unsigned int h = 0; h < numberOfHoles; ++h)
+  {
+    SphericalHole hole;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      std::uniform_real_distribution<double> distribution(
+        radius + 1.0, static_cast<double>(dimensions[axis]) - radius - 1.0);
+      hole.Center[axis] = distribution(randomEngine);
+    }
+    hole.SquaredRadius = radius * radius;
+    holes.push_back(hole);
+  }
+  return holes;
+}
+
+inline bool IsInHole(const std::vector<SphericalHole>& holes, vtkIdType i, vtkIdType j, vtkIdType k)
+{
+  const double x[3] = { i + 0.5, j + 0.5, k + 0.5 };
+  for (const SphericalHole& hole : holes)
+  {
+    double squaredDistance = 0.0;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      squaredDistance += (x[axis] - hole.Center[axis]) * (x[axis] - hole.Center[axis]);
+    }
+    if (squaredDistance < hole.SquaredRadius)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+} // namespace detail
+
+/// \brief Generates a conforming mesh of about numberOfCells cells filling a cube of unit cubes.
+///
+/// The unit cubes are filled with hexahedra, tetrahedra, wedges, or, for the mixed type,
+/// columns of hexahedra, wedges and pyramids. If numberOfHoles is not 0, the cubes inside that
+/// many spherical holes, placed from the seed, are left empty. The points and cells are written
+/// in parallel, directly to float coordinates and 64-bit cell arrays, so that multi-GB meshes
+/// do not need a second copy. The dimensions of the grid of cubes are returned in dimensions.
+inline vtkSmartPointer<vtkUnstructuredGrid> GenerateMesh(GeneratedMeshType type,
+  vtkIdType numberOfCells, unsigned int numberOfHoles, std::uint32_t seed,
+  std::array<vtkIdType, 3>& dimensions)
+{
+  const double cellsPerCube = type == GeneratedMeshType::Hexahedra ? 1.0
+    : type == GeneratedMeshType::Wedges                            ? 2.0
+    : type == GeneratedMeshType::Tetrahedra                        ? 6.0
+                                                                   : 3.0;
+  const double numberOfCubes = static_cast<double>(numberOfCells) / cellsPerCube;
+  const vtkIdType n =
+    std::max<vtkIdType>(1, static_cast<vtkIdType>(std::llround(std::cbrt(numberOfCubes))));
+  dimensions = { n, n, n };
+  const vtkIdType nx = n, ny = n, nz = n;
+  const vtkIdType numberOfRows = ny * nz;
+
+  // the centers of the pyramid columns are appended after the grid points
+  const vtkIdType numberOfGridPoints = (nx + 1) * (ny + 1) * (nz + 1);
+  std::vector<vtkIdType> pyramidColumns(nx * ny, -1);
+  vtkIdType numberOfPyramidColumns = 0;
+  for (vtkIdType j = 0; j < ny; ++j)
+  {
+    for (vtkIdType i = 0; i < nx; ++i)
+    {
+      if (detail::GetCubeFill(type, i, j) == detail::CubeFill::Pyramids)
+      {
+        pyramidColumns[i + nx * j] = numberOfPyramidColumns++;
+      }
+    }
+  }
+  const vtkIdType numberOfPoints = numberOfGridPoints + numberOfPyramidColumns * nz;
+
+  vtkNew<vtkFloatArray> coordinates;
+  coordinates->SetNumberOfComponents(3);
+  coordinates->SetNumberOfTuples(numberOfPoints);
+  float* xyz = coordinates->GetPointer(0);
+  vtkSMPTools::For(0, nz + 1,
+    [&](vtkIdType begin, vtkIdType end)
+    {
+      for (vtkIdType k = begin; k < end; ++k)
+      {
+        float* point = xyz + 3 * k * (nx + 1) * (ny + 1);
+        for (vtkIdType j = 0; j <= ny; ++j)
+        {
+          for (vtkIdType i = 0; i <= nx; ++i)
+          {
+            *point++ = static_cast<float>(i);
+            *point++ = static_cast<float>(j);
+            *point++ = static_cast<float>(k);
+          }
+        }
+      }
+    });
+  vtkSMPTools::For(0, nx * ny,
+    [&](vtkIdType begin, vtkIdType end)
+    {
+      for (vtkIdType column = begin; column < end; ++column)
+      {
+        if (pyramidColumns[column] < 0)
+        {
+          continue;
+        }
+        float* point = xyz + 3 * (numberOfGridPoints + pyramidColumns[column] * nz);
+        for (vtkIdType k = 0; k < nz; ++k)
+        {
+          *point++ = static_cast<float>(column % nx) + 0.5f;
+          *point++ = static_cast<float>(column / nx) + 0.5f;
+          *point++ = static_cast<float>(k) + 0.5f;
+        }
+      }
+    });
+
+  // count the cells and connectivity of each row of cubes along x, and scan them
+  const std::vector<detail::SphericalHole> holes =
+    detail::MakeHoles(dimensions, numberOfHoles, seed);
+  std::vector<vtkTypeInt64> rowCells(numberOfRows + 1, 0);
+  std::vector<vtkTypeInt64> rowConnectivity(numberOfRows + 1, 0);
+  vtkSMPTools::For(0, numberOfRows,
+    [&](vtkIdType begin, vtkIdType end)
+    {
+      for (vtkIdType row = begin; row < end; ++row)
+      {
+        const vtkIdType j = row % ny, k = row / ny;
+        for (vtkIdType i = 0; i < nx; ++i)
+        {
+          if (!holes.empty() && detail::IsInHole(holes, i, j, k))
+          {
+            continue;
+          }
+          const detail::CubeFill fill = detail::GetCubeFill(type, i, j);
+          rowCells[row + 1] += detail::GetNumberOfCubeCells(fill);
+          rowConnectivity[row + 1] += detail::GetCubeConnectivitySize(fill);
+        }
+      }
+    });
+  std::partial_sum(rowCells.begin(), rowCells.end(), rowCells.begin());
+  std::partial_sum(rowConnectivity.begin(), rowConnectivity.end(), rowConnectivity.begin());
+
+  const vtkIdType numberOfGeneratedCells = rowCells[numberOfRows];
+  vtkNew<vtkUnsignedCharArray> cellTypes;
+  cellTypes->SetNumberOfValues(numberOfGeneratedCells);
+  vtkNew<vtkTypeInt64Array> offsets;
+  offsets->SetNumberOfValues(numberOfGeneratedCells + 1);
+  vtkNew<vtkTypeInt64Array> connectivity;
+  connectivity->SetNumberOfValues(rowConnectivity[numberOfRows]);
+  unsigned char* types = cellTypes->GetPointer(0);
+  vtkTypeInt64* cellOffsets = offsets->GetPointer(0);
+  vtkTypeInt64* cellConnectivity = connectivity->GetPointer(0);
+  cellOffsets[numberOfGeneratedCells] = rowConnectivity[numberOfRows];
+  vtkSMPTools::For(0, numberOfRows,
+    [&](vtkIdType begin, vtkIdType end)
+    {
+      for (vtkIdType row = begin; row < end; ++row)
+      {
+        const vtkIdType j = row % ny, k = row / ny;
+        vtkIdType cell = rowCells[row];
+        vtkTypeInt64 position = rowConnectivity[row];
+        for (vtkIdType i = 0; i < nx; ++i)
+        {
+          if (!holes.empty() && detail::IsInHole(holes, i, j, k))
+          {
+            continue;
+          }
+          vtkTypeInt64 c[8];
+          for (int b = 0; b < 8; ++b)
+          {
+            c[b] = (i + (b & 1)) + (nx + 1) * ((j + ((b >> 1) & 1)) + (ny + 1) * (k + (b >> 2)));
+          }
+          const vtkIdType column = i + nx * j;
+          const vtkTypeInt64 center = pyramidColumns[column] < 0
+            ? -1
+            : numberOfGridPoints + pyramidColumns[column] * nz + k;
+          const detail::CubeFill fill = detail::GetCubeFill(type, i, j);
+          detail::WriteCubeCells(
+            fill, c, center, types + cell, cellOffsets + cell, cellConnectivity, position);
+          cell += detail::GetNumberOfCubeCells(fill);
+        }
+      }
+    });
+
+  vtkNew<vtkPoints> points;
+  points->SetData(coordinates);
+  vtkNew<vtkCellArray> cells;
+  cells->SetData(offsets, connectivity);
+  auto ug = vtkSmartPointer<vtkUnstructuredGrid>::New();
+  ug->SetPoints(points);
+  ug->SetCells(cellTypes, cells);
+  return ug;
+}
+
+#endif //_MeshGenerator_h
@@ -0,0 +1,144 @@
+//============================================================================
+//  Copyright (c) Kitware, Inc.
+//  All rights reserved.
+//  See LICENSE.txt for details.
+//  This software is distributed WITHOUT ANY WARRANTY; without even
+//  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+//  PURPOSE.  See the above copyright notice for more information.
+//============================================================================
+#ifndef _MetricSink_h
+#define _MetricSink_h
+
+#include "YamlWriter.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/// \brief Collects the metrics of a trial in preallocated memory, to be written after the trial.
+///
+/// A metric is identified by a name and an optional phase, which make up its key
+/// <name>-<phase>. Both are stored as pointers, so they must outlive the sink, which string
+/// literals do, and adding a metric neither allocates nor writes to a stream. Metrics beyond the
+/// capacity are dropped and counted.
+class MetricSink
+{
+public:
+  static constexpr std::size_t DefaultCapacity = 512;
+
+  explicit MetricSink(std::size_t capacity = DefaultCapacity)
+    : Metrics(capacity)
+  {
+  }
+
+  void Add(const char* name, double value) { this->Add(name, nullptr, value); }
+
+  void Add(const char* name, const char* phase, double value)
+  {
+    if (Metric* metric = this->Next(name, phase))
+    {
+      metric->IsCount = false;
+      metric->Value = value;
+    }
+  }
+
+  void AddCount(const char* name, const char* phase, std::int64_t count)
+  {
+    if (Metric* metric = this->Next(name, phase))
+    {
+      metric->IsCount = true;
+      metric->Count = count;
+    }
+  }
+
+  void Clear()
+  {
+    this->Size = 0;
+    this->Dropped = 0;
+  }
+
+  std::size_t GetSize() const { return this->Size; }
+
+  /// Writes the metrics as dictionary entries, in the order they were added.
+  void Write(YamlWriter& log) const
+  {
+    for (std::size_t i = 0; i < this->Size; ++i)
+    {
+      const Metric& metric = this->Metrics[i];
+      if (metric.IsCount)
+      {
+        log.AddDictionaryEntry(GetKey(metric), metric.Count);
+      }
+      else
+      {
+        log.AddDictionaryEntry(GetKey(metric), metric.Value);
+      }
+    }
+    if (this->Dropped > 0)
+    {
+      log.AddDictionaryEntry("dropped-metrics", this->Dropped);
+    }
+  }
+
+  /// Writes the metrics as one JSON object on a line, labeled with the algorithm and trial.
+  void WriteJsonLine(std::ostream& stream, const std::string& fullName, unsigned int trial) const
+  {
+    char buffer[32];
+    stream << "{\"full-name\":\"" << fullName << "\",\"trial-index\":" << trial;
+    for (std::size_t i = 0; i < this->Size; ++i)
+    {
+      const Metric& metric = this->Metrics[i];
+      if (metric.IsCount)
+      {
+        std::snprintf(buffer, sizeof(buffer), "%lld", static_cast<long long>(metric.Count));
+      }
+      else
+      {
+        std::snprintf(buffer, sizeof(buffer), "%.9g", metric.Value);
+      }
+      stream << ",\"" << GetKey(metric) << "\":" << buffer;
+    }
+    if (this->Dropped > 0)
+    {
+      stream << ",\"dropped-metrics\":" << this->Dropped;
+    }
+    stream << "}\n";
+  }
+
+private:
+  struct Metric
+  {
+    const char* Name = nullptr;
+    const char* Phase = nullptr;
+    bool IsCount = false;
+    double Value = 0.0;
+    std::int64_t Count = 0;
+  };
+
+  Metric* Next(const char* name, const char* phase)
+  {
+    if (this->Size == this->Metrics.size())
+    {
+      ++this->Dropped;
+      return nullptr;
+    }
+    Metric* metric = &this->Metrics[this->Size++];
+    metric->Name = name;
+    metric->Phase = phase;
+    return metric;
+  }
+
+  static std::string GetKey(const Metric& metric)
+  {
+    return metric.Phase ? std::string(metric.Name) + "-" + metric.Phase : metric.Name;
+  }
+
+  std::vector<Metric> Metrics;
+  std::size_t Size = 0;
+  std::size_t Dropped = 0;
+};
+
+#endif //_MetricSink_h
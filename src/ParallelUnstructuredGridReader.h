@@ -0,0 +1,868 @@
+//============================================================================
+//  Copyright (c) Kitware, Inc.
+//  All rights reserved.
+//  See LICENSE.txt for details.
+//  This software is distributed WITHOUT ANY WARRANTY; without even
+//  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+//  PURPOSE.  See the above copyright notice for more information.
+//============================================================================
+#ifndef _ParallelUnstructuredGridReader_h
+#define _ParallelUnstructuredGridReader_h
+
+#include <vtkCellArray.h>
+#include <vtkCellData.h>
+#include <vtkDataArray.h>
+#include <vtkDataCompressor.h>
+#include <vtkIdTypeArray.h>
+#include <vtkLZ4DataCompressor.h>
+#include <vtkLZMADataCompressor.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkSMPThreadLocal.h>
+#include <vtkSMPTools.h>
+#include <vtkSmartPointer.h>
+#include <vtkTypeInt64Array.h>
+#include <vtkUnsignedCharArray.h>
+#include <vtkUnstructuredGrid.h>
+#include <vtkXMLUnstructuredGridReader.h>
+#include <vtkZLibDataCompressor.h>
+#include <vtksys/SystemTools.hxx>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace detail
+{
+/// A tag of the XML header of a VTK file, with its attributes.
+struct XMLTag
+{
+  std::string Name;
+  std::map<std::string, std::string> Attributes;
+  bool IsEndTag = false;
+
+  std::string Get(const std::string& key, const std::string& defaultValue = "") const
+  {
+    auto it = this->Attributes.find(key);
+    return it != this->Attributes.end() ? it->second : defaultValue;
+  }
+};
+
+// Finds the next tag starting at position, skipping declarations and comments, and moves
+// position past it. Element contents, such as inline data, are skipped.
+inline bool NextXMLTag(const char* text, std::size_t length, std::size_t& position, XMLTag& tag)
+{
+  while (true)
+  {
+    while (position < length && text[position] != '<')
+    {
+      ++position;
+    }
+    if (position + 1 >= length)
+    {
+      return false;
+    }
+    if (text[position + 1] == '?' || text[position + 1] == '!')
+    {
+      const char* terminator = text[position + 1] == '?' ? "?>"
+        : position + 2 < length && text[position + 2] == '-' ? "-->"
+                                                             : ">";
+      const char* end = std::search(
+        text + position, text + length, terminator, terminator + std::strlen(terminator));
+      position = static_cast<std::size_t>(end - text) + std::strlen(terminator);
+      continue;
+    }
+    break;
+  }
+
+  tag = XMLTag{};
+  std::size_t current = position + 1;
+  if (text[current] == '/')
+  {
+    tag.IsEndTag = true;
+    ++current;
+  }
+  auto isSpace = [](char c) { return c == ' ' || c == '\t' || c == '\n' || c == '\r'; };
+  const std::size_t nameStart = current;
+  while (current < length && !isSpace(text[current]) && text[current] != '>' &&
+    text[current] != '/')
+  {
+    ++current;
+  }
+  tag.Name.assign(text + nameStart, current - nameStart);
+
+  while (current < length && text[current] != '>')
+  {
+    if (isSpace(text[current]) || text[current] == '/')
+    {
+      ++current;
+      continue;
+    }
+    const std::size_t keyStart = current;
+    while (current < length && text[current] != '=' && !isSpace(text[current]))
+    {
+      ++current;
+    }
+    std::string key(text + keyStart, current - keyStart);
+    while (current < length && text[current] != '"' && text[current] != '\'')
+    {
+      ++current;
+    }
+    if (current >= length)
+    {
+      return false;
+    }
+    const char quote = text[current++];
+    const std::size_t valueStart = current;
+    while (current < length && text[current] != quote)
+    {
+      ++current;
+    }
+    tag.Attributes[key].assign(text + valueStart, current - valueStart);
+    ++current;
+  }
+  position = current + 1;
+  return current < length;
+}
+
+inline int GetXMLDataType(const std::string& typeName)
+{
+  static const std::map<std::string, int> types = { { "Int8", VTK_TYPE_INT8 },
+    { "UInt8", VTK_TYPE_UINT8 }, { "Int16", VTK_TYPE_INT16 }, { "UInt16", VTK_TYPE_UINT16 },
+    { "Int32", VTK_TYPE_INT32 }, { "UInt32", VTK_TYPE_UINT32 }, { "Int64", VTK_TYPE_INT64 },
+    { "UInt64", VTK_TYPE_UINT64 }, { "Float32", VTK_TYPE_FLOAT32 },
+    { "Float64", VTK_TYPE_FLOAT64 } };
+  auto it = types.find(typeName);
+  return it != types.end() ? it->second : 0;
+}
+
+/// Read-only mapping of a whole file.
+struct MappedFile
+{
+  const char* Data = nullptr;
+  std::size_t Length = 0;
+
+  explicit MappedFile(const std::string& fileName)
+  {
+    const int fd = open(fileName.c_str(), O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+      if (fd >= 0)
+      {
+        close(fd);
+      }
+      throw std::runtime_error("Could not open " + fileName);
+    }
+    this->Length = static_cast<std::size_t>(info.st_size);
+    void* address = mmap(nullptr, this->Length, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (address == MAP_FAILED)
+    {
+      throw std::runtime_error("Could not map " + fileName);
+    }
+    this->Data = static_cast<const char*>(address);
+  }
+  ~MappedFile() { munmap(const_cast<char*>(this->Data), this->Length); }
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+};
+
+/// A DataArray element in appended format.
+struct VTUDataArray
+{
+  std::string Name;
+  int DataType = 0;
+  int NumberOfComponents = 1;
+  std::uint64_t Offset = 0;
+  vtkSmartPointer<vtkDataArray> Array;
+};
+
+struct VTUPiece
+{
+  vtkIdType NumberOfPoints = 0;
+  vtkIdType NumberOfCells = 0;
+  VTUDataArray Points;
+  VTUDataArray Connectivity;
+  VTUDataArray Offsets;
+  VTUDataArray Types;
+  std::vector<VTUDataArray> PointData;
+  std::vector<VTUDataArray> CellData;
+  std::string GlobalIdsName;
+};
+
+enum VTUCompressorType
+{
+  VTUNoCompressor = 0,
+  VTUZLibCompressor,
+  VTULZ4Compressor,
+  VTULZMACompressor
+};
+
+/// The XML header of a .vtu file. Supported is false if the file uses a layout that the
+/// parallel path does not decode, such as inline, base64 or byte swapped data, or polyhedra.
+struct VTUFile
+{
+  std::unique_ptr<MappedFile> File;
+  const unsigned char* AppendedData = nullptr;
+  bool HeaderUInt64 = false;
+  int Compressor = VTUNoCompressor;
+  std::vector<VTUPiece> Pieces;
+  bool Supported = true;
+};
+
+/// A compressed block, or a chunk of an uncompressed array, to be decoded into its array.
+struct VTUDecodeTask
+{
+  const unsigned char* Source;
+  std::size_t SourceSize;
+  unsigned char* Destination;
+  std::size_t DestinationSize;
+  int Compressor;
+};
+
+inline bool IsHostLittleEndian()
+{
+  const std::uint16_t one = 1;
+  return *reinterpret_cast<const unsigned char*>(&one) == 1;
+}
+
+inline VTUFile ParseVTUHeader(const std::string& fileName)
+{
+  VTUFile vtu;
+  vtu.File = std::make_unique<MappedFile>(fileName);
+  const char* text = vtu.File->Data;
+  const std::size_t length = vtu.File->Length;
+
+  std::string section;
+  std::size_t position = 0;
+  XMLTag tag;
+  while (vtu.Supported && NextXMLTag(text, length, position, tag))
+  {
+    if (tag.Name == "VTKFile" && !tag.IsEndTag)
+    {
+      const std::string byteOrder = tag.Get("byte_order", "LittleEndian");
+      vtu.Supported = tag.Get("type") == "UnstructuredGrid" &&
+        (byteOrder == "LittleEndian") == IsHostLittleEndian();
+      vtu.HeaderUInt64 = tag.Get("header_type", "UInt32") == "UInt64";
+      const std::string compressor = tag.Get("compressor");
+      vtu.Compressor = compressor.empty() ? VTUNoCompressor
+        : compressor == "vtkZLibDataCompressor" ? VTUZLibCompressor
+        : compressor == "vtkLZ4DataCompressor"  ? VTULZ4Compressor
+        : compressor == "vtkLZMADataCompressor" ? VTULZMACompressor
+                                                : -1;
+    }
+    else if (tag.Name == "Piece" && !tag.IsEndTag)
+    {
+      VTUPiece piece;
+      piece.NumberOfPoints = std::stoll(tag.Get("NumberOfPoints", "0"));
+      piece.NumberOfCells = std::stoll(tag.Get("NumberOfCells", "0"));
+      vtu.Pieces.push_back(std::move(piece));
+    }
+    else if (tag.Name == "Points" || tag.Name == "Cells" || tag.Name == "PointData" ||
+      tag.Name == "CellData" || tag.Name == "FieldData")
+    {
+      section = tag.IsEndTag ? "" : tag.Name;
+      if (tag.Name == "PointData" && !tag.IsEndTag && !vtu.Pieces.empty())
+      {
+        vtu.Pieces.back().GlobalIdsName = tag.Get("GlobalIds");
+      }
+    }
+    else if (tag.Name == "DataArray" && !tag.IsEndTag && section != "FieldData")
+    {
+      VTUDataArray array;
+      array.Name = tag.Get("Name");
+      array.DataType = GetXMLDataType(tag.Get("type"));
+      array.NumberOfComponents = std::stoi(tag.Get("NumberOfComponents", "1"));
+      array.Offset = std::stoull(tag.Get("offset", "0"));
+      vtu.Supported = !vtu.Pieces.empty() && array.DataType != 0 &&
+        tag.Get("format") == "appended";
+      if (!vtu.Supported)
+      {
+        break;
+      }
+      VTUPiece& piece = vtu.Pieces.back();
+      if (section == "Points")
+      {
+        piece.Points = array;
+      }
+      else if (section == "Cells" && array.Name == "connectivity")
+      {
+        piece.Connectivity = array;
+      }
+      else if (section == "Cells" && array.Name == "offsets")
+      {
+        piece.Offsets = array;
+      }
+      else if (section == "Cells" && array.Name == "types")
+      {
+        piece.Types = array;
+      }
+      else if (section == "Cells")
+      {
+        // faces and face offsets of polyhedra
+        vtu.Supported = false;
+      }
+      else if (section == "PointData")
+      {
+        piece.PointData.push_back(array);
+      }
+      else if (section == "CellData")
+      {
+        piece.CellData.push_back(array);
+      }
+    }
+    else if (tag.Name == "AppendedData" && !tag.IsEndTag)
+    {
+      vtu.Supported = tag.Get("encoding") == "raw";
+      const char* marker = static_cast<const char*>(
+        std::memchr(text + position, '_', length - position));
+      if (!marker)
+      {
+        throw std::runtime_error("Missing appended data marker in " + fileName);
+      }
+      vtu.AppendedData = reinterpret_cast<const unsigned char*>(marker + 1);
+      break;
+    }
+  }
+  vtu.Supported =
+    vtu.Supported && vtu.AppendedData && !vtu.Pieces.empty() && vtu.Compressor >= 0;
+  for (const VTUPiece& piece : vtu.Pieces)
+  {
+    vtu.Supported = vtu.Supported && piece.Points.DataType != 0 &&
+      piece.Connectivity.DataType != 0 && piece.Offsets.DataType != 0 &&
+      piece.Types.DataType == VTK_TYPE_UINT8;
+  }
+  return vtu;
+}
+
+// Allocates the array of a DataArray element, and appends the tasks that decode it. The size
+// of the array is taken from the header of its appended data, and checked against
+// expectedNumberOfTuples unless it is negative.
+inline void PlanVTUDataArray(const VTUFile& vtu, vtkIdType expectedNumberOfTuples,
+  VTUDataArray& array, std::vector<VTUDecodeTask>& tasks)
+{
+  const unsigned char* end =
+    reinterpret_cast<const unsigned char*>(vtu.File->Data) + vtu.File->Length;
+  const unsigned char* header = vtu.AppendedData + array.Offset;
+  const std::size_t wordSize = vtu.HeaderUInt64 ? 8 : 4;
+  auto readWord = [&](std::uint64_t index) -> std::uint64_t
+  {
+    if (header + (index + 1) * wordSize > end)
+    {
+      throw std::runtime_error("Truncated appended data of array " + array.Name);
+    }
+    if (vtu.HeaderUInt64)
+    {
+      std::uint64_t word;
+      std::memcpy(&word, header + index * wordSize, wordSize);
+      return word;
+    }
+    std::uint32_t word;
+    std::memcpy(&word, header + index * wordSize, wordSize);
+    return word;
+  };
+
+  const bool compressed = vtu.Compressor != VTUNoCompressor;
+  const std::uint64_t numberOfBlocks = compressed ? readWord(0) : 0;
+  const std::uint64_t blockSize = compressed ? readWord(1) : 0;
+  const std::uint64_t lastBlockSize =
+    compressed ? (readWord(2) != 0 ? readWord(2) : blockSize) : 0;
+  const std::uint64_t numberOfBytes = !compressed ? readWord(0)
+    : numberOfBlocks == 0                        ? 0
+                                                 : (numberOfBlocks - 1) * blockSize + lastBlockSize;
+  const std::uint64_t tupleSize = static_cast<std::uint64_t>(array.NumberOfComponents) *
+    vtkAbstractArray::GetDataTypeSize(array.DataType);
+  const vtkIdType numberOfTuples = static_cast<vtkIdType>(numberOfBytes / tupleSize);
+  if (numberOfBytes % tupleSize != 0 ||
+    (expectedNumberOfTuples >= 0 && numberOfTuples != expectedNumberOfTuples))
+  {
+    throw std::runtime_error("Unexpected size of array " + array.Name);
+  }
+
+  if (array.DataType == VTK_TYPE_INT64)
+  {
+    // so that the connectivity and offsets can be used by vtkCellArray without conversion
+    array.Array = vtkSmartPointer<vtkTypeInt64Array>::New();
+  }
+  else
+  {
+    array.Array = vtk::TakeSmartPointer(vtkDataArray::CreateDataArray(array.DataType));
+  }
+  array.Array->SetName(array.Name.c_str());
+  array.Array->SetNumberOfComponents(array.NumberOfComponents);
+  array.Array->SetNumberOfTuples(numberOfTuples);
+  auto destination = static_cast<unsigned char*>(array.Array->GetVoidPointer(0));
+
+  if (!compressed)
+  {
+    if (header + wordSize + numberOfBytes > end)
+    {
+      throw std::runtime_error("Truncated appended data of array " + array.Name);
+    }
+    // split large copies, so that they are spread over the threads
+    constexpr std::uint64_t chunkSize = 1 << 24;
+    for (std::uint64_t offset = 0; offset < numberOfBytes; offset += chunkSize)
+    {
+      const std::size_t size = std::min(chunkSize, numberOfBytes - offset);
+      tasks.push_back(
+        { header + wordSize + offset, size, destination + offset, size, VTUNoCompressor });
+    }
+    return;
+  }
+
+  const unsigned char* source = header + (3 + numberOfBlocks) * wordSize;
+  for (std::uint64_t block = 0; block < numberOfBlocks; ++block)
+  {
+    const std::uint64_t compressedSize = readWord(3 + block);
+    if (source + compressedSize > end)
+    {
+      throw std::runtime_error("Truncated appended data of array " + array.Name);
+    }
+    tasks.push_back({ source, compressedSize, destination + block * blockSize,
+      block + 1 == numberOfBlocks ? lastBlockSize : blockSize, vtu.Compressor });
+    source += compressedSize;
+  }
+}
+
+inline vtkSmartPointer<vtkDataCompressor> NewDataCompressor(int compressor)
+{
+  switch (compressor)
+  {
+    case VTUZLibCompressor:
+      return vtkSmartPointer<vtkZLibDataCompressor>::New();
+    case VTULZ4Compressor:
+      return vtkSmartPointer<vtkLZ4DataCompressor>::New();
+    default:
+      return vtkSmartPointer<vtkLZMADataCompressor>::New();
+  }
+}
+
+// Decodes all tasks concurrently, with one compressor of each kind per thread.
+inline void DecodeVTUTasks(const std::vector<VTUDecodeTask>& tasks)
+{
+  std::atomic<bool> failed(false);
+  vtkSMPThreadLocal<std::array<vtkSmartPointer<vtkDataCompressor>, 4>> localCompressors;
+  vtkSMPTools::For(0, static_cast<vtkIdType>(tasks.size()), 1,
+    [&](vtkIdType begin, vtkIdType end)
+    {
+      auto& compressors = localCompressors.Local();
+      for (vtkIdType t = begin; t < end; ++t)
+      {
+        const VTUDecodeTask& task = tasks[t];
+        if (task.Compressor == VTUNoCompressor)
+        {
+          std::memcpy(task.Destination, task.Source, task.DestinationSize);
+          continue;
+        }
+        auto& compressor = compressors[task.Compressor];
+        if (!compressor)
+        {
+          compressor = NewDataCompressor(task.Compressor);
+        }
+        if (compressor->Uncompress(task.Source, task.SourceSize, task.Destination,
+              task.DestinationSize) != task.DestinationSize)
+        {
+          failed = true;
+        }
+      }
+    });
+  if (failed)
+  {
+    throw std::runtime_error("Failed to decompress appended data");
+  }
+}
+
+// Widens integer ids to 64-bit, optionally adding a constant, in parallel.
+template <typename T>
+inline void WidenIds(const T* input, vtkIdType numberOfValues, vtkTypeInt64 shift,
+  vtkTypeInt64* output)
+{
+  vtkSMPTools::For(0, numberOfValues,
+    [&](vtkIdType begin, vtkIdType end)
+    {
+      for (vtkIdType i = begin; i < end; ++i)
+      {
+        output[i] = static_cast<vtkTypeInt64>(input[i]) + shift;
+      }
+    });
+}
+
+inline void WidenIds(
+  vtkDataArray* input, vtkIdType numberOfValues, vtkTypeInt64 shift, vtkTypeInt64* output)
+{
+  switch (input->GetDataType())
+  {
+    vtkTemplateMacro(WidenIds(
+      static_cast<const VTK_TT*>(input->GetVoidPointer(0)), numberOfValues, shift, output));
+  }
+}
+
+// Builds an unstructured grid from the decoded arrays of a piece.
+inline vtkSmartPointer<vtkUnstructuredGrid> BuildVTUPiece(VTUPiece& piece)
+{
+  vtkNew<vtkPoints> points;
+  points->SetData(piece.Points.Array);
+
+  // the offsets of a .vtu file do not contain the leading 0
+  vtkNew<vtkTypeInt64Array> offsets;
+  offsets->SetNumberOfValues(piece.NumberOfCells + 1);
+  offsets->SetValue(0, 0);
+  WidenIds(piece.Offsets.Array, piece.NumberOfCells, 0, offsets->GetPointer(1));
+  vtkSmartPointer<vtkTypeInt64Array> connectivity =
+    vtkTypeInt64Array::SafeDownCast(piece.Connectivity.Array);
+  if (!connectivity)
+  {
+    connectivity = vtkSmartPointer<vtkTypeInt64Array>::New();
+    connectivity->SetNumberOfValues(piece.Connectivity.Array->GetNumberOfValues());
+    WidenIds(piece.Connectivity.Array, connectivity->GetNumberOfValues(), 0,
+      connectivity->GetPointer(0));
+  }
+  vtkNew<vtkCellArray> cells;
+  cells->SetData(offsets.GetPointer(), connectivity.GetPointer());
+
+  auto ug = vtkSmartPointer<vtkUnstructuredGrid>::New();
+  ug->SetPoints(points);
+  ug->SetCells(vtkUnsignedCharArray::FastDownCast(piece.Types.Array), cells);
+  for (VTUDataArray& array : piece.PointData)
+  {
+    ug->GetPointData()->AddArray(array.Array);
+    if (array.Name == piece.GlobalIdsName)
+    {
+      ug->GetPointData()->SetGlobalIds(array.Array);
+    }
+  }
+  for (VTUDataArray& array : piece.CellData)
+  {
+    ug->GetCellData()->AddArray(array.Array);
+  }
+  return ug;
+}
+
+// Copies the tuples of source to destination, starting at tuple destinationStart, or to the
+// tuples given by destinationIds if it is not null.
+inline void CopyPieceTuples(vtkDataArray* source, vtkDataArray* destination,
+  vtkIdType destinationStart, const vtkIdType* destinationIds)
+{
+  const std::size_t tupleSize =
+    static_cast<std::size_t>(source->GetNumberOfComponents() * source->GetDataTypeSize());
+  auto input = static_cast<const unsigned char*>(source->GetVoidPointer(0));
+  auto output = static_cast<unsigned char*>(destination->GetVoidPointer(0));
+  vtkSMPTools::For(0, source->GetNumberOfTuples(),
+    [&](vtkIdType begin, vtkIdType end)
+    {
+      if (!destinationIds)
+      {
+        std::memcpy(output + (destinationStart + begin) * tupleSize, input + begin * tupleSize,
+          (end - begin) * tupleSize);
+        return;
+      }
+      for (vtkIdType i = begin; i < end; ++i)
+      {
+        std::memcpy(output + destinationIds[i] * tupleSize, input + i * tupleSize, tupleSize);
+      }
+    });
+}
+
+// Creates an empty array like the one of the first piece, if all pieces have a matching array.
+inline vtkSmartPointer<vtkDataArray> NewAppendedArray(vtkDataArray* first,
+  const std::vector<vtkDataArray*>& pieceArrays, vtkIdType numberOfTuples)
+{
+  for (vtkDataArray* array : pieceArrays)
+  {
+    if (!array || array->GetDataType() != first->GetDataType() ||
+      array->GetNumberOfComponents() != first->GetNumberOfComponents())
+    {
+      return nullptr;
+    }
+  }
+  auto output = vtk::TakeSmartPointer(first->NewInstance());
+  output->SetName(first->GetName());
+  output->SetNumberOfComponents(first->GetNumberOfComponents());
+  output->SetNumberOfTuples(numberOfTuples);
+  return output;
+}
+
+/// \brief Appends pieces into a single unstructured grid.
+///
+/// The offsets and connectivity are stitched in parallel. If every piece has point global ids,
+/// points shared by pieces are merged: the distinct global ids are sorted, and each point is
+/// placed at the rank of its global id, so that ids with gaps or large values still give dense
+/// points. If a global id is negative, i.e. unassigned, or a piece has no global ids, the points
+/// of the pieces are concatenated. Attribute arrays that are not present in all pieces with the
+/// same type are dropped.
+inline vtkSmartPointer<vtkUnstructuredGrid> AppendPieces(
+  std::vector<vtkSmartPointer<vtkUnstructuredGrid>>& pieces)
+{
+  if (pieces.size() == 1)
+  {
+    return pieces[0];
+  }
+  vtkUnstructuredGrid* first = pieces[0];
+  bool mergePoints = true;
+  vtkIdType numberOfCells = 0;
+  vtkIdType connectivitySize = 0;
+  vtkIdType numberOfPoints = 0;
+  std::vector<vtkSmartPointer<vtkIdTypeArray>> globalIds(pieces.size());
+  for (std::size_t p = 0; p < pieces.size(); ++p)
+  {
+    vtkUnstructuredGrid* piece = pieces[p];
+    piece->GetCells()->ConvertTo64BitStorage();
+    if (piece->GetPoints()->GetDataType() != first->GetPoints()->GetDataType())
+    {
+      auto pointsData = vtk::TakeSmartPointer(first->GetPoints()->GetData()->NewInstance());
+      pointsData->DeepCopy(piece->GetPoints()->GetData());
+      piece->GetPoints()->SetData(pointsData);
+    }
+    numberOfCells += piece->GetNumberOfCells();
+    connectivitySize += piece->GetCells()->GetNumberOfConnectivityIds();
+    numberOfPoints += piece->GetNumberOfPoints();
+    vtkDataArray* pieceGlobalIds = piece->GetPointData()->GetGlobalIds();
+    mergePoints = mergePoints && pieceGlobalIds;
+    if (pieceGlobalIds)
+    {
+      globalIds[p] = vtkArrayDownCast<vtkIdTypeArray>(pieceGlobalIds);
+      if (!globalIds[p])
+      {
+        globalIds[p] = vtkSmartPointer<vtkIdTypeArray>::New();
+        globalIds[p]->DeepCopy(pieceGlobalIds);
+      }
+    }
+  }
+  // the output point of every point of every piece when merging
+  std::vector<std::vector<vtkIdType>> pointIds(pieces.size());
+  if (mergePoints)
+  {
+    std::vector<vtkIdType> sortedIds;
+    sortedIds.reserve(static_cast<std::size_t>(numberOfPoints));
+    for (const auto& ids : globalIds)
+    {
+      sortedIds.insert(sortedIds.end(), ids->GetPointer(0),
+        ids->GetPointer(0) + ids->GetNumberOfValues());
+    }
+    vtkSMPTools::Sort(sortedIds.begin(), sortedIds.end());
+    sortedIds.erase(std::unique(sortedIds.begin(), sortedIds.end()), sortedIds.end());
+    mergePoints = !sortedIds.empty() && sortedIds.front() >= 0;
+    if (mergePoints)
+    {
+      numberOfPoints = static_cast<vtkIdType>(sortedIds.size());
+      // dense ids from 0 are already the output points
+      const bool denseIds = sortedIds.back() + 1 == numberOfPoints;
+      for (std::size_t p = 0; p < pieces.size(); ++p)
+      {
+        const vtkIdType* ids = globalIds[p]->GetPointer(0);
+        pointIds[p].resize(static_cast<std::size_t>(globalIds[p]->GetNumberOfValues()));
+        vtkSMPTools::For(0, globalIds[p]->GetNumberOfValues(),
+          [&](vtkIdType begin, vtkIdType end)
+          {
+            for (vtkIdType i = begin; i < end; ++i)
+            {
+              pointIds[p][i] = denseIds
+                ? ids[i]
+                : static_cast<vtkIdType>(
+                    std::lower_bound(sortedIds.begin(), sortedIds.end(), ids[i]) -
+                    sortedIds.begin());
+            }
+          });
+      }
+    }
+  }
+
+  vtkNew<vtkTypeInt64Array> offsets;
+  offsets->SetNumberOfValues(numberOfCells + 1);
+  offsets->SetValue(0, 0);
+  vtkNew<vtkTypeInt64Array> connectivity;
+  connectivity->SetNumberOfValues(connectivitySize);
+  vtkNew<vtkUnsignedCharArray> types;
+  types->SetNumberOfValues(numberOfCells);
+  auto pointsData = vtk::TakeSmartPointer(first->GetPoints()->GetData()->NewInstance());
+  pointsData->SetNumberOfComponents(3);
+  pointsData->SetNumberOfTuples(numberOfPoints);
+
+  auto ug = vtkSmartPointer<vtkUnstructuredGrid>::New();
+  std::vector<std::pair<std::string, vtkSmartPointer<vtkDataArray>>> pointArrays, cellArrays;
+  auto gatherArrays = [&](vtkDataSetAttributes* firstAttributes, bool pointAttributes,
+                        vtkIdType numberOfTuples, vtkDataSetAttributes* outputAttributes)
+  {
+    for (int a = 0; a < firstAttributes->GetNumberOfArrays(); ++a)
+    {
+      vtkDataArray* firstArray = firstAttributes->GetArray(a);
+      if (!firstArray || !firstArray->GetName())
+      {
+        continue;
+      }
+      std::vector<vtkDataArray*> pieceArrays;
+      for (auto& piece : pieces)
+      {
+        pieceArrays.push_back(pointAttributes
+            ? piece->GetPointData()->GetArray(firstArray->GetName())
+            : piece->GetCellData()->GetArray(firstArray->GetName()));
+      }
+      auto output = NewAppendedArray(firstArray, pieceArrays, numberOfTuples);
+      if (output)
+      {
+        outputAttributes->AddArray(output);
+        (pointAttributes ? pointArrays : cellArrays).emplace_back(firstArray->GetName(), output);
+      }
+    }
+  };
+  gatherArrays(first->GetPointData(), true, numberOfPoints, ug->GetPointData());
+  gatherArrays(first->GetCellData(), false, numberOfCells, ug->GetCellData());
+
+  vtkIdType cellOffset = 0;
+  vtkIdType connectivityOffset = 0;
+  vtkIdType pointOffset = 0;
+  for (std::size_t p = 0; p < pieces.size(); ++p)
+  {
+    vtkUnstructuredGrid* piece = pieces[p];
+    vtkCellArray* cells = piece->GetCells();
+    const vtkIdType pieceCells = piece->GetNumberOfCells();
+    const vtkIdType pieceConnectivitySize = cells->GetNumberOfConnectivityIds();
+    const vtkIdType* piecePointIds = mergePoints ? pointIds[p].data() : nullptr;
+
+    WidenIds(cells->GetOffsetsArray64()->GetPointer(1), pieceCells, connectivityOffset,
+      offsets->GetPointer(cellOffset + 1));
+    const vtkTypeInt64* pieceConnectivity = cells->GetConnectivityArray64()->GetPointer(0);
+    vtkTypeInt64* outputConnectivity = connectivity->GetPointer(connectivityOffset);
+    vtkSMPTools::For(0, pieceConnectivitySize,
+      [&](vtkIdType begin, vtkIdType end)
+      {
+        for (vtkIdType i = begin; i < end; ++i)
+        {
+          outputConnectivity[i] = piecePointIds ? piecePointIds[pieceConnectivity[i]]
+                                                : pieceConnectivity[i] + pointOffset;
+        }
+      });
+    CopyPieceTuples(piece->GetCellTypesArray(), types, cellOffset, nullptr);
+    CopyPieceTuples(piece->GetPoints()->GetData(), pointsData, pointOffset, piecePointIds);
+    for (auto& arrays : pointArrays)
+    {
+      CopyPieceTuples(piece->GetPointData()->GetArray(arrays.first.c_str()), arrays.second,
+        pointOffset, piecePointIds);
+    }
+    for (auto& arrays : cellArrays)
+    {
+      CopyPieceTuples(piece->GetCellData()->GetArray(arrays.first.c_str()), arrays.second,
+        cellOffset, nullptr);
+    }
+
+    cellOffset += pieceCells;
+    connectivityOffset += pieceConnectivitySize;
+    pointOffset += piece->GetNumberOfPoints();
+  }
+
+  vtkNew<vtkPoints> points;
+  points->SetData(pointsData);
+  vtkNew<vtkCellArray> outputCells;
+  outputCells->SetData(offsets.GetPointer(), connectivity.GetPointer());
+  ug->SetPoints(points);
+  ug->SetCells(types, outputCells);
+  if (mergePoints && first->GetPointData()->GetGlobalIds())
+  {
+    ug->GetPointData()->SetActiveGlobalIds(first->GetPointData()->GetGlobalIds()->GetName());
+  }
+  return ug;
+}
+
+inline std::vector<std::string> ParsePVTUPieces(const std::string& fileName)
+{
+  MappedFile file(fileName);
+  const std::string directory = vtksys::SystemTools::GetFilenamePath(fileName);
+  std::vector<std::string> pieces;
+  std::size_t position = 0;
+  XMLTag tag;
+  while (NextXMLTag(file.Data, file.Length, position, tag))
+  {
+    if (tag.Name == "Piece" && !tag.IsEndTag && !tag.Get("Source").empty())
+    {
+      const std::string source = tag.Get("Source");
+      pieces.push_back(vtksys::SystemTools::FileIsFullPath(source) || directory.empty()
+          ? source
+          : directory + "/" + source);
+    }
+  }
+  if (pieces.empty())
+  {
+    throw std::runtime_error("No pieces found in " + fileName);
+  }
+  return pieces;
+}
+} // namespace detail
+
+/// \brief Reads a .vtu or .pvtu file, decoding its data arrays and pieces concurrently.
+///
+/// The headers of all files are parsed first, so that every compressed block of every data
+/// array of every piece is a task of a single vtkSMPTools::For, decompressed directly into its
+/// array with a per-thread compressor. Raw appended data with zlib, LZ4, LZMA or no compression
+/// are decoded this way; files with other layouts are read with vtkXMLUnstructuredGridReader.
+/// The pieces are then appended into a single unstructured grid with 64-bit cell storage.
+inline vtkSmartPointer<vtkUnstructuredGrid> ReadUnstructuredGridParallel(
+  const std::string& fileName)
+{
+  const bool isPVTU = vtksys::SystemTools::GetFilenameLastExtension(fileName) == ".pvtu";
+  const std::vector<std::string> fileNames =
+    isPVTU ? detail::ParsePVTUPieces(fileName) : std::vector<std::string>{ fileName };
+
+  std::vector<detail::VTUFile> files(fileNames.size());
+  std::vector<detail::VTUDecodeTask> tasks;
+  for (std::size_t f = 0; f < fileNames.size(); ++f)
+  {
+    files[f] = detail::ParseVTUHeader(fileNames[f]);
+    if (!files[f].Supported)
+    {
+      continue;
+    }
+    for (detail::VTUPiece& piece : files[f].Pieces)
+    {
+      detail::PlanVTUDataArray(files[f], piece.NumberOfPoints, piece.Points, tasks);
+      detail::PlanVTUDataArray(files[f], -1, piece.Connectivity, tasks);
+      detail::PlanVTUDataArray(files[f], piece.NumberOfCells, piece.Offsets, tasks);
+      detail::PlanVTUDataArray(files[f], piece.NumberOfCells, piece.Types, tasks);
+      for (auto& array : piece.PointData)
+      {
+        detail::PlanVTUDataArray(files[f], piece.NumberOfPoints, array, tasks);
+      }
+      for (auto& array : piece.CellData)
+      {
+        detail::PlanVTUDataArray(files[f], piece.NumberOfCells, array, tasks);
+      }
+    }
+  }
+  detail::DecodeVTUTasks(tasks);
+
+  std::vector<vtkSmartPointer<vtkUnstructuredGrid>> pieces;
+  for (std::size_t f = 0; f < fileNames.size(); ++f)
+  {
+    if (files[f].Supported)
+    {
+      for (detail::VTUPiece& piece : files[f].Pieces)
+      {
+        pieces.push_back(detail::BuildVTUPiece(piece));
+      }
+    }
+    else
+    {
+      vtkNew<vtkXMLUnstructuredGridReader> reader;
+      reader->SetFileName(fileNames[f].c_str());
+      reader->Update();
+      pieces.emplace_back(reader->GetOutput());
+    }
+    // the decoded arrays do not reference the mapped file
+    files[f].File.reset();
+  }
+  return detail::AppendPieces(pieces);
+}
+
+#endif //_ParallelUnstructuredGridReader_h
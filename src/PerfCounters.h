@@ -0,0 +1,181 @@
+//============================================================================
+//  Copyright (c) Kitware, Inc.
+//  All rights reserved.
+//  See LICENSE.txt for details.
+//  This software is distributed WITHOUT ANY WARRANTY; without even
+//  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+//  PURPOSE.  See the above copyright notice for more information.
+//============================================================================
+#ifndef _PerfCounters_h
+#define _PerfCounters_h
+
+#include "MetricSink.h"
+#include "PhaseTimer.h"
+#include "YamlWriter.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/// \brief Hardware performance counters of the timed phases, read through perf_event_open.
+///
+/// The counters follow the calling thread and, because they are inherited, every thread it
+/// creates afterwards, so they must be created before the SMP backends start their worker
+/// threads. Counters that cannot be opened, e.g. because of perf_event_paranoid, missing
+/// hardware support, or a non-Linux system, are skipped. When the kernel multiplexes the
+/// counters, the counts of a phase are scaled by the fraction of the phase they ran.
+class PerfCounters : public PhaseObserver
+{
+public:
+  static constexpr int NumberOfEvents = 5;
+
+  PerfCounters()
+  {
+    this->Descriptors.fill(-1);
+#ifdef __linux__
+    const std::uint32_t types[NumberOfEvents] = { PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE,
+      PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE };
+    const std::uint64_t configs[NumberOfEvents] = { PERF_COUNT_HW_CPU_CYCLES,
+      PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES,
+      PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+        (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+      PERF_COUNT_HW_BRANCH_MISSES };
+    for (int event = 0; event < NumberOfEvents; ++event)
+    {
+      perf_event_attr attributes;
+      std::memset(&attributes, 0, sizeof(attributes));
+      attributes.size = sizeof(attributes);
+      attributes.type = types[event];
+      attributes.config = configs[event];
+      attributes.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+      attributes.inherit = 1;
+      attributes.exclude_kernel = 1;
+      attributes.exclude_hv = 1;
+      const long descriptor = syscall(SYS_perf_event_open, &attributes, 0, -1, -1, 0);
+      if (descriptor < 0)
+      {
+        this->Error = std::strerror(errno);
+        continue;
+      }
+      this->Descriptors[event] = static_cast<int>(descriptor);
+    }
+#else
+    this->Error = "perf_event_open is only available on Linux";
+#endif
+    AddPhaseObserver(this);
+  }
+
+  ~PerfCounters() override
+  {
+    RemovePhaseObserver(this);
+#ifdef __linux__
+    for (const int descriptor : this->Descriptors)
+    {
+      if (descriptor >= 0)
+      {
+        close(descriptor);
+      }
+    }
+#endif
+  }
+
+  PerfCounters(const PerfCounters&) = delete;
+  PerfCounters& operator=(const PerfCounters&) = delete;
+
+  /// Writes which counters are available, and why some are not.
+  void LogAvailability(YamlWriter& log) const
+  {
+    log.StartBlock("perf-counters");
+    for (int event = 0; event < NumberOfEvents; ++event)
+    {
+      log.AddDictionaryEntry(GetEventName(event),
+        this->Descriptors[event] >= 0 ? "available" : "unavailable");
+    }
+    if (!this->Error.empty())
+    {
+      log.AddDictionaryEntry("error", this->Error);
+    }
+    log.EndBlock();
+  }
+
+  void StartPhase() override { this->Running.push_back(this->Read()); }
+
+  void StopPhase() override
+  {
+    if (this->Running.empty())
+    {
+      return;
+    }
+    const Snapshot end = this->Read();
+    const Snapshot& start = this->Running.back();
+    for (int event = 0; event < NumberOfEvents; ++event)
+    {
+      const double running = static_cast<double>(end[event].Running - start[event].Running);
+      const double enabled = static_cast<double>(end[event].Enabled - start[event].Enabled);
+      const double value = static_cast<double>(end[event].Value - start[event].Value);
+      this->LastPhase[event] = running > 0.0 ? value * enabled / running : 0.0;
+    }
+    this->Running.pop_back();
+  }
+
+  void ReportPhase(MetricSink& metrics, const char* phase) override
+  {
+    for (int event = 0; event < NumberOfEvents; ++event)
+    {
+      if (this->Descriptors[event] >= 0)
+      {
+        metrics.AddCount(
+          GetEventName(event), phase, static_cast<std::int64_t>(this->LastPhase[event] + 0.5));
+      }
+    }
+  }
+
+  static const char* GetEventName(int event)
+  {
+    static const char* names[NumberOfEvents] = { "cycles", "instructions", "llc-misses",
+      "dtlb-misses", "branch-misses" };
+    return names[event];
+  }
+
+private:
+  struct Reading
+  {
+    std::uint64_t Value = 0;
+    std::uint64_t Enabled = 0;
+    std::uint64_t Running = 0;
+  };
+  using Snapshot = std::array<Reading, NumberOfEvents>;
+
+  Snapshot Read() const
+  {
+    Snapshot snapshot;
+#ifdef __linux__
+    for (int event = 0; event < NumberOfEvents; ++event)
+    {
+      if (this->Descriptors[event] >= 0 &&
+        read(this->Descriptors[event], &snapshot[event], sizeof(Reading)) != sizeof(Reading))
+      {
+        snapshot[event] = Reading();
+      }
+    }
+#endif
+    return snapshot;
+  }
+
+  std::array<int, NumberOfEvents> Descriptors;
+  std::array<double, NumberOfEvents> LastPhase{};
+  std::vector<Snapshot> Running;
+  std::string Error;
+};
+
+#endif //_PerfCounters_h
@@ -0,0 +1,182 @@
+//============================================================================
+//  Copyright (c) Kitware, Inc.
+//  All rights reserved.
+//  See LICENSE.txt for details.
+//  This software is distributed WITHOUT ANY WARRANTY; without even
+//  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+//  PURPOSE.  See the above copyright notice for more information.
+//============================================================================
+#ifndef _PhaseTimer_h
+#define _PhaseTimer_h
+
+#include <vtkm/cont/Timer.h>
+
+#include "MetricSink.h"
+#include "TraceRecorder.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+/// \brief Measures something about the timed phases of the algorithms besides their time.
+///
+/// Phases can be nested, so an observer keeps a stack of the measurements of the running
+/// phases. \c ReportPhase adds the measurements of the last stopped phase to a sink, so it must
+/// neither allocate nor write to a stream.
+class PhaseObserver
+{
+public:
+  virtual ~PhaseObserver() = default;
+  virtual void StartPhase() = 0;
+  virtual void StopPhase() = 0;
+  /// Adds the measurements of the last stopped phase, as metrics named <metric>-<phase>.
+  virtual void ReportPhase(MetricSink& metrics, const char* phase) = 0;
+};
+
+inline std::vector<PhaseObserver*>& GetPhaseObservers()
+{
+  static std::vector<PhaseObserver*> observers;
+  return observers;
+}
+
+inline void AddPhaseObserver(PhaseObserver* observer)
+{
+  GetPhaseObservers().push_back(observer);
+}
+
+inline void RemovePhaseObserver(PhaseObserver* observer)
+{
+  auto& observers = GetPhaseObservers();
+  observers.erase(std::remove(observers.begin(), observers.end(), observer), observers.end());
+}
+
+/// \brief A vtkm::cont::Timer that also starts and stops the registered phase observers.
+///
+/// The observers are started before and stopped after the timer, so that their overhead is not
+/// part of the measured time. When tracing is on, reported phases are also recorded as trace
+/// events of the calling thread. A phase that is still running when the timer is destroyed, e.g.
+/// because of an exception, is stopped to keep the observers balanced.
+class PhaseTimer
+{
+public:
+  PhaseTimer() = default;
+  PhaseTimer(const PhaseTimer&) = delete;
+  PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+  ~PhaseTimer()
+  {
+    if (this->Running)
+    {
+      this->Stop();
+    }
+  }
+
+  void Start()
+  {
+    if (this->Running)
+    {
+      this->Stop();
+    }
+    for (PhaseObserver* observer : GetPhaseObservers())
+    {
+      observer->StartPhase();
+    }
+    this->Running = true;
+    this->Recorder = TraceRecorder::GetInstance();
+    if (this->Recorder)
+    {
+      this->TraceBegin = this->Recorder->Now();
+    }
+    this->Timer.Start();
+  }
+
+  void Stop()
+  {
+    this->Timer.Stop();
+    if (this->Recorder)
+    {
+      this->TraceEnd = this->Recorder->Now();
+    }
+    this->Running = false;
+    const auto& observers = GetPhaseObservers();
+    for (auto observer = observers.rbegin(); observer != observers.rend(); ++observer)
+    {
+      (*observer)->StopPhase();
+    }
+  }
+
+  vtkm::Float64 GetElapsedTime() const { return this->Timer.GetElapsedTime(); }
+
+  /// Adds the elapsed time with the given seconds-<phase> key, followed by the measurements of
+  /// the observers for the phase. The key must outlive the sink, e.g. be a string literal.
+  void Report(MetricSink& metrics, const char* key) const
+  {
+    metrics.Add(key, this->GetElapsedTime());
+    const char* prefix = "seconds-";
+    const std::size_t prefixLength = std::strlen(prefix);
+    this->ReportObservers(
+      metrics, std::strncmp(key, prefix, prefixLength) == 0 ? key + prefixLength : key);
+  }
+
+  /// Adds only the measurements of the observers for the phase, which must outlive the sink.
+  void ReportObservers(MetricSink& metrics, const char* phase) const
+  {
+    if (this->Recorder)
+    {
+      this->Recorder->Record(phase, "phase", this->TraceBegin, this->TraceEnd);
+    }
+    for (PhaseObserver* observer : GetPhaseObservers())
+    {
+      observer->ReportPhase(metrics, phase);
+    }
+  }
+
+private:
+  vtkm::cont::Timer Timer;
+  bool Running = false;
+  TraceRecorder* Recorder = nullptr;
+  double TraceBegin = 0.0;
+  double TraceEnd = 0.0;
+};
+
+/// \brief Times a scope as a phase and reports it to a sink, if there is one.
+///
+/// Code that does not always run in the benchmark, like the VTK filters, takes an optional sink
+/// and times its phases with this, which does nothing without a sink.
+class ScopedPhaseTimer
+{
+public:
+  /// The key must outlive the sink, e.g. be a string literal.
+  ScopedPhaseTimer(MetricSink* metrics, const char* key)
+    : Metrics(metrics)
+    , Key(key)
+  {
+    if (this->Metrics)
+    {
+      this->Timer.Start();
+    }
+  }
+
+  ~ScopedPhaseTimer() { this->Stop(); }
+
+  ScopedPhaseTimer(const ScopedPhaseTimer&) = delete;
+  ScopedPhaseTimer& operator=(const ScopedPhaseTimer&) = delete;
+
+  /// Ends the phase before the end of the scope.
+  void Stop()
+  {
+    if (this->Metrics)
+    {
+      this->Timer.Stop();
+      this->Timer.Report(*this->Metrics, this->Key);
+      this->Metrics = nullptr;
+    }
+  }
+
+private:
+  MetricSink* Metrics;
+  const char* Key;
+  PhaseTimer Timer;
+};
+
+#endif //_PhaseTimer_h
@@ -0,0 +1,187 @@
+//============================================================================
+//  Copyright (c) Kitware, Inc.
+//  All rights reserved.
+//  See LICENSE.txt for details.
+//  This software is distributed WITHOUT ANY WARRANTY; without even
+//  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+//  PURPOSE.  See the above copyright notice for more information.
+//============================================================================
+#ifndef _PointUsageBits_h
+#define _PointUsageBits_h
+
+#include <vtkSMPTools.h>
+#include <vtkType.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace detail
+{
+inline int PopCount(std::uint64_t word)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_popcountll(word);
+#else
+  word = word - ((word >> 1) & 0x5555555555555555ULL);
+  word = (word & 0x3333333333333333ULL) + ((word >> 2) & 0x3333333333333333ULL);
+  word = (word + (word >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+  return static_cast<int>((word * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+// Index of the lowest set bit of a non-zero word.
+inline int CountTrailingZeros(std::uint64_t word)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_ctzll(word);
+#else
+  int count = 0;
+  while (!(word & 1))
+  {
+    word >>= 1;
+    ++count;
+  }
+  return count;
+#endif
+}
+}
+
+/// \brief Marks the input points used by an output with one bit per point.
+///
+/// Threads mark points concurrently while extracting the output cells. \c Scan then numbers the
+/// used points in input order, with a parallel prefix sum over the number of set bits of each
+/// word, after which the output id of a used point is the number of used points before it. This
+/// takes 2 bits per input point, the bit and the word offsets, instead of an id per input point,
+/// and the output ids are derived when needed instead of stored.
+class PointUsageBits
+{
+public:
+  using WordType = std::uint64_t;
+  static constexpr int BitsPerWord = 64;
+
+  explicit PointUsageBits(vtkIdType numberOfPoints)
+    : NumberOfWords((numberOfPoints + BitsPerWord - 1) / BitsPerWord)
+    , Words(new std::atomic<WordType>[NumberOfWords])
+  {
+    std::atomic<WordType>* words = this->Words.get();
+    vtkSMPTools::For(0, this->NumberOfWords,
+      [words](vtkIdType begin, vtkIdType end)
+      {
+        for (vtkIdType word = begin; word < end; ++word)
+        {
+          words[word].store(0, std::memory_order_relaxed);
+        }
+      });
+  }
+
+  /// Marks a point as used. Thread safe; the atomic update is skipped if the bit is set.
+  void Mark(vtkIdType pointId)
+  {
+    std::atomic<WordType>& word = this->Words[pointId / BitsPerWord];
+    const WordType bit = WordType(1) << (pointId % BitsPerWord);
+    if (!(word.load(std::memory_order_relaxed) & bit))
+    {
+      word.fetch_or(bit, std::memory_order_relaxed);
+    }
+  }
+
+  /// Numbers the used points and returns their number. Marking must be finished.
+  vtkIdType Scan()
+  {
+    // words per block of the prefix sum, so that the serial sum over the blocks is short
+    constexpr vtkIdType blockSize = 4096;
+    const vtkIdType numberOfBlocks = (this->NumberOfWords + blockSize - 1) / blockSize;
+    std::vector<vtkIdType> blockOffsets(numberOfBlocks + 1, 0);
+    this->WordOffsets.resize(this->NumberOfWords);
+
+    vtkSMPTools::For(0, numberOfBlocks,
+      [&](vtkIdType block, vtkIdType blockEnd)
+      {
+        for (; block < blockEnd; ++block)
+        {
+          const vtkIdType end = std::min((block + 1) * blockSize, this->NumberOfWords);
+          vtkIdType count = 0;
+          for (vtkIdType word = block * blockSize; word < end; ++word)
+          {
+            count += detail::PopCount(this->GetWord(word));
+          }
+          blockOffsets[block + 1] = count;
+        }
+      });
+    for (vtkIdType block = 0; block < numberOfBlocks; ++block)
+    {
+      blockOffsets[block + 1] += blockOffsets[block];
+    }
+    vtkSMPTools::For(0, numberOfBlocks,
+      [&](vtkIdType block, vtkIdType blockEnd)
+      {
+        for (; block < blockEnd; ++block)
+        {
+          const vtkIdType end = std::min((block + 1) * blockSize, this->NumberOfWords);
+          vtkIdType offset = blockOffsets[block];
+          for (vtkIdType word = block * blockSize; word < end; ++word)
+          {
+            this->WordOffsets[word] = offset;
+            offset += detail::PopCount(this->GetWord(word));
+          }
+        }
+      });
+    return blockOffsets[numberOfBlocks];
+  }
+
+  /// The output id of a used point. Only valid after \c Scan.
+  vtkIdType GetOutputId(vtkIdType pointId) const
+  {
+    const vtkIdType word = pointId / BitsPerWord;
+    const WordType below = (WordType(1) << (pointId % BitsPerWord)) - 1;
+    return this->WordOffsets[word] + detail::PopCount(this->GetWord(word) & below);
+  }
+
+  /// Calls function(inputId, outputId) for the used points in [begin, end), in input order.
+  /// Only valid after \c Scan.
+  template <typename Function>
+  void ForEachUsed(vtkIdType begin, vtkIdType end, Function&& function) const
+  {
+    if (begin >= end)
+    {
+      return;
+    }
+    const vtkIdType lastWord = (end - 1) / BitsPerWord;
+    for (vtkIdType word = begin / BitsPerWord; word <= lastWord; ++word)
+    {
+      WordType bits = this->GetWord(word);
+      vtkIdType outputId = this->WordOffsets[word];
+      const vtkIdType first = word * BitsPerWord;
+      if (first < begin)
+      {
+        const WordType below = (WordType(1) << (begin - first)) - 1;
+        outputId += detail::PopCount(bits & below);
+        bits &= ~below;
+      }
+      if (end - first < BitsPerWord)
+      {
+        bits &= (WordType(1) << (end - first)) - 1;
+      }
+      while (bits)
+      {
+        function(first + detail::CountTrailingZeros(bits), outputId++);
+        bits &= bits - 1;
+      }
+    }
+  }
+
+private:
+  WordType GetWord(vtkIdType word) const
+  {
+    return this->Words[word].load(std::memory_order_relaxed);
+  }
+
+  vtkIdType NumberOfWords;
+  std::unique_ptr<std::atomic<WordType>[]> Words;
+  std::vector<vtkIdType> WordOffsets;
+};
+
+#endif //_PointUsageBits_h
@@ -0,0 +1,68 @@
+//============================================================================
+//  Copyright (c) Kitware, Inc.
+//  All rights reserved.
+//  See LICENSE.txt for details.
+//  This software is distributed WITHOUT ANY WARRANTY; without even
+//  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+//  PURPOSE.  See the above copyright notice for more information.
+//============================================================================
+#ifndef _ScopedThreadLimit_h
+#define _ScopedThreadLimit_h
+
+#include <vtkm/List.h>
+#include <vtkm/cont/DeviceAdapterList.h>
+#include <vtkm/cont/RuntimeDeviceTracker.h>
+#include <vtkm/internal/Configure.h>
+
+#include <vtkSMPTools.h>
+
+#if defined(VTKM_ENABLE_TBB) && __has_include(<tbb/global_control.h>)
+#define EFL_HAS_TBB_GLOBAL_CONTROL
+#include <tbb/global_control.h>
+#endif
+
+#include <cstddef>
+#include <utility>
+
+/// \brief Runs a function with at most the given number of threads.
+///
+/// The VTK SMP tools are limited through a vtkSMPTools::LocalScope. When VTK-m has the TBB
+/// device, a tbb::global_control also limits TBB, which is the minimum over all the active
+/// controls, so it applies to the TBB backends of both VTK and VTK-m, whose own controls are
+/// created by their initialization with the maximum number of threads. Other VTK-m devices keep
+/// the number of threads they were initialized with.
+template <typename Function>
+void RunWithThreadLimit(int numberOfThreads, Function&& function)
+{
+#ifdef EFL_HAS_TBB_GLOBAL_CONTROL
+  tbb::global_control limit(
+    tbb::global_control::max_allowed_parallelism, static_cast<std::size_t>(numberOfThreads));
+#endif
+  vtkSMPTools::LocalScope(
+    vtkSMPTools::Config(numberOfThreads), std::forward<Function>(function));
+}
+
+/// Whether \c RunWithThreadLimit also limits the VTK-m algorithms, which is the case when they
+/// run on the TBB device. They run on the first device of the default list that the runtime
+/// device tracker allows, as in vtkm::cont::TryExecute.
+inline bool ThreadLimitAppliesToVTKm()
+{
+#ifdef EFL_HAS_TBB_GLOBAL_CONTROL
+  const vtkm::cont::RuntimeDeviceTracker& tracker = vtkm::cont::GetRuntimeDeviceTracker();
+  vtkm::cont::DeviceAdapterId activeDevice = vtkm::cont::DeviceAdapterTagUndefined{};
+  vtkm::ListForEach(
+    [&](auto device)
+    {
+      if (activeDevice == vtkm::cont::DeviceAdapterTagUndefined{} && tracker.CanRunOn(device))
+      {
+        activeDevice = device;
+      }
+    },
+    VTKM_DEFAULT_DEVICE_ADAPTER_LIST{});
+  return activeDevice == vtkm::cont::DeviceAdapterTagTBB{};
+#else
+  return false;
+#endif
+}
+
+#endif //_ScopedThreadLimit_h
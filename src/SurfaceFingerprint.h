@@ -0,0 +1,260 @@
+//============================================================================
+//  Copyright (c) Kitware, Inc.
+//  All rights reserved.
+//  See LICENSE.txt for details.
+//  This software is distributed WITHOUT ANY WARRANTY; without even
+//  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+//  PURPOSE.  See the above copyright notice for more information.
+//============================================================================
+#ifndef _SurfaceFingerprint_h
+#define _SurfaceFingerprint_h
+
+#include <vtkm/Types.h>
+#include <vtkm/cont/ArrayHandle.h>
+#include <vtkm/cont/CellSetExplicit.h>
+
+#include <vtkCellArray.h>
+#include <vtkCellData.h>
+#include <vtkIdList.h>
+#include <vtkIdTypeArray.h>
+#include <vtkPointData.h>
+#include <vtkPolyData.h>
+#include <vtkSMPThreadLocal.h>
+#include <vtkSMPThreadLocalObject.h>
+#include <vtkSMPTools.h>
+#include <vtkSmartPointer.h>
+#include <vtkUnstructuredGrid.h>
+
+#include <algorithm>
+#include <cstddef>
+#include <iomanip>
+#include <numeric>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/// \brief Order-independent fingerprint of the faces of a surface.
+///
+/// Every face is hashed from its sorted input point ids and the id of the input cell it
+/// originates from, and the hashes are combined with a sum and a xor, which are commutative,
+/// so the fingerprint does not depend on the order of the faces, their first point or their
+/// orientation, or on the numbering of the output points. A fingerprint is invalid when the
+/// ids of the surface do not allow computing it, e.g. a map of its faces to their input cells
+/// of the wrong length, and then matches no other fingerprint.
+struct SurfaceFingerprint
+{
+  vtkm::UInt64 Sum = 0;
+  vtkm::UInt64 Xor = 0;
+  vtkm::Id NumberOfFaces = 0;
+  bool Valid = true;
+
+  static SurfaceFingerprint Invalid()
+  {
+    SurfaceFingerprint fingerprint;
+    fingerprint.Valid = false;
+    return fingerprint;
+  }
+
+  bool operator==(const SurfaceFingerprint& other) const
+  {
+    return this->Valid && other.Valid && this->Sum == other.Sum && this->Xor == other.Xor &&
+      this->NumberOfFaces == other.NumberOfFaces;
+  }
+  bool operator!=(const SurfaceFingerprint& other) const { return !(*this == other); }
+
+  void Combine(const SurfaceFingerprint& other)
+  {
+    this->Sum += other.Sum;
+    this->Xor ^= other.Xor;
+    this->NumberOfFaces += other.NumberOfFaces;
+    this->Valid = this->Valid && other.Valid;
+  }
+
+  std::string ToString() const
+  {
+    if (!this->Valid)
+    {
+      return "invalid";
+    }
+    std::ostringstream stream;
+    stream << std::hex << std::setfill('0') << std::setw(16) << this->Sum << std::setw(16)
+           << this->Xor;
+    return stream.str();
+  }
+};
+
+namespace detail
+{
+// The finalizer of splitmix64.
+inline vtkm::UInt64 MixFingerprintHash(vtkm::UInt64 value)
+{
+  value ^= value >> 30;
+  value *= 0xbf58476d1ce4e5b9ULL;
+  value ^= value >> 27;
+  value *= 0x94d049bb133111ebULL;
+  value ^= value >> 31;
+  return value;
+}
+
+// Adds a face, given by its unsorted input point ids, which are sorted in place.
+template <typename IdType>
+inline void AddFingerprintFace(
+  SurfaceFingerprint& fingerprint, std::vector<IdType>& pointIds, vtkm::Id cellId)
+{
+  std::sort(pointIds.begin(), pointIds.end());
+  vtkm::UInt64 hash = MixFingerprintHash(static_cast<vtkm::UInt64>(pointIds.size()));
+  for (const IdType pointId : pointIds)
+  {
+    hash = MixFingerprintHash(hash + static_cast<vtkm::UInt64>(pointId) + 0x9e3779b97f4a7c15ULL);
+  }
+  hash = MixFingerprintHash(hash ^ MixFingerprintHash(static_cast<vtkm::UInt64>(cellId)));
+  fingerprint.Sum += hash;
+  fingerprint.Xor ^= hash;
+  ++fingerprint.NumberOfFaces;
+}
+
+inline SurfaceFingerprint ReduceFingerprints(vtkSMPThreadLocal<SurfaceFingerprint>& partials)
+{
+  SurfaceFingerprint fingerprint;
+  for (const SurfaceFingerprint& partial : partials)
+  {
+    fingerprint.Combine(partial);
+  }
+  return fingerprint;
+}
+}
+
+/// \brief Attaches the ids of the input points and cells to an unstructured grid while in scope.
+///
+/// The VTK filters copy the point and cell data to their output, so these arrays give the input
+/// ids of the output points and faces, which the fingerprint of a vtkPolyData needs.
+class ScopedFingerprintIds
+{
+public:
+  static constexpr const char* PointIdsName = "FingerprintPointIds";
+  static constexpr const char* CellIdsName = "FingerprintCellIds";
+
+  explicit ScopedFingerprintIds(vtkUnstructuredGrid* ug)
+    : DataSet(ug)
+  {
+    ug->GetPointData()->AddArray(MakeIds(PointIdsName, ug->GetNumberOfPoints()));
+    ug->GetCellData()->AddArray(MakeIds(CellIdsName, ug->GetNumberOfCells()));
+  }
+
+  ~ScopedFingerprintIds()
+  {
+    this->DataSet->GetPointData()->RemoveArray(PointIdsName);
+    this->DataSet->GetCellData()->RemoveArray(CellIdsName);
+  }
+
+  ScopedFingerprintIds(const ScopedFingerprintIds&) = delete;
+  ScopedFingerprintIds& operator=(const ScopedFingerprintIds&) = delete;
+
+private:
+  static vtkSmartPointer<vtkIdTypeArray> MakeIds(const char* name, vtkIdType count)
+  {
+    auto ids = vtkSmartPointer<vtkIdTypeArray>::New();
+    ids->SetName(name);
+    ids->SetNumberOfValues(count);
+    vtkIdType* values = ids->GetPointer(0);
+    vtkSMPTools::For(0, count,
+      [values](vtkIdType begin, vtkIdType end) { std::iota(values + begin, values + end, begin); });
+    return ids;
+  }
+
+  vtkUnstructuredGrid* DataSet;
+};
+
+/// Computes the fingerprint of the output of a VTK filter that ran within a
+/// ScopedFingerprintIds of its input. Returns an invalid fingerprint without the id arrays.
+inline SurfaceFingerprint ComputeSurfaceFingerprint(vtkPolyData* surface)
+{
+  auto pointIds = vtkIdTypeArray::SafeDownCast(
+    surface->GetPointData()->GetArray(ScopedFingerprintIds::PointIdsName));
+  auto cellIds = vtkIdTypeArray::SafeDownCast(
+    surface->GetCellData()->GetArray(ScopedFingerprintIds::CellIdsName));
+  if (!pointIds || !cellIds)
+  {
+    return SurfaceFingerprint::Invalid();
+  }
+  const vtkIdType* inputPointIds = pointIds->GetPointer(0);
+  const vtkIdType* inputCellIds = cellIds->GetPointer(0);
+
+  vtkSMPThreadLocal<SurfaceFingerprint> partials;
+  vtkSMPThreadLocal<std::vector<vtkIdType>> tlFacePointIds;
+  vtkSMPThreadLocalObject<vtkIdList> tlCellPointIds;
+  // the cells of a vtkPolyData are numbered through its verts, lines, polys and strips
+  vtkIdType cellIdOffset = 0;
+  for (vtkCellArray* cells :
+    { surface->GetVerts(), surface->GetLines(), surface->GetPolys(), surface->GetStrips() })
+  {
+    if (!cells)
+    {
+      continue;
+    }
+    vtkSMPTools::For(0, cells->GetNumberOfCells(),
+      [&](vtkIdType begin, vtkIdType end)
+      {
+        SurfaceFingerprint& partial = partials.Local();
+        std::vector<vtkIdType>& facePointIds = tlFacePointIds.Local();
+        vtkIdList* cellPointIds = tlCellPointIds.Local();
+        for (vtkIdType cellId = begin; cellId < end; ++cellId)
+        {
+          vtkIdType numberOfPoints;
+          const vtkIdType* points;
+          cells->GetCellAtId(cellId, numberOfPoints, points, cellPointIds);
+          facePointIds.resize(numberOfPoints);
+          for (vtkIdType i = 0; i < numberOfPoints; ++i)
+          {
+            facePointIds[i] = inputPointIds[points[i]];
+          }
+          detail::AddFingerprintFace(
+            partial, facePointIds, inputCellIds[cellIdOffset + cellId]);
+        }
+      });
+    cellIdOffset += cells->GetNumberOfCells();
+  }
+  return detail::ReduceFingerprints(partials);
+}
+
+/// Computes the fingerprint of the output of a DP-Hash-* worklet, whose connectivity uses the
+/// input point ids, from the map of its faces to their input cells. Returns an invalid
+/// fingerprint if the map does not have one input cell per face.
+inline SurfaceFingerprint ComputeSurfaceFingerprint(
+  const vtkm::cont::CellSetExplicit<>& faces, const vtkm::cont::ArrayHandle<vtkm::Id>& cellIdMap)
+{
+  const auto connectivity =
+    faces.GetConnectivityArray(vtkm::TopologyElementTagCell(), vtkm::TopologyElementTagPoint())
+      .ReadPortal();
+  const auto offsets =
+    faces.GetOffsetsArray(vtkm::TopologyElementTagCell(), vtkm::TopologyElementTagPoint())
+      .ReadPortal();
+  const auto inputCellIds = cellIdMap.ReadPortal();
+  const vtkm::Id numberOfFaces = faces.GetNumberOfCells();
+  if (inputCellIds.GetNumberOfValues() != numberOfFaces)
+  {
+    return SurfaceFingerprint::Invalid();
+  }
+
+  vtkSMPThreadLocal<SurfaceFingerprint> partials;
+  vtkSMPThreadLocal<std::vector<vtkm::Id>> tlFacePointIds;
+  vtkSMPTools::For(0, numberOfFaces,
+    [&](vtkm::Id begin, vtkm::Id end)
+    {
+      SurfaceFingerprint& partial = partials.Local();
+      std::vector<vtkm::Id>& facePointIds = tlFacePointIds.Local();
+      for (vtkm::Id faceId = begin; faceId < end; ++faceId)
+      {
+        const vtkm::Id first = offsets.Get(faceId);
+        facePointIds.resize(static_cast<std::size_t>(offsets.Get(faceId + 1) - first));
+        for (std::size_t i = 0; i < facePointIds.size(); ++i)
+        {
+          facePointIds[i] = connectivity.Get(first + static_cast<vtkm::Id>(i));
+        }
+        detail::AddFingerprintFace(partial, facePointIds, inputCellIds.Get(faceId));
+      }
+    });
+  return detail::ReduceFingerprints(partials);
+}
+
+#endif //_SurfaceFingerprint_h
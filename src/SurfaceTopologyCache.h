@@ -0,0 +1,80 @@
+//============================================================================
+//  Copyright (c) Kitware, Inc.
+//  All rights reserved.
+//  See LICENSE.txt for details.
+//  This software is distributed WITHOUT ANY WARRANTY; without even
+//  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+//  PURPOSE.  See the above copyright notice for more information.
+//============================================================================
+#ifndef _SurfaceTopologyCache_h
+#define _SurfaceTopologyCache_h
+
+#include <vtkCellArray.h>
+#include <vtkIdTypeArray.h>
+#include <vtkPolyData.h>
+#include <vtkSmartPointer.h>
+#include <vtkType.h>
+
+#include <vector>
+
+/// \brief The topology of the surface that a geometry filter extracted, reused by its later
+/// executions on the same cells.
+///
+/// The faces of the surface only depend on the cells of the input, its ghost arrays, cell mask
+/// and regions, and the settings of the filter, so when only the points and the attributes of
+/// the input change, e.g. over the time steps of a simulation, the cells of the output are
+/// kept and only the output points and attributes are gathered again, through the input id of
+/// every output point and cell. The key holds the modification times and settings that the
+/// topology depends on, so a change of any of them extracts the surface again.
+///
+/// The cell arrays are shared with the outputs, which must not modify them.
+class SurfaceTopologyCache
+{
+public:
+  /// Whether the topology was stored for the key.
+  bool Matches(const std::vector<vtkMTimeType>& key) const
+  {
+    return this->Valid && key == this->Key;
+  }
+
+  /// Stores the cells of the output for the key. pointIds is nullptr when the output points
+  /// are the input points, and regionIdPairs without regions.
+  void Store(const std::vector<vtkMTimeType>& key, vtkPolyData* output, vtkIdTypeArray* pointIds,
+    vtkIdTypeArray* cellIds, vtkIdTypeArray* regionIdPairs)
+  {
+    this->Valid = true;
+    this->Key = key;
+    this->Verts = output->GetVerts();
+    this->Lines = output->GetLines();
+    this->Polys = output->GetPolys();
+    this->Strips = output->GetStrips();
+    this->PointIds = pointIds;
+    this->CellIds = cellIds;
+    this->RegionIdPairs = regionIdPairs;
+  }
+
+  /// Forgets the stored topology.
+  void Clear()
+  {
+    this->Valid = false;
+    this->Key.clear();
+    this->Verts = this->Lines = this->Polys = this->Strips = nullptr;
+    this->PointIds = this->CellIds = this->RegionIdPairs = nullptr;
+  }
+
+  vtkSmartPointer<vtkCellArray> Verts;
+  vtkSmartPointer<vtkCellArray> Lines;
+  vtkSmartPointer<vtkCellArray> Polys;
+  vtkSmartPointer<vtkCellArray> Strips;
+  // the input id of every output point, or nullptr without merging, and of every output cell
+  vtkSmartPointer<vtkIdTypeArray> PointIds;
+  vtkSmartPointer<vtkIdTypeArray> CellIds;
+  // the region id pairs of the output cells, or nullptr without regions
+  vtkSmartPointer<vtkIdTypeArray> RegionIdPairs;
+
+private:
+  bool Valid = false;
+  std::vector<vtkMTimeType> Key;
+};
+
+#endif //_SurfaceTopologyCache_h
@@ -0,0 +1,302 @@
+//============================================================================
+//  Copyright (c) Kitware, Inc.
+//  All rights reserved.
+//  See LICENSE.txt for details.
+//  This software is distributed WITHOUT ANY WARRANTY; without even
+//  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+//  PURPOSE.  See the above copyright notice for more information.
+//============================================================================
+#ifndef _TopologyPermutation_h
+#define _TopologyPermutation_h
+
+#include <vtkAbstractArray.h>
+#include <vtkCellArray.h>
+#include <vtkCellData.h>
+#include <vtkDataArray.h>
+#include <vtkPointData.h>
+#include <vtkPoints.h>
+#include <vtkSMPTools.h>
+#include <vtkSmartPointer.h>
+#include <vtkType.h>
+#include <vtkTypeInt64Array.h>
+#include <vtkUnsignedCharArray.h>
+#include <vtkUnstructuredGrid.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+/// Which entities of a dataset are permuted.
+enum class PermutationTarget
+{
+  Points,
+  Cells,
+  Both
+};
+
+namespace detail
+{
+inline std::uint64_t SplitMix64(std::uint64_t x)
+{
+  x += 0x9E3779B97F4A7C15ull;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+  return x ^ (x >> 31);
+}
+
+// Writes the exclusive scan of input to output[0, n], in parallel over chunks.
+inline void ExclusiveScan(const vtkTypeInt64* input, vtkIdType n, vtkTypeInt64* output)
+{
+  const vtkIdType numberOfChunks = std::max<vtkIdType>(1,
+    std::min<vtkIdType>(n / 65536, 4 * vtkSMPTools::GetEstimatedNumberOfThreads()));
+  const vtkIdType chunkSize = (n + numberOfChunks - 1) / numberOfChunks;
+  std::vector<vtkTypeInt64> chunkSums(numberOfChunks + 1, 0);
+  vtkSMPTools::For(0, numberOfChunks, 1,
+    [&](vtkIdType begin, vtkIdType end)
+    {
+      for (vtkIdType chunk = begin; chunk < end; ++chunk)
+      {
+        const vtkIdType last = std::min(n, (chunk + 1) * chunkSize);
+        chunkSums[chunk + 1] =
+          std::accumulate(input + chunk * chunkSize, input + last, vtkTypeInt64(0));
+      }
+    });
+  std::partial_sum(chunkSums.begin(), chunkSums.end(), chunkSums.begin());
+  vtkSMPTools::For(0, numberOfChunks, 1,
+    [&](vtkIdType begin, vtkIdType end)
+    {
+      for (vtkIdType chunk = begin; chunk < end; ++chunk)
+      {
+        vtkTypeInt64 sum = chunkSums[chunk];
+        const vtkIdType last = std::min(n, (chunk + 1) * chunkSize);
+        for (vtkIdType i = chunk * chunkSize; i < last; ++i)
+        {
+          output[i] = sum;
+          sum += input[i];
+        }
+      }
+    });
+  output[n] = chunkSums[numberOfChunks];
+}
+
+// Moves tuple i of source to tuple map[i] of a new array. The tuples of arrays of whole bytes
+// are copied in parallel; the ones of bit, string and variant arrays are set one by one.
+template <typename ArrayType>
+inline vtkSmartPointer<ArrayType> ScatterTuples(ArrayType* source, const vtkIdType* map)
+{
+  auto destination = vtk::TakeSmartPointer(source->NewInstance());
+  destination->SetName(source->GetName());
+  destination->SetNumberOfComponents(source->GetNumberOfComponents());
+  destination->SetNumberOfTuples(source->GetNumberOfTuples());
+  if (!vtkDataArray::SafeDownCast(source) || source->GetDataType() == VTK_BIT ||
+    source->GetDataTypeSize() <= 0)
+  {
+    for (vtkIdType i = 0; i < source->GetNumberOfTuples(); ++i)
+    {
+      destination->SetTuple(map[i], i, source);
+    }
+    return destination;
+  }
+  const std::size_t tupleSize =
+    static_cast<std::size_t>(source->GetNumberOfComponents() * source->GetDataTypeSize());
+  auto input = static_cast<const unsigned char*>(source->GetVoidPointer(0));
+  auto output = static_cast<unsigned char*>(destination->GetVoidPointer(0));
+  vtkSMPTools::For(0, source->GetNumberOfTuples(),
+    [&](vtkIdType begin, vtkIdType end)
+    {
+      for (vtkIdType i = begin; i < end; ++i)
+      {
+        std::memcpy(output + map[i] * tupleSize, input + i * tupleSize, tupleSize);
+      }
+    });
+  return destination;
+}
+
+// Scatters every array of source to destination, keeping the attribute roles, e.g. the global
+// ids, of the arrays.
+inline void ScatterAttributes(
+  vtkDataSetAttributes* source, vtkDataSetAttributes* destination, const vtkIdType* map)
+{
+  for (int a = 0; a < source->GetNumberOfArrays(); ++a)
+  {
+    vtkAbstractArray* array = source->GetAbstractArray(a);
+    if (!array)
+    {
+      continue;
+    }
+    auto scattered = ScatterTuples(array, map);
+    const int attribute = source->IsArrayAnAttribute(a);
+    if (attribute >= 0)
+    {
+      destination->SetAttribute(scattered, attribute);
+    }
+    else
+    {
+      destination->AddArray(scattered);
+    }
+  }
+}
+} // namespace detail
+
+/// \brief Builds a random permutation of [0, n), where element i moves to permutation[i].
+///
+/// If window is 0 or at least n, the permutation is uniformly random. It is built by sorting
+/// the indices by a counter-based random key in parallel, so that it does not depend on the
+/// number of threads. Otherwise, the indices are shuffled independently inside consecutive
+/// windows of the given size, so that no element moves farther than the window. This allows
+/// controlling how much of the original locality is kept.
+inline std::vector<vtkIdType> MakeRandomPermutation(
+  vtkIdType n, vtkIdType window, std::uint64_t seed)
+{
+  std::vector<vtkIdType> permutation(n);
+  const std::uint64_t seedKey = detail::SplitMix64(seed);
+  if (window <= 0 || window >= n)
+  {
+    std::vector<std::pair<std::uint64_t, vtkIdType>> keys(n);
+    vtkSMPTools::For(0, n,
+      [&](vtkIdType begin, vtkIdType end)
+      {
+        for (vtkIdType i = begin; i < end; ++i)
+        {
+          keys[i] = { detail::SplitMix64(seedKey + static_cast<std::uint64_t>(i)), i };
+        }
+      });
+    vtkSMPTools::Sort(keys.begin(), keys.end());
+    vtkSMPTools::For(0, n,
+      [&](vtkIdType begin, vtkIdType end)
+      {
+        for (vtkIdType i = begin; i < end; ++i)
+        {
+          permutation[keys[i].second] = i;
+        }
+      });
+    return permutation;
+  }
+
+  const vtkIdType numberOfWindows = (n + window - 1) / window;
+  vtkSMPTools::For(0, numberOfWindows,
+    [&](vtkIdType begin, vtkIdType end)
+    {
+      for (vtkIdType w = begin; w < end; ++w)
+      {
+        auto first = permutation.begin() + w * window;
+        auto last = permutation.begin() + std::min(n, (w + 1) * window);
+        std::iota(first, last, w * window);
+        std::mt19937_64 randomEngine(
+          detail::SplitMix64(seedKey + static_cast<std::uint64_t>(w)));
+        std::shuffle(first, last, randomEngine);
+      }
+    });
+  return permutation;
+}
+
+/// \brief Randomly permutes the points and/or cells of an unstructured grid.
+///
+/// Point i of the input becomes point pointMap[i] of the output, and cell i becomes cell
+/// cellMap[i], where the maps are built with \c MakeRandomPermutation. The coordinates and all
+/// point and cell data arrays follow their points and cells. The connectivity is gathered
+/// directly from the 64-bit cell array. When only the points are permuted, it is rewritten in
+/// place, so the input cell array is modified and shared by the output.
+inline vtkSmartPointer<vtkUnstructuredGrid> PermuteDataSet(
+  vtkUnstructuredGrid* ug, PermutationTarget target, vtkIdType window, std::uint32_t seed)
+{
+  const vtkIdType numberOfPoints = ug->GetNumberOfPoints();
+  const vtkIdType numberOfCells = ug->GetNumberOfCells();
+  vtkCellArray* cells = ug->GetCells();
+  cells->ConvertTo64BitStorage();
+
+  std::vector<vtkIdType> pointMap;
+  std::vector<vtkIdType> cellMap;
+  if (target != PermutationTarget::Cells)
+  {
+    pointMap = MakeRandomPermutation(numberOfPoints, window, seed);
+  }
+  if (target != PermutationTarget::Points)
+  {
+    cellMap = MakeRandomPermutation(numberOfCells, window, detail::SplitMix64(~seed));
+  }
+  const vtkIdType* points = pointMap.empty() ? nullptr : pointMap.data();
+
+  auto result = vtkSmartPointer<vtkUnstructuredGrid>::New();
+  if (points)
+  {
+    vtkNew<vtkPoints> permutedPoints;
+    permutedPoints->SetData(detail::ScatterTuples(ug->GetPoints()->GetData(), points));
+    result->SetPoints(permutedPoints);
+    detail::ScatterAttributes(ug->GetPointData(), result->GetPointData(), points);
+  }
+  else
+  {
+    result->SetPoints(ug->GetPoints());
+    result->GetPointData()->PassData(ug->GetPointData());
+  }
+
+  vtkTypeInt64* connectivity = cells->GetConnectivityArray64()->GetPointer(0);
+  const vtkTypeInt64* offsets = cells->GetOffsetsArray64()->GetPointer(0);
+  if (cellMap.empty())
+  {
+    vtkSMPTools::For(0, cells->GetNumberOfConnectivityIds(),
+      [&](vtkIdType begin, vtkIdType end)
+      {
+        for (vtkIdType i = begin; i < end; ++i)
+        {
+          connectivity[i] = points[connectivity[i]];
+        }
+      });
+    cells->GetConnectivityArray()->Modified();
+    cells->Modified();
+    result->SetCells(ug->GetCellTypesArray(), cells);
+    result->GetCellData()->PassData(ug->GetCellData());
+    return result;
+  }
+
+  // offsets of the permuted cells from the sizes of the cells at their new position
+  std::vector<vtkTypeInt64> cellSizes(numberOfCells);
+  vtkSMPTools::For(0, numberOfCells,
+    [&](vtkIdType begin, vtkIdType end)
+    {
+      for (vtkIdType cellId = begin; cellId < end; ++cellId)
+      {
+        cellSizes[cellMap[cellId]] = offsets[cellId + 1] - offsets[cellId];
+      }
+    });
+  vtkNew<vtkTypeInt64Array> permutedOffsets;
+  permutedOffsets->SetNumberOfValues(numberOfCells + 1);
+  vtkTypeInt64* newOffsets = permutedOffsets->GetPointer(0);
+  detail::ExclusiveScan(cellSizes.data(), numberOfCells, newOffsets);
+
+  vtkNew<vtkTypeInt64Array> permutedConnectivity;
+  permutedConnectivity->SetNumberOfValues(cells->GetNumberOfConnectivityIds());
+  vtkTypeInt64* newConnectivity = permutedConnectivity->GetPointer(0);
+  vtkNew<vtkUnsignedCharArray> permutedTypes;
+  permutedTypes->SetNumberOfValues(numberOfCells);
+  const unsigned char* types = ug->GetCellTypesArray()->GetPointer(0);
+  unsigned char* newTypes = permutedTypes->GetPointer(0);
+  vtkSMPTools::For(0, numberOfCells,
+    [&](vtkIdType begin, vtkIdType end)
+    {
+      for (vtkIdType cellId = begin; cellId < end; ++cellId)
+      {
+        const vtkIdType newCellId = cellMap[cellId];
+        vtkTypeInt64* output = newConnectivity + newOffsets[newCellId];
+        for (vtkTypeInt64 i = offsets[cellId]; i < offsets[cellId + 1]; ++i)
+        {
+          *output++ = points ? points[connectivity[i]] : connectivity[i];
+        }
+        newTypes[newCellId] = types[cellId];
+      }
+    });
+
+  vtkNew<vtkCellArray> permutedCells;
+  permutedCells->SetData(permutedOffsets.GetPointer(), permutedConnectivity.GetPointer());
+  result->SetCells(permutedTypes, permutedCells);
+  detail::ScatterAttributes(ug->GetCellData(), result->GetCellData(), cellMap.data());
+  return result;
+}
+
+#endif //_TopologyPermutation_h
@@ -0,0 +1,202 @@
+//============================================================================
+//  Copyright (c) Kitware, Inc.
+//  All rights reserved.
+//  See LICENSE.txt for details.
+//  This software is distributed WITHOUT ANY WARRANTY; without even
+//  the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR
+//  PURPOSE.  See the above copyright notice for more information.
+//============================================================================
+#ifndef _TraceRecorder_h
+#define _TraceRecorder_h
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace detail
+{
+struct TraceEvent
+{
+  const char* Name;
+  const char* Category;
+  double Begin;
+  double End;
+};
+
+struct TraceThreadBuffer
+{
+  int ThreadIndex = 0;
+  std::vector<TraceEvent> Events;
+};
+}
+
+/// \brief Records begin and end times of the algorithm phases and of per-thread chunks of work,
+/// and writes them as a Chrome trace, which chrome://tracing and Perfetto display as a timeline.
+///
+/// Events are appended to a buffer of the recording thread, so recording takes no lock after the
+/// first event of a thread. Event names must outlive the recorder, so dynamic names are interned
+/// with \c Intern. Only one recorder can be active at a time; without one, \c TraceScope does
+/// nothing but an atomic load.
+class TraceRecorder
+{
+public:
+  TraceRecorder()
+    : Origin(std::chrono::steady_clock::now())
+  {
+    GetActive().store(this);
+    // the creating thread is the first one, which is named main
+    this->GetThreadBuffer();
+  }
+
+  ~TraceRecorder() { GetActive().store(nullptr); }
+
+  TraceRecorder(const TraceRecorder&) = delete;
+  TraceRecorder& operator=(const TraceRecorder&) = delete;
+
+  /// The active recorder, or nullptr if tracing is off.
+  static TraceRecorder* GetInstance() { return GetActive().load(std::memory_order_relaxed); }
+
+  /// Microseconds since the recorder was created.
+  double Now() const
+  {
+    const auto elapsed = std::chrono::steady_clock::now() - this->Origin;
+    return std::chrono::duration<double, std::micro>(elapsed).count();
+  }
+
+  /// Returns a copy of the name that lives as long as the recorder.
+  const char* Intern(const std::string& name)
+  {
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    for (const std::string& interned : this->Names)
+    {
+      if (interned == name)
+      {
+        return interned.c_str();
+      }
+    }
+    this->Names.push_back(name);
+    return this->Names.back().c_str();
+  }
+
+  void Record(const char* name, const char* category, double begin, double end)
+  {
+    this->GetThreadBuffer().Events.push_back(detail::TraceEvent{ name, category, begin, end });
+  }
+
+  /// Writes the events in the Chrome trace event format. Returns false if the file cannot be
+  /// written.
+  bool Write(const std::string& filename)
+  {
+    std::ofstream file(filename);
+    if (!file)
+    {
+      return false;
+    }
+    std::lock_guard<std::mutex> lock(this->Mutex);
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    char buffer[64];
+    for (const auto& thread : this->Threads)
+    {
+      file << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":"
+           << thread->ThreadIndex << ",\"args\":{\"name\":\""
+           << (thread->ThreadIndex == 0 ? "main" : "worker " + std::to_string(thread->ThreadIndex))
+           << "\"}}";
+      first = false;
+      for (const detail::TraceEvent& event : thread->Events)
+      {
+        file << ",\n{\"name\":\"";
+        WriteEscaped(file, event.Name);
+        file << "\",\"cat\":\"" << event.Category << "\",\"ph\":\"X\",\"pid\":0,\"tid\":"
+             << thread->ThreadIndex;
+        std::snprintf(buffer, sizeof(buffer), ",\"ts\":%.3f,\"dur\":%.3f}", event.Begin,
+          event.End - event.Begin);
+        file << buffer;
+      }
+    }
+    file << "\n]}\n";
+    return file.good();
+  }
+
+private:
+  static std::atomic<TraceRecorder*>& GetActive()
+  {
+    static std::atomic<TraceRecorder*> active{ nullptr };
+    return active;
+  }
+
+  detail::TraceThreadBuffer& GetThreadBuffer()
+  {
+    // the cached buffer belongs to the recorder that was active when it was created
+    thread_local TraceRecorder* owner = nullptr;
+    thread_local detail::TraceThreadBuffer* buffer = nullptr;
+    if (owner != this)
+    {
+      std::lock_guard<std::mutex> lock(this->Mutex);
+      this->Threads.emplace_back(new detail::TraceThreadBuffer());
+      buffer = this->Threads.back().get();
+      buffer->ThreadIndex = static_cast<int>(this->Threads.size()) - 1;
+      buffer->Events.reserve(4096);
+      owner = this;
+    }
+    return *buffer;
+  }
+
+  static void WriteEscaped(std::ofstream& file, const char* text)
+  {
+    for (; *text; ++text)
+    {
+      if (*text == '"' || *text == '\\')
+      {
+        file << '\\';
+      }
+      file << *text;
+    }
+  }
+
+  std::chrono::steady_clock::time_point Origin;
+  std::mutex Mutex;
+  std::deque<std::string> Names;
+  std::vector<std::unique_ptr<detail::TraceThreadBuffer>> Threads;
+};
+
+/// Records the lifetime of the scope as an event of the calling thread, if tracing is on.
+class TraceScope
+{
+public:
+  explicit TraceScope(const char* name, const char* category = "vtk")
+    : Recorder(TraceRecorder::GetInstance())
+    , Name(name)
+    , Category(category)
+  {
+    if (this->Recorder)
+    {
+      this->Begin = this->Recorder->Now();
+    }
+  }
+
+  ~TraceScope()
+  {
+    if (this->Recorder)
+    {
+      this->Recorder->Record(this->Name, this->Category, this->Begin, this->Recorder->Now());
+    }
+  }
+
+  TraceScope(const TraceScope&) = delete;
+  TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+  TraceRecorder* Recorder;
+  const char* Name;
+  const char* Category;
+  double Begin = 0.0;
+};
+
+#endif //_TraceRecorder_h
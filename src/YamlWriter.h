@@ -20,8 +20,13 @@
 #ifndef _YamlWriter_h
 #define _YamlWriter_h
 
+#include <functional>
 #include <iostream>
 #include <stack>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
 
 class YamlWriter
 {
@@ -42,6 +47,7 @@ class YamlWriter
   std::ostream& OutputStream;
   std::stack<Block> BlockStack;
   bool AtBlockStart;
+  std::function<void(const std::string&, double)> NumericEntryObserver;
 
   Block& CurrentBlock() { return this->BlockStack.top(); }
 
@@ -162,6 +168,31 @@ public:
     this->WriteIndent();
     this->OutputStream << key << ": " << value << std::endl;
     this->AtBlockStart = false;
+    this->NotifyNumericEntry(key, value, std::is_arithmetic<T>());
+  }
+
+  /// Sets a function that is called with the key and value of every numeric dictionary entry
+  /// added afterwards, which allows collecting values while they are written. An empty function
+  /// removes the observer.
+  ///
+  void SetNumericEntryObserver(std::function<void(const std::string&, double)> observer)
+  {
+    this->NumericEntryObserver = std::move(observer);
+  }
+
+private:
+  template <typename T>
+  void NotifyNumericEntry(const std::string& key, const T& value, std::true_type)
+  {
+    if (this->NumericEntryObserver)
+    {
+      this->NumericEntryObserver(key, static_cast<double>(value));
+    }
+  }
+
+  template <typename T>
+  void NotifyNumericEntry(const std::string&, const T&, std::false_type)
+  {
   }
 };
 
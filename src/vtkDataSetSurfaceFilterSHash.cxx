@@ -57,6 +57,8 @@
 #include "vtkVoxel.h"
 #include "vtkWedge.h"
 
+#include "PhaseTimer.h"
+
 #include <algorithm>
 #include <cassert>
 #include <memory>
@@ -365,6 +367,9 @@ vtkDataSetSurfaceFilterSHash::vtkDataSetSurfaceFilterSHash()
   this->NonlinearSubdivisionLevel = 1;
 
   this->Delegation = false;
+
+  // No timing of the phases by default.
+  this->Metrics = nullptr;
 }
 
 //------------------------------------------------------------------------------
@@ -1332,6 +1337,7 @@ int vtkDataSetSurfaceFilterSHash::UnstructuredGridExecute(
   bool info_owned = false;
   if (info == nullptr)
   {
+    ScopedPhaseTimer characterizeTimer(this->Metrics, "seconds-characterize");
     info = vtkGeometryFilterHelper::CharacterizeUnstructuredGrid(input);
     info_owned = true;
   }
@@ -1403,6 +1409,7 @@ int vtkDataSetSurfaceFilterSHash::UnstructuredGridExecuteInternal(
   vtkSmartPointer<vtkUnstructuredGrid> tempInput;
   if (handleSubdivision)
   {
+    ScopedPhaseTimer subdivideTimer(this->Metrics, "seconds-subdivide");
     // Since this filter only properly subdivides 2D cells past
     // level 1, we convert 3D cells to 2D by using
     // vtkUnstructuredGridGeometryFilter.
@@ -1522,6 +1529,7 @@ int vtkDataSetSurfaceFilterSHash::UnstructuredGridExecuteInternal(
   }
 
   // First insert all points.  Points have to come first in poly data.
+  ScopedPhaseTimer hashTimer(this->Metrics, "seconds-hash-cells");
   for (vtkIdType cellId = 0; cellId < numCells; cellId++)
   {
     cellType = input->GetCellType(cellId);
@@ -1885,6 +1893,7 @@ int vtkDataSetSurfaceFilterSHash::UnstructuredGridExecuteInternal(
       }     // default switch case
     }       // switch(cellType)
   }         // for all cells.
+  hashTimer.Stop();
 
   // It would be possible to add these (except for polygons with 5+ sides)
   // to the hashes.  Alternatively, the higher order 2d cells could be handled
@@ -1892,6 +1901,7 @@ int vtkDataSetSurfaceFilterSHash::UnstructuredGridExecuteInternal(
 
   // Now insert 2DCells.  Because of poly datas (cell data) ordering,
   // the 2D cells have to come after points and lines.
+  ScopedPhaseTimer cells2DTimer(this->Metrics, "seconds-insert-2d-cells");
   for (vtkIdType cellId = 0; cellId < numCells && !abort && flag2D; ++cellId)
   {
     // We skip cells marked as hidden
@@ -2133,7 +2143,10 @@ int vtkDataSetSurfaceFilterSHash::UnstructuredGridExecuteInternal(
     }
   } // for all cells.
 
+  cells2DTimer.Stop();
+
   // Now transfer geometry from hash to output (only triangles and quads).
+  ScopedPhaseTimer outputTimer(this->Metrics, "seconds-hash-to-output");
   this->InitQuadHashTraversal();
   while ((q = this->GetNextVisibleQuadFromHash()))
   {
@@ -2165,6 +2178,7 @@ int vtkDataSetSurfaceFilterSHash::UnstructuredGridExecuteInternal(
     this->RecordOrigCellId(this->NumberOfNewCells, q);
     outputCD->CopyData(inputCD, q->SourceId, this->NumberOfNewCells++);
   }
+  outputTimer.Stop();
 
   if (this->PassThroughCellIds)
   {
@@ -93,6 +93,8 @@
 #include "vtkGeometryFilter.h"        // To facilitate delegation
 #include "vtkPolyDataAlgorithm.h"
 
+class MetricSink;
+
 VTK_ABI_NAMESPACE_BEGIN
 template <typename ArrayType>
 class vtkSmartPointer;
@@ -209,6 +211,16 @@ public:
   vtkBooleanMacro(Delegation, vtkTypeBool);
   ///@}
 
+  ///@{
+  /**
+   * Set / get the sink to which the execution adds the seconds of its phases,
+   * e.g. seconds-extract, which must outlive the execution. The default is
+   * nullptr, which times nothing.
+   */
+  void SetMetrics(MetricSink* metrics) { this->Metrics = metrics; }
+  MetricSink* GetMetrics() const { return this->Metrics; }
+  ///@}
+
   ///@{
   /**
    * Direct access methods so that this class can be used as an
@@ -357,6 +369,7 @@ protected:
   int NonlinearSubdivisionLevel;
   vtkTypeBool Delegation;
   bool FastMode;
+  MetricSink* Metrics;
 
 private:
   int UnstructuredGridBaseExecute(vtkDataSet* input, vtkPolyData* output);
@@ -58,7 +58,15 @@
 #include "vtkVoxel.h"
 #include "vtkWedge.h"
 
+#include "CellBinGrid.h"
+#include "CellVisibility.h"
+#include "FusedPointMap.h"
+#include "PhaseTimer.h"
+#include "TraceRecorder.h"
+
+#include <algorithm>
 #include <memory>
+#include <vector>
 
 vtkStandardNewMacro(vtkGeometryFilterPClassifier);
 vtkCxxSetObjectMacro(vtkGeometryFilterPClassifier, Locator, vtkIncrementalPointLocator);
@@ -85,6 +93,7 @@ vtkGeometryFilterPClassifier::vtkGeometryFilterPClassifier()
   this->ExtentClipping = false;
 
   this->Merging = true;
+  this->PointMapMode = POINT_MAP_ARRAY;
   this->Locator = nullptr;
   this->OutputPointsPrecision = DEFAULT_PRECISION;
 
@@ -106,6 +115,10 @@ vtkGeometryFilterPClassifier::vtkGeometryFilterPClassifier()
 
   // Enable delegation to an internal vtkDataSetSurfaceFilter.
   this->Delegation = true;
+
+  // No timing of the phases by default.
+  this->Metrics = nullptr;
+  this->BinGrid = nullptr;
 }
 
 //------------------------------------------------------------------------------
@@ -330,6 +343,8 @@ void vtkGeometryFilterPClassifier::PrintSelf(ostream& os, vtkIndent indent)
   os << indent << "ExtentClipping: " << (this->ExtentClipping ? "On\n" : "Off\n");
 
   os << indent << "Merging: " << (this->Merging ? "On\n" : "Off\n");
+  os << indent << "Point Map Mode: "
+     << (this->PointMapMode == POINT_MAP_FUSED ? "Fused\n" : "Array\n");
 
   os << indent << "Fast Mode: " << (this->FastMode ? "On\n" : "Off\n");
   os << indent << "Degree: " << this->Degree << "\n";
@@ -356,6 +371,7 @@ typedef std::vector<vtkIdType> IdListType;
 struct CellArrayType
 {
   vtkIdType* PointMap;
+  FusedPointMap<vtkIdType>::Allocator* PointIds;
   IdListType Cells;
   IdListType OrigCellIds;
   vtkIdType* ConnPtr;
@@ -364,6 +380,7 @@ struct CellArrayType
 
   CellArrayType()
     : PointMap(nullptr)
+    , PointIds(nullptr)
     , ConnPtr(nullptr)
     , OffsetsPtr(nullptr)
     , ExcFaces(nullptr)
@@ -371,6 +388,7 @@ struct CellArrayType
   }
 
   void SetPointMap(vtkIdType* ptMap) { this->PointMap = ptMap; }
+  void SetPointIds(FusedPointMap<vtkIdType>::Allocator* ptIds) { this->PointIds = ptIds; }
   void SetExcludedFaces(vtkStaticCellLinksTemplate<vtkIdType>* exc) { this->ExcFaces = exc; }
   vtkIdType GetNumberOfCells() { return static_cast<vtkIdType>(this->OrigCellIds.size()); }
   vtkIdType GetNumberOfConnEntries() { return static_cast<vtkIdType>(this->Cells.size()); }
@@ -385,7 +403,15 @@ struct CellArrayType
 
     // Okay insert the boundary face cell
     Cells.emplace_back(npts);
-    if (!this->PointMap)
+    if (this->PointIds)
+    {
+      // write the output ids right away
+      for (auto i = 0; i < npts; ++i)
+      {
+        Cells.emplace_back(this->PointIds->GetOutputId(pts[i]));
+      }
+    }
+    else if (!this->PointMap)
     {
       for (auto i = 0; i < npts; ++i)
       {
@@ -418,6 +444,10 @@ struct LocalDataType
   // If point merging is specified, then a non-null point map is provided.
   vtkIdType* PointMap;
 
+  // Hands out the output ids of the points that this thread touches first
+  // with POINT_MAP_FUSED.
+  FusedPointMap<vtkIdType>::Allocator PointIdAllocator;
+
   // These collect the boundary entities from geometry extraction. Note also
   // that these implicitly keep track of the number of cells inserted.
   CellArrayType Verts;
@@ -525,6 +555,19 @@ struct LocalDataType
     this->Strips.SetPointMap(ptMap);
   }
 
+  void SetFusedPointMap(FusedPointMap<vtkIdType>* fusedMap)
+  {
+    auto* ptIds = fusedMap ? &this->PointIdAllocator : nullptr;
+    if (fusedMap)
+    {
+      this->PointIdAllocator.SetMap(fusedMap);
+    }
+    this->Verts.SetPointIds(ptIds);
+    this->Lines.SetPointIds(ptIds);
+    this->Polys.SetPointIds(ptIds);
+    this->Strips.SetPointIds(ptIds);
+  }
+
   void SetExcludedFaces(vtkStaticCellLinksTemplate<vtkIdType>* exc)
   {
     this->Verts.SetExcludedFaces(exc);
@@ -955,12 +998,16 @@ void ExtractCellGeometry(vtkUnstructuredGrid* input, vtkIdType cellId, int cellT
 // types -- the operator() method needs to be implemented by subclasses.
 struct ExtractCellBoundaries
 {
-  // If point merging is specified, then a point map is created.
+  // If point merging is specified, then a point map is created, or the points
+  // are numbered on first touch with POINT_MAP_FUSED.
   vtkIdType* PointMap;
+  std::unique_ptr<FusedPointMap<vtkIdType>> FusedMap;
 
   // Cell visibility and cell ghost levels
   const char* CellVis;
   const unsigned char* CellGhosts;
+  // The cells to visit by their index in this list, or nullptr to visit all cells
+  const vtkIdType* CellIds;
 
   // These are the final composited output cell arrays
   vtkCellArray* Verts;       // output verts
@@ -990,6 +1037,7 @@ struct ExtractCellBoundaries
   ExtractCellBoundaries* Extract;
   vtkStaticCellLinksTemplate<vtkIdType>* ExcFaces;
   ThreadOutputType* Threads;
+  MetricSink* Metrics; // times Reduce() if not null
 
   ExtractCellBoundaries(const char* cellVis, const unsigned char* ghosts, vtkCellArray* verts,
     vtkCellArray* lines, vtkCellArray* polys, vtkCellArray* strips, vtkExcludedFaces* exc,
@@ -997,6 +1045,7 @@ struct ExtractCellBoundaries
     : PointMap(nullptr)
     , CellVis(cellVis)
     , CellGhosts(ghosts)
+    , CellIds(nullptr)
     , Verts(verts)
     , Lines(lines)
     , Polys(polys)
@@ -1004,6 +1053,7 @@ struct ExtractCellBoundaries
     , Threads(threads)
   {
     this->ExcFaces = (exc == nullptr ? nullptr : exc->Links);
+    this->Metrics = nullptr;
     this->VertsConnPtr = this->VertsOffsetPtr = nullptr;
     this->LinesConnPtr = this->LinesOffsetPtr = nullptr;
     this->PolysConnPtr = this->PolysOffsetPtr = nullptr;
@@ -1020,6 +1070,12 @@ struct ExtractCellBoundaries
     std::fill_n(this->PointMap, numPts, (-1));
   }
 
+  // Number the points on first touch instead of creating a point map.
+  void CreateFusedPointMap(vtkIdType numPts)
+  {
+    this->FusedMap.reset(new FusedPointMap<vtkIdType>(numPts));
+  }
+
   // Helper function supporting Reduce() to allocate and construct output cell arrays.
   // Also keep local information to facilitate compositing.
   void AllocateCellArray(vtkIdType connSize, vtkIdType numCells, vtkCellArray* ca,
@@ -1039,6 +1095,7 @@ struct ExtractCellBoundaries
     // Make sure cells have been built
     auto& localData = this->LocalData.Local();
     localData.SetPointMap(this->PointMap);
+    localData.SetFusedPointMap(this->FusedMap.get());
     localData.SetExcludedFaces(this->ExcFaces);
   }
 
@@ -1048,6 +1105,8 @@ struct ExtractCellBoundaries
   // thread into the filter's output, this performs a parallel append.
   void Reduce()
   {
+    TraceScope scope("ExtractCellBoundaries::Reduce");
+    ScopedPhaseTimer reduceTimer(this->Metrics, "seconds-extract-reduce");
     // Determine offsets to partition work and perform memory allocations.
     vtkIdType numCells, numConnEntries;
     vtkIdType vertsNumPts = 0, vertsNumCells = 0;
@@ -1158,30 +1217,47 @@ struct ExtractUG : public ExtractCellBoundaries
 
   void operator()(vtkIdType cellId, vtkIdType endCellId)
   {
+    TraceScope scope("ExtractUG::operator()");
     auto& localData = this->LocalData.Local();
     auto& cellIter = this->CellIter.Local();
 
-    for (cellIter->GoToCell(cellId); cellId < endCellId; ++cellId, cellIter->GoToNextCell())
+    if (this->CellIds)
     {
-      // Handle ghost cells here.  Another option was used cellVis array.
-      if (this->CellGhosts && this->CellGhosts[cellId] & vtkDataSetAttributes::DUPLICATECELL)
-      { // Do not create surfaces in outer ghost cells.
-        continue;
+      // the listed cells are not consecutive, so the iterator moves to each of them
+      for (vtkIdType index = cellId; index < endCellId; ++index)
+      {
+        cellIter->GoToCell(this->CellIds[index]);
+        this->ExtractCell(this->CellIds[index], cellIter, localData);
       }
+      return;
+    }
+    for (cellIter->GoToCell(cellId); cellId < endCellId; ++cellId, cellIter->GoToNextCell())
+    {
+      this->ExtractCell(cellId, cellIter, localData);
+    }
+  } // operator()
 
-      // If the cell is visible process it
-      if (!this->CellVis || this->CellVis[cellId])
-      {
-        int type = cellIter->GetCellType();
-        vtkIdList* pointIdList = cellIter->GetPointIds();
-        vtkIdType npts = pointIdList->GetNumberOfIds();
-        vtkIdType* pts = pointIdList->GetPointer(0);
+  void ExtractCell(
+    vtkIdType cellId, vtkUnstructuredGridCellIterator* cellIter, LocalDataType& localData)
+  {
+    // Handle ghost cells here.  Another option was used cellVis array.
+    if (this->CellGhosts && this->CellGhosts[cellId] & vtkDataSetAttributes::DUPLICATECELL)
+    { // Do not create surfaces in outer ghost cells.
+      return;
+    }
 
-        ExtractCellGeometry(
-          this->Grid, cellId, type, npts, pts, this->CellVis, cellIter, &localData);
-      } // if cell visible
-    }   // for all cells in this batch
-  }     // operator()
+    // If the cell is visible process it
+    if (!this->CellVis || this->CellVis[cellId])
+    {
+      int type = cellIter->GetCellType();
+      vtkIdList* pointIdList = cellIter->GetPointIds();
+      vtkIdType npts = pointIdList->GetNumberOfIds();
+      vtkIdType* pts = pointIdList->GetPointer(0);
+
+      ExtractCellGeometry(
+        this->Grid, cellId, type, npts, pts, this->CellVis, cellIter, &localData);
+    } // if cell visible
+  }
 
   // Composite local thread data
   void Reduce() { this->ExtractCellBoundaries::Reduce(); }
@@ -1232,31 +1308,48 @@ struct FastExtractUG : public ExtractCellBoundaries
 
   void operator()(vtkIdType cellId, vtkIdType endCellId)
   {
+    TraceScope scope("FastExtractUG::operator()");
     auto& localData = this->LocalData.Local();
     auto& cellIter = this->CellIter.Local();
 
-    for (cellIter->GoToCell(cellId); cellId < endCellId; ++cellId, cellIter->GoToNextCell())
+    if (this->CellIds)
     {
-      // Handle ghost cells here.  Another option was used cellVis array.
-      if (this->CellGhosts && this->CellGhosts[cellId] & vtkDataSetAttributes::DUPLICATECELL)
-      { // Do not create surfaces in outer ghost cells.
-        continue;
+      // the listed cells are not consecutive, so the iterator moves to each of them
+      for (vtkIdType index = cellId; index < endCellId; ++index)
+      {
+        cellIter->GoToCell(this->CellIds[index]);
+        this->ExtractCell(this->CellIds[index], cellIter, localData);
       }
+      return;
+    }
+    for (cellIter->GoToCell(cellId); cellId < endCellId; ++cellId, cellIter->GoToNextCell())
+    {
+      this->ExtractCell(cellId, cellIter, localData);
+    }
+  } // operator()
 
-      // If the cell is visible process it
-      if (this->CellSelection[cellId] != 0 && (!this->CellVis || this->CellVis[cellId]))
-      {
-        int type = cellIter->GetCellType();
-        vtkIdList* pointIdList = cellIter->GetPointIds();
-        vtkIdType npts = pointIdList->GetNumberOfIds();
-        vtkIdType* pts = pointIdList->GetPointer(0);
+  void ExtractCell(
+    vtkIdType cellId, vtkUnstructuredGridCellIterator* cellIter, LocalDataType& localData)
+  {
+    // Handle ghost cells here.  Another option was used cellVis array.
+    if (this->CellGhosts && this->CellGhosts[cellId] & vtkDataSetAttributes::DUPLICATECELL)
+    { // Do not create surfaces in outer ghost cells.
+      return;
+    }
 
-        ExtractCellGeometry(
-          this->Grid, cellId, type, npts, pts, this->CellVis, cellIter, &localData);
+    // If the cell is visible process it
+    if (this->CellSelection[cellId] != 0 && (!this->CellVis || this->CellVis[cellId]))
+    {
+      int type = cellIter->GetCellType();
+      vtkIdList* pointIdList = cellIter->GetPointIds();
+      vtkIdType npts = pointIdList->GetNumberOfIds();
+      vtkIdType* pts = pointIdList->GetPointer(0);
 
-      } // if cell visible and selected via fast mode (vertex degree)
-    }   // for all cells in this batch
-  }     // operator()
+      ExtractCellGeometry(
+        this->Grid, cellId, type, npts, pts, this->CellVis, cellIter, &localData);
+
+    } // if cell visible and selected via fast mode (vertex degree)
+  }
 
   // Composite local thread data
   void Reduce() { this->ExtractCellBoundaries::Reduce(); }
@@ -1475,22 +1568,42 @@ struct GenerateExpPoints
   TIP* InPts;
   TOP* OutPts;
   vtkIdType* PointMap;
+  const FusedPointMap<vtkIdType>* FusedMap;
   ArrayList* PtArrays;
 
-  GenerateExpPoints(TIP* inPts, TOP* outPts, vtkIdType* ptMap, ArrayList* ptArrays)
+  GenerateExpPoints(TIP* inPts, TOP* outPts, vtkIdType* ptMap,
+    const FusedPointMap<vtkIdType>* fusedMap, ArrayList* ptArrays)
     : InPts(inPts)
     , OutPts(outPts)
     , PointMap(ptMap)
+    , FusedMap(fusedMap)
     , PtArrays(ptArrays)
   {
   }
 
   void operator()(vtkIdType ptId, vtkIdType endPtId)
   {
+    TraceScope scope("GenerateExpPoints::operator()");
     const auto inPts = vtk::DataArrayTupleRange<3>(this->InPts);
     auto outPts = vtk::DataArrayTupleRange<3>(this->OutPts);
     vtkIdType mapId;
 
+    if (this->FusedMap)
+    {
+      // The range is one of output points, whose input points are known.
+      const vtkIdType* inputIds = this->FusedMap->GetInputIds();
+      for (; ptId < endPtId; ++ptId)
+      {
+        auto xIn = inPts[inputIds[ptId]];
+        auto xOut = outPts[ptId];
+        xOut[0] = xIn[0];
+        xOut[1] = xIn[1];
+        xOut[2] = xIn[2];
+        this->PtArrays->Copy(inputIds[ptId], ptId);
+      }
+      return;
+    }
+
     for (; ptId < endPtId; ++ptId)
     {
       if ((mapId = this->PointMap[ptId]) >= 0)
@@ -1513,12 +1626,15 @@ struct GenerateImpPoints
   vtkDataSet* InPts;
   TOP* OutPts;
   vtkIdType* PointMap;
+  const FusedPointMap<vtkIdType>* FusedMap;
   ArrayList* PtArrays;
 
-  GenerateImpPoints(vtkDataSet* inPts, TOP* outPts, vtkIdType* ptMap, ArrayList* ptArrays)
+  GenerateImpPoints(vtkDataSet* inPts, TOP* outPts, vtkIdType* ptMap,
+    const FusedPointMap<vtkIdType>* fusedMap, ArrayList* ptArrays)
     : InPts(inPts)
     , OutPts(outPts)
     , PointMap(ptMap)
+    , FusedMap(fusedMap)
     , PtArrays(ptArrays)
   {
   }
@@ -1529,6 +1645,22 @@ struct GenerateImpPoints
     double xIn[3];
     vtkIdType mapId;
 
+    if (this->FusedMap)
+    {
+      // The range is one of output points, whose input points are known.
+      const vtkIdType* inputIds = this->FusedMap->GetInputIds();
+      for (; ptId < endPtId; ++ptId)
+      {
+        this->InPts->GetPoint(inputIds[ptId], xIn);
+        auto xOut = outPts[ptId];
+        xOut[0] = xIn[0];
+        xOut[1] = xIn[1];
+        xOut[2] = xIn[2];
+        this->PtArrays->Copy(inputIds[ptId], ptId);
+      }
+      return;
+    }
+
     for (; ptId < endPtId; ++ptId)
     {
       if ((mapId = this->PointMap[ptId]) >= 0)
@@ -1555,9 +1687,20 @@ struct GeneratePtsWorker
   }
 
   // Create the final point map. This could be threaded (prefix_sum) but
-  // performance gains are minimal.
+  // performance gains are minimal. The points of a fused point map are
+  // already numbered, so no point map is created for them.
   vtkIdType* GeneratePointMap(vtkIdType numInputPts, ExtractCellBoundaries* extract)
   {
+    if (extract->FusedMap)
+    {
+      for (auto& localData : extract->LocalData)
+      {
+        extract->FusedMap->Release(localData.PointIdAllocator);
+      }
+      this->NumOutputPoints = extract->FusedMap->Finalize();
+      return nullptr;
+    }
+
     // The PointMap has been marked as to which points are being used.
     // This needs to be updated to indicate the output point ids.
     vtkIdType* ptMap = extract->PointMap;
@@ -1588,8 +1731,9 @@ struct ExpPtsWorker : public GeneratePtsWorker
     ptArrays.AddArrays(this->NumOutputPoints, inPD, outPD, 0.0, false);
 
     outPts->SetNumberOfTuples(this->NumOutputPoints);
-    GenerateExpPoints<TIP, TOP> genPts(inPts, outPts, ptMap, &ptArrays);
-    vtkSMPTools::For(0, numInputPts, genPts);
+    GenerateExpPoints<TIP, TOP> genPts(inPts, outPts, ptMap, extract->FusedMap.get(), &ptArrays);
+    // the points of a fused point map are generated in output order
+    vtkSMPTools::For(0, extract->FusedMap ? this->NumOutputPoints : numInputPts, genPts);
   }
 };
 
@@ -1609,8 +1753,9 @@ struct ImpPtsWorker : public GeneratePtsWorker
     ptArrays.AddArrays(this->NumOutputPoints, inPD, outPD, 0.0, false);
 
     outPts->SetNumberOfTuples(this->NumOutputPoints);
-    GenerateImpPoints<TOP> genPts(inPts, outPts, ptMap, &ptArrays);
-    vtkSMPTools::For(0, numInputPts, genPts);
+    GenerateImpPoints<TOP> genPts(inPts, outPts, ptMap, extract->FusedMap.get(), &ptArrays);
+    // the points of a fused point map are generated in output order
+    vtkSMPTools::For(0, extract->FusedMap ? this->NumOutputPoints : numInputPts, genPts);
   }
 };
 
@@ -1618,6 +1763,7 @@ struct ImpPtsWorker : public GeneratePtsWorker
 struct CompositeCells
 {
   const vtkIdType* PointMap;
+  const FusedPointMap<vtkIdType>* FusedMap;
   ArrayList* CellArrays;
   ExtractCellBoundaries* Extractor;
   ThreadOutputType* Threads;
@@ -1625,6 +1771,7 @@ struct CompositeCells
   CompositeCells(vtkIdType* ptMap, ArrayList* cellArrays, ExtractCellBoundaries* extract,
     ThreadOutputType* threads)
     : PointMap(ptMap)
+    , FusedMap(extract->FusedMap.get())
     , CellArrays(cellArrays)
     , Extractor(extract)
     , Threads(threads)
@@ -1642,8 +1789,23 @@ struct CompositeCells
     vtkIdType globalCellId = cellIdOffset + offset;
 
     // If not merging points, we reuse input points and so do not need to
-    // produce new points nor point data.
-    if (!this->PointMap)
+    // produce new points nor point data. The cells of a fused point map hold
+    // output ids already.
+    if (this->FusedMap)
+    {
+      for (auto cellId = 0; cellId < numCells; ++cellId)
+      {
+        *offsetPtr++ = offsetVal;
+        vtkIdType npts = *cells++;
+        for (auto i = 0; i < npts; ++i)
+        {
+          *connPtr++ = this->FusedMap->Resolve(*cells++);
+        }
+        offsetVal += npts;
+        this->CellArrays->Copy(cat->OrigCellIds[cellId], globalCellId++);
+      }
+    }
+    else if (!this->PointMap)
     {
       for (auto cellId = 0; cellId < numCells; ++cellId)
       {
@@ -1675,6 +1837,7 @@ struct CompositeCells
 
   void operator()(vtkIdType thread, vtkIdType threadEnd)
   {
+    TraceScope scope("CompositeCells::operator()");
     ExtractCellBoundaries* extract = this->Extractor;
 
     for (; thread < threadEnd; ++thread)
@@ -1732,6 +1895,7 @@ struct CompositeCellIds
 
   void operator()(vtkIdType thread, vtkIdType threadEnd)
   {
+    TraceScope scope("CompositeCellIds::operator()");
     ExtractCellBoundaries* extract = this->Extractor;
 
     for (; thread < threadEnd; ++thread)
@@ -1986,9 +2150,10 @@ struct CharacterizeGrid
 };
 
 // Threaded creation to generate array of originating point ids.
-void PassPointIds(const char* name, vtkIdType numInputPts, vtkIdType numOutputPts, vtkIdType* ptMap,
-  vtkPointData* outPD)
+void PassPointIds(const char* name, vtkIdType numInputPts, vtkIdType numOutputPts,
+  ExtractCellBoundaries* extract, vtkPointData* outPD)
 {
+  vtkIdType* ptMap = extract->PointMap;
   vtkNew<vtkIdTypeArray> origPtIds;
   origPtIds->SetName(name);
   origPtIds->SetNumberOfComponents(1);
@@ -1997,6 +2162,14 @@ void PassPointIds(const char* name, vtkIdType numInputPts, vtkIdType numOutputPt
   vtkIdType* origIds = origPtIds->GetPointer(0);
 
   // Now threaded populate the array
+  if (extract->FusedMap)
+  {
+    const vtkIdType* inputIds = extract->FusedMap->GetInputIds();
+    vtkSMPTools::For(0, numOutputPts, [&origIds, inputIds](vtkIdType ptId, vtkIdType endPtId) {
+      std::copy(inputIds + ptId, inputIds + endPtId, origIds + ptId);
+    });
+    return;
+  }
   vtkSMPTools::For(0, numInputPts, [&origIds, &ptMap](vtkIdType ptId, vtkIdType endPtId) {
     for (; ptId < endPtId; ++ptId)
     {
@@ -2094,6 +2267,7 @@ int vtkGeometryFilterPClassifier::UnstructuredGridExecute(vtkDataSet* dataSetInp
   bool mayDelegate = (info == nullptr && this->Delegation);
   if (info == nullptr)
   {
+    ScopedPhaseTimer characterizeTimer(this->Metrics, "seconds-characterize");
     info = vtkGeometryFilterPClassifierHelper::CharacterizeUnstructuredGrid(input);
   }
 
@@ -2108,11 +2282,6 @@ int vtkGeometryFilterPClassifier::UnstructuredGridExecute(vtkDataSet* dataSetInp
     return 1;
   }
 
-  auto cellIter = vtk::TakeSmartPointer(input->NewCellIterator());
-  vtkIdType cellId;
-  vtkIdType npts = 0;
-  vtkIdList* pointIdList;
-  const vtkIdType* pts = nullptr;
   vtkPoints* inPts = input->GetPoints();
   vtkIdType numInputPts = input->GetNumberOfPoints(), numOutputPts;
   vtkIdType numCells = input->GetNumberOfCells();
@@ -2153,40 +2322,35 @@ int vtkGeometryFilterPClassifier::UnstructuredGridExecute(vtkDataSet* dataSetInp
 
   outCD->CopyGlobalIdsOn();
 
-  // Loop over the cells determining what's visible. This could be threaded
-  // if necessary - for now it's not used very often so serial.
+  // With a bin grid, only the candidate cells of the extent are classified and extracted. The
+  // other cells are hidden, since the extraction reads the visibility of the neighbor cells.
+  CellBinGrid* binGrid = this->ExtentClipping ? this->BinGrid : nullptr;
+  std::vector<vtkIdType> candidateCells;
+  if (binGrid)
+  {
+    ScopedPhaseTimer binGridTimer(this->Metrics, "seconds-bin-grid");
+    binGrid->Update(input);
+    binGrid->FindCandidateCells(this->Extent, candidateCells);
+  }
+
+  // Determine what's visible, in parallel over a mask of the points that pass the clipping.
   if (cellVis)
   {
-    double x[3];
-    for (cellIter->InitTraversal(); !cellIter->IsDoneWithTraversal(); cellIter->GoToNextCell())
+    ScopedPhaseTimer visibilityTimer(this->Metrics, "seconds-cell-visibility");
+    CellVisibility visibility(this->CellClipping, this->CellMinimum, this->CellMaximum,
+      this->PointClipping, this->PointMinimum, this->PointMaximum, this->ExtentClipping,
+      this->Extent);
+    if (binGrid)
     {
-      cellId = cellIter->GetCellId();
-      pointIdList = cellIter->GetPointIds();
-      npts = pointIdList->GetNumberOfIds();
-      pts = pointIdList->GetPointer(0);
-      cellVis[cellId] = 1;
-      if (this->CellClipping && (cellId < this->CellMinimum || cellId > this->CellMaximum))
-      {
-        cellVis[cellId] = 0;
-      }
-      else
-      {
-        for (int i = 0; i < npts; i++)
-        {
-          inPts->GetPoint(pts[i], x);
-          if ((this->PointClipping &&
-                (pts[i] < this->PointMinimum || pts[i] > this->PointMaximum)) ||
-            (this->ExtentClipping &&
-              (x[0] < this->Extent[0] || x[0] > this->Extent[1] || x[1] < this->Extent[2] ||
-                x[1] > this->Extent[3] || x[2] < this->Extent[4] || x[2] > this->Extent[5])))
-          {
-            cellVis[cellId] = 0;
-            break;
-          } // point/extent clipping
-        }   // for each point
-      }     // if point clipping needs checking
-    }       // for all cells
-  }         // if not all visible
+      vtkSMPTools::Fill(cellVis, cellVis + numCells, 0);
+      visibility.Compute(
+        input, candidateCells.data(), static_cast<vtkIdType>(candidateCells.size()), cellVis);
+    }
+    else
+    {
+      visibility.Compute(input, cellVis);
+    }
+  }
 
   // Prepare to generate the output. The cell arrays are of course the output vertex,
   // line, polygon, and triangle strip output. The four IdListType's capture the
@@ -2225,7 +2389,10 @@ int vtkGeometryFilterPClassifier::UnstructuredGridExecute(vtkDataSet* dataSetInp
   output->SetStrips(strips);
 
   // Make sure links are built since link building is not thread safe
-  input->BuildLinks();
+  {
+    ScopedPhaseTimer linksTimer(this->Metrics, "seconds-build-links");
+    input->BuildLinks();
+  }
 
   // Threaded visit of each cell to extract boundary features. Each thread gathers
   // output which is then composited into the final vtkPolyData.
@@ -2234,23 +2401,42 @@ int vtkGeometryFilterPClassifier::UnstructuredGridExecute(vtkDataSet* dataSetInp
 
   // Perform the threaded boundary cell extraction. This performs some
   // initial reduction and allocation of the output. It also computes offets
-  // and sizes for allocation and writing of data.
+  // and sizes for allocation and writing of data. A fused point map numbers
+  // the points during extraction and replaces the point map.
   ExtractCellBoundaries* extract;
+  const bool fusedPoints = this->Merging && this->PointMapMode == POINT_MAP_FUSED;
+  const bool pointMap = this->Merging && !fusedPoints;
+  const vtkIdType numVisitedCells =
+    binGrid ? static_cast<vtkIdType>(candidateCells.size()) : numCells;
+  ScopedPhaseTimer extractTimer(this->Metrics, "seconds-extract");
   if (this->FastMode)
   {
-    FastExtractUG* ext = new FastExtractUG(input, cellVis, cellGhosts, this->Merging, verts, lines,
+    FastExtractUG* ext = new FastExtractUG(input, cellVis, cellGhosts, pointMap, verts, lines,
       polys, strips, this->Degree, input->GetCellLinks(), exc, &threads);
-    vtkSMPTools::For(0, numCells, *ext);
+    ext->Metrics = this->Metrics;
+    ext->CellIds = binGrid ? candidateCells.data() : nullptr;
+    if (fusedPoints)
+    {
+      ext->CreateFusedPointMap(numInputPts);
+    }
+    vtkSMPTools::For(0, numVisitedCells, *ext);
     extract = ext;
   }
   else // the usual path
   {
     ExtractUG* ext = new ExtractUG(
-      input, cellVis, cellGhosts, this->Merging, verts, lines, polys, strips, exc, &threads);
+      input, cellVis, cellGhosts, pointMap, verts, lines, polys, strips, exc, &threads);
+    ext->Metrics = this->Metrics;
+    ext->CellIds = binGrid ? candidateCells.data() : nullptr;
+    if (fusedPoints)
+    {
+      ext->CreateFusedPointMap(numInputPts);
+    }
 
-    vtkSMPTools::For(0, numCells, *ext);
+    vtkSMPTools::For(0, numVisitedCells, *ext);
     extract = ext;
   }
+  extractTimer.Stop();
   numCells = extract->NumCells;
 
   // If merging points, then it's necessary to allocate the points array,
@@ -2263,11 +2449,13 @@ int vtkGeometryFilterPClassifier::UnstructuredGridExecute(vtkDataSet* dataSetInp
     using vtkArrayDispatch::Reals;
     using ExpPtsDispatch = vtkArrayDispatch::Dispatch2ByValueType<Reals, Reals>;
     ExpPtsWorker compWorker;
+    ScopedPhaseTimer pointsTimer(this->Metrics, "seconds-generate-points");
     if (!ExpPtsDispatch::Execute(
           inPts->GetData(), outPts->GetData(), compWorker, numInputPts, inPD, outPD, extract))
     { // Fallback to slowpath for other point types
       compWorker(inPts->GetData(), outPts->GetData(), numInputPts, inPD, outPD, extract);
     }
+    pointsTimer.Stop();
     numOutputPts = compWorker.NumOutputPoints;
 
     // Generate originating point ids if requested and merging is
@@ -2275,21 +2463,25 @@ int vtkGeometryFilterPClassifier::UnstructuredGridExecute(vtkDataSet* dataSetInp
     // points are merged.)
     if (this->PassThroughPointIds)
     {
-      PassPointIds(this->GetOriginalPointIdsName(), numInputPts, numOutputPts, ptMap, outPD);
+      ScopedPhaseTimer pointIdsTimer(this->Metrics, "seconds-pass-point-ids");
+      PassPointIds(this->GetOriginalPointIdsName(), numInputPts, numOutputPts, extract, outPD);
     }
   }
 
   // Finally we can composite the output topology.
+  ScopedPhaseTimer compositeTimer(this->Metrics, "seconds-composite-cells");
   ArrayList cellArrays;
   outCD->CopyAllocate(inCD, numCells);
   cellArrays.AddArrays(numCells, inCD, outCD, 0.0, false);
 
   CompositeCells compCells(ptMap, &cellArrays, extract, &threads);
   vtkSMPTools::For(0, static_cast<vtkIdType>(threads.size()), compCells);
+  compositeTimer.Stop();
 
   // Generate originating cell ids if requested.
   if (this->PassThroughCellIds)
   {
+    ScopedPhaseTimer cellIdsTimer(this->Metrics, "seconds-pass-cell-ids");
     PassCellIds(this->GetOriginalCellIdsName(), extract, &threads, outCD);
   }
 
@@ -2313,7 +2505,6 @@ int vtkGeometryFilterPClassifier::StructuredExecute(
   vtkDataSet* input, vtkPolyData* output, vtkInformation*, vtkExcludedFaces* exc)
 {
   vtkIdType numCells = input->GetNumberOfCells();
-  vtkIdType i, cellId, ptId;
   vtkPointData* inPD = input->GetPointData();
   vtkCellData* inCD = input->GetCellData();
   vtkPointData* outPD = output->GetPointData();
@@ -2393,40 +2584,10 @@ int vtkGeometryFilterPClassifier::StructuredExecute(
   //
   if (cellVis)
   {
-    vtkNew<vtkGenericCell> cell;
-    vtkIdList* ptIds;
-    for (cellId = 0; cellId < numCells; cellId++)
-    {
-      if (this->CellClipping && (cellId < this->CellMinimum || cellId > this->CellMaximum))
-      {
-        cellVis[cellId] = 0;
-      }
-      else
-      {
-        double x[3];
-        input->GetCell(cellId, cell);
-        ptIds = cell->GetPointIds();
-        vtkIdType ncells = ptIds->GetNumberOfIds();
-        for (i = 0; i < ncells; i++)
-        {
-          ptId = ptIds->GetId(i);
-          input->GetPoint(ptId, x);
-
-          if ((this->PointClipping && (ptId < this->PointMinimum || ptId > this->PointMaximum)) ||
-            (this->ExtentClipping &&
-              (x[0] < this->Extent[0] || x[0] > this->Extent[1] || x[1] < this->Extent[2] ||
-                x[1] > this->Extent[3] || x[2] < this->Extent[4] || x[2] > this->Extent[5])))
-          {
-            cellVis[cellId] = 0;
-            break;
-          }
-        }                // for all points defining the cell
-        if (i >= ncells) // if no points are clipped
-        {
-          cellVis[cellId] = 1;
-        }
-      } // check cell clipping first, and then point clipping if necessary
-    }   // for all cells
+    CellVisibility visibility(this->CellClipping, this->CellMinimum, this->CellMaximum,
+      this->PointClipping, this->PointMinimum, this->PointMaximum, this->ExtentClipping,
+      this->Extent);
+    visibility.Compute(input, cellVis);
   }
 
   // We can now extract the boundary topology. This works for all structured
@@ -2498,7 +2659,7 @@ int vtkGeometryFilterPClassifier::StructuredExecute(
   vtkIdType* ptMap = extStr.PointMap;
   if (this->PassThroughPointIds && (inPts == nullptr || mergePts))
   {
-    PassPointIds(this->GetOriginalPointIdsName(), numInputPts, numOutputPts, ptMap, outPD);
+    PassPointIds(this->GetOriginalPointIdsName(), numInputPts, numOutputPts, &extStr, outPD);
   }
 
   // Finally we can composite the output topology.
@@ -2530,11 +2691,7 @@ int vtkGeometryFilterPClassifier::DataSetExecute(vtkDataSet* input, vtkPolyData*
 //------------------------------------------------------------------------------
 int vtkGeometryFilterPClassifier::DataSetExecute(vtkDataSet* input, vtkPolyData* output, vtkExcludedFaces* exc)
 {
-  vtkIdType cellId;
-  int i;
   vtkIdType numCells = input->GetNumberOfCells();
-  double x[3];
-  vtkIdType ptId;
   vtkPointData* inPD = input->GetPointData();
   vtkCellData* inCD = input->GetCellData();
   vtkPointData* outPD = output->GetPointData();
@@ -2581,38 +2738,10 @@ int vtkGeometryFilterPClassifier::DataSetExecute(vtkDataSet* input, vtkPolyData*
   //
   if (cellVis)
   {
-    vtkNew<vtkGenericCell> cell;
-    vtkIdList* ptIds;
-    for (cellId = 0; cellId < numCells; cellId++)
-    {
-      if (this->CellClipping && (cellId < this->CellMinimum || cellId > this->CellMaximum))
-      {
-        cellVis[cellId] = 0;
-      }
-      else
-      {
-        input->GetCell(cellId, cell);
-        ptIds = cell->GetPointIds();
-        for (i = 0; i < ptIds->GetNumberOfIds(); i++)
-        {
-          ptId = ptIds->GetId(i);
-          input->GetPoint(ptId, x);
-
-          if ((this->PointClipping && (ptId < this->PointMinimum || ptId > this->PointMaximum)) ||
-            (this->ExtentClipping &&
-              (x[0] < this->Extent[0] || x[0] > this->Extent[1] || x[1] < this->Extent[2] ||
-                x[1] > this->Extent[3] || x[2] < this->Extent[4] || x[2] > this->Extent[5])))
-          {
-            cellVis[cellId] = 0;
-            break;
-          }
-        }
-        if (i >= ptIds->GetNumberOfIds())
-        {
-          cellVis[cellId] = 1;
-        }
-      }
-    }
+    CellVisibility visibility(this->CellClipping, this->CellMinimum, this->CellMaximum,
+      this->PointClipping, this->PointMinimum, this->PointMaximum, this->ExtentClipping,
+      this->Extent);
+    visibility.Compute(input, cellVis);
   }
 
   // Create new output points. In a dataset, points are assumed to be
@@ -2671,7 +2800,7 @@ int vtkGeometryFilterPClassifier::DataSetExecute(vtkDataSet* input, vtkPolyData*
   vtkIdType* ptMap = extract.PointMap;
   if (this->PassThroughPointIds)
   {
-    PassPointIds(this->GetOriginalPointIdsName(), numInputPts, numOutputPts, ptMap, outPD);
+    PassPointIds(this->GetOriginalPointIdsName(), numInputPts, numOutputPts, &extract, outPD);
   }
 
   // Finally we can composite the output topology.
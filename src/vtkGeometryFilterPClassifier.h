@@ -100,6 +100,9 @@
 #include "vtkFiltersGeometryModule.h" // For export macro
 #include "vtkPolyDataAlgorithm.h"
 
+class CellBinGrid;
+class MetricSink;
+
 class vtkIncrementalPointLocator;
 class vtkStructuredGrid;
 class vtkUnstructuredGrid;
@@ -215,6 +218,34 @@ public:
   vtkBooleanMacro(Merging, bool);
   ///@}
 
+  /**
+   * Ways of tracking which input points are used by the output when merging
+   * points.
+   */
+  enum PointMapModes
+  {
+    POINT_MAP_ARRAY = 0,
+    POINT_MAP_FUSED = 1
+  };
+
+  ///@{
+  /**
+   * Specify how the used points of an unstructured grid are tracked when
+   * merging points. With POINT_MAP_ARRAY (the default), extraction marks a
+   * point map of one id per input point, which is numbered and then applied
+   * to the output connectivity. With POINT_MAP_FUSED, a point gets its output
+   * id when a thread first touches it during extraction, from blocks of ids
+   * taken by each thread, so the extracted connectivity is already renumbered
+   * and the output points are gathered without visiting all input points. The
+   * output points are then ordered by first touch, which depends on the
+   * scheduling of the threads. Other dataset types always use a point map.
+   */
+  vtkSetClampMacro(PointMapMode, int, POINT_MAP_ARRAY, POINT_MAP_FUSED);
+  vtkGetMacro(PointMapMode, int);
+  void SetPointMapModeToArray() { this->SetPointMapMode(POINT_MAP_ARRAY); }
+  void SetPointMapModeToFused() { this->SetPointMapMode(POINT_MAP_FUSED); }
+  ///@}
+
   ///@{
   /**
    * Set/get the desired precision for the output types. See the
@@ -357,6 +388,30 @@ public:
   vtkBooleanMacro(Delegation, vtkTypeBool);
   ///@}
 
+  ///@{
+  /**
+   * Set / get the sink to which the execution adds the seconds of its phases,
+   * e.g. seconds-extract, which must outlive the execution. The default is
+   * nullptr, which times nothing.
+   */
+  void SetMetrics(MetricSink* metrics) { this->Metrics = metrics; }
+  MetricSink* GetMetrics() const { return this->Metrics; }
+  ///@}
+
+  ///@{
+  /**
+   * Set / get a grid of bins over the cells of the input, which must outlive
+   * the execution. With extent clipping on and an unstructured grid input,
+   * the grid is updated for the input, which only rebuilds it if the points
+   * or cells of the input changed, and only the cells of the bins that
+   * overlap the extent are classified and extracted. The grid can be shared
+   * by filters that process the same input. The default is nullptr, which
+   * visits all cells.
+   */
+  void SetCellBinGrid(CellBinGrid* grid) { this->BinGrid = grid; }
+  CellBinGrid* GetCellBinGrid() const { return this->BinGrid; }
+  ///@}
+
   ///@{
   /**
    * Direct access methods so that this class can be used as an
@@ -399,6 +454,7 @@ protected:
   int OutputPointsPrecision;
 
   bool Merging;
+  int PointMapMode;
   vtkIncrementalPointLocator* Locator;
 
   bool FastMode;
@@ -415,6 +471,8 @@ protected:
   int NonlinearSubdivisionLevel;
 
   vtkTypeBool Delegation;
+  MetricSink* Metrics;
+  CellBinGrid* BinGrid;
 
 private:
   vtkGeometryFilterPClassifier(const vtkGeometryFilterPClassifier&) = delete;
@@ -53,8 +53,20 @@
 #include "vtkVoxel.h"
 #include "vtkWedge.h"
 
+#include "AttributeGather.h"
+#include "CellBinGrid.h"
+#include "CellVisibility.h"
+#include "FusedPointMap.h"
+#include "PhaseTimer.h"
+#include "PointUsageBits.h"
+#include "SurfaceTopologyCache.h"
+#include "TraceRecorder.h"
+
+#include <algorithm>
+#include <cstdint>
 #include <memory>
 #include <mutex>
+#include <vector>
 
 VTK_ABI_NAMESPACE_BEGIN
 vtkStandardNewMacro(vtkGeometryFilterPHash);
@@ -90,6 +102,7 @@ vtkGeometryFilterPHash::vtkGeometryFilterPHash()
   this->ExtentClipping = false;
 
   this->Merging = true;
+  this->PointMapMode = POINT_MAP_ARRAY;
   this->Locator = nullptr;
   this->OutputPointsPrecision = DEFAULT_PRECISION;
 
@@ -111,6 +124,18 @@ vtkGeometryFilterPHash::vtkGeometryFilterPHash()
 
   // Enable delegation to an internal vtkDataSetSurfaceFilter.
   this->Delegation = true;
+
+  // All cells are used by default.
+  this->CellMaskArrayName = nullptr;
+
+  // All shared faces are removed by default.
+  this->RegionIdsArrayName = nullptr;
+  this->RegionIdPairsName = nullptr;
+
+  // No timing of the phases by default.
+  this->Metrics = nullptr;
+  this->BinGrid = nullptr;
+  this->TopologyCache = nullptr;
 }
 
 //------------------------------------------------------------------------------
@@ -119,6 +144,9 @@ vtkGeometryFilterPHash::~vtkGeometryFilterPHash()
   this->SetLocator(nullptr);
   this->SetOriginalCellIdsName(nullptr);
   this->SetOriginalPointIdsName(nullptr);
+  this->SetCellMaskArrayName(nullptr);
+  this->SetRegionIdsArrayName(nullptr);
+  this->SetRegionIdPairsName(nullptr);
 }
 
 //------------------------------------------------------------------------------
@@ -313,6 +341,10 @@ void vtkGeometryFilterPHash::PrintSelf(ostream& os, vtkIndent indent)
   os << indent << "ExtentClipping: " << (this->ExtentClipping ? "On\n" : "Off\n");
 
   os << indent << "Merging: " << (this->Merging ? "On\n" : "Off\n");
+  os << indent << "Point Map Mode: "
+     << (this->PointMapMode == POINT_MAP_BITSET ? "Bitset\n"
+          : this->PointMapMode == POINT_MAP_FUSED ? "Fused\n"
+                                                  : "Array\n");
 
   os << indent << "Fast Mode: " << (this->FastMode ? "On\n" : "Off\n");
   os << indent << "Remove Ghost Interfaces: " << (this->RemoveGhostInterfaces ? "On\n" : "Off\n")
@@ -326,6 +358,11 @@ void vtkGeometryFilterPHash::PrintSelf(ostream& os, vtkIndent indent)
   os << indent << "OriginalPointIdsName: " << this->GetOriginalPointIdsName() << endl;
 
   os << indent << "NonlinearSubdivisionLevel: " << this->GetNonlinearSubdivisionLevel() << endl;
+  os << indent << "CellMaskArrayName: "
+     << (this->CellMaskArrayName ? this->CellMaskArrayName : "(none)") << endl;
+  os << indent << "RegionIdsArrayName: "
+     << (this->RegionIdsArrayName ? this->RegionIdsArrayName : "(none)") << endl;
+  os << indent << "RegionIdPairsName: " << this->GetRegionIdPairsName() << endl;
 }
 
 //------------------------------------------------------------------------------
@@ -341,6 +378,8 @@ class Face
 public:
   Face* Next = nullptr;
   TInputIdType OriginalCellId;
+  // The other cell of an interface between two regions, or -1
+  TInputIdType NeighborCellId = -1;
   TInputIdType* PointIds;
   int NumberOfPoints;
   bool IsGhost;
@@ -661,6 +700,12 @@ public:
   }
 };
 
+// Number of entries of CellArrayType::Cells that are composited as one unit of
+// work. The output connectivity and offsets of a chunk of 16K entries, together
+// with its input, take about 200 KiB, so the streaming writes of a chunk stay
+// in the L2 cache of the core that composites it.
+constexpr vtkIdType CompositeChunkSize = 16384;
+
 // This class accumulates cell array-related information. Also marks points
 // as used if a point map is provided.
 template <typename TInputIdType>
@@ -670,28 +715,55 @@ private:
   TInputIdType* PointMap;
   vtkStaticCellLinksTemplate<TInputIdType>* ExcFaces;
   const unsigned char* PointGhost;
+  PointUsageBits* PointBits;
+  typename FusedPointMap<TInputIdType>::Allocator* PointIds;
+  vtkIdType NextChunkStart;
+  bool RecordNeighbors;
 
 public:
   // Make things a little more expressive
   using IdListType = std::vector<TInputIdType>;
   IdListType Cells;
   IdListType OrigCellIds;
+  // The other cell of each cell if neighbors are recorded, -1 for the external faces
+  IdListType NeighborCellIds;
+
+  // The first cell of every chunk of about CompositeChunkSize entries of Cells:
+  // its index and its position in Cells. Recorded while inserting, so that the
+  // chunks can be composited independently without walking the cells first.
+  struct ChunkStart
+  {
+    vtkIdType CellId;
+    vtkIdType Entry;
+  };
+  std::vector<ChunkStart> ChunkStarts;
 
   CellArrayType()
     : PointMap(nullptr)
     , ExcFaces(nullptr)
     , PointGhost(nullptr)
+    , PointBits(nullptr)
+    , PointIds(nullptr)
+    , NextChunkStart(0)
+    , RecordNeighbors(false)
   {
   }
 
   void SetPointsGhost(const unsigned char* pointGhost) { this->PointGhost = pointGhost; }
   void SetPointMap(TInputIdType* ptMap) { this->PointMap = ptMap; }
+  void SetPointBits(PointUsageBits* ptBits) { this->PointBits = ptBits; }
+  void SetPointIds(typename FusedPointMap<TInputIdType>::Allocator* ptIds)
+  {
+    this->PointIds = ptIds;
+  }
   void SetExcludedFaces(vtkStaticCellLinksTemplate<TInputIdType>* exc) { this->ExcFaces = exc; }
+  void SetRecordNeighbors(bool recordNeighbors) { this->RecordNeighbors = recordNeighbors; }
   vtkIdType GetNumberOfCells() { return static_cast<vtkIdType>(this->OrigCellIds.size()); }
   vtkIdType GetNumberOfConnEntries() { return static_cast<vtkIdType>(this->Cells.size()); }
 
   template <typename TGivenIds>
-  void InsertNextCell(TGivenIds npts, const TGivenIds* pts, TGivenIds cellId)
+  void InsertNextCell(
+    TGivenIds npts, const TGivenIds* pts, TGivenIds cellId, TGivenIds neighborCellId = -1)
   {
     // Only insert the face cell if it's not excluded
     if (this->ExcFaces && this->ExcFaces->MatchesCell(npts, pts))
@@ -710,8 +782,31 @@ public:
     }
 
     // Okay insert the boundary face cell
+    const vtkIdType entry = static_cast<vtkIdType>(this->Cells.size());
+    if (entry >= this->NextChunkStart)
+    {
+      this->ChunkStarts.push_back(ChunkStart{ this->GetNumberOfCells(), entry });
+      this->NextChunkStart = entry + CompositeChunkSize;
+    }
     this->Cells.emplace_back(npts);
-    if (!this->PointMap)
+    if (this->PointIds)
+    {
+      // write the output ids right away
+      for (auto i = 0; i < npts; ++i)
+      {
+        this->Cells.emplace_back(
+          this->PointIds->GetOutputId(static_cast<TInputIdType>(pts[i])));
+      }
+    }
+    else if (this->PointBits)
+    {
+      for (auto i = 0; i < npts; ++i)
+      {
+        this->Cells.emplace_back(static_cast<TInputIdType>(pts[i]));
+        this->PointBits->Mark(pts[i]);
+      }
+    }
+    else if (!this->PointMap)
     {
       for (auto i = 0; i < npts; ++i)
       {
@@ -727,6 +822,10 @@ public:
       }
     }
     this->OrigCellIds.emplace_back(static_cast<TInputIdType>(cellId));
+    if (this->RecordNeighbors)
+    {
+      this->NeighborCellIds.emplace_back(static_cast<TInputIdType>(neighborCellId));
+    }
   }
 };
 
@@ -751,14 +850,20 @@ private:
   };
   size_t Size;
   std::vector<Bucket> Buckets;
+  const vtkIdType* RegionIds;
 
 public:
   FaceHashMap(const size_t& size)
     : Size(size)
+    , RegionIds(nullptr)
   {
     this->Buckets.resize(this->Size);
   }
 
+  // With region ids per cell, a face shared by cells of different regions is kept as an
+  // interface, which belongs to the cell of the lower region, so that it faces the other one.
+  void SetRegionIds(const vtkIdType* regionIds) { this->RegionIds = regionIds; }
+
   template <typename FaceType>
   void Insert(const FaceType& f, TFaceMemoryPool& pool)
   {
@@ -774,6 +879,26 @@ public:
     {
       if (*current == f)
       {
+        if (this->RegionIds &&
+          this->RegionIds[current->OriginalCellId] != this->RegionIds[f.OriginalCellId])
+        {
+          if (this->RegionIds[f.OriginalCellId] < this->RegionIds[current->OriginalCellId])
+          {
+            // the face of the lower region, with its orientation
+            current->NeighborCellId = current->OriginalCellId;
+            current->OriginalCellId = f.OriginalCellId;
+            current->IsGhost = f.IsGhost;
+            for (int i = 0; i < f.GetSize(); ++i)
+            {
+              current->PointIds[i] = f.PointIds[i];
+            }
+          }
+          else
+          {
+            current->NeighborCellId = f.OriginalCellId;
+          }
+          return;
+        }
         // delete the duplicate
         if (bucketHead == current)
         {
@@ -792,6 +917,7 @@ public:
     TFace* newF = pool.Allocate(f.GetSize());
     newF->Next = nullptr;
     newF->OriginalCellId = f.OriginalCellId;
+    newF->NeighborCellId = -1;
     newF->IsGhost = f.IsGhost;
     for (int i = 0; i < f.GetSize(); ++i)
     {
@@ -809,25 +935,31 @@ public:
 
   void PopulateCellArrays(std::vector<TCellArrayType*>& threadedPolys)
   {
+    TraceScope scope("PopulateCellArrays");
     std::vector<TFace*> faces;
-    for (auto& bucket : this->Buckets)
     {
-      if (bucket.Head != nullptr)
+      // the serial walk over the buckets
+      TraceScope bucketWalkScope("PopulateCellArrays::BucketWalk");
+      for (auto& bucket : this->Buckets)
       {
-        auto current = bucket.Head;
-        while (current != nullptr)
+        if (bucket.Head != nullptr)
         {
-          if (!current->IsGhost)
+          auto current = bucket.Head;
+          while (current != nullptr)
           {
-            faces.push_back(current);
+            if (!current->IsGhost)
+            {
+              faces.push_back(current);
+            }
+            current = current->Next;
           }
-          current = current->Next;
         }
       }
     }
     const vtkIdType numberOfThreads = static_cast<vtkIdType>(threadedPolys.size());
     const vtkIdType numberOfFaces = static_cast<vtkIdType>(faces.size());
     vtkSMPTools::For(0, numberOfThreads, [&](vtkIdType beginThreadId, vtkIdType endThreadId) {
+      TraceScope insertScope("PopulateCellArrays::InsertFaces");
       for (vtkIdType threadId = beginThreadId; threadId < endThreadId; ++threadId)
       {
         vtkIdType begin = threadId * numberOfFaces / numberOfThreads;
@@ -836,7 +968,7 @@ public:
         {
           auto& f = faces[i];
           threadedPolys[threadId]->template InsertNextCell<TInputIdType>(
-            f->NumberOfPoints, f->PointIds, f->OriginalCellId);
+            f->NumberOfPoints, f->PointIds, f->OriginalCellId, f->NeighborCellId);
         }
       }
     });
@@ -860,6 +992,10 @@ struct LocalDataType
   // If point merging is specified, then a non-null point map is provided.
   TInputIdType* PointMap;
 
+  // Hands out the output ids of the points that this thread touches first
+  // with POINT_MAP_FUSED.
+  typename FusedPointMap<TInputIdType>::Allocator PointIdAllocator;
+
   // These collect the boundary entities from geometry extraction. Note also
   // that these implicitly keep track of the number of cells inserted.
   TCellArrayType Verts;
@@ -977,6 +1113,27 @@ struct LocalDataType
     this->Strips.SetPointMap(ptMap);
   }
 
+  void SetPointBits(PointUsageBits* ptBits)
+  {
+    this->Verts.SetPointBits(ptBits);
+    this->Lines.SetPointBits(ptBits);
+    this->Polys.SetPointBits(ptBits);
+    this->Strips.SetPointBits(ptBits);
+  }
+
+  void SetFusedPointMap(FusedPointMap<TInputIdType>* fusedMap)
+  {
+    auto* ptIds = fusedMap ? &this->PointIdAllocator : nullptr;
+    if (fusedMap)
+    {
+      this->PointIdAllocator.SetMap(fusedMap);
+    }
+    this->Verts.SetPointIds(ptIds);
+    this->Lines.SetPointIds(ptIds);
+    this->Polys.SetPointIds(ptIds);
+    this->Strips.SetPointIds(ptIds);
+  }
+
   void SetExcludedFaces(vtkStaticCellLinksTemplate<TInputIdType>* exc)
   {
     this->Verts.SetExcludedFaces(exc);
@@ -1311,8 +1468,12 @@ template <typename TInputIdType>
 struct ExtractCellBoundaries
 {
   vtkGeometryFilterPHash* Self;
-  // If point merging is specified, then a point map is created.
+  // If point merging is specified, then a point map is created, or the used
+  // points are marked in a bitset with POINT_MAP_BITSET, or numbered on first
+  // touch with POINT_MAP_FUSED.
   TInputIdType* PointMap;
+  std::unique_ptr<PointUsageBits> PointBits;
+  std::unique_ptr<FusedPointMap<TInputIdType>> FusedMap;
 
   // Cell visibility and cell ghost levels
   const char* CellVis;
@@ -1355,6 +1516,16 @@ struct ExtractCellBoundaries
   // to new points).
   void CreatePointMap(vtkIdType numPts)
   {
+    if (this->Self->GetPointMapMode() == vtkGeometryFilterPHash::POINT_MAP_BITSET)
+    {
+      this->PointBits.reset(new PointUsageBits(numPts));
+      return;
+    }
+    if (this->Self->GetPointMapMode() == vtkGeometryFilterPHash::POINT_MAP_FUSED)
+    {
+      this->FusedMap.reset(new FusedPointMap<TInputIdType>(numPts));
+      return;
+    }
     this->PointMap = new TInputIdType[numPts];
     vtkSMPTools::Fill(this->PointMap, this->PointMap + numPts, -1);
   }
@@ -1365,6 +1536,8 @@ struct ExtractCellBoundaries
     // Make sure cells have been built
     auto& localData = this->LocalData.Local();
     localData.SetPointMap(this->PointMap);
+    localData.SetPointBits(this->PointBits.get());
+    localData.SetFusedPointMap(this->FusedMap.get());
     localData.SetExcludedFaces(this->ExcFaces);
     localData.Verts.SetPointsGhost(this->PointGhost);
     localData.Lines.SetPointsGhost(this->PointGhost);
@@ -1444,18 +1617,25 @@ struct ExtractUG : public ExtractCellBoundaries<TInputIdType>
   std::shared_ptr<TFaceHashMap> FaceMap;
   bool RemoveGhostInterfaces;
 
+  // The cells to visit, or nullptr to visit all cells, and their number.
+  const vtkIdType* CellIds;
   vtkIdType NumberOfCells;
   const unsigned char MASKED_CELL;
 
+  // The region of each cell, or nullptr to remove all faces shared by two cells.
+  const vtkIdType* RegionIds;
+
   ExtractUG(vtkGeometryFilterPHash* self, vtkUnstructuredGridBase* grid, const char* cellVis,
     const unsigned char* cellGhost, const unsigned char* pointGhost,
     vtkExcludedFaces<TInputIdType>* exc, ThreadOutputType<TInputIdType>* t)
     : ExtractCellBoundaries<TInputIdType>(self, cellVis, cellGhost, pointGhost, exc, t)
     , Grid(grid)
     , RemoveGhostInterfaces(self->GetRemoveGhostInterfaces())
+    , CellIds(nullptr)
     , NumberOfCells(grid->GetNumberOfCells())
     , MASKED_CELL(
         self->GetRemoveGhostInterfaces() ? MASKED_CELL_VALUE : MASKED_CELL_VALUE_NOT_VISIBLE)
+    , RegionIds(nullptr)
   {
     if (self->GetMerging())
     {
@@ -1464,15 +1644,34 @@ struct ExtractUG : public ExtractCellBoundaries<TInputIdType>
     this->FaceMap = std::make_shared<TFaceHashMap>(static_cast<size_t>(grid->GetNumberOfPoints()));
   }
 
+  // Restrict the extraction to the given cells, e.g. the candidates of an extent. The cells
+  // are then visited by their index in the list.
+  void SetCellIds(const vtkIdType* cellIds, vtkIdType numberOfCells)
+  {
+    this->CellIds = cellIds;
+    this->NumberOfCells = numberOfCells;
+  }
+
+  // Keep the faces shared by cells of different regions, and record the other cell of each
+  // output polygon.
+  void SetRegionIds(const vtkIdType* regionIds)
+  {
+    this->RegionIds = regionIds;
+    this->FaceMap->SetRegionIds(regionIds);
+  }
+
   // Initialize thread data
   void Initialize() override
   {
     this->ExtractCellBoundaries<TInputIdType>::Initialize();
-    this->LocalData.Local().InitializeFacePool(this->Grid->GetNumberOfPoints());
+    auto& localData = this->LocalData.Local();
+    localData.InitializeFacePool(this->Grid->GetNumberOfPoints());
+    localData.Polys.SetRecordNeighbors(this->RegionIds != nullptr);
   }
 
-  void operator()(vtkIdType beginCellId, vtkIdType endCellId)
+  void operator()(vtkIdType beginIndex, vtkIdType endIndex)
   {
+    TraceScope scope("ExtractUG::operator()");
     auto faceMap = this->FaceMap.get();
     auto& localData = this->LocalData.Local();
     auto& cellPointIds = localData.CellPointIds;
@@ -1482,8 +1681,9 @@ struct ExtractUG : public ExtractCellBoundaries<TInputIdType>
     unsigned char type;
     bool isGhost;
     bool isFirst = vtkSMPTools::GetSingleThread();
-    for (vtkIdType cellId = beginCellId; cellId < endCellId; ++cellId)
+    for (vtkIdType index = beginIndex; index < endIndex; ++index)
     {
+      const vtkIdType cellId = this->CellIds ? this->CellIds[index] : index;
       // -------------------------------------Ghost explanation-------------------------------------
       // Note for both cell dimension cases: MASKED_CELL is computed based on RemoveGhostInterfaces.
       //
@@ -1524,13 +1724,15 @@ struct ExtractUG : public ExtractCellBoundaries<TInputIdType>
     }   // for all cells in this batch
     if (isFirst)
     {
-      this->Self->UpdateProgress(static_cast<double>(0.8 * endCellId / this->NumberOfCells));
+      this->Self->UpdateProgress(static_cast<double>(0.8 * endIndex / this->NumberOfCells));
     }
   } // operator()
 
   // Composite local thread data
   void Reduce() override
   {
+    TraceScope scope("ExtractUG::Reduce");
+    ScopedPhaseTimer reduceTimer(this->Self->GetMetrics(), "seconds-extract-reduce");
     std::vector<CellArrayType<TInputIdType>*> threadedPolys;
     for (auto& localData : this->LocalData)
     {
@@ -1952,7 +2154,7 @@ struct ExtractDS : public ExtractCellBoundaries<TInputIdType>
     } // for all cells in this batch
     if (isFirst)
     {
-      this->Self->UpdateProgress(static_cast<double>(0.8 * endCellId / this->NumberOfCells));
+      this->Self->UpdateProgress(static_cast<double>(0.8 * endIndex / this->NumberOfCells));
     }
   } // operator()
 
@@ -2025,14 +2227,19 @@ struct GenerateExpPoints
   TIP* InPts;
   TOP* OutPts;
   TInputIdType* PointMap;
-  ArrayList* PtArrays;
+  const PointUsageBits* PointBits;
+  const FusedPointMap<TInputIdType>* FusedMap;
+  AttributeGather* PtArrays;
   vtkGeometryFilterPHash* Filter;
 
-  GenerateExpPoints(
-    TIP* inPts, TOP* outPts, TInputIdType* ptMap, ArrayList* ptArrays, vtkGeometryFilterPHash* filter)
+  GenerateExpPoints(TIP* inPts, TOP* outPts, TInputIdType* ptMap, const PointUsageBits* ptBits,
+    const FusedPointMap<TInputIdType>* fusedMap, AttributeGather* ptArrays,
+    vtkGeometryFilterPHash* filter)
     : InPts(inPts)
     , OutPts(outPts)
     , PointMap(ptMap)
+    , PointBits(ptBits)
+    , FusedMap(fusedMap)
     , PtArrays(ptArrays)
     , Filter(filter)
   {
@@ -2040,31 +2247,92 @@ struct GenerateExpPoints
 
   void operator()(vtkIdType ptId, vtkIdType endPtId)
   {
+    TraceScope scope("GenerateExpPoints::operator()");
     const auto inPts = vtk::DataArrayTupleRange<3>(this->InPts);
     auto outPts = vtk::DataArrayTupleRange<3>(this->OutPts);
     vtkIdType mapId;
     bool isFirst = vtkSMPTools::GetSingleThread();
-
-    for (; ptId < endPtId; ++ptId)
+    if (this->FusedMap)
     {
+      // The range is one of output points, whose input points are known.
       if (isFirst)
       {
         this->Filter->CheckAbort();
       }
       if (this->Filter->GetAbortOutput())
       {
-        break;
+        return;
       }
-      if ((mapId = this->PointMap[ptId]) >= 0)
+      const TInputIdType* inputIds = this->FusedMap->GetInputIds();
+      for (vtkIdType outId = ptId; outId < endPtId; ++outId)
       {
-        auto xIn = inPts[ptId];
-        auto xOut = outPts[mapId];
+        auto xIn = inPts[inputIds[outId]];
+        auto xOut = outPts[outId];
         xOut[0] = xIn[0];
         xOut[1] = xIn[1];
         xOut[2] = xIn[2];
-        this->PtArrays->Copy(ptId, mapId);
+      }
+      this->PtArrays->Gather(inputIds + ptId, ptId, endPtId - ptId);
+      return;
+    }
+
+    // The point map numbers the used points in input order, so the used points of this
+    // range are contiguous in the output and their attributes are gathered at the end.
+    const bool gatherAttributes = !this->PtArrays->IsEmpty();
+    std::vector<TInputIdType> inputIds;
+    vtkIdType outputBegin = 0;
+    if (gatherAttributes)
+    {
+      inputIds.reserve(endPtId - ptId);
+    }
+    auto generatePoint = [&](vtkIdType inId, vtkIdType outId) {
+      auto xIn = inPts[inId];
+      auto xOut = outPts[outId];
+      xOut[0] = xIn[0];
+      xOut[1] = xIn[1];
+      xOut[2] = xIn[2];
+      if (gatherAttributes)
+      {
+        if (inputIds.empty())
+        {
+          outputBegin = outId;
+        }
+        inputIds.push_back(static_cast<TInputIdType>(inId));
+      }
+    };
+
+    if (this->PointBits)
+    {
+      // only the used points of the range are visited
+      if (isFirst)
+      {
+        this->Filter->CheckAbort();
+      }
+      if (!this->Filter->GetAbortOutput())
+      {
+        this->PointBits->ForEachUsed(ptId, endPtId, generatePoint);
       }
     }
+    else
+    {
+      for (; ptId < endPtId; ++ptId)
+      {
+        if (isFirst)
+        {
+          this->Filter->CheckAbort();
+        }
+        if (this->Filter->GetAbortOutput())
+        {
+          break;
+        }
+        if ((mapId = this->PointMap[ptId]) >= 0)
+        {
+          generatePoint(ptId, mapId);
+        }
+      }
+    }
+    this->PtArrays->Gather(
+      inputIds.data(), outputBegin, static_cast<vtkIdType>(inputIds.size()));
   }
 };
 
@@ -2075,14 +2343,19 @@ struct GenerateImpPoints
   vtkDataSet* InPts;
   TOP* OutPts;
   TInputIdType* PointMap;
+  const PointUsageBits* PointBits;
+  const FusedPointMap<TInputIdType>* FusedMap;
   ArrayList* PtArrays;
   vtkGeometryFilterPHash* Filter;
 
-  GenerateImpPoints(vtkDataSet* inPts, TOP* outPts, TInputIdType* ptMap, ArrayList* ptArrays,
-    vtkGeometryFilterPHash* filter)
+  GenerateImpPoints(vtkDataSet* inPts, TOP* outPts, TInputIdType* ptMap,
+    const PointUsageBits* ptBits, const FusedPointMap<TInputIdType>* fusedMap,
+    ArrayList* ptArrays, vtkGeometryFilterPHash* filter)
     : InPts(inPts)
     , OutPts(outPts)
     , PointMap(ptMap)
+    , PointBits(ptBits)
+    , FusedMap(fusedMap)
     , PtArrays(ptArrays)
     , Filter(filter)
   {
@@ -2094,6 +2367,45 @@ struct GenerateImpPoints
     double xIn[3];
     vtkIdType mapId;
     bool isFirst = vtkSMPTools::GetSingleThread();
+    auto generatePoint = [&](vtkIdType inId, vtkIdType outId) {
+      this->InPts->GetPoint(inId, xIn);
+      auto xOut = outPts[outId];
+      xOut[0] = xIn[0];
+      xOut[1] = xIn[1];
+      xOut[2] = xIn[2];
+      this->PtArrays->Copy(inId, outId);
+    };
+
+    if (this->FusedMap)
+    {
+      // The range is one of output points, whose input points are known.
+      if (isFirst)
+      {
+        this->Filter->CheckAbort();
+      }
+      if (!this->Filter->GetAbortOutput())
+      {
+        const TInputIdType* inputIds = this->FusedMap->GetInputIds();
+        for (vtkIdType outId = ptId; outId < endPtId; ++outId)
+        {
+          generatePoint(inputIds[outId], outId);
+        }
+      }
+      return;
+    }
+    if (this->PointBits)
+    {
+      // only the used points of the range are visited
+      if (isFirst)
+      {
+        this->Filter->CheckAbort();
+      }
+      if (!this->Filter->GetAbortOutput())
+      {
+        this->PointBits->ForEachUsed(ptId, endPtId, generatePoint);
+      }
+      return;
+    }
 
     for (; ptId < endPtId; ++ptId)
     {
@@ -2107,12 +2419,7 @@ struct GenerateImpPoints
       }
       if ((mapId = this->PointMap[ptId]) >= 0)
       {
-        this->InPts->GetPoint(ptId, xIn);
-        auto xOut = outPts[mapId];
-        xOut[0] = xIn[0];
-        xOut[1] = xIn[1];
-        xOut[2] = xIn[2];
-        this->PtArrays->Copy(ptId, mapId);
+        generatePoint(ptId, mapId);
       }
     }
   }
@@ -2132,10 +2439,27 @@ struct GeneratePtsWorker
   }
 
   // Create the final point map. This could be threaded (prefix_sum) but
-  // performance gains are minimal.
+  // performance gains are minimal. A point bitset is numbered by a threaded
+  // prefix sum instead, and the points of a fused point map are already
+  // numbered, so no point map is created for them.
   TInputIdType* GeneratePointMap(
     vtkIdType numInputPts, ExtractCellBoundaries<TInputIdType>* extract)
   {
+    if (extract->FusedMap)
+    {
+      for (auto& localData : extract->LocalData)
+      {
+        extract->FusedMap->Release(localData.PointIdAllocator);
+      }
+      this->NumOutputPoints = extract->FusedMap->Finalize();
+      return nullptr;
+    }
+    if (extract->PointBits)
+    {
+      this->NumOutputPoints = extract->PointBits->Scan();
+      return nullptr;
+    }
+
     // The PointMap has been marked as to which points are being used.
     // This needs to be updated to indicate the output point ids.
     TInputIdType* ptMap = extract->PointMap;
@@ -2168,13 +2492,15 @@ struct ExpPtsWorker : public GeneratePtsWorker<TInputIdType>
     TInputIdType* ptMap = this->GeneratePointMap(numInputPts, extract);
 
     // Now generate all of the points and point attribute data
-    ArrayList ptArrays;
+    AttributeGather ptArrays;
     outPD->CopyAllocate(inPD, this->NumOutputPoints);
-    ptArrays.AddArrays(this->NumOutputPoints, inPD, outPD, 0.0, false);
+    ptArrays.AddArrays(this->NumOutputPoints, inPD, outPD);
 
     outPts->SetNumberOfTuples(this->NumOutputPoints);
-    GenerateExpPoints<TIP, TOP, TInputIdType> genPts(inPts, outPts, ptMap, &ptArrays, this->Filter);
-    vtkSMPTools::For(0, numInputPts, genPts);
+    GenerateExpPoints<TIP, TOP, TInputIdType> genPts(inPts, outPts, ptMap,
+      extract->PointBits.get(), extract->FusedMap.get(), &ptArrays, this->Filter);
+    // the points of a fused point map are generated in output order
+    vtkSMPTools::For(0, extract->FusedMap ? this->NumOutputPoints : numInputPts, genPts);
   }
 };
 
@@ -2201,8 +2527,10 @@ struct ImpPtsWorker : public GeneratePtsWorker<TInputIdType>
     ptArrays.AddArrays(this->NumOutputPoints, inPD, outPD, 0.0, false);
 
     outPts->SetNumberOfTuples(this->NumOutputPoints);
-    GenerateImpPoints<TOP, TInputIdType> genPts(inPts, outPts, ptMap, &ptArrays, this->Filter);
-    vtkSMPTools::For(0, numInputPts, genPts);
+    GenerateImpPoints<TOP, TInputIdType> genPts(inPts, outPts, ptMap,
+      extract->PointBits.get(), extract->FusedMap.get(), &ptArrays, this->Filter);
+    // the points of a fused point map are generated in output order
+    vtkSMPTools::For(0, extract->FusedMap ? this->NumOutputPoints : numInputPts, genPts);
   }
 };
 
@@ -2211,7 +2539,9 @@ template <typename TInputIdType, typename TOutputIdType>
 struct CompositeCells
 {
   const TInputIdType* PointMap;
-  ArrayList* CellArrays;
+  const PointUsageBits* PointBits;
+  const FusedPointMap<TInputIdType>* FusedMap;
+  AttributeGather* CellArrays;
   ExtractCellBoundaries<TInputIdType>* Extractor;
   ThreadOutputType<TInputIdType>* Threads;
 
@@ -2233,11 +2563,13 @@ struct CompositeCells
   TOutputIdType* StripsOffsetPtr;
   vtkGeometryFilterPHash* Filter;
 
-  CompositeCells(TInputIdType* ptMap, ArrayList* cellArrays,
+  CompositeCells(TInputIdType* ptMap, AttributeGather* cellArrays,
     ExtractCellBoundaries<TInputIdType>* extract, ThreadOutputType<TInputIdType>* threads,
     vtkCellArray* verts, vtkCellArray* lines, vtkCellArray* polys, vtkCellArray* strips,
     vtkGeometryFilterPHash* filter)
     : PointMap(ptMap)
+    , PointBits(extract->PointBits.get())
+    , FusedMap(extract->FusedMap.get())
     , CellArrays(cellArrays)
     , Extractor(extract)
     , Threads(threads)
@@ -2277,6 +2609,7 @@ struct CompositeCells
       this->AllocateCellArray(extract->StripsNumPts, extract->StripsNumCells, this->Strips,
         this->StripsConnPtr, this->StripsOffsetPtr);
     }
+    this->PlanChunks();
   }
 
   // Helper function to allocate and construct output cell arrays.
@@ -2294,19 +2627,116 @@ struct CompositeCells
     ca->SetData(outOffsets, outConn);
   }
 
-  void CompositeCellArray(CellArrayType<TInputIdType>* cat, vtkIdType connOffset, vtkIdType offset,
+  // A range of the cells of one thread's cell array, with the positions of its
+  // first cell in the output, so that all chunks can be composited in any order.
+  struct Chunk
+  {
+    CellArrayType<TInputIdType>* CellArray;
+    vtkIdType BeginCell;    // first cell in the cell array
+    vtkIdType EndCell;      // one past the last cell in the cell array
+    vtkIdType BeginEntry;   // position of the first cell in CellArray->Cells
+    vtkIdType ConnOffset;   // position of the first cell in the output connectivity
+    vtkIdType Offset;       // position of the first cell in the output offsets
+    vtkIdType CellIdOffset; // first output cell id of the cell type
+    TOutputIdType* ConnPtr;
+    TOutputIdType* OffsetPtr;
+  };
+  std::vector<Chunk> Chunks;
+
+  vtkIdType GetNumberOfChunks() const { return static_cast<vtkIdType>(this->Chunks.size()); }
+
+  // Splits a thread's cell array into chunks at its recorded chunk starts.
+  void AddChunks(CellArrayType<TInputIdType>* cat, vtkIdType connOffset, vtkIdType offset,
     vtkIdType cellIdOffset, TOutputIdType* connPtr, TOutputIdType* offsetPtr)
   {
-    TInputIdType* cells = cat->Cells.data();
-    vtkIdType numCells = cat->GetNumberOfCells();
-    connPtr += connOffset;
-    offsetPtr += offset;
-    vtkIdType offsetVal = connOffset;
-    vtkIdType globalCellId = cellIdOffset + offset;
+    const auto& starts = cat->ChunkStarts;
+    for (std::size_t i = 0; i < starts.size(); ++i)
+    {
+      Chunk chunk;
+      chunk.CellArray = cat;
+      chunk.BeginCell = starts[i].CellId;
+      chunk.EndCell = i + 1 < starts.size() ? starts[i + 1].CellId : cat->GetNumberOfCells();
+      chunk.BeginEntry = starts[i].Entry;
+      // every cell before this one takes one more entry in Cells (its size) than
+      // in the output connectivity
+      chunk.ConnOffset = connOffset + starts[i].Entry - starts[i].CellId;
+      chunk.Offset = offset + starts[i].CellId;
+      chunk.CellIdOffset = cellIdOffset;
+      chunk.ConnPtr = connPtr;
+      chunk.OffsetPtr = offsetPtr;
+      this->Chunks.push_back(chunk);
+    }
+  }
+
+  // Gathers the chunks of all threads and cell types. Compositing over the
+  // chunks instead of the threads balances the work when the threads produced
+  // outputs of different sizes.
+  void PlanChunks()
+  {
+    auto* extract = this->Extractor;
+    for (auto tItr : *this->Threads)
+    {
+      if (this->VertsConnPtr)
+      {
+        this->AddChunks(&tItr->Verts, tItr->VertsConnOffset, tItr->VertsOffset,
+          extract->VertsCellIdOffset, this->VertsConnPtr, this->VertsOffsetPtr);
+      }
+      if (this->LinesConnPtr)
+      {
+        this->AddChunks(&tItr->Lines, tItr->LinesConnOffset, tItr->LinesOffset,
+          extract->LinesCellIdOffset, this->LinesConnPtr, this->LinesOffsetPtr);
+      }
+      if (this->PolysConnPtr)
+      {
+        this->AddChunks(&tItr->Polys, tItr->PolysConnOffset, tItr->PolysOffset,
+          extract->PolysCellIdOffset, this->PolysConnPtr, this->PolysOffsetPtr);
+      }
+      if (this->StripsConnPtr)
+      {
+        this->AddChunks(&tItr->Strips, tItr->StripsConnOffset, tItr->StripsOffset,
+          extract->StripsCellIdOffset, this->StripsConnPtr, this->StripsOffsetPtr);
+      }
+    }
+  }
+
+  void CompositeChunk(const Chunk& chunk)
+  {
+    const TInputIdType* cells = chunk.CellArray->Cells.data() + chunk.BeginEntry;
+    vtkIdType numCells = chunk.EndCell - chunk.BeginCell;
+    TOutputIdType* connPtr = chunk.ConnPtr + chunk.ConnOffset;
+    TOutputIdType* offsetPtr = chunk.OffsetPtr + chunk.Offset;
+    vtkIdType offsetVal = chunk.ConnOffset;
 
     // If not merging points, we reuse input points and so do not need to
-    // produce new points nor point data.
-    if (!this->PointMap)
+    // produce new points nor point data. The cells of a fused point map hold
+    // output ids already.
+    if (this->FusedMap)
+    {
+      for (auto cellId = 0; cellId < numCells; ++cellId)
+      {
+        *offsetPtr++ = static_cast<TOutputIdType>(offsetVal);
+        TInputIdType npts = *cells++;
+        for (auto i = 0; i < npts; ++i)
+        {
+          *connPtr++ = static_cast<TOutputIdType>(this->FusedMap->Resolve(*cells++));
+        }
+        offsetVal += npts;
+      }
+    }
+    else if (this->PointBits)
+    {
+      for (auto cellId = 0; cellId < numCells; ++cellId)
+      {
+        *offsetPtr++ = static_cast<TOutputIdType>(offsetVal);
+        TInputIdType npts = *cells++;
+        for (auto i = 0; i < npts; ++i)
+        {
+          *connPtr++ = static_cast<TOutputIdType>(this->PointBits->GetOutputId(*cells++));
+        }
+        offsetVal += npts;
+      }
+    }
+    else if (!this->PointMap)
     {
       for (auto cellId = 0; cellId < numCells; ++cellId)
       {
@@ -2317,7 +2747,6 @@ struct CompositeCells
           *connPtr++ = static_cast<TOutputIdType>(*cells++);
         }
         offsetVal += npts;
-        this->CellArrays->Copy(cat->OrigCellIds[cellId], globalCellId++);
       }
     }
     else // Merging - i.e., using a point map
@@ -2331,17 +2760,22 @@ struct CompositeCells
           *connPtr++ = static_cast<TOutputIdType>(this->PointMap[*cells++]);
         }
         offsetVal += npts;
-        this->CellArrays->Copy(cat->OrigCellIds[cellId], globalCellId++);
       }
     }
+
+    // Copy the cell attributes of the faces in one typed pass per array
+    this->CellArrays->Gather(chunk.CellArray->OrigCellIds.data() + chunk.BeginCell,
+      chunk.CellIdOffset + chunk.Offset, numCells);
   }
 
-  void operator()(vtkIdType thread, vtkIdType threadEnd)
+  // Composites the chunks [chunk, chunkEnd). Run with a grain of one chunk, so
+  // that idle threads steal the remaining chunks.
+  void operator()(vtkIdType chunk, vtkIdType chunkEnd)
   {
-    auto* extract = this->Extractor;
+    TraceScope scope("CompositeCells::operator()");
 
     bool isFirst = vtkSMPTools::GetSingleThread();
-    for (; thread < threadEnd; ++thread)
+    for (; chunk < chunkEnd; ++chunk)
     {
       if (isFirst)
       {
@@ -2351,71 +2785,44 @@ struct CompositeCells
       {
         break;
       }
-      auto tItr = (*this->Threads)[thread];
-
-      if (this->VertsConnPtr)
-      {
-        this->CompositeCellArray(&tItr->Verts, tItr->VertsConnOffset, tItr->VertsOffset,
-          extract->VertsCellIdOffset, this->VertsConnPtr, this->VertsOffsetPtr);
-      }
-      if (this->LinesConnPtr)
-      {
-        this->CompositeCellArray(&tItr->Lines, tItr->LinesConnOffset, tItr->LinesOffset,
-          extract->LinesCellIdOffset, this->LinesConnPtr, this->LinesOffsetPtr);
-      }
-      if (this->PolysConnPtr)
-      {
-        this->CompositeCellArray(&tItr->Polys, tItr->PolysConnOffset, tItr->PolysOffset,
-          extract->PolysCellIdOffset, this->PolysConnPtr, this->PolysOffsetPtr);
-      }
-      if (this->StripsConnPtr)
-      {
-        this->CompositeCellArray(&tItr->Strips, tItr->StripsConnOffset, tItr->StripsOffset,
-          extract->StripsCellIdOffset, this->StripsConnPtr, this->StripsOffsetPtr);
-      }
+      this->CompositeChunk(this->Chunks[chunk]);
     }
   }
 }; // CompositeCells
 
-// Composite threads to produce originating cell ids
+// Composite the chunks of the threads to produce originating cell ids
 template <typename TInputIdType, typename TOutputIdType>
 struct CompositeCellIds
 {
-  ExtractCellBoundaries<TInputIdType>* Extractor;
   ::CompositeCells<TInputIdType, TOutputIdType>* CompositeCells;
-  ThreadOutputType<TInputIdType>* Threads;
   vtkIdType* OrigIds;
   vtkGeometryFilterPHash* Filter;
 
-  CompositeCellIds(ExtractCellBoundaries<TInputIdType>* extract,
-    ::CompositeCells<TInputIdType, TOutputIdType>* compositeCells,
-    ThreadOutputType<TInputIdType>* threads, vtkIdType* origIds, vtkGeometryFilterPHash* filter)
-    : Extractor(extract)
-    , CompositeCells(compositeCells)
-    , Threads(threads)
+  CompositeCellIds(::CompositeCells<TInputIdType, TOutputIdType>* compositeCells,
+    vtkIdType* origIds, vtkGeometryFilterPHash* filter)
+    : CompositeCells(compositeCells)
     , OrigIds(origIds)
     , Filter(filter)
   {
   }
 
-  void CompositeIds(CellArrayType<TInputIdType>* cat, vtkIdType offset, vtkIdType cellIdOffset)
+  void CompositeIds(const typename ::CompositeCells<TInputIdType, TOutputIdType>::Chunk& chunk)
   {
-    vtkIdType numCells = cat->GetNumberOfCells();
-    vtkIdType globalCellId = cellIdOffset + offset;
+    const TInputIdType* origCellIds = chunk.CellArray->OrigCellIds.data();
+    vtkIdType globalCellId = chunk.CellIdOffset + chunk.Offset;
 
-    for (auto cellId = 0; cellId < numCells; ++cellId)
+    for (auto cellId = chunk.BeginCell; cellId < chunk.EndCell; ++cellId)
     {
-      this->OrigIds[globalCellId++] = cat->OrigCellIds[cellId];
+      this->OrigIds[globalCellId++] = origCellIds[cellId];
     }
   }
 
-  void operator()(vtkIdType thread, vtkIdType threadEnd)
+  void operator()(vtkIdType chunk, vtkIdType chunkEnd)
   {
-    auto* extract = this->Extractor;
-    auto* compositeCells = this->CompositeCells;
+    TraceScope scope("CompositeCellIds::operator()");
     bool isFirst = vtkSMPTools::GetSingleThread();
 
-    for (; thread < threadEnd; ++thread)
+    for (; chunk < chunkEnd; ++chunk)
     {
       if (isFirst)
       {
@@ -2425,27 +2832,47 @@ struct CompositeCellIds
       {
         break;
       }
-      auto tItr = (*this->Threads)[thread];
+      this->CompositeIds(this->CompositeCells->Chunks[chunk]);
+    }
+  }
+}; // CompositeCellIds
 
-      if (compositeCells->VertsConnPtr)
-      {
-        this->CompositeIds(&tItr->Verts, tItr->VertsOffset, extract->VertsCellIdOffset);
-      }
-      if (compositeCells->LinesConnPtr)
-      {
-        this->CompositeIds(&tItr->Lines, tItr->LinesOffset, extract->LinesCellIdOffset);
-      }
-      if (compositeCells->PolysConnPtr)
-      {
-        this->CompositeIds(&tItr->Polys, tItr->PolysOffset, extract->PolysCellIdOffset);
-      }
-      if (compositeCells->StripsConnPtr)
+// Composites the regions of the originating cell and of the cell on the other side of each
+// output cell, in the same chunks as the cells.
+template <typename TInputIdType, typename TOutputIdType>
+struct CompositeRegionIdPairs
+{
+  ::CompositeCells<TInputIdType, TOutputIdType>* CompositeCells;
+  const vtkIdType* RegionIds;
+  vtkIdType* Pairs;
+
+  CompositeRegionIdPairs(::CompositeCells<TInputIdType, TOutputIdType>* compositeCells,
+    const vtkIdType* regionIds, vtkIdType* pairs)
+    : CompositeCells(compositeCells)
+    , RegionIds(regionIds)
+    , Pairs(pairs)
+  {
+  }
+
+  void operator()(vtkIdType chunk, vtkIdType chunkEnd)
+  {
+    for (; chunk < chunkEnd; ++chunk)
+    {
+      const auto& c = this->CompositeCells->Chunks[chunk];
+      const TInputIdType* origCellIds = c.CellArray->OrigCellIds.data();
+      // only the polygons record the other cell
+      const TInputIdType* neighborCellIds =
+        c.CellArray->NeighborCellIds.empty() ? nullptr : c.CellArray->NeighborCellIds.data();
+      vtkIdType* pair = this->Pairs + 2 * (c.CellIdOffset + c.Offset);
+      for (auto cellId = c.BeginCell; cellId < c.EndCell; ++cellId, pair += 2)
       {
-        this->CompositeIds(&tItr->Strips, tItr->StripsOffset, extract->StripsCellIdOffset);
+        const vtkIdType neighborCellId = neighborCellIds ? neighborCellIds[cellId] : -1;
+        pair[0] = this->RegionIds[origCellIds[cellId]];
+        pair[1] = neighborCellId >= 0 ? this->RegionIds[neighborCellId] : -1;
       }
     }
   }
-}; // CompositeCellIds
+}; // CompositeRegionIdPairs
 
 } // anonymous namespace
 
@@ -2786,19 +3213,41 @@ struct CharacterizeGrid
 };
 
 //------------------------------------------------------------------------------
-// Threaded creation to generate array of originating point ids.
+// Threaded creation to generate array of originating point ids, which is added to outPD
+// unless it is nullptr.
 template <typename TInputIdType>
-void PassPointIds(const char* name, vtkIdType numInputPts, vtkIdType numOutputPts,
-  TInputIdType* ptMap, vtkPointData* outPD)
+vtkSmartPointer<vtkIdTypeArray> PassPointIds(const char* name, vtkIdType numInputPts,
+  vtkIdType numOutputPts, ExtractCellBoundaries<TInputIdType>* extract, vtkPointData* outPD)
 {
-  vtkNew<vtkIdTypeArray> origPtIds;
+  TInputIdType* ptMap = extract->PointMap;
+  const PointUsageBits* ptBits = extract->PointBits.get();
+  vtkSmartPointer<vtkIdTypeArray> origPtIds = vtkSmartPointer<vtkIdTypeArray>::New();
   origPtIds->SetName(name);
   origPtIds->SetNumberOfComponents(1);
   origPtIds->SetNumberOfTuples(numOutputPts);
-  outPD->AddArray(origPtIds);
+  if (outPD)
+  {
+    outPD->AddArray(origPtIds);
+  }
   vtkIdType* origIds = origPtIds->GetPointer(0);
 
   // Now threaded populate the array
+  if (extract->FusedMap)
+  {
+    const TInputIdType* inputIds = extract->FusedMap->GetInputIds();
+    vtkSMPTools::For(0, numOutputPts, [&origIds, inputIds](vtkIdType ptId, vtkIdType endPtId) {
+      std::copy(inputIds + ptId, inputIds + endPtId, origIds + ptId);
+    });
+    return origPtIds;
+  }
+  if (ptBits)
+  {
+    vtkSMPTools::For(0, numInputPts, [&origIds, &ptBits](vtkIdType ptId, vtkIdType endPtId) {
+      ptBits->ForEachUsed(
+        ptId, endPtId, [&origIds](vtkIdType inId, vtkIdType outId) { origIds[outId] = inId; });
+    });
+    return origPtIds;
+  }
   vtkSMPTools::For(0, numInputPts, [&origIds, &ptMap](vtkIdType ptId, vtkIdType endPtId) {
     for (; ptId < endPtId; ++ptId)
     {
@@ -2808,27 +3257,51 @@ void PassPointIds(const char* name, vtkIdType numInputPts, vtkIdType numOutputPt
       }
     }
   });
+  return origPtIds;
 }
 
 //------------------------------------------------------------------------------
-// Threaded compositing of originating cell ids.
+// Threaded compositing of originating cell ids, which are added to outCD unless it is nullptr.
 template <typename TInputIdType, typename TOutputIdType>
-void PassCellIds(const char* name, ExtractCellBoundaries<TInputIdType>* extract,
-  CompositeCells<TInputIdType, TOutputIdType>* compositeCells,
-  ThreadOutputType<TInputIdType>* threads, vtkCellData* outCD, vtkGeometryFilterPHash* filter)
+vtkSmartPointer<vtkIdTypeArray> PassCellIds(const char* name,
+  ExtractCellBoundaries<TInputIdType>* extract,
+  CompositeCells<TInputIdType, TOutputIdType>* compositeCells, vtkCellData* outCD,
+  vtkGeometryFilterPHash* filter)
 {
   vtkIdType numOutputCells = extract->NumCells;
-  vtkNew<vtkIdTypeArray> origCellIds;
+  vtkSmartPointer<vtkIdTypeArray> origCellIds = vtkSmartPointer<vtkIdTypeArray>::New();
   origCellIds->SetName(name);
   origCellIds->SetNumberOfComponents(1);
   origCellIds->SetNumberOfTuples(numOutputCells);
-  outCD->AddArray(origCellIds);
+  if (outCD)
+  {
+    outCD->AddArray(origCellIds);
+  }
   vtkIdType* origIds = origCellIds->GetPointer(0);
 
   // Now populate the original cell ids
-  CompositeCellIds<TInputIdType, TOutputIdType> compIds(
-    extract, compositeCells, threads, origIds, filter);
-  vtkSMPTools::For(0, static_cast<vtkIdType>(threads->size()), compIds);
+  CompositeCellIds<TInputIdType, TOutputIdType> compIds(compositeCells, origIds, filter);
+  vtkSMPTools::For(0, compositeCells->GetNumberOfChunks(), 1, compIds);
+  return origCellIds;
+}
+
+//------------------------------------------------------------------------------
+// Threaded compositing of the region id pairs of the output cells.
+template <typename TInputIdType, typename TOutputIdType>
+vtkSmartPointer<vtkIdTypeArray> PassRegionIdPairs(const char* name, const vtkIdType* regionIds,
+  ExtractCellBoundaries<TInputIdType>* extract,
+  CompositeCells<TInputIdType, TOutputIdType>* compositeCells, vtkCellData* outCD)
+{
+  vtkSmartPointer<vtkIdTypeArray> regionIdPairs = vtkSmartPointer<vtkIdTypeArray>::New();
+  regionIdPairs->SetName(name);
+  regionIdPairs->SetNumberOfComponents(2);
+  regionIdPairs->SetNumberOfTuples(extract->NumCells);
+  outCD->AddArray(regionIdPairs);
+
+  CompositeRegionIdPairs<TInputIdType, TOutputIdType> compPairs(
+    compositeCells, regionIds, regionIdPairs->GetPointer(0));
+  vtkSMPTools::For(0, compositeCells->GetNumberOfChunks(), 1, compPairs);
+  return regionIdPairs;
 }
 
 } // anonymous
@@ -2881,6 +3354,192 @@ void vtkGeometryFilterPHashHelper::CopyFilterParams(vtkDataSetSurfaceFilter* dss
 namespace
 {
 //----------------------------------------------------------------------------
+//------------------------------------------------------------------------------
+// The cell mask of the input, or nullptr if none is set or it is not a valid mask.
+vtkDataArray* GetCellMask(vtkGeometryFilterPHash* self, vtkDataSet* input)
+{
+  const char* name = self->GetCellMaskArrayName();
+  vtkDataArray* mask = CellVisibility::FindCellMask(input, name);
+  if (name && !mask)
+  {
+    vtkWarningWithObjectMacro(self,
+      << "No cell mask " << name
+      << ", which must be an unsigned char or bit cell array with one component; "
+         "all cells are used.");
+  }
+  return mask;
+}
+
+struct CopyRegionIdsWorker
+{
+  template <typename RegionArray>
+  void operator()(RegionArray* regions, vtkIdType* regionIds) const
+  {
+    const auto values = vtk::DataArrayValueRange<1>(regions);
+    vtkSMPTools::For(0, regions->GetNumberOfTuples(),
+      [&](vtkIdType cellId, vtkIdType endCellId)
+      {
+        for (; cellId < endCellId; ++cellId)
+        {
+          regionIds[cellId] = static_cast<vtkIdType>(values[cellId]);
+        }
+      });
+  }
+};
+
+// Copies the region of each cell of the input into regionIds. Returns false if no region
+// array is set or it is not an integral cell array with one component.
+bool GetRegionIds(
+  vtkGeometryFilterPHash* self, vtkDataSet* input, std::vector<vtkIdType>& regionIds)
+{
+  const char* name = self->GetRegionIdsArrayName();
+  if (!name)
+  {
+    return false;
+  }
+  vtkDataArray* regions = input->GetCellData()->GetArray(name);
+  if (regions && regions->GetNumberOfComponents() == 1 &&
+    regions->GetNumberOfTuples() == input->GetNumberOfCells())
+  {
+    regionIds.resize(static_cast<size_t>(input->GetNumberOfCells()));
+    using RegionDispatch = vtkArrayDispatch::DispatchByValueType<vtkArrayDispatch::Integrals>;
+    if (RegionDispatch::Execute(regions, CopyRegionIdsWorker{}, regionIds.data()))
+    {
+      return true;
+    }
+  }
+  vtkWarningWithObjectMacro(self,
+    << "No region ids " << name
+    << ", which must be an integral cell array with one component; shared faces are removed.");
+  regionIds.clear();
+  return false;
+}
+
+// The modification times and settings that the surface of an unstructured grid depends on,
+// besides its points and attributes.
+std::vector<vtkMTimeType> GetTopologyKey(
+  vtkGeometryFilterPHash* self, vtkUnstructuredGridBase* input, vtkDataArray* cellMask)
+{
+  auto getTime = [](vtkObject* object) { return object ? object->GetMTime() : vtkMTimeType(0); };
+  auto value = [](vtkIdType v) { return static_cast<vtkMTimeType>(v); };
+  // The links of an unstructured grid are reset without changing its cells, which modifies the
+  // grid, so its cells are tracked through its cell array.
+  vtkUnstructuredGrid* grid = vtkUnstructuredGrid::SafeDownCast(input);
+  const char* regionsName = self->GetRegionIdsArrayName();
+  vtkDataArray* regions = regionsName ? input->GetCellData()->GetArray(regionsName) : nullptr;
+  return { static_cast<vtkMTimeType>(reinterpret_cast<std::uintptr_t>(input)),
+    grid && grid->GetCells() ? grid->GetCells()->GetMTime() : input->GetMTime(),
+    value(input->GetNumberOfPoints()), value(input->GetNumberOfCells()),
+    getTime(input->GetCellData()->GetGhostArray()),
+    getTime(input->GetPointData()->GetGhostArray()), getTime(cellMask),
+    value(regionsName != nullptr), getTime(regions), value(self->GetCellClipping()),
+    value(self->GetCellMinimum()), value(self->GetCellMaximum()),
+    value(self->GetPointClipping()), value(self->GetPointMinimum()),
+    value(self->GetPointMaximum()), value(self->GetMerging()), value(self->GetPointMapMode()),
+    value(self->GetFastMode()), value(self->GetRemoveGhostInterfaces()) };
+}
+
+// Adds a cached id array to the attributes under the given name, without copying its ids.
+void AddCachedIds(vtkIdTypeArray* ids, const char* name, vtkDataSetAttributes* attributes)
+{
+  vtkNew<vtkIdTypeArray> namedIds;
+  namedIds->ShallowCopy(ids);
+  namedIds->SetName(name);
+  attributes->AddArray(namedIds);
+}
+
+// Sets the cached cells on the output and gathers its points and attributes from the input,
+// in parallel over the cached input ids of the output points and cells.
+int RestoreSurface(vtkGeometryFilterPHash* self, vtkUnstructuredGridBase* input,
+  vtkPolyData* output, const SurfaceTopologyCache* cache)
+{
+  vtkPoints* inPts = input->GetPoints();
+  vtkPointData* inPD = input->GetPointData();
+  vtkCellData* inCD = input->GetCellData();
+  vtkPointData* outPD = output->GetPointData();
+  vtkCellData* outCD = output->GetCellData();
+  {
+    ScopedPhaseTimer restoreTimer(self->GetMetrics(), "seconds-restore-topology");
+    output->SetVerts(cache->Verts);
+    output->SetLines(cache->Lines);
+    output->SetPolys(cache->Polys);
+    output->SetStrips(cache->Strips);
+  }
+  outPD->CopyGlobalIdsOn();
+  outCD->CopyGlobalIdsOn();
+
+  if (!cache->PointIds) // no merging, just use input points
+  {
+    output->SetPoints(inPts);
+    outPD->PassData(inPD);
+  }
+  else
+  {
+    ScopedPhaseTimer pointsTimer(self->GetMetrics(), "seconds-gather-points");
+    const vtkIdType numOutputPts = cache->PointIds->GetNumberOfTuples();
+    const vtkIdType* pointIds = cache->PointIds->GetPointer(0);
+    vtkNew<vtkPoints> outPts;
+    if (self->GetOutputPointsPrecision() == vtkAlgorithm::DEFAULT_PRECISION)
+    {
+      outPts->SetDataType(inPts->GetDataType());
+    }
+    else if (self->GetOutputPointsPrecision() == vtkAlgorithm::SINGLE_PRECISION)
+    {
+      outPts->SetDataType(VTK_FLOAT);
+    }
+    else if (self->GetOutputPointsPrecision() == vtkAlgorithm::DOUBLE_PRECISION)
+    {
+      outPts->SetDataType(VTK_DOUBLE);
+    }
+    outPts->SetNumberOfPoints(numOutputPts);
+    AttributeGather ptArrays;
+    outPD->CopyAllocate(inPD, numOutputPts);
+    ptArrays.AddArrays(numOutputPts, inPD, outPD);
+
+    using vtkArrayDispatch::Reals;
+    using GatherDispatch = vtkArrayDispatch::Dispatch2ByValueType<Reals, Reals>;
+    vtkDataArray* inX = inPts->GetData();
+    vtkDataArray* outX = outPts->GetData();
+    vtkSMPTools::For(0, numOutputPts,
+      [&](vtkIdType ptId, vtkIdType endPtId)
+      {
+        if (!GatherDispatch::Execute(
+              inX, outX, detail::GatherWorker{}, pointIds + ptId, ptId, endPtId - ptId))
+        { // Fallback to slowpath for other point types
+          for (vtkIdType outId = ptId; outId < endPtId; ++outId)
+          {
+            outX->SetTuple(outId, pointIds[outId], inX);
+          }
+        }
+        ptArrays.Gather(pointIds + ptId, ptId, endPtId - ptId);
+      });
+    output->SetPoints(outPts);
+    if (self->GetPassThroughPointIds())
+    {
+      AddCachedIds(cache->PointIds, self->GetOriginalPointIdsName(), outPD);
+    }
+  }
+
+  ScopedPhaseTimer cellDataTimer(self->GetMetrics(), "seconds-gather-cell-data");
+  const vtkIdType numCells = cache->CellIds->GetNumberOfTuples();
+  const vtkIdType* cellIds = cache->CellIds->GetPointer(0);
+  AttributeGather cellArrays;
+  outCD->CopyAllocate(inCD, numCells);
+  cellArrays.AddArrays(numCells, inCD, outCD);
+  vtkSMPTools::For(0, numCells,
+    [&](vtkIdType cellId, vtkIdType endCellId)
+    { cellArrays.Gather(cellIds + cellId, cellId, endCellId - cellId); });
+  if (self->GetPassThroughCellIds())
+  {
+    AddCachedIds(cache->CellIds, self->GetOriginalCellIdsName(), outCD);
+  }
+  if (cache->RegionIdPairs)
+  {
+    AddCachedIds(cache->RegionIdPairs, self->GetRegionIdPairsName(), outCD);
+  }
+  return 1;
+}
+
 template <typename TInputIdType>
 int ExecuteUnstructuredGrid(vtkGeometryFilterPHash* self, vtkDataSet* dataSetInput, vtkPolyData* output,
   vtkGeometryFilterPHashHelper* info, vtkExcludedFaces<TInputIdType>* exc)
@@ -2892,6 +3551,29 @@ int ExecuteUnstructuredGrid(vtkGeometryFilterPHash* self, vtkDataSet* dataSetInp
     return 0;
   }
   vtkUnstructuredGrid* uGrid = vtkUnstructuredGrid::SafeDownCast(uGridBase);
+  vtkDataArray* cellMask = GetCellMask(self, uGridBase);
+
+  // The surface of an earlier execution on the same cells is kept, and only the points and the
+  // attributes are gathered again.
+  SurfaceTopologyCache* topologyCache =
+    self->GetExtentClipping() || exc->Links ? nullptr : self->GetTopologyCache();
+  std::vector<vtkMTimeType> topologyKey;
+  if (topologyCache)
+  {
+    topologyKey = GetTopologyKey(self, uGridBase, cellMask);
+    if (topologyCache->Matches(topologyKey))
+    {
+      return RestoreSurface(self, uGridBase, output, topologyCache);
+    }
+  }
+
+  std::vector<vtkIdType> regionIds;
+  bool regions = false;
+  if (self->GetRegionIdsArrayName())
+  {
+    ScopedPhaseTimer regionIdsTimer(self->GetMetrics(), "seconds-region-ids");
+    regions = GetRegionIds(self, uGridBase, regionIds);
+  }
 
   // If no info, then compute information about the unstructured grid.
   // Depending on the outcome, we may process the data ourselves, or send over
@@ -2900,6 +3582,7 @@ int ExecuteUnstructuredGrid(vtkGeometryFilterPHash* self, vtkDataSet* dataSetInp
   bool info_owned = false;
   if (info == nullptr)
   {
+    ScopedPhaseTimer characterizeTimer(self->GetMetrics(), "seconds-characterize");
     info = vtkGeometryFilterPHashHelper::CharacterizeUnstructuredGrid(uGridBase);
     info_owned = true;
   }
@@ -2915,7 +3598,7 @@ int ExecuteUnstructuredGrid(vtkGeometryFilterPHash* self, vtkDataSet* dataSetInp
     return 1;
   }
   // fast conversion when input is actually polydata with one cell array
-  if (uGrid &&
+  if (uGrid && !cellMask && !regions &&
     (info->HasOnlyVerts() || info->HasOnlyLines() || info->HasOnlyPolys() || info->HasOnlyStrips()))
   {
     vtkNew<vtkPolyData> polyDataInput;
@@ -2959,10 +3642,6 @@ int ExecuteUnstructuredGrid(vtkGeometryFilterPHash* self, vtkDataSet* dataSetInp
     delete info;
   }
 
-  vtkIdType cellId;
-  vtkIdType npts = 0;
-  vtkNew<vtkIdList> pointIdList;
-  const vtkIdType* pts = nullptr;
   vtkPoints* inPts = uGridBase->GetPoints();
   vtkIdType numInputPts = uGridBase->GetNumberOfPoints(), numOutputPts;
   vtkIdType numCells = uGridBase->GetNumberOfCells();
@@ -3000,8 +3679,11 @@ int ExecuteUnstructuredGrid(vtkGeometryFilterPHash* self, vtkDataSet* dataSetInp
   auto pointMaximum = self->GetPointMaximum();
   auto extentClipping = self->GetExtentClipping();
   auto extent = self->GetExtent();
-  // Determine nature of what we have to do
-  if ((!cellClipping) && (!pointClipping) && (!extentClipping))
+  // Determine nature of what we have to do. Without clipping, an unsigned char cell mask is
+  // the visibility of the cells as it is.
+  const bool clipping = cellClipping || pointClipping || extentClipping;
+  const char* maskVis = clipping ? nullptr : CellVisibility::GetCellMaskValues(cellMask);
+  if ((!clipping && !cellMask) || maskVis)
   {
     cellVis = nullptr;
   }
@@ -3014,36 +3696,34 @@ int ExecuteUnstructuredGrid(vtkGeometryFilterPHash* self, vtkDataSet* dataSetInp
   outPD->CopyGlobalIdsOn();
   outCD->CopyGlobalIdsOn();
 
-  // Loop over the cells determining what's visible. This could be threaded
-  // if necessary - for now it's not used very often so serial.
+  // With a bin grid, only the candidate cells of the extent are classified and extracted, so
+  // the visibility of the other cells is never read.
+  CellBinGrid* binGrid = extentClipping ? self->GetCellBinGrid() : nullptr;
+  std::vector<vtkIdType> candidateCells;
+  if (binGrid)
+  {
+    ScopedPhaseTimer binGridTimer(self->GetMetrics(), "seconds-bin-grid");
+    binGrid->Update(uGridBase);
+    binGrid->FindCandidateCells(extent, candidateCells);
+  }
+
+  // Determine what's visible, in parallel over a mask of the points that pass the clipping.
   if (cellVis)
   {
-    double x[3];
-    for (cellId = 0; cellId < numCells; ++cellId)
+    ScopedPhaseTimer visibilityTimer(self->GetMetrics(), "seconds-cell-visibility");
+    CellVisibility visibility(cellClipping, cellMinimum, cellMaximum, pointClipping, pointMinimum,
+      pointMaximum, extentClipping, extent);
+    visibility.SetCellMask(cellMask);
+    if (binGrid)
     {
-      uGridBase->GetCellPoints(cellId, npts, pts, pointIdList);
-      cellVis[cellId] = 1;
-      if (cellClipping && (cellId < cellMinimum || cellId > cellMaximum))
-      {
-        cellVis[cellId] = 0;
-      }
-      else
-      {
-        for (int i = 0; i < npts; i++)
-        {
-          inPts->GetPoint(pts[i], x);
-          if ((pointClipping && (pts[i] < pointMinimum || pts[i] > pointMaximum)) ||
-            (extentClipping &&
-              (x[0] < extent[0] || x[0] > extent[1] || x[1] < extent[2] || x[1] > extent[3] ||
-                x[2] < extent[4] || x[2] > extent[5])))
-          {
-            cellVis[cellId] = 0;
-            break;
-          } // point/extent clipping
-        }   // for each point
-      }     // if point clipping needs checking
-    }       // for all cells
-  }         // if not all visible
+      visibility.Compute(uGridBase, candidateCells.data(),
+        static_cast<vtkIdType>(candidateCells.size()), cellVis);
+    }
+    else
+    {
+      visibility.Compute(uGridBase, cellVis);
+    }
+  }
 
   // Prepare to generate the output. The cell arrays are of course the output vertex,
   // line, polygon, and triangle strip output. The four IdListType's capture the
@@ -3089,9 +3769,20 @@ int ExecuteUnstructuredGrid(vtkGeometryFilterPHash* self, vtkDataSet* dataSetInp
   // Perform the threaded boundary cell extraction. This performs some
   // initial reduction and allocation of the output. It also computes offsets
   // and sizes for allocation and writing of data.
-  auto* extract =
-    new ExtractUG<TInputIdType>(self, uGridBase, cellVis, cellGhosts, pointGhosts, exc, &threads);
-  vtkSMPTools::For(0, numCells, *extract);
+  auto* extract = new ExtractUG<TInputIdType>(
+    self, uGridBase, maskVis ? maskVis : cellVis, cellGhosts, pointGhosts, exc, &threads);
+  if (binGrid)
+  {
+    extract->SetCellIds(candidateCells.data(), static_cast<vtkIdType>(candidateCells.size()));
+  }
+  if (regions)
+  {
+    extract->SetRegionIds(regionIds.data());
+  }
+  {
+    ScopedPhaseTimer extractTimer(self->GetMetrics(), "seconds-extract");
+    vtkSMPTools::For(0, extract->NumberOfCells, *extract);
+  }
   numCells = extract->NumCells;
   self->UpdateProgress(0.8);
 
@@ -3100,32 +3791,38 @@ int ExecuteUnstructuredGrid(vtkGeometryFilterPHash* self, vtkDataSet* dataSetInp
   // an explicit point dispatch (i.e., the point representation is explicitly
   // represented by a data array as we are processing an unstructured grid).
   TInputIdType* ptMap = extract->PointMap;
+  vtkSmartPointer<vtkIdTypeArray> pointIds;
   if (self->GetMerging())
   {
     using vtkArrayDispatch::Reals;
     using ExpPtsDispatch = vtkArrayDispatch::Dispatch2ByValueType<Reals, Reals>;
     ExpPtsWorker<TInputIdType> compWorker(self);
+    ScopedPhaseTimer pointsTimer(self->GetMetrics(), "seconds-generate-points");
     if (!ExpPtsDispatch::Execute(
           inPts->GetData(), outPts->GetData(), compWorker, numInputPts, inPD, outPD, extract))
     { // Fallback to slowpath for other point types
       compWorker(inPts->GetData(), outPts->GetData(), numInputPts, inPD, outPD, extract);
     }
+    pointsTimer.Stop();
     numOutputPts = compWorker.NumOutputPoints;
 
     // Generate originating point ids if requested and merging is
     // on. (Generating these originating point ids only makes sense if the
-    // points are merged.)
-    if (self->GetPassThroughPointIds())
+    // points are merged.) A topology cache gathers the points through them.
+    if (self->GetPassThroughPointIds() || topologyCache)
     {
-      PassPointIds(self->GetOriginalPointIdsName(), numInputPts, numOutputPts, ptMap, outPD);
+      ScopedPhaseTimer pointIdsTimer(self->GetMetrics(), "seconds-pass-point-ids");
+      pointIds = PassPointIds(self->GetOriginalPointIdsName(), numInputPts, numOutputPts,
+        extract, self->GetPassThroughPointIds() ? outPD : nullptr);
     }
   }
   self->UpdateProgress(0.9);
 
   // Finally we can composite the output topology.
-  ArrayList cellArrays;
+  ScopedPhaseTimer compositeTimer(self->GetMetrics(), "seconds-composite-cells");
+  AttributeGather cellArrays;
   outCD->CopyAllocate(inCD, numCells);
-  cellArrays.AddArrays(numCells, inCD, outCD, 0.0, false);
+  cellArrays.AddArrays(numCells, inCD, outCD);
 
 //#ifdef VTK_USE_64BIT_IDS
 //  vtkIdType connectivitySize =
@@ -3137,13 +3834,28 @@ int ExecuteUnstructuredGrid(vtkGeometryFilterPHash* self, vtkDataSet* dataSetInp
     using TOutputIdType = vtkTypeInt64;
     CompositeCells<TInputIdType, TOutputIdType> compCells(
       ptMap, &cellArrays, extract, &threads, verts, lines, polys, strips, self);
-    vtkSMPTools::For(0, static_cast<vtkIdType>(threads.size()), compCells);
+    vtkSMPTools::For(0, compCells.GetNumberOfChunks(), 1, compCells);
+    compositeTimer.Stop();
 
-    // Generate originating cell ids if requested.
-    if (self->GetPassThroughCellIds())
+    // Generate originating cell ids if requested, or for a topology cache, which gathers the
+    // cell attributes through them.
+    vtkSmartPointer<vtkIdTypeArray> cellIds;
+    if (self->GetPassThroughCellIds() || topologyCache)
     {
-      PassCellIds<TInputIdType, TOutputIdType>(
-        self->GetOriginalCellIdsName(), extract, &compCells, &threads, outCD, self);
+      ScopedPhaseTimer cellIdsTimer(self->GetMetrics(), "seconds-pass-cell-ids");
+      cellIds = PassCellIds<TInputIdType, TOutputIdType>(self->GetOriginalCellIdsName(), extract,
+        &compCells, self->GetPassThroughCellIds() ? outCD : nullptr, self);
+    }
+    vtkSmartPointer<vtkIdTypeArray> regionIdPairs;
+    if (regions)
+    {
+      ScopedPhaseTimer pairsTimer(self->GetMetrics(), "seconds-pass-region-id-pairs");
+      regionIdPairs = PassRegionIdPairs<TInputIdType, TOutputIdType>(
+        self->GetRegionIdPairsName(), regionIds.data(), extract, &compCells, outCD);
+    }
+    if (topologyCache && !self->GetAbortOutput())
+    {
+      topologyCache->Store(topologyKey, output, pointIds, cellIds, regionIdPairs);
     }
   }
 //  else
@@ -3152,13 +3864,13 @@ int ExecuteUnstructuredGrid(vtkGeometryFilterPHash* self, vtkDataSet* dataSetInp
 //    using TOutputIdType = vtkTypeInt32;
 //    CompositeCells<TInputIdType, TOutputIdType> compCells(
 //      ptMap, &cellArrays, extract, &threads, verts, lines, polys, strips, self);
-//    vtkSMPTools::For(0, static_cast<vtkIdType>(threads.size()), compCells);
+//    vtkSMPTools::For(0, compCells.GetNumberOfChunks(), 1, compCells);
 //
 //    // Generate originating cell ids if requested.
 //    if (self->GetPassThroughCellIds())
 //    {
 //      PassCellIds<TInputIdType, TOutputIdType>(
-//        self->GetOriginalCellIdsName(), extract, &compCells, &threads, outCD, self);
+//        self->GetOriginalCellIdsName(), extract, &compCells, outCD, self);
 //    }
 //  }
   self->UpdateProgress(1.0);
@@ -3335,14 +4047,14 @@ int ExecuteStructured(vtkGeometryFilterPHash* self, vtkDataSet* input, vtkPolyDa
   TInputIdType* ptMap = extStr->PointMap;
   if (self->GetPassThroughPointIds() && (inPts == nullptr || mergePts))
   {
-    PassPointIds(self->GetOriginalPointIdsName(), numInputPts, numOutputPts, ptMap, outPD);
+    PassPointIds(self->GetOriginalPointIdsName(), numInputPts, numOutputPts, extStr, outPD);
   }
   self->UpdateProgress(0.75);
 
   // Finally we can composite the output topology.
-  ArrayList cellArrays;
+  AttributeGather cellArrays;
   outCD->CopyAllocate(inCD, numCells);
-  cellArrays.AddArrays(numCells, inCD, outCD, 0.0, false);
+  cellArrays.AddArrays(numCells, inCD, outCD);
 
 //#ifdef VTK_USE_64BIT_IDS
 //  vtkIdType connectivitySize =
@@ -3354,13 +4066,13 @@ int ExecuteStructured(vtkGeometryFilterPHash* self, vtkDataSet* input, vtkPolyDa
     using TOutputIdType = vtkTypeInt64;
     CompositeCells<TInputIdType, TOutputIdType> compCells(
       ptMap, &cellArrays, extStr, &threads, nullptr, nullptr, polys, nullptr, self);
-    vtkSMPTools::For(0, static_cast<vtkIdType>(threads.size()), compCells);
+    vtkSMPTools::For(0, compCells.GetNumberOfChunks(), 1, compCells);
 
     // Generate originating cell ids if requested.
     if (self->GetPassThroughCellIds())
     {
       PassCellIds<TInputIdType, TOutputIdType>(
-        self->GetOriginalCellIdsName(), extStr, &compCells, &threads, outCD, self);
+        self->GetOriginalCellIdsName(), extStr, &compCells, outCD, self);
     }
   }
 //  else
@@ -3369,13 +4081,13 @@ int ExecuteStructured(vtkGeometryFilterPHash* self, vtkDataSet* input, vtkPolyDa
 //    using TOutputIdType = vtkTypeInt32;
 //    CompositeCells<TInputIdType, TOutputIdType> compCells(
 //      ptMap, &cellArrays, extStr, &threads, nullptr, nullptr, polys, nullptr, self);
-//    vtkSMPTools::For(0, static_cast<vtkIdType>(threads.size()), compCells);
+//    vtkSMPTools::For(0, compCells.GetNumberOfChunks(), 1, compCells);
 //
 //    // Generate originating cell ids if requested.
 //    if (self->GetPassThroughCellIds())
 //    {
 //      PassCellIds<TInputIdType, TOutputIdType>(
-//        self->GetOriginalCellIdsName(), extStr, &compCells, &threads, outCD, self);
+//        self->GetOriginalCellIdsName(), extStr, &compCells, outCD, self);
 //    }
 //  }
   self->UpdateProgress(1.0);
@@ -3442,10 +4154,10 @@ int vtkGeometryFilterPHash::StructuredExecute(vtkDataSet* input, vtkPolyData* ou
   assert(dataDim != -1);
 
   // Delegate to the generic dataset processing if structuredGrid is not 3d or cell/point/extent
-  // clipping is requested. Otherwise. use the fast structured algorithms. This is done for
-  // simplification purposes.
+  // clipping or a cell mask is requested. Otherwise. use the fast structured algorithms. This is
+  // done for simplification purposes.
   if (dataDim != 3 || this->GetCellClipping() || this->GetPointClipping() ||
-    this->GetExtentClipping())
+    this->GetExtentClipping() || this->GetCellMaskArrayName())
   {
     return this->DataSetExecute(input, output, excludedFaces);
   }
@@ -3503,11 +4215,7 @@ template <typename TInputIdType>
 int ExecuteDataSet(vtkGeometryFilterPHash* self, vtkDataSet* input, vtkPolyData* output,
   vtkExcludedFaces<TInputIdType>* exc)
 {
-  vtkIdType cellId;
-  int i;
   vtkIdType numCells = input->GetNumberOfCells();
-  double x[3];
-  vtkIdType ptId;
   vtkPointData* inPD = input->GetPointData();
   vtkCellData* inCD = input->GetCellData();
   vtkPointData* outPD = output->GetPointData();
@@ -3542,8 +4250,12 @@ int ExecuteDataSet(vtkGeometryFilterPHash* self, vtkDataSet* input, vtkPolyData*
   auto pointMaximum = self->GetPointMaximum();
   auto extentClipping = self->GetExtentClipping();
   auto extent = self->GetExtent();
-  // Determine nature of what we have to do
-  if ((!cellClipping) && (!pointClipping) && (!extentClipping))
+  vtkDataArray* cellMask = GetCellMask(self, input);
+  // Determine nature of what we have to do. Without clipping, an unsigned char cell mask is
+  // the visibility of the cells as it is.
+  const bool clipping = cellClipping || pointClipping || extentClipping;
+  const char* maskVis = clipping ? nullptr : CellVisibility::GetCellMaskValues(cellMask);
+  if ((!clipping && !cellMask) || maskVis)
   {
     cellVis = nullptr;
   }
@@ -3557,39 +4269,11 @@ int ExecuteDataSet(vtkGeometryFilterPHash* self, vtkDataSet* input, vtkPolyData*
   //
   if (cellVis)
   {
-    vtkNew<vtkGenericCell> cell;
-    vtkIdList* ptIds;
-    for (cellId = 0; cellId < numCells; cellId++)
-    {
-      if (cellClipping && (cellId < cellMinimum || cellId > cellMaximum))
-      {
-        cellVis[cellId] = 0;
-      }
-      else
-      {
-        input->GetCell(cellId, cell);
-        ptIds = cell->GetPointIds();
-        vtkIdType ncells = ptIds->GetNumberOfIds();
-        for (i = 0; i < ncells; i++)
-        {
-          ptId = ptIds->GetId(i);
-          input->GetPoint(ptId, x);
-
-          if ((pointClipping && (ptId < pointMinimum || ptId > pointMaximum)) ||
-            (extentClipping &&
-              (x[0] < extent[0] || x[0] > extent[1] || x[1] < extent[2] || x[1] > extent[3] ||
-                x[2] < extent[4] || x[2] > extent[5])))
-          {
-            cellVis[cellId] = 0;
-            break;
-          }
-        }
-        if (i >= ncells)
-        {
-          cellVis[cellId] = 1;
-        }
-      }
-    }
+    ScopedPhaseTimer visibilityTimer(self->GetMetrics(), "seconds-cell-visibility");
+    CellVisibility visibility(cellClipping, cellMinimum, cellMaximum, pointClipping, pointMinimum,
+      pointMaximum, extentClipping, extent);
+    visibility.SetCellMask(cellMask);
+    visibility.Compute(input, cellVis);
   }
 
   // Create new output points. In a dataset, points are assumed to be
@@ -3621,7 +4305,8 @@ int ExecuteDataSet(vtkGeometryFilterPHash* self, vtkDataSet* input, vtkPolyData*
 
   // The extraction process for vtkDataSet
   ThreadOutputType<TInputIdType> threads;
-  ExtractDS<TInputIdType> extract(self, input, cellVis, cellGhosts, pointGhosts, exc, &threads);
+  ExtractDS<TInputIdType> extract(
+    self, input, maskVis ? maskVis : cellVis, cellGhosts, pointGhosts, exc, &threads);
   vtkSMPTools::For(0, numCells, extract);
   numCells = extract.NumCells;
   self->UpdateProgress(0.8);
@@ -3648,14 +4333,14 @@ int ExecuteDataSet(vtkGeometryFilterPHash* self, vtkDataSet* input, vtkPolyData*
   TInputIdType* ptMap = extract.PointMap;
   if (self->GetPassThroughPointIds())
   {
-    PassPointIds(self->GetOriginalPointIdsName(), numInputPts, numOutputPts, ptMap, outPD);
+    PassPointIds(self->GetOriginalPointIdsName(), numInputPts, numOutputPts, &extract, outPD);
   }
   self->UpdateProgress(0.9);
 
   // Finally we can composite the output topology.
-  ArrayList cellArrays;
+  AttributeGather cellArrays;
   outCD->CopyAllocate(inCD, numCells);
-  cellArrays.AddArrays(numCells, inCD, outCD, 0.0, false);
+  cellArrays.AddArrays(numCells, inCD, outCD);
 
 //#ifdef VTK_USE_64BIT_IDS
 //  vtkIdType connectivitySize =
@@ -3667,13 +4352,13 @@ int ExecuteDataSet(vtkGeometryFilterPHash* self, vtkDataSet* input, vtkPolyData*
     using TOutputIdType = vtkTypeInt64;
     CompositeCells<TInputIdType, TOutputIdType> compCells(
       ptMap, &cellArrays, &extract, &threads, verts, lines, polys, strips, self);
-    vtkSMPTools::For(0, static_cast<vtkIdType>(threads.size()), compCells);
+    vtkSMPTools::For(0, compCells.GetNumberOfChunks(), 1, compCells);
 
     // Generate originating cell ids if requested.
     if (self->GetPassThroughCellIds())
     {
       PassCellIds<TInputIdType, TOutputIdType>(
-        self->GetOriginalCellIdsName(), &extract, &compCells, &threads, outCD, self);
+        self->GetOriginalCellIdsName(), &extract, &compCells, outCD, self);
     }
   }
 //  else
@@ -3682,13 +4367,13 @@ int ExecuteDataSet(vtkGeometryFilterPHash* self, vtkDataSet* input, vtkPolyData*
 //    using TOutputIdType = vtkTypeInt32;
 //    CompositeCells<TInputIdType, TOutputIdType> compCells(
 //      ptMap, &cellArrays, &extract, &threads, verts, lines, polys, strips, self);
-//    vtkSMPTools::For(0, static_cast<vtkIdType>(threads.size()), compCells);
+//    vtkSMPTools::For(0, compCells.GetNumberOfChunks(), 1, compCells);
 //
 //    // Generate originating cell ids if requested.
 //    if (self->GetPassThroughCellIds())
 //    {
 //      PassCellIds<TInputIdType, TOutputIdType>(
-//        self->GetOriginalCellIdsName(), &extract, &compCells, &threads, outCD, self);
+//        self->GetOriginalCellIdsName(), &extract, &compCells, outCD, self);
 //    }
 //  }
   self->UpdateProgress(1.0);
@@ -93,6 +93,10 @@
 
 #include <array> // For std::array
 
+class CellBinGrid;
+class MetricSink;
+class SurfaceTopologyCache;
+
 VTK_ABI_NAMESPACE_BEGIN
 class vtkIncrementalPointLocator;
 class vtkStructuredGrid;
@@ -244,6 +248,39 @@ public:
   vtkBooleanMacro(Merging, bool);
   ///@}
 
+  /**
+   * Ways of tracking which input points are used by the output when merging
+   * points.
+   */
+  enum PointMapModes
+  {
+    POINT_MAP_ARRAY = 0,
+    POINT_MAP_BITSET = 1,
+    POINT_MAP_FUSED = 2
+  };
+
+  ///@{
+  /**
+   * Specify how the used points are tracked when merging points. With
+   * POINT_MAP_ARRAY (the default), extraction writes into a point map of one
+   * id per input point, which is then turned into the map from input to
+   * output point ids. With POINT_MAP_BITSET, extraction sets one bit per used
+   * point, and the output ids are derived from a parallel prefix sum over the
+   * number of set bits of each word, so that no map of one id per input point
+   * is ever written. With POINT_MAP_FUSED, a point gets its output id when a
+   * thread first touches it during extraction, from blocks of ids taken by
+   * each thread, so the extracted connectivity is already renumbered and the
+   * output points are gathered without visiting all input points. The output
+   * points are then ordered by first touch, which depends on the scheduling
+   * of the threads.
+   */
+  vtkSetClampMacro(PointMapMode, int, POINT_MAP_ARRAY, POINT_MAP_FUSED);
+  vtkGetMacro(PointMapMode, int);
+  void SetPointMapModeToArray() { this->SetPointMapMode(POINT_MAP_ARRAY); }
+  void SetPointMapModeToBitset() { this->SetPointMapMode(POINT_MAP_BITSET); }
+  void SetPointMapModeToFused() { this->SetPointMapMode(POINT_MAP_FUSED); }
+  ///@}
+
   ///@{
   /**
    * Set/get the desired precision for the output types. See the
@@ -405,6 +442,81 @@ public:
   vtkBooleanMacro(Delegation, vtkTypeBool);
   ///@}
 
+  ///@{
+  /**
+   * Set / get the name of a cell data array that masks the cells of the input,
+   * a vtkUnsignedCharArray or vtkBitArray with one component. The cells with a
+   * zero value are skipped as if they were not in the input, so that the faces
+   * they share with the other cells are external, which extracts the boundary
+   * of a selection of cells, e.g. of a material, without first copying it into
+   * a new data set. The mask is combined with the point, cell and extent
+   * clipping, and does not apply to vtkPolyData inputs. The default is nullptr,
+   * which uses all cells.
+   */
+  vtkSetStringMacro(CellMaskArrayName);
+  vtkGetStringMacro(CellMaskArrayName);
+  ///@}
+
+  ///@{
+  /**
+   * Set / get the name of a cell data array with one integral component that
+   * holds the region, e.g. the material, of each cell of an unstructured grid
+   * input. A face shared by two cells of different regions is then kept as an
+   * interface, in the same pass that finds the external faces. It belongs to
+   * the cell of the lower region, and thus faces the other one. The output
+   * gets a cell data array with two components, named by
+   * SetRegionIdPairsName(), that holds the region of the originating cell and
+   * the region of the cell on the other side, or -1 for the external faces.
+   * The default is nullptr, which removes all shared faces.
+   */
+  vtkSetStringMacro(RegionIdsArrayName);
+  vtkGetStringMacro(RegionIdsArrayName);
+  vtkSetStringMacro(RegionIdPairsName);
+  virtual const char* GetRegionIdPairsName()
+  {
+    return (this->RegionIdPairsName ? this->RegionIdPairsName : "vtkRegionIdPairs");
+  }
+  ///@}
+
+  ///@{
+  /**
+   * Set / get the sink to which the execution adds the seconds of its phases,
+   * e.g. seconds-extract, which must outlive the execution. The default is
+   * nullptr, which times nothing.
+   */
+  void SetMetrics(MetricSink* metrics) { this->Metrics = metrics; }
+  MetricSink* GetMetrics() const { return this->Metrics; }
+  ///@}
+
+  ///@{
+  /**
+   * Set / get a grid of bins over the cells of the input, which must outlive
+   * the execution. With extent clipping on and an unstructured grid input,
+   * the grid is updated for the input, which only rebuilds it if the points
+   * or cells of the input changed, and only the cells of the bins that
+   * overlap the extent are classified and extracted. The grid can be shared
+   * by filters that process the same input. The default is nullptr, which
+   * visits all cells.
+   */
+  void SetCellBinGrid(CellBinGrid* grid) { this->BinGrid = grid; }
+  CellBinGrid* GetCellBinGrid() const { return this->BinGrid; }
+  ///@}
+
+  ///@{
+  /**
+   * Set / get a cache of the extracted surface, which must outlive the
+   * execution. With an unstructured grid input, the cells of the output and
+   * the input ids of its points and cells are stored after an execution,
+   * and a later execution with the same cells, ghost arrays, cell mask,
+   * regions and settings only gathers the points and the attributes of the
+   * input again, e.g. when only the points change over time. Extent
+   * clipping and excluded faces extract the surface every time. The default
+   * is nullptr, which extracts the surface every time.
+   */
+  void SetTopologyCache(SurfaceTopologyCache* cache) { this->TopologyCache = cache; }
+  SurfaceTopologyCache* GetTopologyCache() const { return this->TopologyCache; }
+  ///@}
+
   ///@{
   /**
    * Set/Get if Ghost interfaces will be removed.
@@ -472,6 +584,7 @@ protected:
   bool RemoveGhostInterfaces;
 
   bool Merging;
+  int PointMapMode;
   vtkIncrementalPointLocator* Locator;
 
   bool FastMode;
@@ -487,6 +600,12 @@ protected:
   int NonlinearSubdivisionLevel;
 
   vtkTypeBool Delegation;
+  char* CellMaskArrayName;
+  char* RegionIdsArrayName;
+  char* RegionIdPairsName;
+  MetricSink* Metrics;
+  CellBinGrid* BinGrid;
+  SurfaceTopologyCache* TopologyCache;
 
 private:
   vtkGeometryFilterPHash(const vtkGeometryFilterPHash&) = delete;
@@ -43,6 +43,8 @@
 #include "vtkVoxel.h"
 #include "vtkWedge.h"
 
+#include "PhaseTimer.h"
+
 vtkStandardNewMacro(vtkGeometryFilterSClassifier);
 vtkCxxSetObjectMacro(vtkGeometryFilterSClassifier, Locator, vtkIncrementalPointLocator);
 
@@ -70,6 +72,9 @@ vtkGeometryFilterSClassifier::vtkGeometryFilterSClassifier()
   this->Merging = 1;
   this->Locator = nullptr;
   this->OutputPointsPrecision = DEFAULT_PRECISION;
+
+  // No timing of the phases by default.
+  this->Metrics = nullptr;
 }
 
 //------------------------------------------------------------------------------
@@ -675,6 +680,7 @@ void vtkGeometryFilterSClassifier::UnstructuredGridExecute(vtkDataSet* dataSetIn
   // Loop over the cells determining what's visible
   if (!allVisible)
   {
+    ScopedPhaseTimer visibilityTimer(this->Metrics, "seconds-cell-visibility");
     for (cellIter->GoToFirstCell(); !cellIter->IsDoneWithTraversal(); cellIter->GoToNextCell())
     {
       cellId = cellIter->GetCurrentCellId();
@@ -723,6 +729,7 @@ void vtkGeometryFilterSClassifier::UnstructuredGridExecute(vtkDataSet* dataSetIn
 
   // Loop over all cells now that visibility is known
   // (Have to compute visibility first for 3D cell boundaries)
+  ScopedPhaseTimer extractTimer(this->Metrics, "seconds-extract");
   int progressInterval = numCells / 20 + 1;
   for (cellIter->GoToFirstCell(); !cellIter->IsDoneWithTraversal(); cellIter->GoToNextCell())
   {
@@ -1038,6 +1045,7 @@ void vtkGeometryFilterSClassifier::UnstructuredGridExecute(vtkDataSet* dataSetIn
       }        // switch
     }          // if visible
   }            // for all cells
+  extractTimer.Stop();
 
   // Update ourselves and release memory
   //
@@ -1051,6 +1059,7 @@ void vtkGeometryFilterSClassifier::UnstructuredGridExecute(vtkDataSet* dataSetIn
   strips->Delete();
 
   // Copy the cell data in appropriate order : verts / lines / polys / strips
+  ScopedPhaseTimer cellDataTimer(this->Metrics, "seconds-copy-cell-data");
   size_t offset = 0;
   size_t size = vertCellIds.size();
   for (size_t i = 0; i < size; ++i)
@@ -1075,6 +1084,7 @@ void vtkGeometryFilterSClassifier::UnstructuredGridExecute(vtkDataSet* dataSetIn
   {
     outputCD->CopyData(cd, stripCellIds[i], static_cast<vtkIdType>(i + offset));
   }
+  cellDataTimer.Stop();
 
   output->Squeeze();
 
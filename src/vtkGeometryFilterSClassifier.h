@@ -57,6 +57,8 @@
 #include "vtkFiltersGeometryModule.h" // For export macro
 #include "vtkPolyDataAlgorithm.h"
 
+class MetricSink;
+
 class vtkIncrementalPointLocator;
 
 class VTKFILTERSGEOMETRY_EXPORT vtkGeometryFilterSClassifier : public vtkPolyDataAlgorithm
@@ -179,6 +181,16 @@ public:
   int GetOutputPointsPrecision() const;
   //@}
 
+  //@{
+  /**
+   * Set / get the sink to which the execution adds the seconds of its phases,
+   * e.g. seconds-extract, which must outlive the execution. The default is
+   * nullptr, which times nothing.
+   */
+  void SetMetrics(MetricSink* metrics) { this->Metrics = metrics; }
+  MetricSink* GetMetrics() const { return this->Metrics; }
+  //@}
+
 protected:
   vtkGeometryFilterSClassifier();
   ~vtkGeometryFilterSClassifier() override;
@@ -204,6 +216,7 @@ protected:
 
   vtkTypeBool Merging;
   vtkIncrementalPointLocator* Locator;
+  MetricSink* Metrics;
 
 private:
   vtkGeometryFilterSClassifier(const vtkGeometryFilterSClassifier&) = delete;